@@ -14,6 +14,9 @@ MyStackViewPage
     headerText: "OpenVR Motion Compensation"
     headerShowBackButton: false
 
+    // Bumped whenever the driver published new pose statistics, the device rows re-read them then
+    property int poseStatisticsRevision: 0
+
     // Generic popup
     MyDialogOkPopup
     {
@@ -78,6 +81,14 @@ MyStackViewPage
                 id: hmdStatusText
                 text: ""
             }
+
+            MyText
+            {
+                id: hmdPoseStatisticsText
+                Layout.leftMargin: 30
+                font.pointSize: 16
+                text: ""
+            }
         }
 
         RowLayout
@@ -155,6 +166,117 @@ MyStackViewPage
                 id: referenceTrackerStatusText
                 text: ""
             }
+
+            MyText
+            {
+                id: referenceTrackerPoseStatisticsText
+                Layout.leftMargin: 30
+                font.pointSize: 16
+                text: ""
+            }
+        }
+
+        RowLayout
+        {
+            Rectangle
+            {
+                color: "#ffffff"
+                height: 1
+                Layout.fillWidth: true
+            }
+        }
+
+        // Motion compensated controllers and trackers
+        MyText
+        {
+            text: "Also compensate (offset in cm), or fuse as additional reference tracker (Ref, applied on enable):"
+        }
+
+        ColumnLayout
+        {
+            spacing: 6
+
+            Repeater
+            {
+                id: compensatedDevicesRepeater
+                model: []
+
+                delegate: RowLayout
+                {
+                    property int openVRId: modelData
+                    spacing: 12
+
+                    CheckBox
+                    {
+                        id: compensatedCheckBox
+                        checked: DeviceManipulationTabController.isDeviceCompensated(openVRId)
+                        onClicked:
+                        {
+                            if (!DeviceManipulationTabController.setDeviceCompensated(openVRId, checked))
+                            {
+                                deviceManipulationMessageDialog.showMessage("Compensated devices", "Could not change the device:\n" + DeviceManipulationTabController.getDeviceModeErrorString())
+                            }
+                            checked = DeviceManipulationTabController.isDeviceCompensated(openVRId)
+                            referenceCheckBox.checked = DeviceManipulationTabController.isDeviceReference(openVRId)
+                        }
+                    }
+
+                    CheckBox
+                    {
+                        id: referenceCheckBox
+                        text: "Ref"
+                        checked: DeviceManipulationTabController.isDeviceReference(openVRId)
+                        onClicked:
+                        {
+                            if (!DeviceManipulationTabController.setDeviceReference(openVRId, checked))
+                            {
+                                deviceManipulationMessageDialog.showMessage("Reference trackers", "Could not change the device:\n" + DeviceManipulationTabController.getDeviceModeErrorString())
+                            }
+                            checked = DeviceManipulationTabController.isDeviceReference(openVRId)
+                            compensatedCheckBox.checked = DeviceManipulationTabController.isDeviceCompensated(openVRId)
+                        }
+                    }
+
+                    MyText
+                    {
+                        Layout.preferredWidth: 400
+                        elide: Text.ElideRight
+                        text: deviceName(openVRId)
+                    }
+
+                    Repeater
+                    {
+                        model: 3
+
+                        MyTextField
+                        {
+                            property int axis: index
+                            keyBoardUID: 100 + openVRId * 3 + axis
+                            Layout.preferredWidth: 110
+                            horizontalAlignment: Text.AlignHCenter
+                            text: DeviceManipulationTabController.getDeviceOffset(openVRId, axis).toFixed(1)
+                            function onInputEvent(input)
+                            {
+                                var val = parseFloat(input)
+                                if (!isNaN(val))
+                                {
+                                    if (!DeviceManipulationTabController.setDeviceOffset(openVRId, axis, val))
+                                    {
+                                        deviceManipulationMessageDialog.showMessage("Compensated devices", "Could not set the offset:\n" + DeviceManipulationTabController.getDeviceModeErrorString())
+                                    }
+                                }
+                                text = DeviceManipulationTabController.getDeviceOffset(openVRId, axis).toFixed(1)
+                            }
+                        }
+                    }
+
+                    MyText
+                    {
+                        font.pointSize: 14
+                        text: { poseStatisticsRevision; return DeviceManipulationTabController.getPoseStatisticsText(openVRId) }
+                    }
+                }
+            }
         }
 
         RowLayout
@@ -207,9 +329,22 @@ MyStackViewPage
                 }
             }
 
+            // Diagnostics button
+            MyPushButton
+            {
+                Layout.preferredWidth: 200
+                Layout.topMargin: 20
+                Layout.bottomMargin: 35
+                text: "Diagnostics"
+                onClicked:
+                {
+                    var res = mainView.push(diagnosticsPage)
+                }
+            }
+
             Item
             {
-               Layout.preferredWidth: 710
+               Layout.preferredWidth: 500
             }
 
             // Apply button
@@ -300,6 +435,7 @@ MyStackViewPage
             }
             function onDeviceInfoChanged(index)
             {
+                compensatedDevicesRepeater.model = compensatedDevicesRepeater.model.slice()
                 if (index == hmdSelectionComboBox.currentIndex)
                 {
                     fetchHMDInfo()
@@ -310,14 +446,37 @@ MyStackViewPage
             {
                 debugLoggerButton.text = DeviceManipulationTabController.getDebugModeButtonText()
             }
+            function onPoseStatisticsChanged()
+            {
+                fetchPoseStatistics()
+            }
         }
 
     }
 
+    function deviceName(openVRId)
+    {
+        var name = openVRId.toString() + ": " + DeviceManipulationTabController.getDeviceSerial(openVRId)
+        var deviceClass = DeviceManipulationTabController.getDeviceClass(openVRId)
+        var deviceMode = DeviceManipulationTabController.getDeviceMode(openVRId)
+
+        name += deviceClass == 2 ? " (Controller)" : " (Tracker)"
+        if (deviceMode == 1)
+        {
+            name += " - Reference Tracker"
+        }
+        else if (deviceMode == 2)
+        {
+            name += " - Motion Compensated"
+        }
+        return name
+    }
+
     function fetchDevices()
     {
         var hmds = []
         var tracker = []
+        var trackerIds = []
         var oldHMDIndex = hmdSelectionComboBox.currentIndex
         var oldtrackerIndex = referenceTrackerSelectionComboBox.currentIndex
         var deviceCount = DeviceManipulationTabController.getDeviceCount()
@@ -352,6 +511,7 @@ MyStackViewPage
             if (deviceClass == 2 || deviceClass == 3)
             {
                 tracker.push(deviceName)
+                trackerIds.push(openVRId)
                 DeviceManipulationTabController.setTrackerArrayID(i, tracker.length - 1)
                 ++trackerCount
             }
@@ -359,6 +519,7 @@ MyStackViewPage
 
         hmdSelectionComboBox.model = hmds
         referenceTrackerSelectionComboBox.model = tracker
+        compensatedDevicesRepeater.model = trackerIds
 
         if (hmdCount < 1 || trackerCount < 1)
         {   
@@ -480,6 +641,19 @@ MyStackViewPage
         }
     }
 
+    function fetchPoseStatistics()
+    {
+        if (hmdSelectionComboBox.currentIndex >= 0)
+        {
+            hmdPoseStatisticsText.text = DeviceManipulationTabController.getPoseStatisticsText(DeviceManipulationTabController.getHMDDeviceID(hmdSelectionComboBox.currentIndex))
+        }
+        if (referenceTrackerSelectionComboBox.currentIndex >= 0)
+        {
+            referenceTrackerPoseStatisticsText.text = DeviceManipulationTabController.getPoseStatisticsText(DeviceManipulationTabController.getTrackerDeviceID(referenceTrackerSelectionComboBox.currentIndex))
+        }
+        poseStatisticsRevision++
+    }
+
     function fetchTrackerInfo()
     {
         var index = referenceTrackerSelectionComboBox.currentIndex
@@ -0,0 +1,118 @@
+import QtQuick 2.9
+import QtQuick.Controls 2.0
+import QtQuick.Layouts 1.3
+import ovrmc.motioncompensation 1.0
+
+MyStackViewPage
+{
+    id: diagnosticsPage
+	width: 1200
+	height: 800
+    headerText: "Diagnostics"
+
+	property var columnWidths: [ 300, 220, 130, 100, 100, 100, 100, 100 ]
+	property var columnTitles: [ "Device", "Stage", "Count", "p50", "p90", "p99", "p99.9", "Max" ]
+
+	// Rebuilds the table from the statistics the driver reports right now
+	function refreshLatency()
+	{
+		DeviceManipulationTabController.updateLatencyStatistics()
+		latencyRepeater.model = 0
+		latencyRepeater.model = DeviceManipulationTabController.getLatencyRowCount()
+		latencyEmptyText.visible = latencyRepeater.model == 0
+	}
+
+	// Polls the driver while the page is shown
+	Timer
+	{
+		id: latencyTimer
+		interval: 1000
+		repeat: true
+		running: diagnosticsPage.visible
+		triggeredOnStart: true
+		onTriggered:
+		{
+			refreshLatency()
+		}
+	}
+
+    content: ColumnLayout
+    {
+        spacing: 12
+
+		MyText
+		{
+			text: "Time the driver spends on the pose updates of each device, in microseconds:"
+			font.pointSize: 16
+		}
+
+		RowLayout
+		{
+			Repeater
+			{
+				model: columnTitles.length
+				MyText
+				{
+					Layout.preferredWidth: columnWidths[index]
+					horizontalAlignment: index < 2 ? Text.AlignLeft : Text.AlignRight
+					text: columnTitles[index]
+				}
+			}
+		}
+
+		Rectangle
+		{
+			color: "#cccccc"
+			height: 1
+			Layout.fillWidth: true
+		}
+
+		Repeater
+		{
+			id: latencyRepeater
+			model: 0
+			RowLayout
+			{
+				property int row: index
+				Repeater
+				{
+					model: columnTitles.length
+					MyText
+					{
+						Layout.preferredWidth: columnWidths[index]
+						horizontalAlignment: index < 2 ? Text.AlignLeft : Text.AlignRight
+						elide: Text.ElideRight
+						font.pointSize: 16
+						text: DeviceManipulationTabController.getLatencyRowText(row, index)
+					}
+				}
+			}
+		}
+
+		MyText
+		{
+			id: latencyEmptyText
+			font.pointSize: 16
+			text: "No pose updates timed yet. The driver may also have been built without latency histograms."
+		}
+
+		Item
+		{
+			Layout.fillHeight: true
+		}
+
+		RowLayout
+		{
+			MyPushButton
+			{
+				Layout.preferredWidth: 200
+				text: "Reset"
+				onClicked:
+				{
+					DeviceManipulationTabController.resetLatencyStatistics()
+					refreshLatency()
+				}
+			}
+		}
+    }
+}
@@ -72,7 +72,8 @@ MyStackViewPage
                 Layout.preferredWidth: 518
                 Layout.fillWidth: true
                 model: [
-                    "Reference Tracker"
+                    "Reference Tracker",
+                    "Rig Pose (shared memory)"
                 ]
                 onCurrentIndexChanged:
                 {
@@ -84,6 +85,42 @@ MyStackViewPage
             }
         }
 
+        // Reference tracker filter
+        GridLayout
+        {
+            columns: 2
+
+            MyText
+            {
+                Layout.preferredWidth: 360
+                Layout.leftMargin: 0
+                Layout.rightMargin: 0
+                horizontalAlignment: Text.AlignLeft
+                text: "Reference Tracker Filter:"
+            }
+
+            MyComboBox
+            {
+                id: filterTypeComboBox
+                Layout.maximumWidth: 518
+                Layout.minimumWidth: 518
+                Layout.preferredWidth: 518
+                Layout.fillWidth: true
+                model: [
+                    "DEMA + LPF",
+                    "Kalman",
+                    "One Euro"
+                ]
+                onCurrentIndexChanged:
+                {
+                    if (currentIndex >= 0)
+                    {
+                        DeviceManipulationTabController.setFilterType(currentIndex)
+                    }
+                }
+            }
+        }
+
         // LPF Beta Value
         GridLayout
         {
@@ -218,6 +255,341 @@ MyStackViewPage
             }
         }
 
+        // Kalman process noise
+        GridLayout
+        {
+            columns: 5
+
+            MyText
+            {
+                Layout.preferredWidth: 360
+                Layout.leftMargin: 0
+                Layout.rightMargin: 0
+                horizontalAlignment: Text.AlignLeft
+                text: "Kalman process noise:"
+            }
+
+            MyPushButton2
+            {
+                id: kalmanProcessNoiseDecreaseButton
+                Layout.leftMargin: 0
+                Layout.preferredWidth: 45
+                text: "-"
+                onClicked:
+                {
+                    DeviceManipulationTabController.scaleKalmanProcessNoise(0.5);
+                }
+            }
+
+            MyTextField
+            {
+                id: kalmanProcessNoiseInputField
+                text: "0"
+                keyBoardUID: 21
+                Layout.preferredWidth: 140
+                Layout.leftMargin: 10
+                Layout.rightMargin: 10
+                horizontalAlignment: Text.AlignHCenter
+                function onInputEvent(input)
+                {
+                    var val = parseFloat(input)
+                    if (!isNaN(val))
+                    {
+                        if (!DeviceManipulationTabController.setKalmanProcessNoise(val))
+                        {
+                            deviceManipulationMessageDialog.showMessage("Kalman process noise", "Could not set new value:\n" + DeviceManipulationTabController.getDeviceModeErrorString())
+                        }
+                    }
+                    text = DeviceManipulationTabController.getKalmanProcessNoise().toPrecision(4)
+                }
+            }
+
+            MyPushButton2
+            {
+                id: kalmanProcessNoiseIncreaseButton
+                Layout.preferredWidth: 45
+                text: "+"
+                onClicked:
+                {
+                    DeviceManipulationTabController.scaleKalmanProcessNoise(2.0);
+                }
+            }
+
+            MyText
+            {
+                Layout.leftMargin: 110
+                text: "higher = less lag"
+            }
+        }
+
+        // Kalman observation noise
+        GridLayout
+        {
+            columns: 5
+
+            MyText
+            {
+                Layout.preferredWidth: 360
+                Layout.leftMargin: 0
+                Layout.rightMargin: 0
+                horizontalAlignment: Text.AlignLeft
+                text: "Kalman observation noise (m / rad):"
+            }
+
+            MyPushButton2
+            {
+                id: kalmanObservationNoiseDecreaseButton
+                Layout.leftMargin: 0
+                Layout.preferredWidth: 45
+                text: "-"
+                onClicked:
+                {
+                    DeviceManipulationTabController.increaseKalmanObservationNoise(-0.0001);
+                }
+            }
+
+            MyTextField
+            {
+                id: kalmanObservationNoiseInputField
+                text: "0"
+                keyBoardUID: 22
+                Layout.preferredWidth: 140
+                Layout.leftMargin: 10
+                Layout.rightMargin: 10
+                horizontalAlignment: Text.AlignHCenter
+                function onInputEvent(input)
+                {
+                    var val = parseFloat(input)
+                    if (!isNaN(val))
+                    {
+                        if (!DeviceManipulationTabController.setKalmanObservationNoise(val))
+                        {
+                            deviceManipulationMessageDialog.showMessage("Kalman observation noise", "Could not set new value:\n" + DeviceManipulationTabController.getDeviceModeErrorString())
+                        }
+                    }
+                    text = DeviceManipulationTabController.getKalmanObservationNoise().toFixed(4)
+                }
+            }
+
+            MyPushButton2
+            {
+                id: kalmanObservationNoiseIncreaseButton
+                Layout.preferredWidth: 45
+                text: "+"
+                onClicked:
+                {
+                    DeviceManipulationTabController.increaseKalmanObservationNoise(0.0001);
+                }
+            }
+
+            MyText
+            {
+                Layout.leftMargin: 110
+                text: "0 < value"
+            }
+        }
+
+        // Kalman prediction
+        GridLayout
+        {
+            columns: 5
+
+            MyText
+            {
+                Layout.preferredWidth: 360
+                Layout.leftMargin: 0
+                Layout.rightMargin: 0
+                horizontalAlignment: Text.AlignLeft
+                text: "Kalman prediction (ms):"
+            }
+
+            MyPushButton2
+            {
+                id: kalmanPredictionDecreaseButton
+                Layout.leftMargin: 0
+                Layout.preferredWidth: 45
+                text: "-"
+                onClicked:
+                {
+                    DeviceManipulationTabController.increaseKalmanPrediction(-1.0);
+                }
+            }
+
+            MyTextField
+            {
+                id: kalmanPredictionInputField
+                text: "0"
+                keyBoardUID: 23
+                Layout.preferredWidth: 140
+                Layout.leftMargin: 10
+                Layout.rightMargin: 10
+                horizontalAlignment: Text.AlignHCenter
+                function onInputEvent(input)
+                {
+                    var val = parseFloat(input)
+                    if (!isNaN(val))
+                    {
+                        if (!DeviceManipulationTabController.setKalmanPrediction(val))
+                        {
+                            deviceManipulationMessageDialog.showMessage("Kalman prediction", "Could not set new value:\n" + DeviceManipulationTabController.getDeviceModeErrorString())
+                        }
+                    }
+                    text = DeviceManipulationTabController.getKalmanPrediction().toFixed(1)
+                }
+            }
+
+            MyPushButton2
+            {
+                id: kalmanPredictionIncreaseButton
+                Layout.preferredWidth: 45
+                text: "+"
+                onClicked:
+                {
+                    DeviceManipulationTabController.increaseKalmanPrediction(1.0);
+                }
+            }
+
+            MyText
+            {
+                Layout.leftMargin: 110
+                text: "0 <= ms <= 50"
+            }
+        }
+
+        // One Euro min cutoff
+        GridLayout
+        {
+            columns: 5
+
+            MyText
+            {
+                Layout.preferredWidth: 360
+                Layout.leftMargin: 0
+                Layout.rightMargin: 0
+                horizontalAlignment: Text.AlignLeft
+                text: "One Euro min cutoff (Hz):"
+            }
+
+            MyPushButton2
+            {
+                id: oneEuroMinCutoffDecreaseButton
+                Layout.leftMargin: 0
+                Layout.preferredWidth: 45
+                text: "-"
+                onClicked:
+                {
+                    DeviceManipulationTabController.increaseOneEuroMinCutoff(-0.1);
+                }
+            }
+
+            MyTextField
+            {
+                id: oneEuroMinCutoffInputField
+                text: "0"
+                keyBoardUID: 24
+                Layout.preferredWidth: 140
+                Layout.leftMargin: 10
+                Layout.rightMargin: 10
+                horizontalAlignment: Text.AlignHCenter
+                function onInputEvent(input)
+                {
+                    var val = parseFloat(input)
+                    if (!isNaN(val))
+                    {
+                        if (!DeviceManipulationTabController.setOneEuroMinCutoff(val))
+                        {
+                            deviceManipulationMessageDialog.showMessage("One Euro min cutoff", "Could not set new value:\n" + DeviceManipulationTabController.getDeviceModeErrorString())
+                        }
+                    }
+                    text = DeviceManipulationTabController.getOneEuroMinCutoff().toFixed(2)
+                }
+            }
+
+            MyPushButton2
+            {
+                id: oneEuroMinCutoffIncreaseButton
+                Layout.preferredWidth: 45
+                text: "+"
+                onClicked:
+                {
+                    DeviceManipulationTabController.increaseOneEuroMinCutoff(0.1);
+                }
+            }
+
+            MyText
+            {
+                Layout.leftMargin: 110
+                text: "lower = less jitter"
+            }
+        }
+
+        // One Euro beta
+        GridLayout
+        {
+            columns: 5
+
+            MyText
+            {
+                Layout.preferredWidth: 360
+                Layout.leftMargin: 0
+                Layout.rightMargin: 0
+                horizontalAlignment: Text.AlignLeft
+                text: "One Euro beta:"
+            }
+
+            MyPushButton2
+            {
+                id: oneEuroBetaDecreaseButton
+                Layout.leftMargin: 0
+                Layout.preferredWidth: 45
+                text: "-"
+                onClicked:
+                {
+                    DeviceManipulationTabController.increaseOneEuroBeta(-0.1);
+                }
+            }
+
+            MyTextField
+            {
+                id: oneEuroBetaInputField
+                text: "0"
+                keyBoardUID: 25
+                Layout.preferredWidth: 140
+                Layout.leftMargin: 10
+                Layout.rightMargin: 10
+                horizontalAlignment: Text.AlignHCenter
+                function onInputEvent(input)
+                {
+                    var val = parseFloat(input)
+                    if (!isNaN(val))
+                    {
+                        if (!DeviceManipulationTabController.setOneEuroBeta(val))
+                        {
+                            deviceManipulationMessageDialog.showMessage("One Euro beta", "Could not set new value:\n" + DeviceManipulationTabController.getDeviceModeErrorString())
+                        }
+                    }
+                    text = DeviceManipulationTabController.getOneEuroBeta().toFixed(2)
+                }
+            }
+
+            MyPushButton2
+            {
+                id: oneEuroBetaIncreaseButton
+                Layout.preferredWidth: 45
+                text: "+"
+                onClicked:
+                {
+                    DeviceManipulationTabController.increaseOneEuroBeta(0.1);
+                }
+            }
+
+            MyText
+            {
+                Layout.leftMargin: 110
+                text: "higher = less lag"
+            }
+        }
+
 		// Set Vel + Acc to zero
 		RowLayout
 		{
@@ -242,6 +614,33 @@ MyStackViewPage
 			}
 		}
 
+		// Keep the last seconds of poses in the driver and dump them on an anomaly or the shortcut
+		RowLayout
+		{
+		spacing: 18
+			MyText
+			{
+				text: "Flight recorder:"
+			}
+
+			Item
+			{
+				Layout.preferredWidth: 80
+			}
+
+			CheckBox
+			{
+				id: flightRecorderCheckBox
+				onCheckedChanged:
+				{
+					if (flightRecorderCheckBox.checked != DeviceManipulationTabController.getFlightRecorder())
+					{
+						DeviceManipulationTabController.setFlightRecorder(flightRecorderCheckBox.checked)
+					}
+				}
+			}
+		}
+
 		// Start of section "Offsets"
 		RowLayout
 		{
@@ -755,6 +1154,56 @@ MyStackViewPage
 			}
         }
 
+        GridLayout
+        {
+			columns: 3
+
+            MyText
+            {
+                Layout.preferredWidth: 360
+                Layout.leftMargin: 0
+                Layout.rightMargin: 0
+                horizontalAlignment: Text.AlignLeft
+                text: "Dump Flight Recorder:"
+            }
+
+			MyPushButton
+			{
+				id: btn_dumpFlightRecorder
+				Layout.preferredWidth: 200
+				Layout.topMargin: 0
+				Layout.bottomMargin: 0
+				text: ""
+				onClicked:
+				{
+					if (DeviceManipulationTabController.isDesktopModeActive())
+					{
+						keybinding.showPopup(2);
+					}
+					else
+					{
+						deviceManipulationMessageDialog.showMessage("Shortcuts", "Due to SteamVR limitations, shortcuts\ncan only be set in desktop mode!")
+					}
+				}
+			}
+
+			MyPushButtonIcon
+			{
+				id: btn_dumpFlightRecorder_Remove
+				Layout.preferredWidth: 45
+				Layout.preferredHeight: 45
+				Layout.leftMargin: 20
+				Layout.topMargin: 0
+				Layout.bottomMargin: 0
+				imagesource : "octicons-trashcan.png"
+				onClicked:
+				{
+					DeviceManipulationTabController.removeKey(2);
+					refreshButtonText();
+				}
+			}
+        }
+
         Item
         {
             Layout.fillWidth: true
@@ -774,7 +1223,11 @@ MyStackViewPage
         {
             lpfBetaInputField.text = DeviceManipulationTabController.getLPFBeta().toFixed(4)
             samplesInputField.text = DeviceManipulationTabController.getSamples()
+            mcModeComboBox.currentIndex = DeviceManipulationTabController.getMotionCompensationMode()
+            filterTypeComboBox.currentIndex = DeviceManipulationTabController.getFilterType()
+            updateFilterFields()
 			setZeroCheckBox.checked = DeviceManipulationTabController.getZeroMode()
+			flightRecorderCheckBox.checked = DeviceManipulationTabController.getFlightRecorder()
 			refreshButtonText()
 			updateOffsets()
         }
@@ -786,6 +1239,7 @@ MyStackViewPage
             {
                 lpfBetaInputField.text = DeviceManipulationTabController.getLPFBeta().toFixed(4)
                 samplesInputField.text = DeviceManipulationTabController.getSamples()
+                updateFilterFields()
             }
 
 			function onOffsetChanged()
@@ -805,9 +1259,19 @@ MyStackViewPage
 		rollInputField.text = DeviceManipulationTabController.getHMDtoRefRotationOffset(2).toFixed(3)
 	}
 
+	function updateFilterFields()
+	{
+		kalmanProcessNoiseInputField.text = DeviceManipulationTabController.getKalmanProcessNoise().toPrecision(4)
+		kalmanObservationNoiseInputField.text = DeviceManipulationTabController.getKalmanObservationNoise().toFixed(4)
+		kalmanPredictionInputField.text = DeviceManipulationTabController.getKalmanPrediction().toFixed(1)
+		oneEuroMinCutoffInputField.text = DeviceManipulationTabController.getOneEuroMinCutoff().toFixed(2)
+		oneEuroBetaInputField.text = DeviceManipulationTabController.getOneEuroBeta().toFixed(2)
+	}
+
 	function refreshButtonText()
 	{
 		btn_enableMC.text = DeviceManipulationTabController.getModifiers_AsString(0) + DeviceManipulationTabController.getKey_AsString(0);
 		btn_setZeroPose.text = DeviceManipulationTabController.getModifiers_AsString(1) + DeviceManipulationTabController.getKey_AsString(1);
+		btn_dumpFlightRecorder.text = DeviceManipulationTabController.getModifiers_AsString(2) + DeviceManipulationTabController.getKey_AsString(2);
 	}
 }
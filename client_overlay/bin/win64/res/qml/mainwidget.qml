@@ -21,6 +21,11 @@ Rectangle
         stackView: mainView
     }
 
+	property DiagnosticsPage diagnosticsPage: DiagnosticsPage
+	{
+        stackView: mainView
+    }
+
     StackView
 	{
         id: mainView
@@ -31,6 +31,7 @@ include(client_overlay.pri)
 DISTFILES += \
     bin/win64/res/qml/DeviceManipulationPage.qml \
     bin/win64/res/qml/DeviceRenderModelPage.qml \
+    bin/win64/res/qml/DiagnosticsPage.qml \
     bin/win64/res/qml/MotionCompensationPage.qml \
     bin/win64/res/qml/MyComboBox.qml \
     bin/win64/res/qml/MyDialogOkCancelPopup.qml \
@@ -409,9 +409,7 @@ namespace motioncompensation
 			}
 		}
 
-		vr::TrackedDevicePose_t devicePoses[vr::k_unMaxTrackedDeviceCount];
-		vr::VRSystem()->GetDeviceToAbsoluteTrackingPose(vr::TrackingUniverseStanding, 0.0f, devicePoses, vr::k_unMaxTrackedDeviceCount);
-		deviceManipulationTabController.eventLoopTick(devicePoses);
+		deviceManipulationTabController.eventLoopTick();
 
 		if (m_ulOverlayThumbnailHandle != vr::k_ulOverlayHandleInvalid)
 		{
@@ -12,6 +12,10 @@ namespace motioncompensation
 {
 	DeviceManipulationTabController::~DeviceManipulationTabController()
 	{
+		if (deviceEventsSubscribed)
+		{
+			parent->vrMotionCompensation().setEventCallback(nullptr);
+		}
 		if (identifyThread.joinable())
 		{
 			identifyThread.join();
@@ -43,12 +47,36 @@ namespace motioncompensation
 
 		LOG(DEBUG) << "deviceInfos size: " << deviceInfos.size();
 
+		// Subscribe before the first search, changes in between are found by the search
+		subscribeDeviceEvents();
 		SearchDevices();
 
 		parent->vrMotionCompensation().setOffsets(_offset);
 	}
 
-	void DeviceManipulationTabController::eventLoopTick(vr::TrackedDevicePose_t* devicePoses)
+	bool DeviceManipulationTabController::subscribeDeviceEvents()
+	{
+		try
+		{
+			parent->vrMotionCompensation().subscribeEvents(vrmotioncompensation::DeviceEventMask_All);
+			parent->vrMotionCompensation().setEventCallback([this](const vrmotioncompensation::DeviceEvent& event)
+			{
+				// Called on the ipc thread of the client library
+				QMetaObject::invokeMethod(this, [this, event]()
+				{
+					handleDeviceEvent(event);
+				}, Qt::QueuedConnection);
+			});
+			deviceEventsSubscribed = true;
+		}
+		catch (std::exception& e)
+		{
+			LOG(ERROR) << "Could not subscribe to device events, polling the device infos: " << e.what();
+		}
+		return deviceEventsSubscribed;
+	}
+
+	void DeviceManipulationTabController::eventLoopTick()
 	{
 		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
 		if (settingsUpdateCounter >= 50)
@@ -57,33 +85,26 @@ namespace motioncompensation
 
 			if (parent->isDashboardVisible() || parent->isDesktopMode())
 			{
-				unsigned i = 0;
-				for (auto info : deviceInfos)
+				// One request for the modes and connection states of all devices, answered without devices while nothing changed.
+				// Only now and then while the driver pushes device events
+				if (!deviceEventsSubscribed)
 				{
-					if (!info) continue;
-					// Has the device mode changed?
-					bool hasDeviceInfoChanged = updateDeviceInfo(i);
-
-					// Has the connection status changed?
-					unsigned status = devicePoses[info->openvrId].bDeviceIsConnected ? 0 : 1;
-					if (info->deviceStatus != status)
-					{
-						info->deviceStatus = status;
-						hasDeviceInfoChanged = true;
-						LOG(INFO) << "Serial " << info->serial << ", DeviceStatus changed to:  " << info->deviceStatus;
-					}
-
-					// Push changes to UI
-					if (hasDeviceInfoChanged)
+					SearchDevices();
+				}
+				else if (++deviceEventsCheckCounter >= 5)
+				{
+					// The driver drops events when its queue is full and unsubscribes a client it could not reach.
+					// Device infos that changed without an event mean events were lost
+					deviceEventsCheckCounter = 0;
+					uint32_t generation = deviceInfoGeneration;
+					SearchDevices();
+					if (deviceInfoGeneration != generation)
 					{
-						emit deviceInfoChanged(i);
-					//	LOG(INFO) << "UI update pushed.";
+						LOG(WARNING) << "Device infos changed without a device event, subscribing again";
+						subscribeDeviceEvents();
 					}
-
-					++i;
 				}
-
-				SearchDevices();
+				updatePoseStatistics();
 			}
 		}
 		else
@@ -92,6 +113,33 @@ namespace motioncompensation
 		}
 	}
 
+	void DeviceManipulationTabController::handleDeviceEvent(const vrmotioncompensation::DeviceEvent& event)
+	{
+		switch (event.Type)
+		{
+			case vrmotioncompensation::DeviceEventType::ReferenceTrackingLost:
+				LOG(WARNING) << "Reference tracker " << event.OpenVRId << " lost tracking";
+				break;
+
+			case vrmotioncompensation::DeviceEventType::ReferenceTrackingRegained:
+				LOG(INFO) << "Reference tracker " << event.OpenVRId << " regained tracking";
+				break;
+
+			case vrmotioncompensation::DeviceEventType::ZeroPoseSet:
+				LOG(INFO) << "Zero pose set";
+				break;
+
+			default:
+				// Added, removed, activated, deactivated, mode or status changed. One request picks up all changes
+				// since the last one, events for a generation that was already fetched cost nothing
+				if (event.Generation != deviceInfoGeneration)
+				{
+					SearchDevices();
+				}
+				break;
+		}
+	}
+
 	bool DeviceManipulationTabController::SearchDevices()
 	{
 		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
@@ -99,51 +147,81 @@ namespace motioncompensation
 
 		try
 		{
-			// Get some infos about the found devices
-			for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; ++id)
+			vrmotioncompensation::DeviceInfoList list;
+			if (!parent->vrMotionCompensation().getAllDeviceInfo(list, deviceInfoGeneration))
+			{
+				return false;
+			}
+			deviceInfoGeneration = list.Generation;
+
+			bool present[vr::k_unMaxTrackedDeviceCount] = {};
+			for (uint32_t i = 0; i < list.Count; ++i)
 			{
-				vr::ETrackedDeviceClass deviceClass = vr::VRSystem()->GetTrackedDeviceClass(id);
+				const vrmotioncompensation::DeviceInfoEntry& entry = list.Devices[i];
+				uint32_t id = entry.OpenVRId;
+				if (id >= vr::k_unMaxTrackedDeviceCount || (entry.deviceClass != vr::TrackedDeviceClass_HMD
+					&& entry.deviceClass != vr::TrackedDeviceClass_Controller && entry.deviceClass != vr::TrackedDeviceClass_GenericTracker))
+				{
+					continue;
+				}
+				present[id] = true;
+				int status = (entry.Status & vrmotioncompensation::DeviceStatus_Connected) ? 0 : 1;
 
-				if (deviceClass != vr::TrackedDeviceClass_Invalid && deviceInfos[id]->deviceClass == vr::TrackedDeviceClass_Invalid)
+				// A device we do not know yet, or another device in the slot of one that was removed
+				if (deviceInfos[id]->deviceClass == vr::TrackedDeviceClass_Invalid || deviceInfos[id]->serialHash != entry.SerialHash)
 				{
-					if (deviceClass == vr::TrackedDeviceClass_HMD || deviceClass == vr::TrackedDeviceClass_Controller || deviceClass == vr::TrackedDeviceClass_GenericTracker)
+					auto info = std::make_shared<DeviceInfo>();
+					info->openvrId = id;
+					info->deviceClass = entry.deviceClass;
+					info->deviceMode = entry.deviceMode;
+					info->deviceStatus = status;
+					info->serialHash = entry.SerialHash;
+					char buffer[vr::k_unMaxPropertyStringSize];
+
+					// Get and save the serial number
+					vr::ETrackedPropertyError pError = vr::TrackedProp_Success;
+					vr::VRSystem()->GetStringTrackedDeviceProperty(id, vr::Prop_SerialNumber_String, buffer, vr::k_unMaxPropertyStringSize, &pError);
+					if (pError == vr::TrackedProp_Success)
+					{
+						info->serial = std::string(buffer);
+					}
+					else
 					{
-						auto info = std::make_shared<DeviceInfo>();
-						info->openvrId = id;
-						info->deviceClass = deviceClass;
-						char buffer[vr::k_unMaxPropertyStringSize];
-
-						// Get and save the serial number
-						vr::ETrackedPropertyError pError = vr::TrackedProp_Success;
-						vr::VRSystem()->GetStringTrackedDeviceProperty(id, vr::Prop_SerialNumber_String, buffer, vr::k_unMaxPropertyStringSize, &pError);
-						if (pError == vr::TrackedProp_Success)
-						{
-							info->serial = std::string(buffer);
-						}
-						else
-						{
-							info->serial = std::string("<unknown serial>");
-							LOG(ERROR) << "Could not get serial of device " << id;
-						}
-
-						// Get and save the current device mode
-						try
-						{
-							vrmotioncompensation::DeviceInfo info2;
-							parent->vrMotionCompensation().getDeviceInfo(info->openvrId, info2);
-							info->deviceMode = info2.deviceMode;
-						}
-						catch (std::exception& e)
-						{
-							LOG(ERROR) << "Exception caught while getting device info: " << e.what();
-						}
-
-						// Store the found info
-						deviceInfos[id] = info;
-						LOG(INFO) << "Found device: id " << info->openvrId << ", class " << info->deviceClass << ", serial " << info->serial;
-
-						newDeviceAdded = true;
+						info->serial = std::string("<unknown serial>");
+						LOG(ERROR) << "Could not get serial of device " << id;
 					}
+
+					// Store the found info
+					deviceInfos[id] = info;
+					LOG(INFO) << "Found device: id " << info->openvrId << ", class " << info->deviceClass << ", serial " << info->serial;
+
+					newDeviceAdded = true;
+					continue;
+				}
+
+				// Has the device mode or the connection status changed?
+				auto info = deviceInfos[id];
+				if (info->deviceMode != entry.deviceMode || info->deviceStatus != status)
+				{
+					if (info->deviceStatus != status)
+					{
+						LOG(INFO) << "Serial " << info->serial << ", DeviceStatus changed to:  " << status;
+					}
+					info->deviceMode = entry.deviceMode;
+					info->deviceStatus = status;
+					emit deviceInfoChanged(id);
+				}
+			}
+
+			// Devices the driver no longer has are shown as disconnected
+			for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; ++id)
+			{
+				auto info = deviceInfos[id];
+				if (!present[id] && info->deviceClass != vr::TrackedDeviceClass_Invalid && info->deviceStatus != 1)
+				{
+					info->deviceStatus = 1;
+					LOG(INFO) << "Serial " << info->serial << ", DeviceStatus changed to:  " << info->deviceStatus;
+					emit deviceInfoChanged(id);
 				}
 			}
 
@@ -179,6 +257,10 @@ namespace motioncompensation
 		_HMDSerial = settings->value("motionCompensationHMDSerial", "").toString();
 		_RefTrackerSerial = settings->value("motionCompensationRefTrackerSerial", "").toString();
 
+		// Load the source of the reference pose
+		_motionCompensationMode = settings->value("motionCompensationMode", (unsigned)vrmotioncompensation::MotionCompensationMode::ReferenceTracker).toUInt() == (unsigned)vrmotioncompensation::MotionCompensationMode::RigPose
+			? vrmotioncompensation::MotionCompensationMode::RigPose : vrmotioncompensation::MotionCompensationMode::ReferenceTracker;
+
 		// Load filter settings
 		_LPFBeta = settings->value("motionCompensationLPFBeta", 0.85).toDouble();
 		_samples = settings->value("motionCompensationSamples", 12).toUInt();
@@ -186,6 +268,19 @@ namespace motioncompensation
 		// Load setZeroMode
 		_setZeroMode = settings->value("motionCompensationSetZeroMode", false).toBool();
 
+		// Load the flight recorder
+		_flightRecorder = settings->value("motionCompensationFlightRecorder", false).toBool();
+
+		// Load filter type and Kalman filter settings
+		_filterType = (vrmotioncompensation::MotionCompensationFilterType)settings->value("motionCompensationFilterType", 0).toUInt();
+		_kalmanProcessNoise = settings->value("motionCompensationKalmanProcessNoise", 5.0).toDouble();
+		_kalmanObservationNoise = settings->value("motionCompensationKalmanObservationNoise", 0.0005).toDouble();
+		_kalmanPredictionMs = settings->value("motionCompensationKalmanPredictionMs", 0.0).toDouble();
+
+		// Load One Euro filter settings
+		_oneEuroMinCutoff = settings->value("motionCompensationOneEuroMinCutoff", 1.0).toDouble();
+		_oneEuroBeta = settings->value("motionCompensationOneEuroBeta", 1.0).toDouble();
+
 		// Load offset settings
 		_offset.Translation.v[0] = settings->value("motionCompensationOffsetTranslation_X", 0.0).toDouble();
 		_offset.Translation.v[1] = settings->value("motionCompensationOffsetTranslation_Y", 0.0).toDouble();
@@ -194,6 +289,22 @@ namespace motioncompensation
 		_offset.Rotation.v[1] = settings->value("motionCompensationOffsetRotation_Y", 0.0).toDouble();
 		_offset.Rotation.v[2] = settings->value("motionCompensationOffsetRotation_R", 0.0).toDouble();
 
+		// Load the motion compensated devices besides the HMD
+		_compensatedDevices.clear();
+		int deviceCount = settings->beginReadArray("motionCompensationDevices");
+		for (int i = 0; i < deviceCount; i++)
+		{
+			settings->setArrayIndex(i);
+			CompensatedDeviceSettings device;
+			device.compensated = settings->value("compensated", false).toBool();
+			device.offset.v[0] = settings->value("offsetTranslation_X", 0.0).toDouble();
+			device.offset.v[1] = settings->value("offsetTranslation_Y", 0.0).toDouble();
+			device.offset.v[2] = settings->value("offsetTranslation_Z", 0.0).toDouble();
+			device.reference = settings->value("reference", false).toBool();
+			_compensatedDevices[settings->value("serial", "").toString().toStdString()] = device;
+		}
+		settings->endArray();
+
 		settings->endGroup();
 
 		// Load shortcuts
@@ -207,6 +318,10 @@ namespace motioncompensation
 		Qt::KeyboardModifiers shortcutMod_2 = settings->value("shortcut_1_mod", Qt::KeyboardModifier::NoModifier).toInt();
 		newKey(1, shortcutKey, shortcutMod_2);
 
+		shortcutKey = (Qt::Key)settings->value("shortcut_2_key", Qt::Key::Key_unknown).toInt();
+		Qt::KeyboardModifiers shortcutMod_3 = settings->value("shortcut_2_mod", Qt::KeyboardModifier::NoModifier).toInt();
+		newKey(2, shortcutKey, shortcutMod_3);
+
 		settings->endGroup();
 		LOG(INFO) << "Loading saved Settings";
 	}
@@ -222,6 +337,9 @@ namespace motioncompensation
 		settings->setValue("motionCompensationHMDSerial", _HMDSerial);
 		settings->setValue("motionCompensationRefTrackerSerial", _RefTrackerSerial);
 
+		// Save the source of the reference pose
+		settings->setValue("motionCompensationMode", (unsigned)_motionCompensationMode);
+
 		// Save filter settings
 		settings->setValue("motionCompensationLPFBeta", _LPFBeta);
 		settings->setValue("motionCompensationSamples", _samples);
@@ -229,6 +347,19 @@ namespace motioncompensation
 		// AJOUTER : Save setZeroMode
 		settings->setValue("motionCompensationSetZeroMode", _setZeroMode);
 
+		// Save the flight recorder
+		settings->setValue("motionCompensationFlightRecorder", _flightRecorder);
+
+		// Save filter type and Kalman filter settings
+		settings->setValue("motionCompensationFilterType", (unsigned)_filterType);
+		settings->setValue("motionCompensationKalmanProcessNoise", _kalmanProcessNoise);
+		settings->setValue("motionCompensationKalmanObservationNoise", _kalmanObservationNoise);
+		settings->setValue("motionCompensationKalmanPredictionMs", _kalmanPredictionMs);
+
+		// Save One Euro filter settings
+		settings->setValue("motionCompensationOneEuroMinCutoff", _oneEuroMinCutoff);
+		settings->setValue("motionCompensationOneEuroBeta", _oneEuroBeta);
+
 		// Save offset settings
 		settings->setValue("motionCompensationOffsetTranslation_X", _offset.Translation.v[0]);
 		settings->setValue("motionCompensationOffsetTranslation_Y", _offset.Translation.v[1]);
@@ -237,6 +368,21 @@ namespace motioncompensation
 		settings->setValue("motionCompensationOffsetRotation_Y", _offset.Rotation.v[1]);
 		settings->setValue("motionCompensationOffsetRotation_R", _offset.Rotation.v[2]);
 
+		// Save the motion compensated devices besides the HMD
+		settings->beginWriteArray("motionCompensationDevices");
+		int i = 0;
+		for (auto& device : _compensatedDevices)
+		{
+			settings->setArrayIndex(i++);
+			settings->setValue("serial", QString::fromStdString(device.first));
+			settings->setValue("compensated", device.second.compensated);
+			settings->setValue("offsetTranslation_X", device.second.offset.v[0]);
+			settings->setValue("offsetTranslation_Y", device.second.offset.v[1]);
+			settings->setValue("offsetTranslation_Z", device.second.offset.v[2]);
+			settings->setValue("reference", device.second.reference);
+		}
+		settings->endArray();
+
 		settings->endGroup();
 		settings->sync();
 
@@ -253,6 +399,8 @@ namespace motioncompensation
 		settings->setValue("shortcut_0_mod", (int)getModifiers_AsModifiers(0));
 		settings->setValue("shortcut_1_key", getKey_AsKey(1));
 		settings->setValue("shortcut_1_mod", (int)getModifiers_AsModifiers(1));
+		settings->setValue("shortcut_2_key", getKey_AsKey(2));
+		settings->setValue("shortcut_2_mod", (int)getModifiers_AsModifiers(2));
 
 		settings->endGroup();
 		settings->sync();
@@ -262,6 +410,7 @@ namespace motioncompensation
 	{
 		NewShortcut(0, &DeviceManipulationTabController::toggleMotionCompensationMode, "Enable / Disable Motion Compensation");
 		NewShortcut(1, &DeviceManipulationTabController::resetRefZeroPose, "Reset reference zero pose");
+		NewShortcut(2, &DeviceManipulationTabController::dumpFlightRecorder, "Dump flight recorder");
 	}
 
 	void DeviceManipulationTabController::NewShortcut(int id, void (DeviceManipulationTabController::* method)(), QString description)
@@ -476,28 +625,15 @@ namespace motioncompensation
 	bool DeviceManipulationTabController::updateDeviceInfo(unsigned OpenVRId)
 	{
 		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
-		bool retval = false;
-
-		if (OpenVRId < deviceInfos.size() && deviceInfos[OpenVRId])
+		if (OpenVRId >= deviceInfos.size() || !deviceInfos[OpenVRId])
 		{
-			try
-			{
-				vrmotioncompensation::DeviceInfo info;
-
-				parent->vrMotionCompensation().getDeviceInfo(deviceInfos[OpenVRId]->openvrId, info);
-				if (deviceInfos[OpenVRId]->deviceMode != info.deviceMode)
-				{
-					deviceInfos[OpenVRId]->deviceMode = info.deviceMode;
-					retval = true;
-				}
-			}
-			catch (std::exception& e)
-			{
-				LOG(ERROR) << "Exception caught while getting device info: " << e.what();
-			}
+			return false;
 		}
 
-		return retval;
+		// Refreshes all devices at once, deviceInfoChanged is emitted for every device that changed
+		vrmotioncompensation::MotionCompensationDeviceMode deviceMode = deviceInfos[OpenVRId]->deviceMode;
+		SearchDevices();
+		return deviceInfos[OpenVRId]->deviceMode != deviceMode;
 	}
 
 	void DeviceManipulationTabController::toggleMotionCompensationMode()
@@ -517,7 +653,7 @@ namespace motioncompensation
 		}
 
 		// Search for the correct serial number and save its OpenVR Id.
-		if (_RefTrackerSerial != "" && _HMDSerial != "")
+		if (_HMDSerial != "")
 		{
 			for (int i = 0; i < vr::k_unMaxTrackedDeviceCount; i++)
 			{
@@ -539,6 +675,13 @@ namespace motioncompensation
 
 			applySettings_ovrid(MCid, RTid, !_MotionCompensationIsOn);
 		}
+		else if (MCid >= 0 && _motionCompensationMode == vrmotioncompensation::MotionCompensationMode::RigPose)
+		{
+			// The rig pose needs no reference tracker
+			LOG(DEBUG) << "ToggleMC: Found the HMD. HMD OVRID: " << MCid;
+
+			applySettings_ovrid(MCid, 0, !_MotionCompensationIsOn);
+		}
 
 		//int MCindex = QQmlProperty::read(parent, "hmdSelectionComboBox.currentIndex").toInt();
 	}
@@ -626,13 +769,19 @@ namespace motioncompensation
 		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
 		try
 		{
-			vrmotioncompensation::MotionCompensationMode NewMode = vrmotioncompensation::MotionCompensationMode::ReferenceTracker;
+			vrmotioncompensation::MotionCompensationMode NewMode = _motionCompensationMode;
+			bool referenceTracker = _motionCompensationMode == vrmotioncompensation::MotionCompensationMode::ReferenceTracker;
+			uint32_t RTovrId = referenceTracker ? deviceInfos[RTid]->openvrId : vr::k_unTrackedDeviceIndexInvalid;
 
 			// Send new settings to the driver.dll
-			if (EnableMotionCompensation && _motionCompensationMode == vrmotioncompensation::MotionCompensationMode::ReferenceTracker)
+			if (EnableMotionCompensation && referenceTracker)
 			{
 				LOG(INFO) << "Sending Motion Compensation Mode: ReferenceTracker";
 			}
+			else if (EnableMotionCompensation && _motionCompensationMode == vrmotioncompensation::MotionCompensationMode::RigPose)
+			{
+				LOG(INFO) << "Sending Motion Compensation Mode: RigPose";
+			}
 			else
 			{
 				LOG(INFO) << "Sending Motion Compensation Mode: Disabled";
@@ -640,22 +789,48 @@ namespace motioncompensation
 				NewMode = vrmotioncompensation::MotionCompensationMode::Disabled;
 			}
 
-			for (unsigned int deviceOpenVrId = 0; deviceOpenVrId < deviceInfos.size(); ++deviceOpenVrId)
+			// The HMD switches the compensation on or off, disabling also resets every other compensated device
+			parent->vrMotionCompensation().setDeviceMotionCompensationMode(deviceInfos[MCid]->openvrId, RTovrId, NewMode);
+			parent->vrMotionCompensation().setDeviceCompensation(deviceInfos[MCid]->openvrId, NewMode != vrmotioncompensation::MotionCompensationMode::Disabled,
+				getDeviceCompensationOffset(MCid));
+
+			// Add the other selected devices and remove the deselected ones
+			if (NewMode != vrmotioncompensation::MotionCompensationMode::Disabled)
 			{
-				if (!deviceInfos[deviceOpenVrId])
+				for (unsigned id = 0; id < deviceInfos.size(); ++id)
 				{
-					continue;
+					if (!deviceInfos[id] || deviceInfos[id]->deviceClass == vr::TrackedDeviceClass_Invalid || id == MCid || (referenceTracker && id == RTid))
+					{
+						continue;
+					}
+
+					bool compensated = isDeviceCompensated(id) && !isDeviceReference(id);
+					if (compensated || deviceInfos[id]->deviceMode == vrmotioncompensation::MotionCompensationDeviceMode::MotionCompensated)
+					{
+						parent->vrMotionCompensation().setDeviceCompensation(deviceInfos[id]->openvrId, compensated, getDeviceCompensationOffset(id));
+					}
 				}
+			}
 
-				if (deviceOpenVrId != RTid)
+			// Fuse the additional reference trackers, or go back to a single one
+			if (NewMode == vrmotioncompensation::MotionCompensationMode::ReferenceTracker)
+			{
+				std::vector<uint32_t> referenceIds = getReferenceTrackerIds(RTid);
+				bool hadReferences = false;
+				for (unsigned id = 0; id < deviceInfos.size(); ++id)
+				{
+					hadReferences |= id != RTid && deviceInfos[id] && deviceInfos[id]->deviceMode == vrmotioncompensation::MotionCompensationDeviceMode::ReferenceTracker;
+				}
+				if (referenceIds.size() > 1 || hadReferences)
 				{
-					// Send new mode
-					parent->vrMotionCompensation().setDeviceMotionCompensationMode(deviceInfos[deviceOpenVrId]->openvrId, deviceInfos[RTid]->openvrId, NewMode);
+					parent->vrMotionCompensation().setReferenceTrackers(referenceIds);
 				}
 			}
 
 			// Send settings
-			parent->vrMotionCompensation().setMoticonCompensationSettings(_LPFBeta, _samples, _setZeroMode);
+			parent->vrMotionCompensation().setMoticonCompensationSettings(_LPFBeta, _samples, _setZeroMode, _filterType, _kalmanProcessNoise, _kalmanObservationNoise, _kalmanPredictionMs,
+				_oneEuroMinCutoff, _oneEuroBeta);
+			parent->vrMotionCompensation().setFlightRecorder(getFlightRecorderSettings());
 		}
 		catch (vrmotioncompensation::vrmotioncompensation_exception& e)
 		{
@@ -673,6 +848,10 @@ namespace motioncompensation
 			{
 				m_deviceModeErrorString = "Device not found";
 			} break;
+			case (int)vrmotioncompensation::ipc::ReplyStatus::InvalidType:
+			{
+				m_deviceModeErrorString = "Invalid filter type";
+			} break;
 			default:
 			{
 				m_deviceModeErrorString = "SteamVR did not load OVRMC .dll";
@@ -693,7 +872,10 @@ namespace motioncompensation
 		_MotionCompensationIsOn = EnableMotionCompensation;
 
 		setHMD(MCid);
-		setReferenceTracker(RTid);
+		if (_motionCompensationMode == vrmotioncompensation::MotionCompensationMode::ReferenceTracker)
+		{
+			setReferenceTracker(RTid);
+		}
 
 		saveMotionCompensationSettings();
 
@@ -730,6 +912,39 @@ namespace motioncompensation
 		}
 	}
 
+	void DeviceManipulationTabController::dumpFlightRecorder()
+	{
+		try
+		{
+			LOG(INFO) << "Dumping the flight recorder";
+			parent->vrMotionCompensation().dumpFlightRecorder();
+		}
+		catch (vrmotioncompensation::vrmotioncompensation_exception& e)
+		{
+			switch (e.errorcode)
+			{
+			case (int)vrmotioncompensation::ipc::ReplyStatus::InvalidOperation:
+			{
+				m_deviceModeErrorString = "The flight recorder is off";
+			} break;
+			case (int)vrmotioncompensation::ipc::ReplyStatus::AlreadyInUse:
+			{
+				m_deviceModeErrorString = "The flight recorder is still writing a dump";
+			} break;
+			default:
+			{
+				m_deviceModeErrorString = "SteamVR did not load OVRMC .dll";
+			} break;
+			}
+			LOG(ERROR) << "Exception caught while dumping the flight recorder: " << e.what();
+		}
+		catch (std::exception& e)
+		{
+			m_deviceModeErrorString = "Unknown exception";
+			LOG(ERROR) << "Exception caught while dumping the flight recorder: " << e.what();
+		}
+	}
+
 	QString DeviceManipulationTabController::getDeviceModeErrorString()
 	{
 		return m_deviceModeErrorString;
@@ -821,6 +1036,193 @@ namespace motioncompensation
 		emit settingChanged();
 	}
 
+	void DeviceManipulationTabController::setFilterType(unsigned type)
+	{
+		switch (type)
+		{
+		case 0:
+			_filterType = vrmotioncompensation::MotionCompensationFilterType::Default;
+			break;
+		case 1:
+			_filterType = vrmotioncompensation::MotionCompensationFilterType::Kalman;
+			break;
+		case 2:
+			_filterType = vrmotioncompensation::MotionCompensationFilterType::OneEuro;
+			break;
+		default:
+			break;
+		}
+	}
+
+	unsigned DeviceManipulationTabController::getFilterType()
+	{
+		return (unsigned)_filterType;
+	}
+
+	bool DeviceManipulationTabController::setKalmanProcessNoise(double value)
+	{
+		// A few checks if the user input is valid
+		if (value <= 0.0)
+		{
+			m_deviceModeErrorString = "Value must be higher than 0";
+			return false;
+		}
+
+		_kalmanProcessNoise = value;
+
+		return true;
+	}
+
+	double DeviceManipulationTabController::getKalmanProcessNoise()
+	{
+		return _kalmanProcessNoise;
+	}
+
+	bool DeviceManipulationTabController::setKalmanObservationNoise(double value)
+	{
+		// A few checks if the user input is valid
+		if (value <= 0.0)
+		{
+			m_deviceModeErrorString = "Value must be higher than 0";
+			return false;
+		}
+
+		_kalmanObservationNoise = value;
+
+		return true;
+	}
+
+	double DeviceManipulationTabController::getKalmanObservationNoise()
+	{
+		return _kalmanObservationNoise;
+	}
+
+	bool DeviceManipulationTabController::setKalmanPrediction(double value)
+	{
+		// A few checks if the user input is valid
+		if (value < 0.0)
+		{
+			m_deviceModeErrorString = "Value cannot be lower than 0";
+			return false;
+		}
+		if (value > 50.0)
+		{
+			m_deviceModeErrorString = "Value cannot be higher than 50 ms";
+			return false;
+		}
+
+		_kalmanPredictionMs = value;
+
+		return true;
+	}
+
+	double DeviceManipulationTabController::getKalmanPrediction()
+	{
+		return _kalmanPredictionMs;
+	}
+
+	void DeviceManipulationTabController::scaleKalmanProcessNoise(double factor)
+	{
+		_kalmanProcessNoise *= factor;
+
+		if (_kalmanProcessNoise < 1.0E-6)
+		{
+			_kalmanProcessNoise = 1.0E-6;
+		}
+
+		emit settingChanged();
+	}
+
+	void DeviceManipulationTabController::increaseKalmanObservationNoise(double value)
+	{
+		_kalmanObservationNoise += value;
+
+		if (_kalmanObservationNoise < 0.0001)
+		{
+			_kalmanObservationNoise = 0.0001;
+		}
+
+		emit settingChanged();
+	}
+
+	void DeviceManipulationTabController::increaseKalmanPrediction(double value)
+	{
+		_kalmanPredictionMs += value;
+
+		if (_kalmanPredictionMs > 50.0)
+		{
+			_kalmanPredictionMs = 50.0;
+		}
+		else if (_kalmanPredictionMs < 0.0)
+		{
+			_kalmanPredictionMs = 0.0;
+		}
+
+		emit settingChanged();
+	}
+
+	bool DeviceManipulationTabController::setOneEuroMinCutoff(double value)
+	{
+		// A few checks if the user input is valid
+		if (value <= 0.0)
+		{
+			m_deviceModeErrorString = "Value must be higher than 0";
+			return false;
+		}
+
+		_oneEuroMinCutoff = value;
+
+		return true;
+	}
+
+	double DeviceManipulationTabController::getOneEuroMinCutoff()
+	{
+		return _oneEuroMinCutoff;
+	}
+
+	bool DeviceManipulationTabController::setOneEuroBeta(double value)
+	{
+		// A few checks if the user input is valid
+		if (value < 0.0)
+		{
+			m_deviceModeErrorString = "Value cannot be lower than 0";
+			return false;
+		}
+
+		_oneEuroBeta = value;
+
+		return true;
+	}
+
+	double DeviceManipulationTabController::getOneEuroBeta()
+	{
+		return _oneEuroBeta;
+	}
+
+	void DeviceManipulationTabController::increaseOneEuroMinCutoff(double value)
+	{
+		_oneEuroMinCutoff += value;
+
+		if (_oneEuroMinCutoff < 0.1)
+		{
+			_oneEuroMinCutoff = 0.1;
+		}
+
+		emit settingChanged();
+	}
+
+	void DeviceManipulationTabController::increaseOneEuroBeta(double value)
+	{
+		_oneEuroBeta += value;
+
+		if (_oneEuroBeta < 0.0)
+		{
+			_oneEuroBeta = 0.0;
+		}
+
+		emit settingChanged();
+	}
+
 	void DeviceManipulationTabController::setHMDtoRefTranslationOffset(unsigned axis, double value)
 	{
 		_offset.Translation.v[axis] = value;
@@ -859,6 +1261,199 @@ namespace motioncompensation
 		return _offset.Rotation.v[axis];
 	}
 
+	bool DeviceManipulationTabController::setDeviceCompensated(unsigned OpenVRId, bool compensated)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
+		if (OpenVRId >= deviceInfos.size() || !deviceInfos[OpenVRId] || deviceInfos[OpenVRId]->deviceClass == vr::TrackedDeviceClass_Invalid)
+		{
+			m_deviceModeErrorString = "Invalid device";
+			return false;
+		}
+
+		if (compensated && deviceInfos[OpenVRId]->deviceMode == vrmotioncompensation::MotionCompensationDeviceMode::ReferenceTracker)
+		{
+			m_deviceModeErrorString = "The reference tracker cannot be motion compensated";
+			return false;
+		}
+
+		_compensatedDevices[deviceInfos[OpenVRId]->serial].compensated = compensated;
+		if (compensated)
+		{
+			_compensatedDevices[deviceInfos[OpenVRId]->serial].reference = false;
+		}
+		saveMotionCompensationSettings();
+
+		return sendDeviceCompensation(OpenVRId);
+	}
+
+	bool DeviceManipulationTabController::isDeviceCompensated(unsigned OpenVRId)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
+		if (OpenVRId < deviceInfos.size() && deviceInfos[OpenVRId])
+		{
+			auto search = _compensatedDevices.find(deviceInfos[OpenVRId]->serial);
+			return search != _compensatedDevices.end() && search->second.compensated;
+		}
+
+		return false;
+	}
+
+	bool DeviceManipulationTabController::setDeviceOffset(unsigned OpenVRId, unsigned axis, double value)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
+		if (OpenVRId >= deviceInfos.size() || !deviceInfos[OpenVRId] || axis > 2)
+		{
+			m_deviceModeErrorString = "Invalid device";
+			return false;
+		}
+
+		_compensatedDevices[deviceInfos[OpenVRId]->serial].offset.v[axis] = value / 100.0;
+		saveMotionCompensationSettings();
+
+		return sendDeviceCompensation(OpenVRId);
+	}
+
+	double DeviceManipulationTabController::getDeviceOffset(unsigned OpenVRId, unsigned axis)
+	{
+		return getDeviceCompensationOffset(OpenVRId).Translation.v[axis % 3] * 100.0;
+	}
+
+	vrmotioncompensation::MotionCompensationDeviceOffset DeviceManipulationTabController::getDeviceCompensationOffset(unsigned OpenVRId)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
+		vrmotioncompensation::MotionCompensationDeviceOffset offset = { { 0, 0, 0 }, { 1, 0, 0, 0 } };
+
+		if (OpenVRId < deviceInfos.size() && deviceInfos[OpenVRId])
+		{
+			auto search = _compensatedDevices.find(deviceInfos[OpenVRId]->serial);
+			if (search != _compensatedDevices.end())
+			{
+				offset.Translation = search->second.offset;
+			}
+		}
+
+		return offset;
+	}
+
+	// Sends the compensation setting of a device, while the compensation is running
+	bool DeviceManipulationTabController::sendDeviceCompensation(unsigned OpenVRId)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
+		if (!_MotionCompensationIsOn || deviceInfos[OpenVRId]->deviceMode == vrmotioncompensation::MotionCompensationDeviceMode::ReferenceTracker)
+		{
+			return true;
+		}
+
+		// The HMD is always compensated
+		bool compensated = isDeviceCompensated(OpenVRId) || QString::fromStdString(deviceInfos[OpenVRId]->serial) == _HMDSerial;
+
+		try
+		{
+			parent->vrMotionCompensation().setDeviceCompensation(deviceInfos[OpenVRId]->openvrId, compensated, getDeviceCompensationOffset(OpenVRId));
+		}
+		catch (vrmotioncompensation::vrmotioncompensation_exception& e)
+		{
+			switch (e.errorcode)
+			{
+			case (int)vrmotioncompensation::ipc::ReplyStatus::InvalidId:
+			case (int)vrmotioncompensation::ipc::ReplyStatus::NotFound:
+			{
+				m_deviceModeErrorString = "Device not found";
+			} break;
+			case (int)vrmotioncompensation::ipc::ReplyStatus::InvalidOperation:
+			{
+				m_deviceModeErrorString = "The reference tracker cannot be motion compensated";
+			} break;
+			default:
+			{
+				m_deviceModeErrorString = "SteamVR did not load OVRMC .dll";
+			} break;
+			}
+			LOG(ERROR) << "Exception caught while setting device compensation: " << e.what();
+
+			return false;
+		}
+		catch (std::exception& e)
+		{
+			m_deviceModeErrorString = "Unknown exception";
+			LOG(ERROR) << "Unknown exception caught while setting device compensation: " << e.what();
+
+			return false;
+		}
+
+		updateDeviceInfo(OpenVRId);
+
+		return true;
+	}
+
+	bool DeviceManipulationTabController::setDeviceReference(unsigned OpenVRId, bool reference)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
+		if (OpenVRId >= deviceInfos.size() || !deviceInfos[OpenVRId] || deviceInfos[OpenVRId]->deviceClass == vr::TrackedDeviceClass_Invalid)
+		{
+			m_deviceModeErrorString = "Invalid device";
+			return false;
+		}
+
+		if (reference && QString::fromStdString(deviceInfos[OpenVRId]->serial) == _HMDSerial)
+		{
+			m_deviceModeErrorString = "The HMD cannot be a reference tracker";
+			return false;
+		}
+
+		if (reference && getReferenceTrackerIds(vr::k_unMaxTrackedDeviceCount).size() >= vrmotioncompensation::MaxReferenceTrackers - 1)
+		{
+			m_deviceModeErrorString = "Too many reference trackers";
+			return false;
+		}
+
+		// A reference tracker is never compensated
+		CompensatedDeviceSettings& device = _compensatedDevices[deviceInfos[OpenVRId]->serial];
+		device.reference = reference;
+		if (reference)
+		{
+			device.compensated = false;
+		}
+		saveMotionCompensationSettings();
+
+		// The new set of reference trackers is sent with the next apply
+		return true;
+	}
+
+	bool DeviceManipulationTabController::isDeviceReference(unsigned OpenVRId)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
+		if (OpenVRId < deviceInfos.size() && deviceInfos[OpenVRId])
+		{
+			auto search = _compensatedDevices.find(deviceInfos[OpenVRId]->serial);
+			return search != _compensatedDevices.end() && search->second.reference;
+		}
+
+		return false;
+	}
+
+	// The selected reference tracker first, then the additional ones that are connected
+	std::vector<uint32_t> DeviceManipulationTabController::getReferenceTrackerIds(unsigned RTid)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
+		std::vector<uint32_t> ids;
+		if (RTid < deviceInfos.size() && deviceInfos[RTid])
+		{
+			ids.push_back(deviceInfos[RTid]->openvrId);
+		}
+
+		for (unsigned id = 0; id < deviceInfos.size() && ids.size() < vrmotioncompensation::MaxReferenceTrackers; ++id)
+		{
+			if (id != RTid && deviceInfos[id] && deviceInfos[id]->deviceClass != vr::TrackedDeviceClass_Invalid && deviceInfos[id]->deviceStatus == 0
+				&& QString::fromStdString(deviceInfos[id]->serial) != _HMDSerial && isDeviceReference(id))
+			{
+				ids.push_back(deviceInfos[id]->openvrId);
+			}
+		}
+
+		return ids;
+	}
+
 	void DeviceManipulationTabController::setMotionCompensationMode(unsigned NewMode)
 	{
 		switch (NewMode)
@@ -866,6 +1461,9 @@ namespace motioncompensation
 		case 0:
 			_motionCompensationMode = vrmotioncompensation::MotionCompensationMode::ReferenceTracker;
 			break;
+		case 1:
+			_motionCompensationMode = vrmotioncompensation::MotionCompensationMode::RigPose;
+			break;
 		default:
 			break;
 		}
@@ -881,6 +1479,9 @@ namespace motioncompensation
 		case vrmotioncompensation::MotionCompensationMode::ReferenceTracker:
 			return 0;
 			break;
+		case vrmotioncompensation::MotionCompensationMode::RigPose:
+			return 1;
+			break;
 		default:
 			return 0;
 			break;
@@ -976,4 +1577,216 @@ namespace motioncompensation
 	{
 		return debugModeButtonString;
 	}
+
+	bool DeviceManipulationTabController::setFlightRecorder(bool enable)
+	{
+		_flightRecorder = enable;
+		saveMotionCompensationSettings();
+
+		try
+		{
+			LOG(INFO) << "Sending flight recorder " << (enable ? "on" : "off");
+			parent->vrMotionCompensation().setFlightRecorder(getFlightRecorderSettings());
+		}
+		catch (std::exception& e)
+		{
+			m_deviceModeErrorString = "Could not set the flight recorder";
+			LOG(ERROR) << "Exception caught while setting the flight recorder: " << e.what();
+
+			return false;
+		}
+
+		return true;
+	}
+
+	bool DeviceManipulationTabController::getFlightRecorder()
+	{
+		return _flightRecorder;
+	}
+
+	vrmotioncompensation::FlightRecorderSettings DeviceManipulationTabController::getFlightRecorderSettings()
+	{
+		// 10 s before and 1 s after a trigger, 10 cm position jumps, 50 cm compensation
+		vrmotioncompensation::FlightRecorderSettings settings;
+		settings.Enabled = _flightRecorder;
+		settings.Seconds = 10;
+		settings.PostTriggerMs = 1000;
+		settings.MaxPositionJump = 0.1;
+		settings.MaxCompensationDelta = 0.5;
+		settings.DumpOnTrackingLost = true;
+		return settings;
+	}
+
+	bool DeviceManipulationTabController::updateLatencyStatistics()
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
+		latencyRows.clear();
+
+		try
+		{
+			for (auto& info : deviceInfos)
+			{
+				if (!info)
+				{
+					continue;
+				}
+
+				vrmotioncompensation::DeviceLatencyStatistics statistics;
+				try
+				{
+					parent->vrMotionCompensation().getLatencyStatistics(info->openvrId, statistics);
+				}
+				catch (vrmotioncompensation::vrmotioncompensation_notfound&)
+				{
+					// The driver does not handle this device (yet)
+					continue;
+				}
+
+				for (uint32_t stage = 0; stage < vrmotioncompensation::LatencyStageCount; stage++)
+				{
+					if (statistics.Stages[stage].Count == 0)
+					{
+						continue;
+					}
+					LatencyRow row;
+					row.serial = info->serial;
+					row.stage = (vrmotioncompensation::LatencyStage)stage;
+					row.statistics = statistics.Stages[stage];
+					latencyRows.push_back(row);
+				}
+			}
+		}
+		catch (std::exception& e)
+		{
+			LOG(ERROR) << "Exception caught while getting latency statistics: " << e.what();
+
+			return false;
+		}
+
+		return true;
+	}
+
+	bool DeviceManipulationTabController::resetLatencyStatistics()
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
+
+		try
+		{
+			for (auto& info : deviceInfos)
+			{
+				if (!info)
+				{
+					continue;
+				}
+
+				vrmotioncompensation::DeviceLatencyStatistics statistics;
+				try
+				{
+					parent->vrMotionCompensation().getLatencyStatistics(info->openvrId, statistics, true);
+				}
+				catch (vrmotioncompensation::vrmotioncompensation_notfound&)
+				{
+				}
+			}
+		}
+		catch (std::exception& e)
+		{
+			LOG(ERROR) << "Exception caught while resetting latency statistics: " << e.what();
+
+			return false;
+		}
+		latencyRows.clear();
+
+		return true;
+	}
+
+	void DeviceManipulationTabController::updatePoseStatistics()
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
+		try
+		{
+			// The driver creates the block on startup, so keep trying until it is there
+			if (!poseStatisticsReader.isOpen())
+			{
+				poseStatisticsReader.open();
+			}
+		}
+		catch (std::exception&)
+		{
+			poseStatisticsValid = false;
+			return;
+		}
+
+		int64_t timeNs = 0;
+		poseStatisticsValid = poseStatisticsReader.read(poseStatistics, timeNs);
+		if (poseStatisticsValid)
+		{
+			emit poseStatisticsChanged();
+		}
+	}
+
+	QString DeviceManipulationTabController::getPoseStatisticsText(unsigned OpenVRId)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
+		if (!poseStatisticsValid || OpenVRId >= vrmotioncompensation::PoseStatisticsDeviceCount || poseStatistics[OpenVRId].Count == 0)
+		{
+			return QString();
+		}
+
+		const vrmotioncompensation::PoseStatistics_v1& statistics = poseStatistics[OpenVRId];
+		return QString("%1 Hz, p99 %2 ms, %3 lost")
+			.arg(statistics.RateHz, 0, 'f', 0)
+			.arg((double)statistics.Interval.P99Ns / 1.0E6, 0, 'f', 2)
+			.arg(statistics.NotRunningOkCount);
+	}
+
+	unsigned DeviceManipulationTabController::getLatencyRowCount()
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
+		return (unsigned)latencyRows.size();
+	}
+
+	QString DeviceManipulationTabController::getLatencyRowText(unsigned row, unsigned column)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_dataMutex);
+		if (row >= latencyRows.size())
+		{
+			return QString();
+		}
+
+		const LatencyRow& r = latencyRows[row];
+		auto us = [](uint64_t ns) { return QString::number((double)ns / 1000.0, 'f', 1); };
+		switch (column)
+		{
+		case 0:
+			return QString::fromStdString(r.serial);
+		case 1:
+			switch (r.stage)
+			{
+			case vrmotioncompensation::LatencyStage::PoseUpdated:
+				return QString("Pose hook");
+			case vrmotioncompensation::LatencyStage::HandlePoseUpdate:
+				return QString("Device handle");
+			case vrmotioncompensation::LatencyStage::UpdateReference:
+				return QString("Reference update");
+			case vrmotioncompensation::LatencyStage::ApplyCompensation:
+				return QString("Compensation");
+			}
+			return QString();
+		case 2:
+			return QString::number(r.statistics.Count);
+		case 3:
+			return us(r.statistics.P50Ns);
+		case 4:
+			return us(r.statistics.P90Ns);
+		case 5:
+			return us(r.statistics.P99Ns);
+		case 6:
+			return us(r.statistics.P999Ns);
+		case 7:
+			return us(r.statistics.MaxNs);
+		default:
+			return QString();
+		}
+	}
 } // namespace motioncompensation
\ No newline at end of file
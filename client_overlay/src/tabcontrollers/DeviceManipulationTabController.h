@@ -23,9 +23,26 @@ namespace motioncompensation
 		vr::ETrackedDeviceClass deviceClass = vr::TrackedDeviceClass_Invalid;
 		uint32_t openvrId = 0;
 		int deviceStatus = 0;					// 0: Normal, 1: Disconnected/Suspended
+		uint64_t serialHash = 0;				// Of the driver, tells a new device in the same slot apart
 		vrmotioncompensation::MotionCompensationDeviceMode deviceMode = vrmotioncompensation::MotionCompensationDeviceMode::Default;
 	};
 
+	// Settings of a motion compensated device besides the HMD, stored by serial number
+	struct CompensatedDeviceSettings
+	{
+		bool compensated = false;
+		vr::HmdVector3d_t offset = { 0, 0, 0 };		// Translation in the device frame in meters
+		bool reference = false;						// Additional reference tracker, fused with the selected one
+	};
+
+	// One stage of one device on the diagnostics page
+	struct LatencyRow
+	{
+		std::string serial = "";
+		vrmotioncompensation::LatencyStage stage = vrmotioncompensation::LatencyStage::PoseUpdated;
+		vrmotioncompensation::LatencyStatistics statistics = {};
+	};
+
 	class DeviceManipulationTabController : public QObject
 	{
 		Q_OBJECT		
@@ -57,12 +74,15 @@ namespace motioncompensation
 		QQuickWindow* widget;
 
 		// Shortcut related
-		ShortcutStruct shortcut[2];
+		ShortcutStruct shortcut[3];
 
 		// Device and ID storage
 		std::vector<std::shared_ptr<DeviceInfo>> deviceInfos;		// Holds all device infos. The index represents the OpenVR ID. Therefore there are many empty fields in this array
 		std::map<uint32_t, uint32_t> TrackerArrayIdToDeviceId;
 		std::map<uint32_t, uint32_t> HMDArrayIdToDeviceId;
+		uint32_t deviceInfoGeneration = 0;							// Of the last getAllDeviceInfo reply, 0 before the first
+		bool deviceEventsSubscribed = false;						// The driver pushes device events, the device infos are only checked now and then
+		unsigned deviceEventsCheckCounter = 0;
 
 		// Settings
 		vrmotioncompensation::MotionCompensationMode _motionCompensationMode = vrmotioncompensation::MotionCompensationMode::ReferenceTracker;
@@ -71,8 +91,16 @@ namespace motioncompensation
 		double _LPFBeta = 0.2;
 		uint32_t _samples = 100;
 		bool _setZeroMode = false;
+		vrmotioncompensation::MotionCompensationFilterType _filterType = vrmotioncompensation::MotionCompensationFilterType::Default;
+		double _kalmanProcessNoise = 5.0;
+		double _kalmanObservationNoise = 0.0005;
+		double _kalmanPredictionMs = 0.0;
+		double _oneEuroMinCutoff = 1.0;
+		double _oneEuroBeta = 1.0;
 		vrmotioncompensation::MMFstruct_OVRMC_v1 _offset;
+		std::map<std::string, CompensatedDeviceSettings> _compensatedDevices;
 		bool _MotionCompensationIsOn = false;
+		bool _flightRecorder = false;
 
 
 		// Debug
@@ -82,6 +110,12 @@ namespace motioncompensation
 		// Error return string
 		QString m_deviceModeErrorString;
 
+		// Diagnostics
+		std::vector<LatencyRow> latencyRows;
+		vrmotioncompensation::VRMotionCompensationPoseStatistics poseStatisticsReader;
+		vrmotioncompensation::PoseStatistics_v1 poseStatistics[vrmotioncompensation::PoseStatisticsDeviceCount];
+		bool poseStatisticsValid = false;
+
 		// Threads
 		std::thread identifyThread;
 		unsigned settingsUpdateCounter = 0;
@@ -96,10 +130,16 @@ namespace motioncompensation
 
 		void initStage2(OverlayController* parent, QQuickWindow* widget);
 
-		void eventLoopTick(vr::TrackedDevicePose_t* devicePoses);
+		void eventLoopTick();
 
 		bool SearchDevices();
 
+		// Subscribes to all device events, false if the driver refused. Subscribing again is harmless
+		bool subscribeDeviceEvents();
+
+		// Device event pushed by the driver, called on the Qt thread
+		void handleDeviceEvent(const vrmotioncompensation::DeviceEvent& event);
+
 		void handleEvent(const vr::VREvent_t& vrEvent);
 
 		void reloadMotionCompensationSettings();
@@ -147,6 +187,7 @@ namespace motioncompensation
 		Q_INVOKABLE bool applySettings(unsigned Dindex, unsigned RTindex, bool EnableMotionCompensation);
 		bool applySettings_ovrid(unsigned MCid, unsigned RTid, bool EnableMotionCompensation);
 		void resetRefZeroPose();
+		void dumpFlightRecorder();
 		Q_INVOKABLE QString getDeviceModeErrorString();
 		Q_INVOKABLE bool isDesktopModeActive();
 
@@ -163,6 +204,31 @@ namespace motioncompensation
 		Q_INVOKABLE void increaseLPFBeta(double value);
 		Q_INVOKABLE void increaseSamples(int value);
 
+		Q_INVOKABLE void setFilterType(unsigned type);
+		Q_INVOKABLE unsigned getFilterType();
+
+		Q_INVOKABLE bool setKalmanProcessNoise(double value);
+		Q_INVOKABLE double getKalmanProcessNoise();
+
+		Q_INVOKABLE bool setKalmanObservationNoise(double value);
+		Q_INVOKABLE double getKalmanObservationNoise();
+
+		Q_INVOKABLE bool setKalmanPrediction(double value);
+		Q_INVOKABLE double getKalmanPrediction();
+
+		Q_INVOKABLE void scaleKalmanProcessNoise(double factor);
+		Q_INVOKABLE void increaseKalmanObservationNoise(double value);
+		Q_INVOKABLE void increaseKalmanPrediction(double value);
+
+		Q_INVOKABLE bool setOneEuroMinCutoff(double value);
+		Q_INVOKABLE double getOneEuroMinCutoff();
+
+		Q_INVOKABLE bool setOneEuroBeta(double value);
+		Q_INVOKABLE double getOneEuroBeta();
+
+		Q_INVOKABLE void increaseOneEuroMinCutoff(double value);
+		Q_INVOKABLE void increaseOneEuroBeta(double value);
+
 		Q_INVOKABLE void setHMDtoRefTranslationOffset(unsigned axis, double value);
 		Q_INVOKABLE void setHMDtoRefRotationOffset(unsigned axis, double value);
 
@@ -172,12 +238,40 @@ namespace motioncompensation
 		Q_INVOKABLE double getHMDtoRefTranslationOffset(unsigned axis);
 		Q_INVOKABLE double getHMDtoRefRotationOffset(unsigned axis);
 
+		// Motion compensated devices besides the HMD, offsets in cm
+		Q_INVOKABLE bool setDeviceCompensated(unsigned OpenVRId, bool compensated);
+		Q_INVOKABLE bool isDeviceCompensated(unsigned OpenVRId);
+		Q_INVOKABLE bool setDeviceOffset(unsigned OpenVRId, unsigned axis, double value);
+		Q_INVOKABLE double getDeviceOffset(unsigned OpenVRId, unsigned axis);
+		vrmotioncompensation::MotionCompensationDeviceOffset getDeviceCompensationOffset(unsigned OpenVRId);
+		bool sendDeviceCompensation(unsigned OpenVRId);
+
+		// Additional reference trackers on the rig, fused with the selected reference tracker
+		Q_INVOKABLE bool setDeviceReference(unsigned OpenVRId, bool reference);
+		Q_INVOKABLE bool isDeviceReference(unsigned OpenVRId);
+		std::vector<uint32_t> getReferenceTrackerIds(unsigned RTid);
+
 		Q_INVOKABLE void setMotionCompensationMode(unsigned NewMode);
 		Q_INVOKABLE int getMotionCompensationMode();
 
 		// Debug mode
 		Q_INVOKABLE bool setDebugMode(bool TestForStandby);
 		Q_INVOKABLE QString getDebugModeButtonText();
+
+		// Flight recorder, sent to the driver right away and with every applySettings
+		Q_INVOKABLE bool setFlightRecorder(bool enable);
+		Q_INVOKABLE bool getFlightRecorder();
+		vrmotioncompensation::FlightRecorderSettings getFlightRecorderSettings();
+
+		// Latency of the driver's pose path per device and stage, columns are device, stage, count, p50, p90, p99, p99.9 and max in us
+		Q_INVOKABLE bool updateLatencyStatistics();
+		Q_INVOKABLE bool resetLatencyStatistics();
+		Q_INVOKABLE unsigned getLatencyRowCount();
+		Q_INVOKABLE QString getLatencyRowText(unsigned row, unsigned column);
+
+		// Pose rate, inter-arrival p99 and poses without tracking from the driver's shared memory, refreshed with the device infos
+		void updatePoseStatistics();
+		Q_INVOKABLE QString getPoseStatisticsText(unsigned OpenVRId);
 		
 
 	public slots:
@@ -188,5 +282,6 @@ namespace motioncompensation
 		void settingChanged();
 		void offsetChanged();
 		void debugModeChanged();
+		void poseStatisticsChanged();
 	};
 } // namespace motioncompensation
\ No newline at end of file
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "vrmc_openvr.h"
+#include <openvr_math.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+// Small helpers shared by the benchmark executables
+namespace vrmotioncompensation
+{
+	namespace bench
+	{
+		// Per-call budget quoted in IVRServerDriverHost006Hooks::_trackedDevicePoseUpdated
+		static const double PoseBudgetNs = 166000.0;
+
+		// Keeps the compiler from optimizing away a value
+		template<typename T> inline void doNotOptimize(const T& value)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			__asm__ __volatile__("" : : "g"(&value) : "memory");
+#else
+			static volatile const void* sink;
+			sink = &value;
+#endif
+		}
+
+		inline double nowNs()
+		{
+			return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		// Whether a missed timing limit fails the bench. The limits hold on an otherwise idle machine, so ctest runs the
+		// benches for their correctness checks only with VRMC_BENCH_TIMING=0, unless VRMC_BENCH_TIMING_TESTS is on
+		inline bool timingChecked()
+		{
+			const char* value = std::getenv("VRMC_BENCH_TIMING");
+			return value == nullptr || std::strcmp(value, "0") != 0;
+		}
+
+		// Marker of a missed timing limit
+		inline const char* timingFailed()
+		{
+			return timingChecked() ? "FAILED" : "SLOW (not checked)";
+		}
+
+		// Default directory of the benchmarks that write files, the working directory if there is no temp directory
+		inline std::string tempDirectory()
+		{
+			std::error_code error;
+			std::filesystem::path path = std::filesystem::temp_directory_path(error);
+			return error ? std::string(".") : path.string();
+		}
+
+		inline void printHeader()
+		{
+			printf("%-44s %12s %14s %10s\n", "benchmark", "ns/pose", "poses/s", "% budget");
+		}
+
+		inline void printResult(const char* name, double totalNs, size_t count)
+		{
+			double nsPerPose = totalNs / (double)count;
+			printf("%-44s %12.1f %14.0f %10.4f\n", name, nsPerPose, 1.0E9 / nsPerPose, nsPerPose / PoseBudgetNs * 100.0);
+		}
+
+		// Generates a synthetic rig: the reference tracker sits on a platform that moves with
+		// a mix of sines (heave, surge, pitch, roll, yaw) plus sensor noise. The HMD rides on the same rig
+		// and additionally moves on its own.
+		class SyntheticRig
+		{
+		public:
+			SyntheticRig(unsigned seed = 42) : _Rng(seed), _Noise(0.0, 0.0005)
+			{
+			}
+
+			vr::DriverPose_t basePose()
+			{
+				vr::DriverPose_t pose = {};
+				pose.qWorldFromDriverRotation = vrmath::quaternionFromRotationY(0.3);
+				pose.vecWorldFromDriverTranslation[0] = 0.5;
+				pose.vecWorldFromDriverTranslation[1] = -1.2;
+				pose.vecWorldFromDriverTranslation[2] = 0.1;
+				pose.qDriverFromHeadRotation = { 1, 0, 0, 0 };
+				pose.qRotation = { 1, 0, 0, 0 };
+				pose.result = vr::TrackingResult_Running_OK;
+				pose.poseIsValid = true;
+				pose.deviceIsConnected = true;
+				return pose;
+			}
+
+			// Rig motion at time t in seconds
+			void rigMotion(double t, double(&pos)[3], vr::HmdQuaternion_t& rot)
+			{
+				pos[0] = 0.05 * std::sin(2.0 * 3.14159265358979 * 0.7 * t);
+				pos[1] = 1.0 + 0.08 * std::sin(2.0 * 3.14159265358979 * 1.3 * t);
+				pos[2] = 0.04 * std::sin(2.0 * 3.14159265358979 * 0.4 * t + 1.0);
+				rot = vrmath::quaternionFromYawPitchRoll(
+					0.10 * std::sin(2.0 * 3.14159265358979 * 0.2 * t),
+					0.15 * std::sin(2.0 * 3.14159265358979 * 0.9 * t),
+					0.12 * std::sin(2.0 * 3.14159265358979 * 0.6 * t));
+			}
+
+			vr::DriverPose_t refPose(double t, bool noise = true)
+			{
+				vr::DriverPose_t pose = basePose();
+				rigMotion(t, pose.vecPosition, pose.qRotation);
+				if (noise)
+				{
+					for (int i = 0; i < 3; i++)
+					{
+						pose.vecPosition[i] += _Noise(_Rng);
+					}
+				}
+				return pose;
+			}
+
+			vr::DriverPose_t hmdPose(double t)
+			{
+				vr::DriverPose_t pose = basePose();
+				double rigPos[3];
+				vr::HmdQuaternion_t rigRot;
+				rigMotion(t, rigPos, rigRot);
+
+				// Head offset on the rig plus some head movement of its own
+				vr::HmdVector3d_t head = { 0.1 * std::sin(t), 0.6, -0.3 + 0.05 * std::cos(1.7 * t) };
+				vr::HmdVector3d_t world = vrmath::quaternionRotateVector(rigRot, head) + rigPos;
+				pose.vecPosition[0] = world.v[0];
+				pose.vecPosition[1] = world.v[1];
+				pose.vecPosition[2] = world.v[2];
+				pose.qRotation = rigRot * vrmath::quaternionFromRotationY(0.4 * std::sin(0.5 * t));
+				pose.vecVelocity[0] = 0.1 * std::cos(t);
+				pose.vecAngularVelocity[1] = 0.2 * std::cos(0.5 * t);
+				return pose;
+			}
+
+			std::vector<vr::DriverPose_t> refStream(size_t count, double rate)
+			{
+				std::vector<vr::DriverPose_t> poses(count);
+				for (size_t i = 0; i < count; i++)
+				{
+					poses[i] = refPose((double)i / rate);
+				}
+				return poses;
+			}
+
+			std::vector<vr::DriverPose_t> hmdStream(size_t count, double rate)
+			{
+				std::vector<vr::DriverPose_t> poses(count);
+				for (size_t i = 0; i < count; i++)
+				{
+					poses[i] = hmdPose((double)i / rate);
+				}
+				return poses;
+			}
+
+		private:
+			std::mt19937 _Rng;
+			std::normal_distribution<double> _Noise;
+		};
+	}
+}
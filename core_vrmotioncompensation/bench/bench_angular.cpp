@@ -0,0 +1,251 @@
+#include "BenchUtil.h"
+#include "FilterPipeline.h"
+#include "Filters.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+
+using namespace vrmotioncompensation;
+
+// Checks the angular velocity and acceleration estimated from consecutive reference rotations against
+// analytic spinning-body trajectories, and compares them with the Euler angle differences used before.
+// The rate from two samples belongs to the middle of the interval, the acceleration from two rates to the
+// earlier sample, so the analytic values are taken there.
+// Exits with 1 if the quaternion estimate misses the analytic rate or acceleration by more than the tolerance,
+// or if the slerp low pass pipeline does not report the rate of a steady spin.
+// Usage: bench_vrmotioncompensation_angular [seconds]
+
+static const double PI = 3.14159265358979323846;
+static const double RefRate = 369.0;
+static const long long RefPeriodUs = 2710;
+static const int CostRounds = 7;
+
+// Relative to the magnitude of the analytic value, plus an absolute floor
+static const double RelTolerance = 1.0E-4;
+static const double AbsTolerance = 1.0E-6;
+
+struct Trajectory
+{
+	const char* Name;
+	std::function<vr::HmdQuaternion_t(double)> Rot;
+	std::function<vr::HmdVector3d_t(double)> AngVel;
+	std::function<vr::HmdVector3d_t(double)> AngAcc;
+};
+
+static vr::HmdVector3d_t scale(const vr::HmdVector3d_t& v, double s)
+{
+	return { v.v[0] * s, v.v[1] * s, v.v[2] * s };
+}
+
+static vr::HmdVector3d_t cross(const vr::HmdVector3d_t& a, const vr::HmdVector3d_t& b)
+{
+	return { a.v[1] * b.v[2] - a.v[2] * b.v[1], a.v[2] * b.v[0] - a.v[0] * b.v[2], a.v[0] * b.v[1] - a.v[1] * b.v[0] };
+}
+
+static double length(const vr::HmdVector3d_t& v)
+{
+	return std::sqrt(v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2]);
+}
+
+static std::vector<Trajectory> trajectories()
+{
+	std::vector<Trajectory> result;
+
+	// Constant spin about a tilted axis
+	const vr::HmdVector3d_t spin = scale({ 0.3, 0.8, -0.52 }, 4.0 / length({ 0.3, 0.8, -0.52 }));
+	result.push_back({ "steady spin 4 rad/s",
+		[=](double t) { return core::quaternionExp(scale(spin, t)); },
+		[=](double) { return spin; },
+		[=](double) { return vr::HmdVector3d_t{ 0, 0, 0 }; } });
+
+	// Pitch through +-90 degrees, where the Euler angles lock
+	const vr::HmdVector3d_t pitch = { 0, 2.0, 0 };
+	const vr::HmdQuaternion_t yawed = vrmath::quaternionFromRotationZ(0.4);
+	result.push_back({ "pitch through gimbal lock",
+		[=](double t) { return core::quaternionExp(scale(pitch, t)) * yawed; },
+		[=](double) { return pitch; },
+		[=](double) { return vr::HmdVector3d_t{ 0, 0, 0 }; } });
+
+	// Spin up with constant angular acceleration about a fixed axis
+	const vr::HmdVector3d_t alpha = scale({ -0.6, 0.0, 0.8 }, 1.5);
+	result.push_back({ "spin up 1.5 rad/s^2",
+		[=](double t) { return core::quaternionExp(scale(alpha, 0.5 * t * t)); },
+		[=](double t) { return scale(alpha, t); },
+		[=](double) { return alpha; } });
+
+	// Coning: a body spinning about its own axis, tilted by 30 degrees and precessing about the vertical
+	const double precession = 1.2;
+	const double own = 6.0;
+	const vr::HmdQuaternion_t tilt = vrmath::quaternionFromRotationX(PI / 6.0);
+	auto ownAxis = [=](double t) {
+		return vrmath::quaternionRotateVector(vrmath::quaternionFromRotationY(precession * t) * tilt, vr::HmdVector3d_t{ 0, 1, 0 });
+	};
+	result.push_back({ "coning 1.2 / 6 rad/s",
+		[=](double t) { return vrmath::quaternionFromRotationY(precession * t) * tilt * vrmath::quaternionFromRotationY(own * t); },
+		[=](double t) { return vr::HmdVector3d_t{ 0, precession, 0 } + scale(ownAxis(t), own); },
+		[=](double t) { return scale(cross({ 0, precession, 0 }, ownAxis(t)), own); } });
+
+	return result;
+}
+
+// The angular velocity of the filter chain before: differences of Euler angles, shortest difference
+// taken with fmod in degrees on radians, and the 1 - diff term
+static double legacyAngleDifference(double Raw, double New)
+{
+	double diff = std::fmod((New - Raw + 180.0), 360.0) - 180.0;
+	return diff < -180.0 ? diff + 360.0 : diff;
+}
+
+static vr::HmdVector3d_t legacyVelocity(double time, const vr::HmdQuaternion_t& q, const vr::HmdQuaternion_t& Old_q)
+{
+	vr::HmdVector3d_t euler = core::toEulerAngles(q);
+	vr::HmdVector3d_t eulerOld = core::toEulerAngles(Old_q);
+	vr::HmdVector3d_t result;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		result.v[axis] = (1 - legacyAngleDifference(euler.v[axis], eulerOld.v[axis])) / time;
+	}
+	return result;
+}
+
+struct Errors
+{
+	double MaxVel = 0.0;
+	double MaxAcc = 0.0;
+	double RmsVel = 0.0;
+	bool Ok = true;
+};
+
+// Runs an estimator over a trajectory and compares with the analytic rate and acceleration
+static Errors check(const Trajectory& trajectory, double seconds,
+	vr::HmdVector3d_t (*velocity)(double, const vr::HmdQuaternion_t&, const vr::HmdQuaternion_t&), bool withTolerance)
+{
+	Errors errors;
+	double dt = (double)RefPeriodUs / 1.0E6;
+	size_t count = (size_t)(seconds * RefRate);
+	vr::HmdQuaternion_t last = trajectory.Rot(0.0);
+	vr::HmdVector3d_t lastVel = { 0, 0, 0 };
+	double sum = 0.0;
+
+	for (size_t i = 1; i < count; i++)
+	{
+		double t = (double)i * dt;
+		vr::HmdQuaternion_t q = trajectory.Rot(t);
+		vr::HmdVector3d_t vel = velocity(dt, q, last);
+
+		vr::HmdVector3d_t velTruth = trajectory.AngVel(t - 0.5 * dt);
+		double velError = length(vel - velTruth);
+		errors.MaxVel = std::max(errors.MaxVel, velError);
+		sum += velError * velError;
+		if (withTolerance && velError > RelTolerance * length(velTruth) + AbsTolerance)
+		{
+			errors.Ok = false;
+		}
+
+		if (i >= 2)
+		{
+			vr::HmdVector3d_t acc = core::vecDerivative(dt, vel, lastVel);
+			vr::HmdVector3d_t accTruth = trajectory.AngAcc(t - dt);
+			double accError = length(acc - accTruth);
+			errors.MaxAcc = std::max(errors.MaxAcc, accError);
+
+			// The acceleration divides the rate error by dt once more
+			if (withTolerance && accError > RelTolerance * length(accTruth) + RelTolerance * length(velTruth) + AbsTolerance)
+			{
+				errors.Ok = false;
+			}
+		}
+
+		last = q;
+		lastVel = vel;
+	}
+	errors.RmsVel = std::sqrt(sum / (double)(count - 1));
+	return errors;
+}
+
+// A steady spin through the slerp low pass is a steady spin again, lagging behind: the pipeline has to report its rate
+static bool checkPipeline(const Trajectory& trajectory, double seconds, double& error)
+{
+	core::FilterContext ctx;
+	ctx.LpfBeta = 0.3;
+	core::FilterPipelineFn pipeline = core::selectFilterPipeline(MotionCompensationFilterType::Default, 1, ctx.LpfBeta, false);
+
+	vr::DriverPose_t pose = {};
+	pose.poseIsValid = true;
+	pose.result = vr::TrackingResult_Running_OK;
+
+	error = 0.0;
+	size_t count = (size_t)(seconds * RefRate);
+	for (size_t i = 0; i < count; i++)
+	{
+		long long sampleUs = (long long)i * RefPeriodUs;
+		pose.qRotation = trajectory.Rot((double)sampleUs / 1.0E6);
+		core::FilterOutput out;
+		pipeline(ctx, pose, sampleUs, out);
+
+		// Settled after a second
+		if (sampleUs > 1000000)
+		{
+			error = std::max(error, length(out.AngVel - trajectory.AngVel(0.0)));
+		}
+	}
+	return error <= 1.0E-3 * length(trajectory.AngVel(0.0));
+}
+
+static double cost(vr::HmdVector3d_t (*velocity)(double, const vr::HmdQuaternion_t&, const vr::HmdQuaternion_t&), const std::vector<vr::HmdQuaternion_t>& rotations)
+{
+	double checksum = 0.0;
+	double best = 1.0E300;
+	for (int round = 0; round < CostRounds; round++)
+	{
+		double start = bench::nowNs();
+		for (size_t i = 1; i < rotations.size(); i++)
+		{
+			checksum += velocity(1.0 / RefRate, rotations[i], rotations[i - 1]).v[1];
+		}
+		best = std::min(best, bench::nowNs() - start);
+	}
+	bench::doNotOptimize(checksum);
+	return best;
+}
+
+int main(int argc, char* argv[])
+{
+	double seconds = 10.0;
+	if (argc > 1)
+	{
+		seconds = std::max(2.0, std::atof(argv[1]));
+	}
+
+	bool ok = true;
+	printf("%-28s %-12s %14s %14s %14s\n", "trajectory", "estimator", "max rate err", "rms rate err", "max acc err");
+	printf("%-28s %-12s %14s %14s %14s\n", "", "", "rad/s", "rad/s", "rad/s^2");
+	for (const Trajectory& trajectory : trajectories())
+	{
+		Errors quat = check(trajectory, seconds, core::quaternionVelocity, true);
+		Errors euler = check(trajectory, seconds, legacyVelocity, false);
+		printf("%-28s %-12s %14.3g %14.3g %14.3g%s\n", trajectory.Name, "quaternion", quat.MaxVel, quat.RmsVel, quat.MaxAcc, quat.Ok ? "" : "  FAILED");
+		printf("%-28s %-12s %14.3g %14.3g %14.3g\n", "", "Euler (old)", euler.MaxVel, euler.RmsVel, euler.MaxAcc);
+		ok = ok && quat.Ok;
+	}
+
+	double pipelineError;
+	bool pipelineOk = checkPipeline(trajectories()[0], seconds, pipelineError);
+	printf("\nslerp LPF pipeline on the steady spin: max rate error %.3g rad/s%s\n\n", pipelineError, pipelineOk ? "" : "  FAILED");
+	ok = ok && pipelineOk;
+
+	// ----------------------------------------------------------------------------------------------- //
+	// Cost
+	std::vector<vr::HmdQuaternion_t> rotations(200000);
+	const Trajectory coning = trajectories()[3];
+	for (size_t i = 0; i < rotations.size(); i++)
+	{
+		rotations[i] = coning.Rot((double)i / RefRate);
+	}
+	bench::printHeader();
+	bench::printResult("angular velocity: quaternion", cost(core::quaternionVelocity, rotations), rotations.size() - 1);
+	bench::printResult("angular velocity: Euler (old)", cost(legacyVelocity, rotations), rotations.size() - 1);
+
+	return ok ? 0 : 1;
+}
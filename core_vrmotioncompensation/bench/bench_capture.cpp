@@ -0,0 +1,206 @@
+#include "BenchUtil.h"
+#include "CaptureFile.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+using namespace vrmotioncompensation;
+
+// Writes a debug logger sized capture (50000 data points of 4 quaternion and 12 vector channels) the old way, as
+// semicolon separated text through std::ofstream with std::endl after every line, and as a binary capture through
+// the memory mapped writer. The capture is read back without copying and converted to csv.
+// Exits with 1 if a value read back from the capture or parsed from the csv differs from the one written,
+// or the channel names or record count do not survive.
+// Usage: bench_vrmotioncompensation_capture [data points] [directory]
+
+static const int Quaternions = 4;
+static const int Vectors = 12;
+
+static long long fileSize(const std::string& path)
+{
+	std::FILE* file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr)
+	{
+		return -1;
+	}
+	std::fseek(file, 0, SEEK_END);
+	long long size = std::ftell(file);
+	std::fclose(file);
+	return size;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t points = 50000;
+	std::string directory = ".";
+	if (argc > 1)
+	{
+		points = (size_t)std::max(1, std::atoi(argv[1]));
+	}
+	if (argc > 2)
+	{
+		directory = argv[2];
+	}
+	const std::string textPath = directory + "/bench_capture.txt";
+	const std::string capturePath = directory + "/bench_capture.vrmccap";
+	const std::string csvPath = directory + "/bench_capture.csv";
+
+	std::vector<core::CaptureChannel> channels;
+	for (int i = 0; i < Quaternions; i++)
+	{
+		channels.push_back({ "Rotation" + std::to_string(i), core::CaptureChannelType::Quaternion });
+	}
+	for (int i = 0; i < Vectors; i++)
+	{
+		channels.push_back({ "Vector" + std::to_string(i), core::CaptureChannelType::Vector3 });
+	}
+
+	// Data points of a rig: time, then the channels with full precision values
+	bench::SyntheticRig rig;
+	const size_t doubles = 1 + Quaternions * 4 + Vectors * 3;
+	std::vector<double> data(points * doubles);
+	for (size_t i = 0; i < points; i++)
+	{
+		double t = (double)i / 1000.0;
+		vr::DriverPose_t pose = rig.hmdPose(t);
+		double* record = &data[i * doubles];
+		size_t index = 0;
+		record[index++] = t;
+		for (int q = 0; q < Quaternions; q++)
+		{
+			vr::HmdQuaternion_t rot = pose.qRotation * vrmath::quaternionFromRotationY(0.1 * q);
+			record[index++] = rot.w;
+			record[index++] = rot.x;
+			record[index++] = rot.y;
+			record[index++] = rot.z;
+		}
+		for (int v = 0; v < Vectors; v++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				record[index++] = pose.vecPosition[axis] * (1.0 + 0.01 * v) + 1.0E-7 * (double)i;
+			}
+		}
+	}
+
+	bool ok = true;
+
+	// The old text file
+	double start = bench::nowNs();
+	{
+		std::ofstream file(textPath);
+		file << "Time;";
+		for (const core::CaptureChannel& channel : channels)
+		{
+			file << channel.Name << ";";
+		}
+		file << std::endl;
+		for (size_t i = 0; i < points; i++)
+		{
+			for (size_t j = 0; j < doubles; j++)
+			{
+				file << data[i * doubles + j] << ";";
+			}
+			file << std::endl;
+		}
+	}
+	double textNs = bench::nowNs() - start;
+
+	// The binary capture, grown from a small start to include the remapping
+	start = bench::nowNs();
+	{
+		core::CaptureWriter writer;
+		if (!writer.open(capturePath.c_str(), channels, 1234567, 1024))
+		{
+			printf("FAILED: could not create %s\n", capturePath.c_str());
+			return 1;
+		}
+		for (size_t i = 0; i < points; i++)
+		{
+			writer.append(&data[i * doubles]);
+		}
+	}
+	double captureNs = bench::nowNs() - start;
+
+	// Read back
+	core::CaptureReader reader;
+	start = bench::nowNs();
+	bool opened = reader.open(capturePath.c_str());
+	double openNs = bench::nowNs() - start;
+	if (!opened || reader.getRecordCount() != points || reader.getChannelCount() != channels.size() || reader.getHeader().StartTimeUs != 1234567)
+	{
+		printf("FAILED: the capture header does not match what was written\n");
+		return 1;
+	}
+	for (uint32_t i = 0; i < reader.getChannelCount(); i++)
+	{
+		if (channels[i].Name != reader.getChannel(i).Name || (uint32_t)channels[i].Type != reader.getChannel(i).Type)
+		{
+			printf("FAILED: channel %u is %s instead of %s\n", i, reader.getChannel(i).Name, channels[i].Name.c_str());
+			ok = false;
+		}
+	}
+	if (std::memcmp(reader.getRecord(0), data.data(), data.size() * sizeof(double)) != 0)
+	{
+		printf("FAILED: the records read back differ from the ones written\n");
+		ok = false;
+	}
+
+	// Csv, parsed back value by value
+	start = bench::nowNs();
+	{
+		std::FILE* file = std::fopen(csvPath.c_str(), "w");
+		reader.writeCsv(file);
+		std::fclose(file);
+	}
+	double csvNs = bench::nowNs() - start;
+	{
+		std::FILE* file = std::fopen(csvPath.c_str(), "r");
+		std::vector<char> line(doubles * 40 + 4096);
+		size_t row = 0;
+		size_t mismatches = 0;
+		bool title = true;
+		while (std::fgets(line.data(), (int)line.size(), file) != nullptr)
+		{
+			if (title)
+			{
+				title = false;
+				if (std::strncmp(line.data(), "Time,Rotation0.w,Rotation0.x", 28) != 0)
+				{
+					printf("FAILED: unexpected csv title %.60s\n", line.data());
+					ok = false;
+				}
+				continue;
+			}
+			char* pos = line.data();
+			for (size_t j = 0; j < doubles; j++)
+			{
+				double value = std::strtod(pos, &pos);
+				mismatches += (row < points && value != data[row * doubles + j]) ? 1 : 0;
+				pos++;
+			}
+			row++;
+		}
+		std::fclose(file);
+		if (row != points || mismatches != 0)
+		{
+			printf("FAILED: the csv has %zu rows and %zu values that differ\n", row, mismatches);
+			ok = false;
+		}
+	}
+	reader.close();
+
+	printf("%zu data points of %d quaternion and %d vector channels\n\n", points, Quaternions, Vectors);
+	printf("%-36s %10s %12s %14s\n", "", "ms", "MB", "ns/point");
+	printf("%-36s %10.2f %12.2f %14.1f\n", "text, ofstream and endl (old)", textNs / 1.0E6, (double)fileSize(textPath) / 1.0E6, textNs / (double)points);
+	printf("%-36s %10.2f %12.2f %14.1f\n", "binary capture, mapped", captureNs / 1.0E6, (double)fileSize(capturePath) / 1.0E6, captureNs / (double)points);
+	printf("%-36s %10.2f %12s %14.1f\n", "open capture for reading", openNs / 1.0E6, "", openNs / (double)points);
+	printf("%-36s %10.2f %12.2f %14.1f\n", "capture to csv, exact", csvNs / 1.0E6, (double)fileSize(csvPath) / 1.0E6, csvNs / (double)points);
+
+	std::remove(textPath.c_str());
+	std::remove(capturePath.c_str());
+	std::remove(csvPath.c_str());
+	return ok ? 0 : 1;
+}
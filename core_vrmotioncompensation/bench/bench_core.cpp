@@ -0,0 +1,276 @@
+#include "BenchUtil.h"
+#include "CompensatedDevices.h"
+#include "MotionCompensationCore.h"
+
+#include <cstdlib>
+
+using namespace vrmotioncompensation;
+
+// Benchmarks the reference tracker update and the HMD compensation on synthetic pose streams.
+// Checks that a device with an offset is passed through unchanged while compensation is disabled or the reference is
+// not valid, and moved by its offset once it is. Exits with 1 if not.
+// Then switches the compensation mode with two compensated devices that carry an offset. Exits with 1 if a device
+// is not back in the default mode without an offset afterwards.
+// Usage: bench_vrmotioncompensation_core [pose count]
+
+static const double RefRate = 369.0;
+static const double HmdRate = 1120.0;
+
+static void primeCore(core::MotionCompensationCore& mc, bench::SyntheticRig& rig, double lpfBeta, uint32_t samples)
+{
+	mc.setLpfBeta(lpfBeta);
+	mc.setAlpha(samples);
+	mc.setEnabled(true);
+	mc.setZeroPose(rig.refPose(0.0, false));
+
+	// The reference pose becomes valid after 100 updates
+	for (int i = 1; i <= 200; i++)
+	{
+		mc.updateRefPose(rig.refPose(i / RefRate), (long long)(i / RefRate * 1.0E6));
+	}
+}
+
+static void benchUpdateRefPose(const char* name, double lpfBeta, uint32_t samples, const std::vector<vr::DriverPose_t>& refPoses)
+{
+	core::MotionCompensationCore mc;
+	bench::SyntheticRig rig;
+	primeCore(mc, rig, lpfBeta, samples);
+
+	long long timestamp = 0;
+	double start = bench::nowNs();
+	for (size_t i = 0; i < refPoses.size(); i++)
+	{
+		timestamp += 2710;
+		mc.updateRefPose(refPoses[i], timestamp);
+	}
+	double end = bench::nowNs();
+
+	bench::printResult(name, end - start, refPoses.size());
+}
+
+static void benchApplyMotionCompensation(const char* name, bool setZero, bool timeAligned, const std::vector<vr::DriverPose_t>& hmdPoses, size_t count)
+{
+	core::MotionCompensationCore mc;
+	bench::SyntheticRig rig;
+	primeCore(mc, rig, 0.2, 12);
+	mc.setZeroMode(setZero);
+
+	// Somewhere between the last two reference samples
+	long long timestamp = (long long)(199.5 / RefRate * 1.0E6);
+
+	double checksum = 0.0;
+	double start = bench::nowNs();
+	for (size_t i = 0; i < count; i++)
+	{
+		vr::DriverPose_t pose = hmdPoses[i % hmdPoses.size()];
+		if (timeAligned)
+		{
+			mc.applyMotionCompensation(pose, timestamp);
+		}
+		else
+		{
+			mc.applyMotionCompensation(pose);
+		}
+		checksum += pose.vecPosition[0];
+	}
+	double end = bench::nowNs();
+	bench::doNotOptimize(checksum);
+
+	bench::printResult(name, end - start, count);
+}
+
+// HMD and reference tracker poses interleaved at their native rates, like inside vrserver
+static void benchInterleaved(const char* name, const std::vector<vr::DriverPose_t>& refPoses, const std::vector<vr::DriverPose_t>& hmdPoses, size_t count)
+{
+	core::MotionCompensationCore mc;
+	bench::SyntheticRig rig;
+	primeCore(mc, rig, 0.2, 12);
+
+	double checksum = 0.0;
+	size_t refIndex = 0;
+	double start = bench::nowNs();
+	for (size_t i = 0; i < count; i++)
+	{
+		double t = (double)i / HmdRate;
+		while ((double)refIndex / RefRate <= t)
+		{
+			mc.updateRefPose(refPoses[refIndex % refPoses.size()], (long long)((double)refIndex / RefRate * 1.0E6));
+			refIndex++;
+		}
+
+		vr::DriverPose_t pose = hmdPoses[i % hmdPoses.size()];
+		mc.applyMotionCompensation(pose, (long long)(t * 1.0E6));
+		checksum += pose.vecPosition[1];
+	}
+	double end = bench::nowNs();
+	bench::doNotOptimize(checksum);
+
+	bench::printResult(name, end - start, count + refIndex);
+}
+
+// Several compensated devices (HMD, controllers, trackers) updated at the HMD rate against the same reference.
+// Every device besides the HMD carries an offset. The cost per compensated pose should not grow with the device count.
+static void benchMultiDevice(const char* name, size_t devices, const std::vector<vr::DriverPose_t>& refPoses, const std::vector<vr::DriverPose_t>& hmdPoses, size_t count)
+{
+	core::MotionCompensationCore mc;
+	bench::SyntheticRig rig;
+	primeCore(mc, rig, 0.2, 12);
+
+	const MotionCompensationDeviceOffset offset = { { 0.0, -0.05, 0.12 }, vrmath::quaternionFromRotationX(0.3) };
+
+	double checksum = 0.0;
+	size_t refIndex = 0;
+	size_t poseCount = 0;
+	double start = bench::nowNs();
+	for (size_t i = 0; poseCount < count; i++)
+	{
+		double t = (double)i / HmdRate;
+		while ((double)refIndex / RefRate <= t)
+		{
+			mc.updateRefPose(refPoses[refIndex % refPoses.size()], (long long)((double)refIndex / RefRate * 1.0E6));
+			refIndex++;
+		}
+
+		for (size_t device = 0; device < devices; device++)
+		{
+			vr::DriverPose_t pose = hmdPoses[(i + device * 97) % hmdPoses.size()];
+			if (device == 0)
+			{
+				mc.applyMotionCompensation(pose, (long long)(t * 1.0E6));
+			}
+			else
+			{
+				mc.applyMotionCompensation(pose, (long long)(t * 1.0E6), offset);
+			}
+			checksum += pose.vecPosition[1];
+		}
+		poseCount += devices;
+	}
+	double end = bench::nowNs();
+	bench::doNotOptimize(checksum);
+
+	bench::printResult(name, end - start, poseCount + refIndex);
+}
+
+static bool samePose(const vr::DriverPose_t& a, const vr::DriverPose_t& b)
+{
+	return a.vecPosition[0] == b.vecPosition[0] && a.vecPosition[1] == b.vecPosition[1] && a.vecPosition[2] == b.vecPosition[2]
+		&& a.qRotation.w == b.qRotation.w && a.qRotation.x == b.qRotation.x && a.qRotation.y == b.qRotation.y && a.qRotation.z == b.qRotation.z;
+}
+
+static bool checkOffsetWithoutCompensation(const std::vector<vr::DriverPose_t>& hmdPoses)
+{
+	const MotionCompensationDeviceOffset offset = { { 0.0, -0.05, 0.12 }, vrmath::quaternionFromRotationX(0.3) };
+	const vr::DriverPose_t raw = hmdPoses[0];
+	bench::SyntheticRig rig;
+	core::MotionCompensationCore mc;
+
+	// Disabled, then enabled before the reference pose is valid
+	vr::DriverPose_t disabled = raw;
+	mc.applyMotionCompensation(disabled, 0, offset);
+	mc.setEnabled(true);
+	mc.setZeroPose(rig.refPose(0.0, false));
+	vr::DriverPose_t noReference = raw;
+	mc.applyMotionCompensation(noReference, 0, offset);
+
+	// Compensated with and without the offset
+	for (int i = 1; i <= 200; i++)
+	{
+		mc.updateRefPose(rig.refPose(i / RefRate), (long long)(i / RefRate * 1.0E6));
+	}
+	long long timestampUs = (long long)(200 / RefRate * 1.0E6);
+	vr::DriverPose_t compensated = raw;
+	mc.applyMotionCompensation(compensated, timestampUs);
+	vr::DriverPose_t withOffset = raw;
+	mc.applyMotionCompensation(withOffset, timestampUs, offset);
+	vr::DriverPose_t expected = compensated;
+	core::MotionCompensationCore::applyDeviceOffset(expected, offset);
+
+	bool ok = samePose(disabled, raw) && samePose(noReference, raw) && samePose(withOffset, expected);
+	printf("\noffset without compensation: %s\n", ok ? "passed through, applied once compensated" : "FAILED");
+	return ok;
+}
+
+// Stands in for the driver's DeviceManipulationHandle
+struct DeviceHandle
+{
+	MotionCompensationDeviceMode Mode = MotionCompensationDeviceMode::Default;
+	MotionCompensationDeviceOffset Offset = { { 0, 0, 0 }, { 1, 0, 0, 0 } };
+
+	void setMotionCompensationDeviceMode(MotionCompensationDeviceMode mode)
+	{
+		Mode = mode;
+	}
+
+	void setOffset(const MotionCompensationDeviceOffset& offset)
+	{
+		Offset = offset;
+	}
+};
+
+static bool checkModeSwitch()
+{
+	// Device 5 is gone by the time the mode is switched
+	DeviceHandle handles[4];
+	const MotionCompensationDeviceOffset offset = { { 0.0, -0.05, 0.12 }, vrmath::quaternionFromRotationX(0.3) };
+	core::CompensatedDevices devices;
+	for (uint32_t id : { 1u, 2u, 5u })
+	{
+		devices.add(id);
+		if (id < 4)
+		{
+			handles[id].setOffset(offset);
+			handles[id].setMotionCompensationDeviceMode(MotionCompensationDeviceMode::MotionCompensated);
+		}
+	}
+	bool ok = !devices.add(2) && devices.devices().size() == 3;
+
+	devices.releaseAll([&handles](uint32_t id)
+	{
+		return id < 4 ? &handles[id] : nullptr;
+	});
+	for (uint32_t id : { 1u, 2u })
+	{
+		const DeviceHandle& handle = handles[id];
+		ok = ok && handle.Mode == MotionCompensationDeviceMode::Default
+			&& handle.Offset.Translation.v[0] == 0.0 && handle.Offset.Translation.v[1] == 0.0 && handle.Offset.Translation.v[2] == 0.0
+			&& handle.Offset.Rotation.w == 1.0 && handle.Offset.Rotation.x == 0.0 && handle.Offset.Rotation.y == 0.0 && handle.Offset.Rotation.z == 0.0;
+	}
+	ok = ok && devices.devices().empty() && !devices.contains(1) && devices.add(1);
+
+	printf("\nmode switch with two compensated devices: %s\n", ok ? "both back to default without an offset" : "FAILED");
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = 1000000;
+	if (argc > 1)
+	{
+		count = (size_t)std::strtoull(argv[1], nullptr, 10);
+	}
+
+	bench::SyntheticRig rig;
+	std::vector<vr::DriverPose_t> refPoses = rig.refStream(count, RefRate);
+	std::vector<vr::DriverPose_t> hmdPoses = rig.hmdStream(4096, HmdRate);
+
+	printf("Pose count: %zu, budget per call: %.0f ns\n\n", count, bench::PoseBudgetNs);
+	bench::printHeader();
+
+	benchUpdateRefPose("updateRefPose (DEMA + LPF)", 0.2, 12, refPoses);
+	benchUpdateRefPose("updateRefPose (DEMA, LPF off)", 1.0, 12, refPoses);
+	benchUpdateRefPose("updateRefPose (filters off)", 1.0, 1, refPoses);
+
+	benchApplyMotionCompensation("applyMotionCompensation", false, false, hmdPoses, count);
+	benchApplyMotionCompensation("applyMotionCompensation (setZero)", true, false, hmdPoses, count);
+	benchApplyMotionCompensation("applyMotionCompensation (time aligned)", false, true, hmdPoses, count);
+
+	benchInterleaved("interleaved 1120 Hz HMD / 369 Hz ref", refPoses, hmdPoses, count);
+	benchMultiDevice("interleaved, 1 compensated device", 1, refPoses, hmdPoses, count);
+	benchMultiDevice("interleaved, 3 compensated devices", 3, refPoses, hmdPoses, count);
+	benchMultiDevice("interleaved, 7 compensated devices", 7, refPoses, hmdPoses, count);
+
+	bool ok = checkOffsetWithoutCompensation(hmdPoses);
+	ok = checkModeSwitch() && ok;
+	return ok ? 0 : 1;
+}
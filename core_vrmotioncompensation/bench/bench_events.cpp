@@ -0,0 +1,184 @@
+#include "BenchUtil.h"
+#include "DeviceEventQueue.h"
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace vrmotioncompensation;
+
+// Checks the queue the driver hands device events through to the thread that pushes them to the clients.
+// Producer threads push numbered events as fast as they can while the delivering thread pops them; every event
+// has to arrive once, intact and in the order of its producer, or be counted as dropped. A queue nobody pops
+// has to drop and count instead of blocking the producer. Then events are pushed one at a time to a delivering
+// thread that sleeps in between, as the driver's events arrive, and the time from the push to the pop is measured.
+// Exits with 1 if an event was lost without being counted, duplicated, reordered or corrupted, a full queue
+// blocked a push, or the p99 from the push to the pop of a sleeping delivering thread exceeds 1 ms.
+// Usage: bench_vrmotioncompensation_events [events]
+
+static const int Producers = 4;
+static const uint64_t DeliveryBudgetNs = 1000000;
+
+static std::string queueName(const char* name)
+{
+	return std::string("vrmc_bench_events.") + name + "." + std::to_string((long long)bench::nowNs());
+}
+
+static DeviceEvent makeEvent(uint32_t producer, uint32_t number)
+{
+	DeviceEvent event = {};
+	event.Type = (DeviceEventType)(1 + number % 9);
+	event.OpenVRId = producer;
+	event.Generation = number;
+	event.SerialHash = hashSerialNumber("LHR-0000000") ^ ((uint64_t)producer << 32 | number);
+	return event;
+}
+
+static bool checkOrdering(uint32_t count)
+{
+	core::DeviceEventQueue queue;
+	if (!queue.create(queueName("ordering").c_str()))
+	{
+		printf("FAILED: could not create a queue\n");
+		return false;
+	}
+
+	std::vector<std::thread> producers;
+	for (uint32_t p = 0; p < Producers; p++)
+	{
+		producers.emplace_back([&queue, p, count]()
+		{
+			for (uint32_t n = 0; n < count; n++)
+			{
+				queue.push(makeEvent(p, n));
+			}
+		});
+	}
+
+	// Events of a producer may be dropped but never reordered
+	std::vector<int64_t> last(Producers, -1);
+	uint64_t received = 0;
+	uint64_t bad = 0;
+	DeviceEvent event;
+	while (queue.pop(event, 100))
+	{
+		received++;
+		DeviceEvent expected = makeEvent(event.OpenVRId % Producers, event.Generation);
+		if (event.OpenVRId >= Producers || (int64_t)event.Generation <= last[event.OpenVRId] || event.Type != expected.Type
+			|| event.SerialHash != expected.SerialHash)
+		{
+			bad++;
+			continue;
+		}
+		last[event.OpenVRId] = event.Generation;
+	}
+	for (std::thread& producer : producers)
+	{
+		producer.join();
+	}
+	while (queue.pop(event, 0))
+	{
+		received++;
+	}
+
+	bool ok = bad == 0 && received + queue.getDropped() == (uint64_t)count * Producers;
+	printf("%d producers pushed %llu events, %llu delivered, %llu dropped, %llu out of order or corrupted %s\n", Producers,
+		(unsigned long long)count * Producers, (unsigned long long)received, (unsigned long long)queue.getDropped(),
+		(unsigned long long)bad, ok ? "" : "FAILED");
+	return ok;
+}
+
+static bool checkFull()
+{
+	core::DeviceEventQueue queue;
+	queue.create(queueName("full").c_str());
+
+	bool ok = true;
+	for (uint32_t n = 0; n < core::DeviceEventQueue::Capacity; n++)
+	{
+		ok = queue.push(makeEvent(0, n)) && ok;
+	}
+	double start = bench::nowNs();
+	ok = !queue.push(makeEvent(0, core::DeviceEventQueue::Capacity)) && queue.getDropped() == 1 && ok;
+	double fullNs = bench::nowNs() - start;
+
+	// The event that did not fit is gone, the ones before it are still there in order
+	DeviceEvent event;
+	uint32_t popped = 0;
+	while (queue.pop(event, 0))
+	{
+		ok = event.Generation == popped && ok;
+		popped++;
+	}
+	ok = popped == core::DeviceEventQueue::Capacity && ok;
+
+	// A queue that was never created drops as well
+	core::DeviceEventQueue none;
+	ok = !none.push(makeEvent(0, 0)) && none.getDropped() == 1 && !none.pop(event, 0) && ok;
+
+	bool fast = fullNs < 1.0E6;
+	printf("full queue dropped and counted in %.0f ns %s\n", fullNs, !ok ? "FAILED" : fast ? "" : bench::timingFailed());
+	return ok && (fast || !bench::timingChecked());
+}
+
+static bool checkDelivery(uint32_t count)
+{
+	core::DeviceEventQueue queue;
+	queue.create(queueName("delivery").c_str());
+
+	core::LatencyHistogram delivery;
+	core::LatencyHistogram push;
+	std::atomic<uint32_t> delivered = { 0 };
+	std::thread consumer([&]()
+	{
+		DeviceEvent event;
+		while (delivered.load() < count && queue.pop(event, 1000))
+		{
+			delivery.record((uint64_t)(core::LatencyHistogram::nowNs() - event.TimeNs));
+			delivered++;
+		}
+	});
+
+	for (uint32_t n = 0; n < count; n++)
+	{
+		// Gives the delivering thread time to go to sleep, like the driver's events that come seconds apart
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		DeviceEvent event = makeEvent(0, n);
+		event.TimeNs = core::LatencyHistogram::nowNs();
+		queue.push(event);
+		push.record((uint64_t)(core::LatencyHistogram::nowNs() - event.TimeNs));
+	}
+	consumer.join();
+
+	LatencyStatistics pushStatistics = push.getStatistics();
+	LatencyStatistics statistics = delivery.getStatistics();
+	bool ok = delivered.load() == count;
+	bool fast = statistics.P99Ns <= DeliveryBudgetNs;
+	printf("\n%-26s %7s %12s %12s %12s %12s\n", "us", "count", "p50", "p99", "p99.9", "max");
+	printf("%-26s %7llu %12.1f %12.1f %12.1f %12.1f\n", "push, receiver asleep", (unsigned long long)pushStatistics.Count,
+		(double)pushStatistics.P50Ns / 1000.0, (double)pushStatistics.P99Ns / 1000.0, (double)pushStatistics.P999Ns / 1000.0, (double)pushStatistics.MaxNs / 1000.0);
+	printf("%-26s %7llu %12.1f %12.1f %12.1f %12.1f %s\n", "push to pop", (unsigned long long)statistics.Count,
+		(double)statistics.P50Ns / 1000.0, (double)statistics.P99Ns / 1000.0, (double)statistics.P999Ns / 1000.0, (double)statistics.MaxNs / 1000.0,
+		!ok ? "FAILED" : fast ? "" : bench::timingFailed());
+	return ok && (fast || !bench::timingChecked());
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t count = 200000;
+	if (argc > 1)
+	{
+		count = (uint32_t)std::max(1000, std::atoi(argv[1]));
+	}
+
+	bool ok = checkOrdering(count);
+	ok = checkFull() && ok;
+	ok = checkDelivery(std::max<uint32_t>(200, count / 500)) && ok;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,441 @@
+#include "BenchUtil.h"
+#include "MotionCompensationCore.h"
+#include "Filters.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <random>
+
+using namespace vrmotioncompensation;
+
+// Compares the reference tracker filters by output noise, effective latency and cost per sample.
+// The noise is the RMS deviation of the filtered pose while the tracker stands still. The effective latency
+// is the RMS deviation of a moving tracker, without the noise part, divided by the RMS speed: the delay
+// a pure lag would need for the same error. Unlike a fitted delay this also covers the overshoot of DEMA.
+// For every DEMA / LPF setting the Kalman filter is tuned to the same output noise, then the latencies are compared.
+// The One Euro filter is tuned by its cutoff at rest to the same noise.
+// Exits with 1 if the Kalman filter is not faster than DEMA on the position at equal noise, or if one One Euro step
+// costs more than DEMA plus the two slerps of the default chain, or if the One Euro velocities fail the step check
+// below. The rotation latency is only reported: the two stage
+// slerp low pass is a pure lag and trades noise for latency differently.
+// Usage: bench_vrmotioncompensation_filters [seconds]
+
+static const double PI = 3.14159265358979323846;
+static const double RefRate = 369.0;
+static const double PosNoise = 0.0005;
+static const double RotNoise = 0.0005;
+
+static const double OneEuroBeta = 1.0;
+
+// Skipped at the start of every run, so the filters have settled
+static const double SettleTime = 2.0;
+
+struct FilterConfig
+{
+	const char* Name;
+	MotionCompensationFilterType FilterType;
+	uint32_t Samples;
+	double LpfBeta;
+	double ProcessNoise;
+	double MinCutoff;
+	double Beta;
+};
+
+struct Channel
+{
+	std::function<double(double)> Truth;
+	std::vector<double> Time;
+	std::vector<double> Out;
+
+	// RMS deviation from the truth
+	double error() const
+	{
+		double sum = 0.0;
+		size_t count = 0;
+		for (size_t i = 0; i < Time.size(); i++)
+		{
+			if (Time[i] >= SettleTime)
+			{
+				double d = Out[i] - Truth(Time[i]);
+				sum += d * d;
+				count++;
+			}
+		}
+		return std::sqrt(sum / (double)count);
+	}
+
+	// RMS speed of the truth
+	double speed() const
+	{
+		double sum = 0.0;
+		size_t count = 0;
+		for (size_t i = 0; i < Time.size(); i++)
+		{
+			if (Time[i] >= SettleTime)
+			{
+				double d = (Truth(Time[i] + 1.0E-5) - Truth(Time[i] - 1.0E-5)) / 2.0E-5;
+				sum += d * d;
+				count++;
+			}
+		}
+		return std::sqrt(sum / (double)count);
+	}
+};
+
+static double movingPos(double t)
+{
+	return 0.05 * std::sin(2.0 * PI * 0.7 * t) + 0.03 * std::sin(2.0 * PI * 1.9 * t + 0.5);
+}
+
+static double movingRot(double t)
+{
+	return 0.10 * std::sin(2.0 * PI * 0.9 * t) + 0.05 * std::sin(2.0 * PI * 2.3 * t + 1.0);
+}
+
+// Feeds a tracker moving along y and rotating around y through the core and records the filtered reference
+static void run(const FilterConfig& config, double seconds, bool moving, Channel& pos, Channel& rot)
+{
+	pos.Truth = moving ? movingPos : +[](double) { return 0.02; };
+	rot.Truth = moving ? movingRot : +[](double) { return 0.05; };
+
+	core::MotionCompensationCore mc;
+	mc.setFilterType(config.FilterType);
+	mc.setLpfBeta(config.LpfBeta);
+	mc.setAlpha(config.Samples);
+	mc.setKalmanNoise(config.ProcessNoise, PosNoise);
+	mc.setOneEuroParameters(config.MinCutoff, config.Beta);
+	mc.setEnabled(true);
+
+	vr::DriverPose_t pose = {};
+	pose.qWorldFromDriverRotation = { 1, 0, 0, 0 };
+	pose.qDriverFromHeadRotation = { 1, 0, 0, 0 };
+	pose.qRotation = { 1, 0, 0, 0 };
+	mc.setZeroPose(pose);
+
+	std::mt19937 rng(7);
+	std::normal_distribution<double> posNoise(0.0, PosNoise);
+	std::normal_distribution<double> rotNoise(0.0, RotNoise);
+
+	for (size_t i = 0; (double)i / RefRate < seconds; i++)
+	{
+		double t = (double)i / RefRate;
+		pose.vecPosition[1] = pos.Truth(t) + posNoise(rng);
+		pose.qRotation = vrmath::quaternionFromRotationY(rot.Truth(t) + rotNoise(rng));
+		mc.updateRefPose(pose, (long long)(t * 1.0E6));
+
+		core::ReferenceSnapshot ref = mc.getSnapshot();
+		pos.Time.push_back(t);
+		pos.Out.push_back(ref.RefPos.v[1]);
+		rot.Time.push_back(t);
+		rot.Out.push_back(core::quaternionLog(ref.RefRot).v[1]);
+	}
+}
+
+static void measureNoise(const FilterConfig& config, double seconds, double& posNoise, double& rotNoise)
+{
+	Channel pos, rot;
+	run(config, seconds, false, pos, rot);
+	posNoise = pos.error();
+	rotNoise = rot.error();
+}
+
+static double effectiveLatency(const Channel& channel, double noise)
+{
+	double error = channel.error();
+	return std::sqrt(std::max(0.0, error * error - noise * noise)) / channel.speed();
+}
+
+static void measureLatency(const FilterConfig& config, double seconds, double posNoise, double rotNoise, double& posLatency, double& rotLatency)
+{
+	Channel pos, rot;
+	run(config, seconds, true, pos, rot);
+	posLatency = effectiveLatency(pos, posNoise);
+	rotLatency = effectiveLatency(rot, rotNoise);
+}
+
+static FilterConfig kalmanConfig(double processNoise)
+{
+	return { "", MotionCompensationFilterType::Kalman, 2, 1.0, processNoise, 0.0, 0.0 };
+}
+
+static FilterConfig oneEuroConfig(double minCutoff)
+{
+	return { "", MotionCompensationFilterType::OneEuro, 2, 1.0, 0.0, minCutoff, OneEuroBeta };
+}
+
+// Parameter of a filter that gives the target output noise on one channel. The noise has to rise with the parameter.
+static double matchNoise(double seconds, double target, bool rotation, FilterConfig (*makeConfig)(double), double lo, double hi)
+{
+	lo = std::log(lo);
+	hi = std::log(hi);
+	for (int i = 0; i < 40; i++)
+	{
+		double mid = 0.5 * (lo + hi);
+		double posNoise, rotNoise;
+		measureNoise(makeConfig(std::exp(mid)), seconds, posNoise, rotNoise);
+		if ((rotation ? rotNoise : posNoise) > target)
+		{
+			hi = mid;
+		}
+		else
+		{
+			lo = mid;
+		}
+	}
+	return std::exp(0.5 * (lo + hi));
+}
+
+// ----------------------------------------------------------------------------------------------- //
+// Cost per sample
+
+// The One Euro filter on a noise-free rig that starts to move and rotate at a constant rate and stops again.
+// The published velocities have to be the rates of the published pose, must not overshoot the rig and have to fall
+// below 20% within 200 ms of the stop, ahead of the speed filtered at DerivativeCutoff that sets the cutoff
+static bool checkOneEuroStep()
+{
+	const long long StepUs = 2710;
+	const double Speed = 0.5;
+	const double AngularSpeed = 1.0;
+	const double MoveStart = 1.0;
+	const double MoveEnd = 2.0;
+	const double Probe = 0.2;
+
+	core::PoseOneEuroFilter filter;
+	filter.setParameters(1.0, OneEuroBeta);
+
+	double maxMismatch = 0.0;
+	double maxVel = 0.0;
+	double onsetVel = 0.0, stopVel = 0.0, stopAngVel = 0.0, stopLagged = 0.0;
+	double lagged = 0.0, lastRaw = 0.0;
+	vr::HmdVector3d_t lastPos = {};
+	vr::HmdQuaternion_t lastRot = { 1, 0, 0, 0 };
+	for (long long timeUs = 0; timeUs <= 3000000; timeUs += StepUs)
+	{
+		double t = (double)timeUs / 1.0E6;
+		double moved = std::min(std::max(t - MoveStart, 0.0), MoveEnd - MoveStart);
+		double pos[3] = { 0.0, 0.02 + Speed * moved, 0.0 };
+		vr::HmdQuaternion_t rot = vrmath::quaternionFromRotationY(AngularSpeed * moved);
+		filter.update(timeUs, pos, rot);
+		const core::PoseOneEuroFilter::State& state = filter.state();
+
+		double dt = (double)StepUs / 1.0E6;
+		if (timeUs > 0)
+		{
+			double angStep = core::quaternionLog(state.Rot * vrmath::quaternionConjugate(lastRot)).v[1];
+			maxMismatch = std::max(maxMismatch, std::fabs(state.Vel.v[1] * dt - (state.Pos.v[1] - lastPos.v[1])) / dt);
+			maxMismatch = std::max(maxMismatch, std::fabs(state.AngVel.v[1] * dt - angStep) / dt);
+			lagged += 2.0 * PI * dt / (2.0 * PI * dt + 1.0) * ((pos[1] - lastRaw) / dt - lagged);
+		}
+		maxVel = std::max(maxVel, state.Vel.v[1]);
+		if (timeUs == (long long)((MoveStart + Probe) * 1.0E6) / StepUs * StepUs)
+		{
+			onsetVel = state.Vel.v[1];
+		}
+		if (timeUs == (long long)((MoveEnd + Probe) * 1.0E6) / StepUs * StepUs)
+		{
+			stopVel = state.Vel.v[1];
+			stopAngVel = state.AngVel.v[1];
+			stopLagged = lagged;
+		}
+		lastPos = state.Pos;
+		lastRot = state.Rot;
+		lastRaw = pos[1];
+	}
+
+	bool ok = maxMismatch < 1.0E-9 && maxVel <= Speed * 1.02 && std::fabs(stopVel) < 0.2 * Speed && std::fabs(stopVel) < stopLagged
+		&& std::fabs(stopAngVel) < 0.2 * AngularSpeed;
+	printf("\nOne Euro step %.1f m/s, %.1f rad/s: %.0f ms after the start %.3f m/s, %.0f ms after the stop %.4f m/s and %.4f rad/s"
+		" (filtered speed %.3f m/s), max %.3f m/s, off the pose rate by %.1e %s\n", Speed, AngularSpeed, Probe * 1000.0, onsetVel,
+		Probe * 1000.0, stopVel, stopAngVel, stopLagged, maxVel, maxMismatch, ok ? "" : "FAILED");
+	return ok;
+}
+
+static const int CostRounds = 7;
+
+// Filter steps of the default chain: DEMA on the three axes, the two stage slerp low pass and the
+// angular velocity derived from its consecutive outputs
+static double costDemaSlerp(const std::vector<vr::DriverPose_t>& poses)
+{
+	double alpha = 2.0 / (1.0 + 12.0);
+	double lpfBeta = 0.85;
+	vr::HmdVector3d_t dema[2] = {};
+	vr::HmdQuaternion_t rot[2] = { { 1, 0, 0, 0 }, { 1, 0, 0, 0 } };
+	vr::HmdQuaternion_t last = { 1, 0, 0, 0 };
+	double checksum = 0.0;
+
+	double best = 1.0E300;
+	for (int round = 0; round < CostRounds; round++)
+	{
+		double start = bench::nowNs();
+		for (const vr::DriverPose_t& pose : poses)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				dema[0].v[axis] += alpha * (pose.vecPosition[axis] - dema[1].v[axis]);
+				dema[1].v[axis] += alpha * (dema[0].v[axis] - dema[1].v[axis]);
+				checksum += 2 * dema[0].v[axis] - dema[1].v[axis];
+			}
+			rot[0] = core::slerp(rot[0], pose.qRotation, lpfBeta);
+			rot[1] = core::slerp(rot[1], rot[0], lpfBeta);
+			checksum += core::quaternionVelocity(1.0 / RefRate, rot[1], last).v[0];
+			last = rot[1];
+		}
+		best = std::min(best, bench::nowNs() - start);
+	}
+	bench::doNotOptimize(checksum);
+	return best;
+}
+
+static double costOneEuro(const std::vector<vr::DriverPose_t>& poses)
+{
+	core::PoseOneEuroFilter filter;
+	double checksum = 0.0;
+
+	double best = 1.0E300;
+	long long timeUs = 0;
+	for (int round = 0; round < CostRounds; round++)
+	{
+		double start = bench::nowNs();
+		for (const vr::DriverPose_t& pose : poses)
+		{
+			timeUs += 2710;
+			filter.update(timeUs, pose.vecPosition, pose.qRotation);
+			checksum += filter.state().Pos.v[0] + filter.state().Rot.w;
+		}
+		best = std::min(best, bench::nowNs() - start);
+	}
+	bench::doNotOptimize(checksum);
+	return best;
+}
+
+static double costKalman(const std::vector<vr::DriverPose_t>& poses)
+{
+	core::PoseKalmanFilter filter;
+	double checksum = 0.0;
+
+	double best = 1.0E300;
+	long long timeUs = 0;
+	for (int round = 0; round < CostRounds; round++)
+	{
+		double start = bench::nowNs();
+		for (const vr::DriverPose_t& pose : poses)
+		{
+			timeUs += 2710;
+			filter.update(timeUs, pose.vecPosition, pose.qRotation);
+			core::PoseKalmanFilter::State state = filter.predict(0.0);
+			checksum += state.Pos.v[0] + state.Rot.w;
+		}
+		best = std::min(best, bench::nowNs() - start);
+	}
+	bench::doNotOptimize(checksum);
+	return best;
+}
+
+// The whole reference update, filter plus the conversions and publishing shared by all filters
+static double costUpdateRefPose(MotionCompensationFilterType type, const std::vector<vr::DriverPose_t>& poses)
+{
+	core::MotionCompensationCore mc;
+	mc.setFilterType(type);
+	mc.setLpfBeta(0.85);
+	mc.setAlpha(12);
+	mc.setEnabled(true);
+	mc.setZeroPose(poses[0]);
+
+	double best = 1.0E300;
+	long long timeUs = 0;
+	for (int round = 0; round < CostRounds; round++)
+	{
+		double start = bench::nowNs();
+		for (const vr::DriverPose_t& pose : poses)
+		{
+			timeUs += 2710;
+			mc.updateRefPose(pose, timeUs);
+		}
+		best = std::min(best, bench::nowNs() - start);
+	}
+	return best;
+}
+
+int main(int argc, char* argv[])
+{
+	double seconds = 12.0;
+	if (argc > 1)
+	{
+		seconds = std::atof(argv[1]);
+	}
+
+	printf("Reference tracker at %.0f Hz, noise %.2f mm / %.3f deg, %.0f s per run\n\n", RefRate, PosNoise * 1000.0, RotNoise * 180.0 / PI, seconds);
+	printf("%-40s %12s %12s %12s %12s\n", "", "pos noise", "pos latency", "rot noise", "rot latency");
+	printf("%-40s %12s %12s %12s %12s\n", "", "mm", "ms", "deg", "ms");
+
+	const FilterConfig demaConfigs[] = {
+		{ "DEMA 4, LPF 0.6", MotionCompensationFilterType::Default, 4, 0.6, 0.0, 0.0, 0.0 },
+		{ "DEMA 10, LPF 0.3", MotionCompensationFilterType::Default, 10, 0.3, 0.0, 0.0, 0.0 },
+		{ "DEMA 25, LPF 0.15", MotionCompensationFilterType::Default, 25, 0.15, 0.0, 0.0, 0.0 },
+		{ "DEMA 100, LPF 0.05", MotionCompensationFilterType::Default, 100, 0.05, 0.0, 0.0, 0.0 },
+	};
+
+	bool ok = true;
+	for (const FilterConfig& dema : demaConfigs)
+	{
+		double posNoise, rotNoise, posLatency, rotLatency;
+		measureNoise(dema, seconds, posNoise, rotNoise);
+		measureLatency(dema, seconds, posNoise, rotNoise, posLatency, rotLatency);
+
+		// The Kalman filter has one tuning for both channels, so it is matched to each channel separately
+		FilterConfig kalmanPos = kalmanConfig(matchNoise(seconds, posNoise, false, kalmanConfig, 1.0E-8, 1.0E10));
+		FilterConfig kalmanRot = kalmanConfig(matchNoise(seconds, rotNoise, true, kalmanConfig, 1.0E-8, 1.0E10));
+		FilterConfig oneEuroPos = oneEuroConfig(matchNoise(seconds, posNoise, false, oneEuroConfig, 1.0E-3, 1.0E3));
+		FilterConfig oneEuroRot = oneEuroConfig(matchNoise(seconds, rotNoise, true, oneEuroConfig, 1.0E-3, 1.0E3));
+
+		double kPosNoise, kRotNoise, kPosLatency, kRotLatency, unused;
+		measureNoise(kalmanPos, seconds, kPosNoise, unused);
+		measureLatency(kalmanPos, seconds, kPosNoise, 0.0, kPosLatency, unused);
+		measureNoise(kalmanRot, seconds, unused, kRotNoise);
+		measureLatency(kalmanRot, seconds, 0.0, kRotNoise, unused, kRotLatency);
+
+		char name[64];
+		printf("%-40s %12.4f %12.2f %12.4f %12.2f\n", dema.Name, posNoise * 1000.0, posLatency * 1000.0, rotNoise * 180.0 / PI, rotLatency * 1000.0);
+		snprintf(name, sizeof(name), "  Kalman q=%.3g (pos) / q=%.3g (rot)", kalmanPos.ProcessNoise, kalmanRot.ProcessNoise);
+		printf("%-40s %12.4f %12.2f %12.4f %12.2f\n", name, kPosNoise * 1000.0, kPosLatency * 1000.0, kRotNoise * 180.0 / PI, kRotLatency * 1000.0);
+
+		double ePosNoise, eRotNoise, ePosLatency, eRotLatency;
+		measureNoise(oneEuroPos, seconds, ePosNoise, unused);
+		measureLatency(oneEuroPos, seconds, ePosNoise, 0.0, ePosLatency, unused);
+		measureNoise(oneEuroRot, seconds, unused, eRotNoise);
+		measureLatency(oneEuroRot, seconds, 0.0, eRotNoise, unused, eRotLatency);
+		snprintf(name, sizeof(name), "  One Euro %.3g Hz (pos) / %.3g Hz (rot)", oneEuroPos.MinCutoff, oneEuroRot.MinCutoff);
+		printf("%-40s %12.4f %12.2f %12.4f %12.2f\n", name, ePosNoise * 1000.0, ePosLatency * 1000.0, eRotNoise * 180.0 / PI, eRotLatency * 1000.0);
+
+		if (kPosLatency >= posLatency)
+		{
+			printf("  FAILED: Kalman filter is not faster than DEMA at equal noise\n");
+			ok = false;
+		}
+	}
+
+	ok = checkOneEuroStep() && ok;
+
+	bench::SyntheticRig rig;
+	std::vector<vr::DriverPose_t> poses = rig.refStream(100000, RefRate);
+
+	printf("\n");
+	bench::printHeader();
+	double demaSlerp = costDemaSlerp(poses);
+	double oneEuro = costOneEuro(poses);
+	bench::printResult("filter step: DEMA + 2 slerps (default)", demaSlerp, poses.size());
+	bench::printResult("filter step: One Euro", oneEuro, poses.size());
+	bench::printResult("filter step: Kalman", costKalman(poses), poses.size());
+	bench::printResult("updateRefPose: default", costUpdateRefPose(MotionCompensationFilterType::Default, poses), poses.size());
+	bench::printResult("updateRefPose: One Euro", costUpdateRefPose(MotionCompensationFilterType::OneEuro, poses), poses.size());
+	bench::printResult("updateRefPose: Kalman", costUpdateRefPose(MotionCompensationFilterType::Kalman, poses), poses.size());
+
+	if (oneEuro > demaSlerp)
+	{
+		printf("%s: One Euro filter step costs more than DEMA + 2 slerps\n", bench::timingFailed());
+		ok = !bench::timingChecked() && ok;
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,369 @@
+#include "BenchUtil.h"
+#include "MotionCompensationCore.h"
+#include "FlightRecorder.h"
+#include "CaptureFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace vrmotioncompensation;
+
+// Checks the flight recorder of the core and measures what it adds to the HMD path.
+// The core compensates a synthetic rig in real time (the reference at 250 Hz, the HMD at 1 kHz with device id 3)
+// with the recorder attached. A clean run must not trigger a dump. A requested dump has to hold the poses of the
+// window around the trigger in time order, exactly as they went into applyMotionCompensation and without gaps,
+// and a second trigger while the dump is pending has to be refused. Then a position jump of the HMD, a lost HMD,
+// a lost reference tracker and a reference that moves the HMD too far each have to write a dump of their kind.
+// Exits with 1 if a dump is missing, of the wrong kind, incomplete or out of order, a trigger fires on clean
+// poses or is taken while another is pending, or the recorder adds more than 250 ns to a compensated pose.
+// Usage: bench_vrmotioncompensation_flightrecorder [directory, the temp directory by default]
+
+static const int CostRounds = 7;
+static const double RecordBudgetNs = 250.0;
+static const uint32_t HmdId = 3;
+static const uint32_t TrackerId = 9;
+
+// Layout of a dump record, see FlightRecorder::dump: the time, three scalars, the raw and filtered reference,
+// four derivatives, then the device
+static const size_t DumpDevice = 1;
+static const size_t DumpDevicePosition = 1 + 3 + (3 + 4) * 2 + 3 * 4;
+static const size_t DumpDoubles = DumpDevicePosition + 3 + 4 + 3 + 4;
+
+// Compensates the rig at its real rate, remembering the raw HMD positions in world space
+class RigDriver
+{
+public:
+	RigDriver(core::FlightRecorder* recorder)
+	{
+		// The reference filter settles on the rig before the zero pose is set, like in the driver
+		_Core.setEnabled(true);
+		for (long long i = -PrimeMs; i < 0; i += 4)
+		{
+			_Core.updateRefPose(_Rig.refPose((double)i / 1000.0), BaseUs + i * 1000);
+		}
+		_Core.setZeroPose(_Rig.refPose(0.0));
+		_Core.setFlightRecorder(recorder);
+		_StartNs = bench::nowNs();
+	}
+
+	~RigDriver()
+	{
+		_Core.setFlightRecorder(nullptr);
+	}
+
+	// One millisecond of the rig. The hooks may change the poses before they go into the core
+	template<typename RefHook, typename HmdHook>
+	void step(RefHook refHook, HmdHook hmdHook)
+	{
+		double due = _StartNs + (double)_Step * 1.0E6;
+		while (bench::nowNs() < due)
+		{
+			std::this_thread::yield();
+		}
+
+		double t = (double)_Step / 1000.0;
+		long long timestampUs = BaseUs + _Step * 1000;
+		if (_Step % 4 == 0)
+		{
+			vr::DriverPose_t ref = _Rig.refPose(t);
+			refHook(ref);
+			_Core.updateRefPose(ref, timestampUs);
+		}
+
+		vr::DriverPose_t hmd = _Rig.hmdPose(t);
+		hmdHook(hmd);
+		vr::HmdVector3d_t world = vrmath::quaternionRotateVector(hmd.qWorldFromDriverRotation, hmd.vecPosition) + hmd.vecWorldFromDriverTranslation;
+		_Core.applyMotionCompensation(hmd, timestampUs, HmdId);
+		Fed.push_back(world);
+		_Step++;
+	}
+
+	void step()
+	{
+		step([](vr::DriverPose_t&) {}, [](vr::DriverPose_t&) {});
+	}
+
+	std::vector<vr::HmdVector3d_t> Fed;
+
+private:
+	static const long long PrimeMs = 2000;
+	static const long long BaseUs = 10000000;
+
+	bench::SyntheticRig _Rig;
+	core::MotionCompensationCore _Core;
+	double _StartNs = 0.0;
+	long long _Step = 0;
+};
+
+struct DumpLog
+{
+	std::mutex Mutex;
+	FlightRecorderTrigger Reason = FlightRecorderTrigger::None;
+	std::string Path;
+	size_t Entries = 0;
+};
+
+// Keeps the rig running until the recorder wrote dump number count, at most for three seconds
+static bool waitForDump(core::FlightRecorder& recorder, RigDriver& driver, uint32_t count)
+{
+	double startNs = bench::nowNs();
+	while (recorder.getDumpCount() < count)
+	{
+		if (bench::nowNs() - startNs > 3.0E9)
+		{
+			return false;
+		}
+		driver.step();
+	}
+	return true;
+}
+
+static bool expectDump(core::FlightRecorder& recorder, RigDriver& driver, DumpLog& log, uint32_t count, FlightRecorderTrigger reason, const char* name)
+{
+	if (!waitForDump(recorder, driver, count))
+	{
+		printf("FAILED: no dump after %s\n", name);
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(log.Mutex);
+	if (log.Reason != reason || log.Path.empty())
+	{
+		printf("FAILED: %s wrote a dump of trigger %u to '%s'\n", name, (uint32_t)log.Reason, log.Path.c_str());
+		return false;
+	}
+	printf("%-24s %6zu poses in %s\n", name, log.Entries, log.Path.c_str());
+	std::remove(log.Path.c_str());
+	return true;
+}
+
+// The dump has to cover the window around the trigger in time order, and its HMD poses have to be a run of the
+// poses that were fed, without gaps
+static bool checkDump(const std::string& path, const RigDriver& driver, const FlightRecorderSettings& settings)
+{
+	core::CaptureReader reader;
+	if (!reader.open(path.c_str()) || reader.getChannelCount() != 15 || reader.getHeader().RecordSize != DumpDoubles * sizeof(double))
+	{
+		printf("FAILED: %s is not a flight recorder dump\n", path.c_str());
+		return false;
+	}
+
+	double lastTime = -1.0E300;
+	size_t before = 0;
+	size_t after = 0;
+	size_t fed = driver.Fed.size();
+	for (uint64_t i = 0; i < reader.getRecordCount(); i++)
+	{
+		const double* record = reader.getRecord(i);
+		double time = record[0];
+		if (time < lastTime || time < -(double)settings.Seconds || time > (double)settings.PostTriggerMs / 1000.0)
+		{
+			printf("FAILED: record %llu at %.6f s is out of order or outside the window\n", (unsigned long long)i, time);
+			return false;
+		}
+		lastTime = time;
+		before += time <= 0.0 ? 1 : 0;
+		after += time > 0.0 ? 1 : 0;
+		if (record[DumpDevice] != (double)HmdId)
+		{
+			printf("FAILED: record %llu is of device %.0f\n", (unsigned long long)i, record[DumpDevice]);
+			return false;
+		}
+
+		// Find the first pose in what was fed, then every next record has to be the next pose
+		if (fed == driver.Fed.size())
+		{
+			for (fed = 0; fed < driver.Fed.size(); fed++)
+			{
+				if (std::memcmp(&driver.Fed[fed], &record[DumpDevicePosition], sizeof(vr::HmdVector3d_t)) == 0)
+				{
+					break;
+				}
+			}
+		}
+		if (fed >= driver.Fed.size() || std::memcmp(&driver.Fed[fed], &record[DumpDevicePosition], sizeof(vr::HmdVector3d_t)) != 0)
+		{
+			printf("FAILED: record %llu is not the HMD pose that was fed\n", (unsigned long long)i);
+			return false;
+		}
+		fed++;
+	}
+
+	// Poses after the trigger were written for PostTriggerMs, the ones before for as long as the rig ran
+	if (before < 500 || after < settings.PostTriggerMs / 2)
+	{
+		printf("FAILED: the dump has %zu poses before and %zu after the trigger\n", before, after);
+		return false;
+	}
+	printf("%-24s %6zu poses before and %zu after the trigger\n", "request", before, after);
+	return true;
+}
+
+static double costCompensation(core::FlightRecorder* recorder, size_t count)
+{
+	bench::SyntheticRig rig;
+	core::MotionCompensationCore core;
+	core.setEnabled(true);
+	core.setZeroPose(rig.refPose(0.0));
+	core.updateRefPose(rig.refPose(0.01), 10000);
+	core.setFlightRecorder(recorder);
+
+	std::vector<vr::DriverPose_t> hmd = rig.hmdStream(1024, 1000.0);
+	double checksum = 0.0;
+	double best = 1.0E300;
+	for (int round = 0; round < CostRounds; round++)
+	{
+		double start = bench::nowNs();
+		for (size_t i = 0; i < count; i++)
+		{
+			vr::DriverPose_t pose = hmd[i % hmd.size()];
+			core.applyMotionCompensation(pose, 10000 + (long long)(i % hmd.size()), HmdId);
+			checksum += pose.vecPosition[0];
+		}
+		best = std::min(best, bench::nowNs() - start);
+	}
+	bench::doNotOptimize(checksum);
+	core.setFlightRecorder(nullptr);
+	return best / (double)count;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string directory = argc > 1 ? argv[1] : bench::tempDirectory();
+	bool ok = true;
+
+	FlightRecorderSettings settings = core::FlightRecorder::defaultSettings();
+	settings.Enabled = true;
+	settings.Seconds = 2;
+	settings.PostTriggerMs = 200;
+
+	// Cost on the HMD path. Position jumps are off, the stream jumps back at its end
+	double withoutNs = costCompensation(nullptr, 200000);
+	double withNs;
+	{
+		core::FlightRecorder recorder;
+		FlightRecorderSettings cost = settings;
+		cost.MaxPositionJump = 0.0;
+		recorder.configure(cost);
+		withNs = costCompensation(&recorder, 200000);
+		if (recorder.getDumpCount() != 0 || !recorder.trigger(FlightRecorderTrigger::Request, core::TelemetryWriter::nowNs()))
+		{
+			printf("FAILED: the cost run triggered a dump\n");
+			ok = false;
+		}
+	}
+
+	core::FlightRecorder recorder;
+	DumpLog log;
+	recorder.setDirectory(directory);
+	recorder.setDumpCallback([&log](FlightRecorderTrigger reason, const std::string& path, size_t entries)
+	{
+		std::lock_guard<std::mutex> lock(log.Mutex);
+		log.Reason = reason;
+		log.Path = path;
+		log.Entries = entries;
+	});
+	if (recorder.trigger(FlightRecorderTrigger::Request, core::TelemetryWriter::nowNs()) || !recorder.configure(settings))
+	{
+		printf("FAILED: a disabled recorder took a trigger or the settings were refused\n");
+		return 1;
+	}
+	FlightRecorderSettings invalid = settings;
+	invalid.Seconds = core::FlightRecorder::MaxSeconds + 1;
+	if (recorder.configure(invalid))
+	{
+		printf("FAILED: %u seconds were accepted\n", invalid.Seconds);
+		ok = false;
+	}
+
+	RigDriver driver(&recorder);
+
+	// A clean second of the rig
+	for (int i = 0; i < 1000; i++)
+	{
+		driver.step();
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	if (recorder.getDumpCount() != 0)
+	{
+		printf("FAILED: clean poses triggered a dump\n");
+		ok = false;
+	}
+
+	// Requested, a second request while it is pending is dropped
+	uint32_t dumps = 0;
+	if (!recorder.trigger(FlightRecorderTrigger::Request, core::TelemetryWriter::nowNs()))
+	{
+		printf("FAILED: the request was refused\n");
+		ok = false;
+	}
+	driver.step();
+	if (recorder.trigger(FlightRecorderTrigger::Request, core::TelemetryWriter::nowNs()))
+	{
+		printf("FAILED: a trigger was taken while a dump is pending\n");
+		ok = false;
+	}
+	if (waitForDump(recorder, driver, ++dumps))
+	{
+		std::lock_guard<std::mutex> lock(log.Mutex);
+		ok = log.Reason == FlightRecorderTrigger::Request && checkDump(log.Path, driver, settings) && ok;
+		std::remove(log.Path.c_str());
+	}
+	else
+	{
+		printf("FAILED: no dump after the request\n");
+		ok = false;
+	}
+
+	// The HMD jumps by 30 cm for one pose
+	driver.step([](vr::DriverPose_t&) {}, [](vr::DriverPose_t& hmd) { hmd.vecPosition[0] += 0.3; });
+	ok = expectDump(recorder, driver, log, ++dumps, FlightRecorderTrigger::PositionJump, "HMD jump") && ok;
+
+	// The HMD loses tracking for one pose
+	driver.step([](vr::DriverPose_t&) {}, [](vr::DriverPose_t& hmd) { hmd.result = vr::TrackingResult_Running_OutOfRange; });
+	ok = expectDump(recorder, driver, log, ++dumps, FlightRecorderTrigger::TrackingLost, "HMD tracking lost") && ok;
+
+	// The reference tracker, reported by the driver
+	recorder.updateTracking(TrackerId, true, core::TelemetryWriter::nowNs());
+	driver.step();
+	recorder.updateTracking(TrackerId, false, core::TelemetryWriter::nowNs());
+	ok = expectDump(recorder, driver, log, ++dumps, FlightRecorderTrigger::TrackingLost, "reference tracking lost") && ok;
+
+	// The reference moves 1 m for 100 ms, long enough for its filter to follow, without jump detection
+	FlightRecorderSettings noJumps = settings;
+	noJumps.MaxPositionJump = 0.0;
+	recorder.configure(noJumps);
+	for (int i = 0; i < 100; i++)
+	{
+		driver.step([](vr::DriverPose_t& ref) { ref.vecPosition[1] += 1.0; }, [](vr::DriverPose_t&) {});
+	}
+	ok = expectDump(recorder, driver, log, ++dumps, FlightRecorderTrigger::CompensationDelta, "compensation delta") && ok;
+
+	// Off again
+	settings.Enabled = false;
+	recorder.configure(settings);
+	if (recorder.trigger(FlightRecorderTrigger::Request, core::TelemetryWriter::nowNs()))
+	{
+		printf("FAILED: a disabled recorder took a trigger\n");
+		ok = false;
+	}
+
+	printf("\n%-44s %10s\n", "ns per compensated HMD pose", "best");
+	printf("%-44s %10.1f\n", "without recorder", withoutNs);
+	printf("%-44s %10.1f\n", "with recorder", withNs);
+	printf("%-44s %10.1f\n", "added", withNs - withoutNs);
+
+	if (withNs - withoutNs > RecordBudgetNs)
+	{
+		printf("%s: the recorder adds %.1f ns, more than %.0f ns\n", bench::timingFailed(), withNs - withoutNs, RecordBudgetNs);
+		ok = !bench::timingChecked() && ok;
+	}
+	return ok ? 0 : 1;
+}
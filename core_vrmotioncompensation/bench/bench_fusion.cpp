@@ -0,0 +1,327 @@
+#include "BenchUtil.h"
+#include "ReferenceFusion.h"
+#include "FilterPipeline.h"
+#include "Filters.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace vrmotioncompensation;
+
+// Fuses three noisy reference trackers mounted on the synthetic rig and compares the fused reference pose
+// with a single tracker: noise of the raw pose, and the tracking error of the moving rig once both go through the
+// DEMA filter tuned to the same noise at rest. Tracker 1 and then tracker 0 (which paces the output) drop out for a while.
+// Exits with 1 if the fused position noise is not close to the single tracker noise / sqrt(3), if the fused pose
+// freezes or jumps during a dropout, or if at the same noise the filtered fused reference does not track the rig closer.
+// Usage: bench_vrmotioncompensation_fusion [seconds]
+
+static const double RefRate = 369.0;
+static const long long RefPeriodUs = 2710;
+static const double PosNoise = 0.0005;
+static const double RotNoise = 0.0001;
+static const uint32_t TrackerCount = 3;
+
+// DEMA sample count of the single tracker
+static const uint32_t DefaultSamples = 30;
+
+// Skipped at the start, so calibration and filters have settled
+static const double SettleTime = 1.0;
+
+// Dropouts in seconds, tracker 0 paces the output
+struct Dropout
+{
+	uint32_t Tracker;
+	double Start;
+	double End;
+};
+static const Dropout Dropouts[] = { { 1, 3.0, 3.4 }, { 0, 5.0, 5.5 } };
+
+class TrackerRig
+{
+public:
+	explicit TrackerRig(bool moving = true) : _Moving(moving), _Rng(7), _PosNoise(0.0, PosNoise), _RotNoise(0.0, RotNoise)
+	{
+		// Tracker poses on the rig
+		_Offsets[0] = { { 0, 0, 0 }, { 1, 0, 0, 0 } };
+		_Offsets[1] = { { 0.25, 0.05, -0.1 }, vrmath::quaternionFromRotationY(0.8) };
+		_Offsets[2] = { { -0.2, 0.1, 0.15 }, vrmath::quaternionFromRotationX(-0.5) };
+	}
+
+	// Rig pose at time t in seconds
+	void rig(double t, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot)
+	{
+		double p[3];
+		_Rig.rigMotion(_Moving ? t : 0.0, p, rot);
+		pos = { p[0], p[1], p[2] };
+	}
+
+	vr::DriverPose_t tracker(uint32_t index, double t, bool noise)
+	{
+		vr::DriverPose_t pose = _Rig.basePose();
+		vr::HmdVector3d_t pos, posNext, posPrev;
+		vr::HmdQuaternion_t rot, rotNext, rotPrev;
+		trackerTruth(index, t, pos, rot);
+		trackerTruth(index, t + 1.0E-4, posNext, rotNext);
+		trackerTruth(index, t - 1.0E-4, posPrev, rotPrev);
+
+		vr::HmdVector3d_t vel = (posNext - posPrev) / 2.0E-4;
+		vr::HmdVector3d_t angVel = core::quaternionLog(rotNext * vrmath::quaternionConjugate(rotPrev)) / 2.0E-4;
+		if (noise)
+		{
+			pos = pos + vr::HmdVector3d_t{ _PosNoise(_Rng), _PosNoise(_Rng), _PosNoise(_Rng) };
+			rot = core::quaternionExp({ _RotNoise(_Rng), _RotNoise(_Rng), _RotNoise(_Rng) }) * rot;
+		}
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			pose.vecPosition[axis] = pos.v[axis];
+			pose.vecVelocity[axis] = vel.v[axis];
+			pose.vecAngularVelocity[axis] = angVel.v[axis];
+		}
+		pose.qRotation = rot;
+		return pose;
+	}
+
+private:
+	void trackerTruth(uint32_t index, double t, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot)
+	{
+		vr::HmdVector3d_t rigPos;
+		vr::HmdQuaternion_t rigRot;
+		rig(t, rigPos, rigRot);
+		pos = rigPos + vrmath::quaternionRotateVector(rigRot, _Offsets[index].Translation);
+		rot = rigRot * _Offsets[index].Rotation;
+	}
+
+	bool _Moving;
+	bench::SyntheticRig _Rig;
+	MotionCompensationDeviceOffset _Offsets[TrackerCount];
+	std::mt19937 _Rng;
+	std::normal_distribution<double> _PosNoise;
+	std::normal_distribution<double> _RotNoise;
+};
+
+static bool inDropout(uint32_t tracker, double t)
+{
+	for (const Dropout& dropout : Dropouts)
+	{
+		if (dropout.Tracker == tracker && t >= dropout.Start && t < dropout.End)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+struct ReferenceSample
+{
+	double Time;
+	vr::DriverPose_t Pose;
+};
+
+struct FusedRun
+{
+	std::vector<ReferenceSample> Single;
+	std::vector<ReferenceSample> Fused;
+	double FusionNs = 0.0;
+	size_t FusionCalls = 0;
+};
+
+// The trackers report in turn, every one at the reference tracker rate
+static FusedRun run(double seconds, bool moving)
+{
+	TrackerRig rig(moving);
+	core::ReferenceFusion fusion;
+	fusion.setTrackers(TrackerCount);
+
+	FusedRun result;
+	size_t frames = (size_t)(seconds * RefRate);
+	for (size_t frame = 0; frame < frames; frame++)
+	{
+		for (uint32_t tracker = 0; tracker < TrackerCount; tracker++)
+		{
+			long long timestampUs = (long long)frame * RefPeriodUs + (long long)tracker * RefPeriodUs / TrackerCount;
+			double t = (double)timestampUs / 1.0E6;
+			vr::DriverPose_t pose = rig.tracker(tracker, t, true);
+			if (inDropout(tracker, t))
+			{
+				pose.result = vr::TrackingResult_Running_OutOfRange;
+			}
+
+			if (tracker == 0 && pose.result == vr::TrackingResult_Running_OK)
+			{
+				result.Single.push_back({ t, pose });
+			}
+
+			vr::DriverPose_t fused;
+			double start = bench::nowNs();
+			bool hasOutput = fusion.update(tracker, pose, timestampUs, fused);
+			result.FusionNs += bench::nowNs() - start;
+			result.FusionCalls++;
+			if (hasOutput)
+			{
+				result.Fused.push_back({ t, fused });
+			}
+		}
+	}
+	return result;
+}
+
+static double positionError(TrackerRig& rig, const ReferenceSample& sample, const vr::HmdVector3d_t& pos)
+{
+	vr::HmdVector3d_t truePos;
+	vr::HmdQuaternion_t trueRot;
+	rig.rig(sample.Time, truePos, trueRot);
+	vr::HmdVector3d_t d = pos - truePos;
+	return std::sqrt(d.v[0] * d.v[0] + d.v[1] * d.v[1] + d.v[2] * d.v[2]);
+}
+
+static double rotationError(TrackerRig& rig, const ReferenceSample& sample)
+{
+	vr::HmdVector3d_t truePos;
+	vr::HmdQuaternion_t trueRot;
+	rig.rig(sample.Time, truePos, trueRot);
+	vr::HmdVector3d_t d = core::quaternionLog(sample.Pose.qRotation * vrmath::quaternionConjugate(trueRot));
+	return std::sqrt(d.v[0] * d.v[0] + d.v[1] * d.v[1] + d.v[2] * d.v[2]);
+}
+
+// RMS position and rotation error of the raw reference, after the settle time
+static void rawError(const std::vector<ReferenceSample>& samples, double& posError, double& rotError)
+{
+	TrackerRig rig;
+	double posSum = 0.0, rotSum = 0.0;
+	size_t count = 0;
+	for (const ReferenceSample& sample : samples)
+	{
+		if (sample.Time >= SettleTime)
+		{
+			double p = positionError(rig, sample, { sample.Pose.vecPosition[0], sample.Pose.vecPosition[1], sample.Pose.vecPosition[2] });
+			double r = rotationError(rig, sample);
+			posSum += p * p;
+			rotSum += r * r;
+			count++;
+		}
+	}
+	posError = std::sqrt(posSum / (double)count);
+	rotError = std::sqrt(rotSum / (double)count);
+}
+
+// RMS position error of the reference after the DEMA filter of the default chain, on the moving or the resting rig
+static double filteredError(const std::vector<ReferenceSample>& samples, uint32_t demaSamples, bool moving)
+{
+	TrackerRig rig(moving);
+	core::FilterContext ctx;
+	ctx.Alpha = 2.0 / (1.0 + (double)demaSamples);
+	core::FilterPipelineFn pipeline = core::selectFilterPipeline(MotionCompensationFilterType::Default, demaSamples, 1.0, true);
+	if (!samples.empty())
+	{
+		// Start settled on the first sample
+		const double(&first)[3] = samples[0].Pose.vecPosition;
+		ctx.Dema[0] = ctx.Dema[1] = { first[0], first[1], first[2] };
+	}
+
+	double sum = 0.0;
+	size_t count = 0;
+	for (const ReferenceSample& sample : samples)
+	{
+		core::FilterOutput out;
+		pipeline(ctx, sample.Pose, (long long)(sample.Time * 1.0E6), out);
+		if (sample.Time >= SettleTime)
+		{
+			double e = positionError(rig, sample, out.Pos);
+			sum += e * e;
+			count++;
+		}
+	}
+	return std::sqrt(sum / (double)count);
+}
+
+// Lowest DEMA sample count whose noise at rest is not above the given noise
+static uint32_t samplesForNoise(const std::vector<ReferenceSample>& samples, double noise)
+{
+	for (uint32_t demaSamples = 2; demaSamples < 1000; demaSamples++)
+	{
+		if (filteredError(samples, demaSamples, false) <= noise)
+		{
+			return demaSamples;
+		}
+	}
+	return 1000;
+}
+
+int main(int argc, char* argv[])
+{
+	double seconds = 8.0;
+	if (argc > 1)
+	{
+		seconds = std::max(6.0, std::atof(argv[1]));
+	}
+
+	FusedRun result = run(seconds, true);
+	bool ok = true;
+
+	// ----------------------------------------------------------------------------------------------- //
+	// Raw noise
+	double singlePos, singleRot, fusedPos, fusedRot;
+	rawError(result.Single, singlePos, singleRot);
+	rawError(result.Fused, fusedPos, fusedRot);
+	double expectedPos = singlePos / std::sqrt((double)TrackerCount);
+
+	printf("%-32s %14s %14s\n", "raw reference", "position mm", "rotation mrad");
+	printf("%-32s %14.4f %14.4f\n", "single tracker", singlePos * 1000.0, singleRot * 1000.0);
+	printf("%-32s %14.4f %14.4f\n", "3 trackers fused", fusedPos * 1000.0, fusedRot * 1000.0);
+	printf("%-32s %14.4f\n\n", "single / sqrt(3)", expectedPos * 1000.0);
+	if (fusedPos > 1.2 * expectedPos)
+	{
+		printf("FAILED: fused position noise %.4f mm, expected about %.4f mm\n", fusedPos * 1000.0, expectedPos * 1000.0);
+		ok = false;
+	}
+
+	// ----------------------------------------------------------------------------------------------- //
+	// Dropouts: the output has to continue at the tracker rate and stay close to the rig
+	TrackerRig rig;
+	for (const Dropout& dropout : Dropouts)
+	{
+		size_t outputs = 0;
+		double maxError = 0.0;
+		for (const ReferenceSample& sample : result.Fused)
+		{
+			if (sample.Time >= dropout.Start && sample.Time < dropout.End)
+			{
+				outputs++;
+				maxError = std::max(maxError, positionError(rig, sample, { sample.Pose.vecPosition[0], sample.Pose.vecPosition[1], sample.Pose.vecPosition[2] }));
+			}
+		}
+		size_t expected = (size_t)((dropout.End - dropout.Start) * RefRate);
+		printf("tracker %u dropped for %.0f ms: %zu of about %zu fused poses, max error %.3f mm\n",
+			dropout.Tracker, (dropout.End - dropout.Start) * 1000.0, outputs, expected, maxError * 1000.0);
+		if (outputs + 2 < expected || maxError > 6.0 * PosNoise)
+		{
+			printf("FAILED: the fused reference froze or jumped while tracker %u was dropped\n", dropout.Tracker);
+			ok = false;
+		}
+	}
+
+	// ----------------------------------------------------------------------------------------------- //
+	// Filter lag: at the same output noise the fused reference needs fewer DEMA samples, so it lags less behind the rig
+	FusedRun still = run(seconds, false);
+	double targetNoise = filteredError(still.Single, DefaultSamples, false);
+	uint32_t fusedSamples = samplesForNoise(still.Fused, targetNoise);
+	double singleError = filteredError(result.Single, DefaultSamples, true);
+	double fusedError = filteredError(result.Fused, fusedSamples, true);
+
+	printf("\n%-32s %10s %16s %16s\n", "DEMA filtered reference", "samples", "noise at rest mm", "error moving mm");
+	printf("%-32s %10u %16.4f %16.4f\n", "single tracker", DefaultSamples, targetNoise * 1000.0, singleError * 1000.0);
+	printf("%-32s %10u %16.4f %16.4f\n\n", "3 trackers fused, same noise", fusedSamples, filteredError(still.Fused, fusedSamples, false) * 1000.0, fusedError * 1000.0);
+	if (fusedSamples >= DefaultSamples || fusedError >= singleError)
+	{
+		printf("FAILED: at the same noise the filtered fused reference does not track the rig closer than a single tracker\n");
+		ok = false;
+	}
+
+	// ----------------------------------------------------------------------------------------------- //
+	// Cost
+	bench::printHeader();
+	bench::printResult("fusion: 3 trackers, per tracker pose", result.FusionNs, result.FusionCalls);
+
+	return ok ? 0 : 1;
+}
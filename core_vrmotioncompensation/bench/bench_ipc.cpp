@@ -0,0 +1,344 @@
+#include "BenchUtil.h"
+#include "IpcRing.h"
+#include "LatencyHistogram.h"
+#include <ipc_transport.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace vrmotioncompensation;
+
+// Checks the ipc ring and compares the round trip of a request through both ipc transports.
+// Producer threads send numbered messages into one ring while a consumer checks that every message arrives once,
+// intact and in the order its producer sent it. A ring without a receiver has to report full instead of
+// overwriting, and must refuse a message larger than a slot. An echo thread then plays the driver: it receives
+// ipc::Request messages on a server endpoint and answers every one with an ipc::Reply on the client's endpoint,
+// back to back and with the client pausing between requests, so the echo thread sleeps in the kernel for each one.
+// The peers are threads, but use the same named shared memory, kernel waits and wakes as separate processes.
+// The driver pushes device events with trySend, which has to fail at once on a full endpoint of either transport.
+// A ring laid out again under a client that is still attached, as a restarted driver does on Windows, has to drop the
+// old messages and take the client's next one.
+// Exits with 1 if a message was lost, duplicated, reordered or corrupted, a full ring or an oversized message
+// was accepted, a ring laid out again kept old messages or lost a new one, trySend waited or took a message into a full endpoint, a request or reply timed out, or a round trip through the ring took longer than the 50 ms the
+// message queue receive loops used to poll at.
+// Usage: bench_vrmotioncompensation_ipc [messages]
+
+static const int Producers = 4;
+static const uint32_t SlotSize = 256;
+static const uint32_t TimeoutMs = 1000;
+static const uint64_t RoundTripBudgetNs = 50000000;
+
+struct TestMessage
+{
+	uint32_t Producer;
+	uint32_t Size;
+	uint64_t Number;
+	uint8_t Payload[SlotSize - 16];
+};
+
+static uint8_t payloadByte(uint32_t producer, uint64_t number, uint32_t i)
+{
+	return (uint8_t)(producer * 31 + number * 7 + i);
+}
+
+struct AlignedMemory
+{
+	explicit AlignedMemory(size_t size) : _Buffer(size + 64)
+	{
+		_Memory = _Buffer.data() + (64 - (uintptr_t)_Buffer.data() % 64) % 64;
+	}
+
+	void* get()
+	{
+		return _Memory;
+	}
+
+	std::vector<char> _Buffer;
+	char* _Memory;
+};
+
+static bool checkOrdering(size_t count)
+{
+	const uint32_t slots = 64;
+	size_t memorySize = core::IpcRing::requiredSize(slots, SlotSize);
+	AlignedMemory memory(memorySize);
+	core::IpcRing ring;
+	if (!ring.create(memory.get(), memorySize, slots, SlotSize, "vrmc_bench_ipc.ordering"))
+	{
+		printf("FAILED: could not create a ring\n");
+		return false;
+	}
+
+	std::atomic<bool> sendFailed = { false };
+	std::vector<std::thread> producers;
+	for (uint32_t p = 0; p < Producers; p++)
+	{
+		producers.emplace_back([&ring, &sendFailed, p, count]()
+		{
+			TestMessage message;
+			for (uint64_t n = 0; n < count; n++)
+			{
+				// Messages of varying length, the receiver has to get the size back
+				message.Producer = p;
+				message.Number = n;
+				message.Size = 16 + (uint32_t)(n % (sizeof(message.Payload) + 1));
+				for (uint32_t i = 0; i < message.Size - 16; i++)
+				{
+					message.Payload[i] = payloadByte(p, n, i);
+				}
+				if (!ring.send(&message, message.Size, TimeoutMs))
+				{
+					sendFailed = true;
+					return;
+				}
+			}
+		});
+	}
+
+	std::vector<uint64_t> next(Producers, 0);
+	uint64_t received = 0;
+	uint64_t bad = 0;
+	TestMessage message;
+	uint32_t size;
+	while (received < count * Producers)
+	{
+		if (!ring.receive(&message, sizeof(message), size, TimeoutMs))
+		{
+			break;
+		}
+		received++;
+		bool ok = size == message.Size && message.Producer < Producers && message.Number == next[message.Producer];
+		for (uint32_t i = 0; ok && i < size - 16; i++)
+		{
+			ok = message.Payload[i] == payloadByte(message.Producer, message.Number, i);
+		}
+		if (ok)
+		{
+			next[message.Producer]++;
+		}
+		else
+		{
+			bad++;
+		}
+	}
+	for (std::thread& producer : producers)
+	{
+		producer.join();
+	}
+
+	bool ok = !sendFailed && bad == 0 && received == count * Producers && !ring.tryReceive(&message, sizeof(message), size);
+	printf("%d producers sent %llu messages, %llu received, %llu lost, out of order or corrupted %s\n", Producers,
+		(unsigned long long)(count * Producers), (unsigned long long)received, (unsigned long long)bad, ok ? "" : "FAILED");
+	return ok;
+}
+
+static bool checkFull()
+{
+	const uint32_t slots = 8;
+	size_t memorySize = core::IpcRing::requiredSize(slots, SlotSize);
+	AlignedMemory memory(memorySize);
+	core::IpcRing ring;
+	ring.create(memory.get(), memorySize, slots, SlotSize, "vrmc_bench_ipc.full");
+
+	uint64_t value = 0;
+	bool ok = true;
+	for (uint32_t i = 0; i < slots; i++)
+	{
+		value = i;
+		ok = ring.send(&value, sizeof(value), 0) && ok;
+	}
+	ok = !ring.send(&value, sizeof(value), 0) && ok;
+	static char large[SlotSize + 1];
+	uint32_t received;
+	ok = ring.tryReceive(&value, sizeof(value), received) && value == 0 && ok;
+	ok = !ring.send(large, sizeof(large), 0) && ring.send(&value, sizeof(value), 0) && ok;
+
+	// A second ring attached to the same memory sees the same messages
+	core::IpcRing attached;
+	ok = attached.attach(memory.get(), memorySize, "vrmc_bench_ipc.full") && attached.tryReceive(&value, sizeof(value), received) && value == 1 && ok;
+	printf("full ring and oversized message refused %s\n", ok ? "" : "FAILED");
+	return ok;
+}
+
+// A restarted driver lays its ring out again in memory that a client of the driver before still maps, as it does on
+// Windows: the old messages are gone and the client's next message arrives
+static bool checkRecreate()
+{
+	const uint32_t slots = 8;
+	size_t memorySize = core::IpcRing::requiredSize(slots, SlotSize);
+	AlignedMemory memory(memorySize);
+	core::IpcRing driver;
+	core::IpcRing client;
+	bool ok = driver.create(memory.get(), memorySize, slots, SlotSize, "vrmc_bench_ipc.recreate")
+		&& client.attach(memory.get(), memorySize, "vrmc_bench_ipc.recreate");
+	uint64_t value = 0;
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		value = i;
+		ok = client.send(&value, sizeof(value), 0) && ok;
+	}
+	driver.detach();
+
+	core::IpcRing restarted;
+	uint32_t received;
+	ok = restarted.create(memory.get(), memorySize, slots, SlotSize, "vrmc_bench_ipc.recreate") && !restarted.tryReceive(&value, sizeof(value), received) && ok;
+	value = 42;
+	ok = client.send(&value, sizeof(value), 0) && ok;
+	value = 0;
+	ok = restarted.tryReceive(&value, sizeof(value), received) && value == 42 && !restarted.tryReceive(&value, sizeof(value), received) && ok;
+	printf("ring laid out again under an attached client %s\n", ok ? "" : "FAILED");
+	return ok;
+}
+
+// Fills the client's endpoint from the driver's side with trySend until it refuses
+static bool checkTrySend(ipc::TransportType type, const char* name)
+{
+	std::string base = "vrmc_bench_ipc.trysend." + std::to_string((long long)bench::nowNs());
+	try
+	{
+		std::unique_ptr<ipc::Transport> client = ipc::createTransport(type, base, sizeof(ipc::Reply));
+		std::unique_ptr<ipc::Transport> replies = ipc::openTransport(type, base);
+
+		ipc::Reply reply(ipc::ReplyType::DeviceEvent);
+		uint32_t sent = 0;
+		while (sent <= ipc::TransportMessageCount && replies->trySend(&reply, sizeof(reply)))
+		{
+			sent++;
+		}
+		double start = bench::nowNs();
+		bool refused = !replies->trySend(&reply, sizeof(reply));
+		double refusedNs = bench::nowNs() - start;
+
+		bool ok = refused && sent == ipc::TransportMessageCount && replies->getMessageSize() == sizeof(ipc::Reply);
+		bool fast = refusedNs < 1.0E6;
+		printf("%-22s trySend took %u messages, refused the next in %.0f ns %s\n", name, sent, refusedNs,
+			!ok ? "FAILED" : fast ? "" : bench::timingFailed());
+		return ok && (fast || !bench::timingChecked());
+	}
+	catch (std::exception& e)
+	{
+		printf("FAILED: %s endpoint: %s\n", name, e.what());
+		return false;
+	}
+}
+
+static bool checkRoundTrip(ipc::TransportType type, const char* name, size_t count, bool idle)
+{
+	std::string base = "vrmc_bench_ipc." + std::to_string((long long)bench::nowNs());
+	std::unique_ptr<ipc::Transport> server;
+	std::unique_ptr<ipc::Transport> client;
+	try
+	{
+		server = ipc::createTransport(type, base + ".server", sizeof(ipc::Request));
+		client = ipc::createTransport(type, base + ".client", sizeof(ipc::Reply));
+	}
+	catch (std::exception& e)
+	{
+		printf("FAILED: could not create the %s endpoints: %s\n", name, e.what());
+		return false;
+	}
+
+	std::atomic<bool> echoFailed = { false };
+	std::thread echo([&]()
+	{
+		try
+		{
+			// The driver's side, it opens the client's endpoint by name as in IPC_ClientConnect
+			std::unique_ptr<ipc::Transport> replies = ipc::openTransport(type, base + ".client");
+			for (size_t i = 0; i < count; i++)
+			{
+				ipc::Request request;
+				uint32_t size;
+				if (!server->receive(&request, sizeof(request), size, TimeoutMs) || size != sizeof(request))
+				{
+					echoFailed = true;
+					return;
+				}
+				ipc::Reply reply(ipc::ReplyType::IPC_Ping);
+				reply.messageId = request.msg.ipc_Ping.messageId;
+				reply.status = ipc::ReplyStatus::Ok;
+				reply.msg.ipc_Ping.nonce = request.msg.ipc_Ping.nonce;
+				replies->send(&reply, sizeof(reply));
+			}
+		}
+		catch (std::exception& e)
+		{
+			printf("echo thread: %s\n", e.what());
+			echoFailed = true;
+		}
+	});
+
+	core::LatencyHistogram histogram;
+	bool ok = true;
+	try
+	{
+		std::unique_ptr<ipc::Transport> requests = ipc::openTransport(type, base + ".server");
+		for (size_t i = 0; i < count && ok; i++)
+		{
+			if (idle)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			}
+			ipc::Request request(ipc::RequestType::IPC_Ping);
+			request.msg.ipc_Ping.clientId = 1;
+			request.msg.ipc_Ping.messageId = (uint32_t)i + 1;
+			request.msg.ipc_Ping.nonce = i * 977;
+
+			int64_t start = core::LatencyHistogram::nowNs();
+			requests->send(&request, sizeof(request));
+			ipc::Reply reply;
+			uint32_t size;
+			ok = client->receive(&reply, sizeof(reply), size, TimeoutMs) && size == sizeof(reply) && reply.messageId == i + 1 && reply.msg.ipc_Ping.nonce == i * 977;
+			histogram.record((uint64_t)(core::LatencyHistogram::nowNs() - start));
+		}
+	}
+	catch (std::exception& e)
+	{
+		printf("client: %s\n", e.what());
+		ok = false;
+	}
+	if (!ok)
+	{
+		// The echo thread gives up when its receive times out
+		echoFailed = true;
+	}
+	echo.join();
+
+	LatencyStatistics statistics = histogram.getStatistics();
+	bool inBudget = type != ipc::TransportType::SharedMemoryRing || statistics.MaxNs <= RoundTripBudgetNs;
+	printf("%-22s %-5s %7llu  p50 %9.1f us  p99 %9.1f us  p99.9 %9.1f us  max %9.1f us %s\n", name, idle ? "idle" : "busy",
+		(unsigned long long)statistics.Count, (double)statistics.P50Ns / 1000.0, (double)statistics.P99Ns / 1000.0,
+		(double)statistics.P999Ns / 1000.0, (double)statistics.MaxNs / 1000.0, !ok || echoFailed ? "FAILED" : inBudget ? "" : bench::timingFailed());
+	return ok && !echoFailed && (inBudget || !bench::timingChecked());
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = 200000;
+	if (argc > 1)
+	{
+		count = std::max<size_t>(1000, (size_t)std::atoll(argv[1]));
+	}
+
+	bool ok = checkOrdering(count);
+	ok = checkFull() && ok;
+	ok = checkRecreate() && ok;
+	ok = checkTrySend(ipc::TransportType::MessageQueue, "message_queue") && ok;
+	ok = checkTrySend(ipc::TransportType::SharedMemoryRing, "shared memory ring") && ok;
+
+	printf("\n%-22s %-5s %7s  round trip of a request and its reply\n", "transport", "", "count");
+	size_t roundTrips = std::max<size_t>(1000, count / 10);
+	size_t idleRoundTrips = std::max<size_t>(100, count / 400);
+	ok = checkRoundTrip(ipc::TransportType::MessageQueue, "message_queue", roundTrips, false) && ok;
+	ok = checkRoundTrip(ipc::TransportType::SharedMemoryRing, "shared memory ring", roundTrips, false) && ok;
+	ok = checkRoundTrip(ipc::TransportType::MessageQueue, "message_queue", idleRoundTrips, true) && ok;
+	ok = checkRoundTrip(ipc::TransportType::SharedMemoryRing, "shared memory ring", idleRoundTrips, true) && ok;
+	return ok ? 0 : 1;
+}
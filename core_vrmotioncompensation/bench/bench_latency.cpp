@@ -0,0 +1,239 @@
+#include "BenchUtil.h"
+#include "LatencyHistogram.h"
+#include "MotionCompensationCore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace vrmotioncompensation;
+
+// Checks the latency histograms of the pose path and measures what timing a stage costs.
+// Every bucket edge has to map back to its bucket, with buckets no wider than 1/32 of their values. Percentiles
+// of a long-tailed distribution with a few outliers past the last bucket are compared with the exact ones, and
+// threads recording into one histogram at the same time must not lose a value. The VRMC_LATENCY_ macros are
+// checked to record, or, when built with VRMC_NO_LATENCY_HISTOGRAMS, to record nothing.
+// Exits with 1 if a bucket edge is off, a percentile is below the exact one or more than 1/32 above it, a value
+// is lost, the macros do not match the build, or a record takes more than 25 ns.
+// Usage: bench_vrmotioncompensation_latency [values]
+
+static const int Threads = 4;
+static const double RecordBudgetNs = 25.0;
+
+static bool checkBuckets()
+{
+	using core::LatencyHistogram;
+	for (uint32_t bucket = 1; bucket < LatencyHistogram::BucketCount; bucket++)
+	{
+		uint64_t lower = LatencyHistogram::bucketUpperEdge(bucket - 1) + 1;
+		uint64_t upper = LatencyHistogram::bucketUpperEdge(bucket);
+		if (upper < lower || LatencyHistogram::bucketOf(lower) != bucket || LatencyHistogram::bucketOf(upper) != bucket
+			|| (double)(upper - lower + 1) > std::max(1.0, (double)lower / LatencyHistogram::SubBuckets))
+		{
+			printf("FAILED: bucket %u covers %llu to %llu\n", bucket, (unsigned long long)lower, (unsigned long long)upper);
+			return false;
+		}
+	}
+	if (LatencyHistogram::bucketOf(~0ull) != LatencyHistogram::BucketCount - 1)
+	{
+		printf("FAILED: the largest value is not in the last bucket\n");
+		return false;
+	}
+	return true;
+}
+
+// The smallest value that at least p of the values do not exceed
+static uint64_t exactPercentile(const std::vector<uint64_t>& sorted, double p)
+{
+	size_t rank = std::max<size_t>(1, (size_t)std::ceil(p * (double)sorted.size()));
+	return sorted[rank - 1];
+}
+
+static bool checkPercentile(const char* name, uint64_t reported, uint64_t exact)
+{
+	bool ok = reported >= exact && (double)reported <= (double)exact * (1.0 + 1.0 / core::LatencyHistogram::SubBuckets) + 1.0;
+	printf("%-8s %14llu %14llu %s\n", name, (unsigned long long)exact, (unsigned long long)reported, ok ? "" : "FAILED");
+	return ok;
+}
+
+// Pose path like latencies: log-normal around 2 us, and a few stalls of up to half a second
+static bool checkAccuracy(size_t count)
+{
+	std::mt19937_64 rng(7);
+	std::lognormal_distribution<double> latency(std::log(2000.0), 1.0);
+	std::uniform_real_distribution<double> stall(1.0E8, 5.0E8);
+
+	core::LatencyHistogram histogram;
+	std::vector<uint64_t> values(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		values[i] = i % 5000 == 4999 ? (uint64_t)stall(rng) : (uint64_t)latency(rng);
+		histogram.record(values[i]);
+	}
+	std::sort(values.begin(), values.end());
+
+	LatencyStatistics statistics = histogram.getStatistics();
+	printf("%-8s %14s %14s\n", "ns", "exact", "histogram");
+	bool ok = statistics.Count == count;
+	ok = checkPercentile("p50", statistics.P50Ns, exactPercentile(values, 0.5)) && ok;
+	ok = checkPercentile("p90", statistics.P90Ns, exactPercentile(values, 0.9)) && ok;
+	ok = checkPercentile("p99", statistics.P99Ns, exactPercentile(values, 0.99)) && ok;
+	ok = checkPercentile("p99.9", statistics.P999Ns, exactPercentile(values, 0.999)) && ok;
+	ok = checkPercentile("max", statistics.MaxNs, values.back()) && ok;
+
+	histogram.reset();
+	statistics = histogram.getStatistics();
+	if (statistics.Count != 0 || statistics.MaxNs != 0 || statistics.P50Ns != 0)
+	{
+		printf("FAILED: the histogram is not empty after a reset\n");
+		ok = false;
+	}
+	return ok;
+}
+
+// Every thread records its own values, none may get lost
+static bool checkThreads(size_t count)
+{
+	core::LatencyHistogram histogram;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < Threads; t++)
+	{
+		threads.emplace_back([&histogram, t, count]()
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				histogram.record((uint64_t)(t + 1) * 1000 + i % 1000);
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	LatencyStatistics statistics = histogram.getStatistics();
+	if (statistics.Count != count * Threads || statistics.MaxNs != (uint64_t)Threads * 1000 + 999)
+	{
+		printf("FAILED: %d threads recorded %llu values with a maximum of %llu ns\n", Threads, (unsigned long long)statistics.Count,
+			(unsigned long long)statistics.MaxNs);
+		return false;
+	}
+	printf("%d threads recorded %llu values\n", Threads, (unsigned long long)statistics.Count);
+	return true;
+}
+
+static bool checkMacros()
+{
+	core::LatencyHistogram histogram;
+	for (int i = 0; i < 1000; i++)
+	{
+		VRMC_LATENCY_SCOPE(histogram);
+		VRMC_LATENCY_START(startNs);
+		bench::doNotOptimize(i);
+		VRMC_LATENCY_RECORD(startNs, histogram);
+	}
+#ifndef VRMC_NO_LATENCY_HISTOGRAMS
+	const uint64_t expected = 2000;
+#else
+	const uint64_t expected = 0;
+#endif
+	uint64_t count = histogram.getStatistics().Count;
+	if (count != expected)
+	{
+		printf("FAILED: the macros recorded %llu values instead of %llu\n", (unsigned long long)count, (unsigned long long)expected);
+		return false;
+	}
+	return true;
+}
+
+// Compensates the same HMD poses, with every call timed like a stage of the driver or not
+static double costCompensation(bool timed, size_t count)
+{
+	bench::SyntheticRig rig;
+	core::MotionCompensationCore core;
+	core.setEnabled(true);
+	core.setZeroPose(rig.refPose(0.0));
+	core.updateRefPose(rig.refPose(0.01), 10000);
+	std::vector<vr::DriverPose_t> hmd = rig.hmdStream(1024, 1000.0);
+
+	core::LatencyHistogram histogram;
+	double checksum = 0.0;
+	double best = 1.0E300;
+	for (int round = 0; round < 5; round++)
+	{
+		double start = bench::nowNs();
+		for (size_t i = 0; i < count; i++)
+		{
+			vr::DriverPose_t pose = hmd[i % hmd.size()];
+			if (timed)
+			{
+				VRMC_LATENCY_SCOPE(histogram);
+				core.applyMotionCompensation(pose, 10000, 3);
+			}
+			else
+			{
+				core.applyMotionCompensation(pose, 10000, 3);
+			}
+			checksum += pose.vecPosition[0];
+		}
+		best = std::min(best, bench::nowNs() - start);
+	}
+	bench::doNotOptimize(checksum);
+	return best / (double)count;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = 1000000;
+	if (argc > 1)
+	{
+		count = std::max<size_t>(10000, (size_t)std::atoll(argv[1]));
+	}
+
+	bool ok = checkBuckets();
+	ok = checkAccuracy(count) && ok;
+	ok = checkThreads(count) && ok;
+	ok = checkMacros() && ok;
+
+	core::LatencyHistogram histogram;
+	double recordNs = 1.0E300;
+	for (int round = 0; round < 5; round++)
+	{
+		double start = bench::nowNs();
+		for (size_t i = 0; i < count; i++)
+		{
+			histogram.record(1000 + (i & 4095));
+		}
+		recordNs = std::min(recordNs, (bench::nowNs() - start) / (double)count);
+	}
+	double clockNs = 1.0E300;
+	for (int round = 0; round < 5; round++)
+	{
+		int64_t sum = 0;
+		double start = bench::nowNs();
+		for (size_t i = 0; i < count; i++)
+		{
+			sum += core::LatencyHistogram::nowNs();
+		}
+		clockNs = std::min(clockNs, (bench::nowNs() - start) / (double)count);
+		bench::doNotOptimize(sum);
+	}
+	double untimedNs = costCompensation(false, count / 4);
+	double timedNs = costCompensation(true, count / 4);
+
+	printf("\n%-44s %10s\n", "ns", "best");
+	printf("%-44s %10.1f\n", "record", recordNs);
+	printf("%-44s %10.1f\n", "clock read", clockNs);
+	printf("%-44s %10.1f\n", "compensated HMD pose", untimedNs);
+	printf("%-44s %10.1f\n", "compensated HMD pose, timed", timedNs);
+
+	if (recordNs > RecordBudgetNs)
+	{
+		printf("%s: a record takes %.1f ns, more than %.0f ns\n", bench::timingFailed(), recordNs, RecordBudgetNs);
+		ok = !bench::timingChecked() && ok;
+	}
+	return ok ? 0 : 1;
+}
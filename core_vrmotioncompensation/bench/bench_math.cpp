@@ -0,0 +1,194 @@
+#include "BenchUtil.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace vrmotioncompensation;
+
+// Checks the quaternion kernels selected in openvr_math_simd.h against the scalar versions
+// and benchmarks both. Exits with 1 if a result differs by more than the tolerance.
+// Usage: bench_vrmotioncompensation_math [operation count]
+
+static const double Tolerance = 1.0E-12;
+
+static double maxDifference(const vr::HmdQuaternion_t& a, const vr::HmdQuaternion_t& b)
+{
+	return std::max(std::max(std::fabs(a.w - b.w), std::fabs(a.x - b.x)), std::max(std::fabs(a.y - b.y), std::fabs(a.z - b.z)));
+}
+
+static double maxDifference(const vr::HmdVector3d_t& a, const vr::HmdVector3d_t& b)
+{
+	return std::max(std::max(std::fabs(a.v[0] - b.v[0]), std::fabs(a.v[1] - b.v[1])), std::fabs(a.v[2] - b.v[2]));
+}
+
+// Random rotations. Every second one is slightly off unit length, like the output of the unnormalized slerp
+static std::vector<vr::HmdQuaternion_t> randomQuaternions(std::mt19937& rng, size_t count)
+{
+	std::uniform_real_distribution<double> angle(-3.14159265358979, 3.14159265358979);
+	std::uniform_real_distribution<double> scale(0.9, 1.1);
+	std::vector<vr::HmdQuaternion_t> quats(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		vr::HmdQuaternion_t q = vrmath::quaternionFromYawPitchRoll(angle(rng), angle(rng), angle(rng));
+		if (i & 1)
+		{
+			double s = scale(rng);
+			q = { q.w * s, q.x * s, q.y * s, q.z * s };
+		}
+		quats[i] = q;
+	}
+	return quats;
+}
+
+static std::vector<vr::HmdVector3d_t> randomVectors(std::mt19937& rng, size_t count)
+{
+	std::uniform_real_distribution<double> coord(-2.0, 2.0);
+	std::vector<vr::HmdVector3d_t> vecs(count);
+	for (auto& v : vecs)
+	{
+		v = { coord(rng), coord(rng), coord(rng) };
+	}
+	return vecs;
+}
+
+static bool report(const char* name, double diff)
+{
+	bool ok = diff <= Tolerance;
+	printf("%-44s max diff %.3e %s\n", name, diff, ok ? "OK" : "FAILED");
+	return ok;
+}
+
+static bool checkKernels(const std::vector<vr::HmdQuaternion_t>& quats, const std::vector<vr::HmdVector3d_t>& vecs)
+{
+	double mulDiff = 0.0;
+	double rotDiff = 0.0;
+	double rotInvDiff = 0.0;
+	for (size_t i = 0; i < quats.size(); i++)
+	{
+		const vr::HmdQuaternion_t& a = quats[i];
+		const vr::HmdQuaternion_t& b = quats[(i + 1) % quats.size()];
+		const vr::HmdVector3d_t& v = vecs[i % vecs.size()];
+		vr::HmdQuaternion_t aConj = vrmath::quaternionConjugate(a);
+
+		mulDiff = std::max(mulDiff, maxDifference(a * b, vrmath::scalar::quaternionMultiply(a, b)));
+		rotDiff = std::max(rotDiff, maxDifference(vrmath::quaternionRotateVector(a, v), vrmath::scalar::quaternionRotateVector(a, aConj, v.v)));
+		rotDiff = std::max(rotDiff, maxDifference(vrmath::quaternionRotateVector(a, v.v), vrmath::scalar::quaternionRotateVector(a, aConj, v.v)));
+		rotInvDiff = std::max(rotInvDiff, maxDifference(vrmath::quaternionRotateVector(a, aConj, v, true), vrmath::scalar::quaternionRotateVector(aConj, a, v.v)));
+		rotInvDiff = std::max(rotInvDiff, maxDifference(vrmath::quaternionRotateVector(a, v.v, true), vrmath::scalar::quaternionRotateVector(aConj, a, v.v)));
+	}
+
+	double batchDiff = 0.0;
+	std::vector<vr::HmdVector3d_t> out(vecs.size());
+	std::vector<vr::HmdVector3d_t> expected(vecs.size());
+	for (size_t i = 0; i < 64; i++)
+	{
+		const vr::HmdQuaternion_t& q = quats[i];
+		bool reverse = (i & 2) != 0;
+		vr::HmdQuaternion_t qConj = vrmath::quaternionConjugate(q);
+
+		vrmath::quaternionRotateVectors(q, vecs.data(), out.data(), vecs.size(), reverse);
+		if (reverse)
+		{
+			vrmath::scalar::quaternionRotateVectors(qConj, q, vecs.data(), expected.data(), vecs.size());
+		}
+		else
+		{
+			vrmath::scalar::quaternionRotateVectors(q, qConj, vecs.data(), expected.data(), vecs.size());
+		}
+
+		for (size_t k = 0; k < vecs.size(); k++)
+		{
+			batchDiff = std::max(batchDiff, maxDifference(out[k], expected[k]));
+		}
+	}
+
+	// In place
+	std::vector<vr::HmdVector3d_t> inPlace = vecs;
+	vrmath::quaternionRotateVectors(quats[0], inPlace.data(), inPlace.data(), inPlace.size());
+	vrmath::scalar::quaternionRotateVectors(quats[0], vrmath::quaternionConjugate(quats[0]), vecs.data(), expected.data(), vecs.size());
+	for (size_t k = 0; k < vecs.size(); k++)
+	{
+		batchDiff = std::max(batchDiff, maxDifference(inPlace[k], expected[k]));
+	}
+
+	bool ok = report("quaternion multiply", mulDiff);
+	ok &= report("rotate vector", rotDiff);
+	ok &= report("rotate vector (reverse)", rotInvDiff);
+	ok &= report("batched rotate", batchDiff);
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = 10000000;
+	if (argc > 1)
+	{
+		count = (size_t)std::strtoull(argv[1], nullptr, 10);
+	}
+
+	std::mt19937 rng(7);
+	std::vector<vr::HmdQuaternion_t> quats = randomQuaternions(rng, 4096);
+	std::vector<vr::HmdVector3d_t> vecs = randomVectors(rng, 4099);
+
+	printf("Kernels: %s, operation count: %zu\n\n", VRMATH_SIMD_NAME, count);
+	printf("%-44s %12s %14s\n", "benchmark", "ns/op", "ops/s");
+	auto print = [](const char* name, double totalNs, size_t ops) {
+		printf("%-44s %12.2f %14.0f\n", name, totalNs / (double)ops, 1.0E9 * (double)ops / totalNs);
+	};
+
+	const size_t mask = quats.size() - 1;
+	vr::HmdQuaternion_t acc = { 1, 0, 0, 0 };
+	double start = bench::nowNs();
+	for (size_t i = 0; i < count; i++)
+	{
+		acc = vrmath::scalar::quaternionMultiply(quats[i & mask], quats[(i + 1) & mask]) + acc;
+	}
+	print("quaternion multiply (scalar)", bench::nowNs() - start, count);
+
+	start = bench::nowNs();
+	for (size_t i = 0; i < count; i++)
+	{
+		acc = quats[i & mask] * quats[(i + 1) & mask] + acc;
+	}
+	print("quaternion multiply", bench::nowNs() - start, count);
+
+	vr::HmdVector3d_t vacc = { 0, 0, 0 };
+	start = bench::nowNs();
+	for (size_t i = 0; i < count; i++)
+	{
+		const vr::HmdQuaternion_t& q = quats[i & mask];
+		vacc = vacc + vrmath::scalar::quaternionRotateVector(q, vrmath::quaternionConjugate(q), vecs[i & mask].v);
+	}
+	print("rotate vector (scalar)", bench::nowNs() - start, count);
+
+	start = bench::nowNs();
+	for (size_t i = 0; i < count; i++)
+	{
+		vacc = vacc + vrmath::quaternionRotateVector(quats[i & mask], vecs[i & mask]);
+	}
+	print("rotate vector", bench::nowNs() - start, count);
+
+	std::vector<vr::HmdVector3d_t> out(vecs.size());
+	size_t rounds = std::max<size_t>(1, count / vecs.size());
+	start = bench::nowNs();
+	for (size_t r = 0; r < rounds; r++)
+	{
+		const vr::HmdQuaternion_t& q = quats[r & mask];
+		vrmath::scalar::quaternionRotateVectors(q, vrmath::quaternionConjugate(q), vecs.data(), out.data(), vecs.size());
+		bench::doNotOptimize(out);
+	}
+	print("batched rotate, per vector (scalar)", bench::nowNs() - start, rounds * vecs.size());
+
+	start = bench::nowNs();
+	for (size_t r = 0; r < rounds; r++)
+	{
+		vrmath::quaternionRotateVectors(quats[r & mask], vecs.data(), out.data(), vecs.size());
+		bench::doNotOptimize(out);
+	}
+	print("batched rotate, per vector", bench::nowNs() - start, rounds * vecs.size());
+	bench::doNotOptimize(acc);
+	bench::doNotOptimize(vacc);
+
+	printf("\nComparison with the scalar kernels (tolerance %.0e):\n", Tolerance);
+	return checkKernels(quats, vecs) ? 0 : 1;
+}
@@ -0,0 +1,303 @@
+#include "BenchUtil.h"
+#include "FilterPipeline.h"
+#include "Filters.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace vrmotioncompensation;
+
+// Checks every selectable filter pipeline against the branching filter code it replaced and
+// times every built-in pipeline next to it.
+// Exits with 1 if a pipeline does not reproduce the output of the branching code.
+// Usage: bench_vrmotioncompensation_pipeline [pose count]
+
+static const double RefRate = 369.0;
+static const long long RefPeriodUs = 2710;
+static const int CostRounds = 7;
+
+struct FilterSettings
+{
+	MotionCompensationFilterType FilterType;
+	uint32_t Samples;
+	double LpfBeta;
+	bool SetZeroMode;
+};
+
+// The reference filter of MotionCompensationCore::updateRefPose before the pipelines: all settings are checked per sample.
+// The derivatives follow the pipelines: none for DEMA, the angular velocity from the relative rotation between consecutive outputs
+class BranchingFilter
+{
+public:
+	FilterSettings Settings;
+	long long KalmanPredictionUs = 0;
+
+	explicit BranchingFilter(const FilterSettings& settings) : Settings(settings)
+	{
+		_Alpha = 2.0 / (1.0 + (double)settings.Samples);
+	}
+
+	void update(const vr::DriverPose_t& pose, long long timestampUs, core::FilterOutput& out)
+	{
+		out = {};
+		long long sampleUs = timestampUs + (long long)(pose.poseTimeOffset * 1.0E6);
+		double tdiff = _LastSampleUs < 0 ? 0.0 : (double)(sampleUs - _LastSampleUs) / 1.0E6;
+
+		if (Settings.FilterType == MotionCompensationFilterType::Kalman)
+		{
+			_Kalman.update(sampleUs, pose.vecPosition, pose.qRotation);
+			core::PoseKalmanFilter::State filtered = _Kalman.predict((double)KalmanPredictionUs / 1.0E6);
+			out.TimeShiftUs = KalmanPredictionUs;
+			out.Pos = filtered.Pos;
+			out.Rot = filtered.Rot;
+			if (!Settings.SetZeroMode)
+			{
+				out.Vel = filtered.Vel;
+				out.Acc = filtered.Acc;
+				out.AngVel = filtered.AngVel;
+				out.AngAcc = filtered.AngAcc;
+			}
+		}
+		else if (Settings.FilterType == MotionCompensationFilterType::OneEuro)
+		{
+			_OneEuro.update(sampleUs, pose.vecPosition, pose.qRotation);
+			const core::PoseOneEuroFilter::State& filtered = _OneEuro.state();
+			out.Pos = filtered.Pos;
+			out.Rot = filtered.Rot;
+			if (!Settings.SetZeroMode)
+			{
+				out.Vel = filtered.Vel;
+				out.AngVel = filtered.AngVel;
+			}
+		}
+		else
+		{
+			if (Settings.Samples >= 2)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					_Dema[0].v[axis] += _Alpha * (pose.vecPosition[axis] - _Dema[1].v[axis]);
+					_Dema[1].v[axis] += _Alpha * (_Dema[0].v[axis] - _Dema[1].v[axis]);
+					out.Pos.v[axis] = 2 * _Dema[0].v[axis] - _Dema[1].v[axis];
+				}
+			}
+			else
+			{
+				out.Pos = { pose.vecPosition[0], pose.vecPosition[1], pose.vecPosition[2] };
+				if (!Settings.SetZeroMode)
+				{
+					out.Vel = { pose.vecVelocity[0], pose.vecVelocity[1], pose.vecVelocity[2] };
+				}
+			}
+
+			if (Settings.LpfBeta <= 0.9999)
+			{
+				_Rot[0] = core::slerp(_Rot[0], pose.qRotation, Settings.LpfBeta);
+				_Rot[1] = core::slerp(_Rot[1], _Rot[0], Settings.LpfBeta);
+				if (!Settings.SetZeroMode)
+				{
+					out.AngVel = core::quaternionVelocity(tdiff, _Rot[1], _Last.Rot);
+					for (int axis = 0; axis < 3; axis++)
+					{
+						out.AngAcc.v[axis] = core::vecAcceleration(tdiff, out.AngVel.v[axis], _Last.AngVel.v[axis]);
+					}
+				}
+			}
+			else
+			{
+				_Rot[1] = pose.qRotation;
+				if (!Settings.SetZeroMode)
+				{
+					out.AngVel = { pose.vecAngularVelocity[0], pose.vecAngularVelocity[1], pose.vecAngularVelocity[2] };
+					out.AngAcc = { pose.vecAngularAcceleration[0], pose.vecAngularAcceleration[1], pose.vecAngularAcceleration[2] };
+				}
+			}
+			out.Rot = _Rot[1];
+		}
+
+		_LastSampleUs = sampleUs;
+		_Last = out;
+	}
+
+private:
+	double _Alpha;
+	long long _LastSampleUs = -1;
+	core::FilterOutput _Last = {};
+	vr::HmdVector3d_t _Dema[2] = {};
+	vr::HmdQuaternion_t _Rot[2] = { { 1, 0, 0, 0 }, { 1, 0, 0, 0 } };
+	core::PoseKalmanFilter _Kalman;
+	core::PoseOneEuroFilter _OneEuro;
+};
+
+static void initContext(core::FilterContext& ctx, const FilterSettings& settings, long long predictionUs)
+{
+	ctx.Alpha = 2.0 / (1.0 + (double)settings.Samples);
+	ctx.LpfBeta = settings.LpfBeta;
+	ctx.KalmanPredictionUs = predictionUs;
+}
+
+static bool near(double a, double b)
+{
+	return std::fabs(a - b) <= 1.0E-9 * (1.0 + std::fabs(a) + std::fabs(b));
+}
+
+static bool same(const vr::HmdVector3d_t& a, const vr::HmdVector3d_t& b)
+{
+	return near(a.v[0], b.v[0]) && near(a.v[1], b.v[1]) && near(a.v[2], b.v[2]);
+}
+
+static bool same(const core::FilterOutput& a, const core::FilterOutput& b)
+{
+	return same(a.Pos, b.Pos) && same(a.Vel, b.Vel) && same(a.Acc, b.Acc) && same(a.AngVel, b.AngVel) && same(a.AngAcc, b.AngAcc)
+		&& near(a.Rot.w, b.Rot.w) && near(a.Rot.x, b.Rot.x) && near(a.Rot.y, b.Rot.y) && near(a.Rot.z, b.Rot.z)
+		&& a.TimeShiftUs == b.TimeShiftUs;
+}
+
+static const char* typeName(MotionCompensationFilterType type)
+{
+	switch (type)
+	{
+	case MotionCompensationFilterType::Kalman:
+		return "Kalman";
+	case MotionCompensationFilterType::OneEuro:
+		return "One Euro";
+	default:
+		return "default";
+	}
+}
+
+// Runs the selected pipeline and the branching filter side by side
+static bool checkSettings(const FilterSettings& settings, const std::vector<vr::DriverPose_t>& poses)
+{
+	const long long predictionUs = 8000;
+	BranchingFilter branching(settings);
+	branching.KalmanPredictionUs = predictionUs;
+
+	core::FilterContext ctx;
+	initContext(ctx, settings, predictionUs);
+	core::FilterPipelineFn pipeline = core::selectFilterPipeline(settings.FilterType, settings.Samples, settings.LpfBeta, settings.SetZeroMode);
+
+	long long timestampUs = 0;
+	for (size_t i = 0; i < poses.size(); i++)
+	{
+		timestampUs += RefPeriodUs;
+		core::FilterOutput expected, actual;
+		branching.update(poses[i], timestampUs, expected);
+		pipeline(ctx, poses[i], timestampUs, actual);
+
+		if (!same(expected, actual))
+		{
+			printf("FAILED: %s filter, samples %u, LPF %.2f, zero mode %d differs at sample %zu\n",
+				typeName(settings.FilterType), settings.Samples, settings.LpfBeta, (int)settings.SetZeroMode, i);
+			return false;
+		}
+	}
+	return true;
+}
+
+static double costPipeline(core::FilterPipelineFn pipeline, const std::vector<vr::DriverPose_t>& poses)
+{
+	core::FilterContext ctx;
+	initContext(ctx, { MotionCompensationFilterType::Default, 12, 0.85, false }, 0);
+	core::FilterOutput out;
+	double checksum = 0.0;
+
+	double best = 1.0E300;
+	long long timestampUs = 0;
+	for (int round = 0; round < CostRounds; round++)
+	{
+		double start = bench::nowNs();
+		for (const vr::DriverPose_t& pose : poses)
+		{
+			timestampUs += RefPeriodUs;
+			pipeline(ctx, pose, timestampUs, out);
+			checksum += out.Pos.v[0] + out.Rot.w + out.Vel.v[1];
+		}
+		best = std::min(best, bench::nowNs() - start);
+	}
+	bench::doNotOptimize(checksum);
+	return best;
+}
+
+static double costBranching(const FilterSettings& settings, const std::vector<vr::DriverPose_t>& poses)
+{
+	BranchingFilter filter(settings);
+	core::FilterOutput out;
+	double checksum = 0.0;
+
+	double best = 1.0E300;
+	long long timestampUs = 0;
+	for (int round = 0; round < CostRounds; round++)
+	{
+		// The settings may change between samples
+		bench::doNotOptimize(filter.Settings);
+		double start = bench::nowNs();
+		for (const vr::DriverPose_t& pose : poses)
+		{
+			timestampUs += RefPeriodUs;
+			filter.update(pose, timestampUs, out);
+			checksum += out.Pos.v[0] + out.Rot.w + out.Vel.v[1];
+		}
+		best = std::min(best, bench::nowNs() - start);
+	}
+	bench::doNotOptimize(checksum);
+	return best;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = 200000;
+	if (argc > 1)
+	{
+		count = (size_t)std::atol(argv[1]);
+	}
+
+	bench::SyntheticRig rig;
+	std::vector<vr::DriverPose_t> poses = rig.refStream(count, RefRate);
+
+	// ----------------------------------------------------------------------------------------------- //
+	// Equivalence
+	const MotionCompensationFilterType types[] = { MotionCompensationFilterType::Default, MotionCompensationFilterType::Kalman, MotionCompensationFilterType::OneEuro };
+	const uint32_t samples[] = { 1, 12 };
+	const double lpfBetas[] = { 0.2, 1.0 };
+	const bool zeroModes[] = { false, true };
+
+	std::vector<vr::DriverPose_t> checkPoses(poses.begin(), poses.begin() + std::min<size_t>(poses.size(), 5000));
+	bool ok = true;
+	int checked = 0;
+	for (MotionCompensationFilterType type : types)
+	{
+		for (uint32_t sampleCount : samples)
+		{
+			for (double lpfBeta : lpfBetas)
+			{
+				for (bool zeroMode : zeroModes)
+				{
+					ok = checkSettings({ type, sampleCount, lpfBeta, zeroMode }, checkPoses) && ok;
+					checked++;
+				}
+			}
+		}
+	}
+	printf("%d filter settings checked against the branching filter: %s\n\n", checked, ok ? "identical" : "DIFFERENT");
+
+	// ----------------------------------------------------------------------------------------------- //
+	// Cost per reference sample
+	bench::printHeader();
+
+	size_t pipelineCount;
+	const core::FilterPipelineInfo* pipelines = core::filterPipelines(pipelineCount);
+	for (size_t i = 0; i < pipelineCount; i++)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "pipeline: %s", pipelines[i].Name);
+		bench::printResult(name, costPipeline(pipelines[i].Run, poses), poses.size());
+	}
+
+	bench::printResult("branching: DEMA / slerp LPF / stage", costBranching({ MotionCompensationFilterType::Default, 12, 0.85, false }, poses), poses.size());
+	bench::printResult("branching: DEMA / slerp LPF / zero", costBranching({ MotionCompensationFilterType::Default, 12, 0.85, true }, poses), poses.size());
+	bench::printResult("branching: Kalman / Kalman / stage", costBranching({ MotionCompensationFilterType::Kalman, 12, 0.85, false }, poses), poses.size());
+	bench::printResult("branching: One Euro / One Euro / stage", costBranching({ MotionCompensationFilterType::OneEuro, 12, 0.85, false }, poses), poses.size());
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,289 @@
+#include "BenchUtil.h"
+#include "PoseStatistics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace vrmotioncompensation;
+
+// Checks the per-device pose statistics and their shared memory block.
+// A 1120 Hz pose stream with jitter, dropped updates, a stretch of lost tracking and a spread of poseTimeOffset
+// goes into a counter with known arrival times, and the counts, rate, inter-arrival percentiles and offsets are
+// compared with the exact ones. Threads recording into one counter must not lose a pose. A writer thread
+// publishes statistics into the block as fast as it can while the reader copies them; every field of a
+// published entry is derived from the same counter, so the reader can tell a torn copy.
+// Exits with 1 if a count or the offsets are off, the rate is more than 0.1 % off, a percentile is below the
+// exact one or more than 1/32 above it, a torn copy was accepted, no copy got through, or a pose costs more
+// than 100 ns to record.
+// Usage: bench_vrmotioncompensation_posestats [poses]
+
+static const double RateHz = 1120.0;
+static const int Threads = 4;
+static const double RecordBudgetNs = 100.0;
+
+static vr::DriverPose_t makePose(bool tracking, double timeOffset)
+{
+	vr::DriverPose_t pose = {};
+	pose.poseIsValid = tracking;
+	pose.result = tracking ? vr::TrackingResult_Running_OK : vr::TrackingResult_Running_OutOfRange;
+	pose.deviceIsConnected = true;
+	pose.poseTimeOffset = timeOffset;
+	return pose;
+}
+
+static uint64_t exactPercentile(const std::vector<uint64_t>& sorted, double p)
+{
+	size_t rank = std::max<size_t>(1, (size_t)std::ceil(p * (double)sorted.size()));
+	return sorted[rank - 1];
+}
+
+static bool checkPercentiles(const char* name, const LatencyStatistics& statistics, std::vector<uint64_t> values)
+{
+	std::sort(values.begin(), values.end());
+	const double percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+	const uint64_t reported[] = { statistics.P50Ns, statistics.P90Ns, statistics.P99Ns, statistics.P999Ns };
+	bool ok = statistics.Count == values.size() && statistics.MaxNs == values.back();
+	for (int i = 0; i < 4; i++)
+	{
+		uint64_t exact = exactPercentile(values, percentiles[i]);
+		ok = ok && reported[i] >= exact && (double)reported[i] <= (double)exact * (1.0 + 1.0 / core::LatencyHistogram::SubBuckets) + 1.0;
+	}
+	printf("%-12s p50 %9.1f us  p99 %9.1f us  p99.9 %9.1f us  max %9.1f us %s\n", name, (double)statistics.P50Ns / 1000.0,
+		(double)statistics.P99Ns / 1000.0, (double)statistics.P999Ns / 1000.0, (double)statistics.MaxNs / 1000.0, ok ? "" : "FAILED");
+	return ok;
+}
+
+static bool checkStream(size_t count)
+{
+	std::mt19937_64 rng(11);
+	std::normal_distribution<double> jitter(0.0, 60000.0);
+	std::uniform_real_distribution<double> offset(-0.02, -0.004);
+
+	core::PoseStatisticsCounter counter;
+	std::vector<uint64_t> intervals;
+	std::vector<uint64_t> offsets;
+	uint64_t invalid = 0;
+	int64_t offsetMin = INT64_MAX;
+	int64_t offsetMax = INT64_MIN;
+	int64_t offsetSum = 0;
+	const int64_t periodNs = (int64_t)(1.0E9 / RateHz);
+	int64_t nowNs = 1000000000;
+	int64_t firstNs = nowNs;
+	int64_t lastNs = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		// Every 997th update is dropped, and a second of lost tracking in the middle
+		if (i > 0)
+		{
+			int64_t step = periodNs * (i % 997 == 0 ? 2 : 1) + (int64_t)jitter(rng);
+			nowNs += std::max<int64_t>(step, 1000);
+			intervals.push_back((uint64_t)(nowNs - lastNs));
+		}
+		bool tracking = i < count / 2 || i >= count / 2 + (size_t)RateHz;
+		double timeOffset = tracking ? offset(rng) : 0.0;
+		if (tracking)
+		{
+			int64_t offsetNs = (int64_t)(timeOffset * 1.0E9);
+			offsetMin = std::min(offsetMin, offsetNs);
+			offsetMax = std::max(offsetMax, offsetNs);
+			offsetSum += offsetNs;
+			offsets.push_back((uint64_t)-offsetNs);
+		}
+		else
+		{
+			invalid++;
+		}
+		counter.record(makePose(tracking, timeOffset), nowNs);
+		lastNs = nowNs;
+	}
+
+	PoseStatistics_v1 statistics = counter.getStatistics();
+	double exactRate = (double)(count - 1) * 1.0E9 / (double)(lastNs - firstNs);
+	bool ok = statistics.Count == count && statistics.InvalidCount == invalid && statistics.NotRunningOkCount == invalid;
+	printf("%llu poses, %llu invalid, %llu not Running_OK\n", (unsigned long long)statistics.Count, (unsigned long long)statistics.InvalidCount,
+		(unsigned long long)statistics.NotRunningOkCount);
+	bool rateOk = std::fabs(statistics.RateHz - exactRate) <= exactRate * 0.001;
+	printf("rate %.2f Hz, exact %.2f Hz %s\n", statistics.RateHz, exactRate, rateOk ? "" : "FAILED");
+	ok = checkPercentiles("interval", statistics.Interval, intervals) && rateOk && ok;
+	ok = checkPercentiles("time offset", statistics.TimeOffset, offsets) && ok;
+
+	double mean = (double)offsetSum / 1.0E9 / (double)offsets.size();
+	bool offsetOk = std::fabs(statistics.TimeOffsetMinS - (double)offsetMin / 1.0E9) < 1.0E-12
+		&& std::fabs(statistics.TimeOffsetMaxS - (double)offsetMax / 1.0E9) < 1.0E-12
+		&& std::fabs(statistics.TimeOffsetMeanS - mean) < 1.0E-12;
+	printf("time offset min %.3f ms, max %.3f ms, mean %.3f ms %s\n", statistics.TimeOffsetMinS * 1000.0, statistics.TimeOffsetMaxS * 1000.0,
+		statistics.TimeOffsetMeanS * 1000.0, offsetOk ? "" : "FAILED");
+	ok = offsetOk && ok;
+
+	counter.reset();
+	statistics = counter.getStatistics();
+	if (statistics.Count != 0 || statistics.Interval.Count != 0 || statistics.RateHz != 0.0 || statistics.TimeOffsetMinS != 0.0)
+	{
+		printf("FAILED: the statistics are not empty after a reset\n");
+		ok = false;
+	}
+	return ok;
+}
+
+static bool checkThreads(size_t count)
+{
+	core::PoseStatisticsCounter counter;
+	std::atomic<int64_t> clock = { 1 };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < Threads; t++)
+	{
+		threads.emplace_back([&counter, &clock, t, count]()
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				counter.record(makePose((i + t) % 3 != 0, -0.01), clock.fetch_add(1000, std::memory_order_relaxed));
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	PoseStatistics_v1 statistics = counter.getStatistics();
+	uint64_t invalid = 0;
+	for (int t = 0; t < Threads; t++)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			invalid += (i + t) % 3 == 0 ? 1 : 0;
+		}
+	}
+	if (statistics.Count != count * Threads || statistics.InvalidCount != invalid || statistics.TimeOffset.Count != count * Threads - invalid)
+	{
+		printf("FAILED: %d threads recorded %llu poses, %llu invalid\n", Threads, (unsigned long long)statistics.Count,
+			(unsigned long long)statistics.InvalidCount);
+		return false;
+	}
+	printf("%d threads recorded %llu poses\n", Threads, (unsigned long long)statistics.Count);
+	return true;
+}
+
+static void fill(PoseStatistics_v1* devices, uint64_t n)
+{
+	for (uint32_t id = 0; id < PoseStatisticsDeviceCount; id++)
+	{
+		PoseStatistics_v1& device = devices[id];
+		device = {};
+		device.OpenVRId = id;
+		device.Count = n;
+		device.InvalidCount = n + id;
+		device.NotRunningOkCount = n * 2;
+		device.RateHz = (double)n;
+		device.Interval.Count = n;
+		device.Interval.MaxNs = n + 1;
+		device.TimeOffset.P50Ns = n + 2;
+	}
+}
+
+static bool isConsistent(const PoseStatistics_v1* devices, int64_t timeNs)
+{
+	static PoseStatistics_v1 expected[PoseStatisticsDeviceCount];
+	fill(expected, (uint64_t)timeNs);
+	return std::memcmp(devices, expected, sizeof(expected)) == 0;
+}
+
+static bool checkBlock(int milliseconds)
+{
+	static MMFstruct_OVRMC_PoseStatistics_v1 block;
+	static PoseStatistics_v1 published[PoseStatisticsDeviceCount];
+	static PoseStatistics_v1 copy[PoseStatisticsDeviceCount];
+
+	int64_t timeNs = 0;
+	core::PoseStatisticsWriter::init(block);
+	if (core::PoseStatisticsReader::read(block, copy, timeNs) == false || copy[5].OpenVRId != 5 || copy[5].Count != 0)
+	{
+		printf("FAILED: an initialized block does not read as empty\n");
+		return false;
+	}
+
+	std::atomic<bool> stop = { false };
+	uint64_t writes = 0;
+	std::thread writer([&]() {
+		uint64_t n = 1;
+		while (!stop.load(std::memory_order_relaxed))
+		{
+			fill(published, n);
+			core::PoseStatisticsWriter::publish(block, published, (int64_t)n);
+			n++;
+		}
+		writes = n - 1;
+	});
+
+	uint64_t reads = 0;
+	uint64_t failed = 0;
+	uint64_t torn = 0;
+	double end = bench::nowNs() + (double)milliseconds * 1.0E6;
+	while (bench::nowNs() < end)
+	{
+		reads++;
+		if (!core::PoseStatisticsReader::read(block, copy, timeNs))
+		{
+			failed++;
+		}
+		else if (timeNs != 0 && !isConsistent(copy, timeNs))
+		{
+			torn++;
+		}
+	}
+	stop = true;
+	writer.join();
+
+	printf("%llu publishes, %llu reads, %llu gave up, %llu torn\n", (unsigned long long)writes, (unsigned long long)reads,
+		(unsigned long long)failed, (unsigned long long)torn);
+	if (torn != 0 || failed == reads)
+	{
+		printf("FAILED: %s\n", torn != 0 ? "a torn copy was accepted" : "no copy got through");
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = 1000000;
+	if (argc > 1)
+	{
+		count = std::max<size_t>(10000, (size_t)std::atoll(argv[1]));
+	}
+
+	bool ok = checkStream(count);
+	ok = checkThreads(count / 4) && ok;
+	ok = checkBlock(300) && ok;
+
+	core::PoseStatisticsCounter counter;
+	vr::DriverPose_t pose = makePose(true, -0.012);
+	double recordNs = 1.0E300;
+	for (int round = 0; round < 5; round++)
+	{
+		counter.reset();
+		int64_t nowNs = 1;
+		double start = bench::nowNs();
+		for (size_t i = 0; i < count; i++)
+		{
+			nowNs += 892857 + (int64_t)(i & 1023);
+			counter.record(pose, nowNs);
+		}
+		recordNs = std::min(recordNs, (bench::nowNs() - start) / (double)count);
+	}
+
+	printf("\n%-44s %10s\n", "ns", "best");
+	printf("%-44s %10.1f\n", "record", recordNs);
+	if (recordNs > RecordBudgetNs)
+	{
+		printf("%s: a record takes %.1f ns, more than %.0f ns\n", bench::timingFailed(), recordNs, RecordBudgetNs);
+		ok = !bench::timingChecked() && ok;
+	}
+	return ok ? 0 : 1;
+}
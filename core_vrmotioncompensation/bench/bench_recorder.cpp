@@ -0,0 +1,315 @@
+#include "BenchUtil.h"
+#include "CaptureRecorder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace vrmotioncompensation;
+
+// Checks the lock-free capture path of the debug logger and measures what a record costs the pose threads.
+// Three producer threads record at pose rates (two trackers at 250 Hz and the HMD at 1 kHz, sped up) while the
+// drain thread writes the capture. Every record carries its thread and counter, so the file shows a lost,
+// duplicated, torn or reordered record. Then the producers record as fast as they can: records may be dropped
+// when a ring is full, but every record has to be either in the file or counted as dropped. A second capture
+// on the same recorder checks that the threads pick up new rings, and a full capture that it stops taking records.
+// The cost of a record is compared with the old logger, a mutex around a shared buffer, with the same threads.
+// Exits with 1 if a record is lost, torn or out of order, the counts do not add up, a record is taken after
+// stop or past the end of the capture, or the median record costs more than 200 ns.
+// Usage: bench_vrmotioncompensation_recorder [paced milliseconds] [directory]
+
+static const int Producers = 3;
+static const double RecordBudgetNs = 200.0;
+
+// Time, producer, counter, then a quaternion and a vector derived from both
+static std::vector<core::CaptureChannel> benchChannels()
+{
+	return {
+		{ "Producer", core::CaptureChannelType::Scalar },
+		{ "Counter", core::CaptureChannelType::Scalar },
+		{ "Rotation", core::CaptureChannelType::Quaternion },
+		{ "Position", core::CaptureChannelType::Vector3 },
+	};
+}
+
+static const size_t RecordDoubles = 1 + 1 + 1 + 4 + 3;
+
+static void makeRecord(double* record, double time, int producer, uint64_t counter)
+{
+	double d = (double)counter * 0.001 + (double)producer;
+	record[0] = time;
+	record[1] = (double)producer;
+	record[2] = (double)counter;
+	for (size_t i = 3; i < RecordDoubles; i++)
+	{
+		record[i] = d * (double)i;
+	}
+}
+
+struct ProducerResult
+{
+	uint64_t Recorded = 0;
+	uint64_t Refused = 0;
+	std::vector<double> CallNs;
+};
+
+// Reads the capture back and checks every record against makeRecord. Records of a producer have to come in
+// the order of their counter, without gaps if lossless is set
+static bool checkCapture(const std::string& path, uint64_t expectedRecords, bool lossless, uint64_t& outOfTimeOrder)
+{
+	core::CaptureReader reader;
+	if (!reader.open(path.c_str()) || reader.getHeader().RecordSize != RecordDoubles * sizeof(double))
+	{
+		printf("FAILED: %s is not a capture of the bench channels\n", path.c_str());
+		return false;
+	}
+	if (reader.getRecordCount() != expectedRecords)
+	{
+		printf("FAILED: the capture has %llu records instead of %llu\n", (unsigned long long)reader.getRecordCount(), (unsigned long long)expectedRecords);
+		return false;
+	}
+
+	std::vector<int64_t> last(Producers, -1);
+	double lastTime = -1.0;
+	outOfTimeOrder = 0;
+	double expected[RecordDoubles];
+	for (uint64_t i = 0; i < reader.getRecordCount(); i++)
+	{
+		const double* record = reader.getRecord(i);
+		int producer = (int)record[1];
+		if (producer < 0 || producer >= Producers)
+		{
+			printf("FAILED: record %llu is from an unknown producer\n", (unsigned long long)i);
+			return false;
+		}
+		uint64_t counter = (uint64_t)record[2];
+		makeRecord(expected, record[0], producer, counter);
+		if (std::memcmp(expected, record, sizeof(expected)) != 0)
+		{
+			printf("FAILED: record %llu is torn\n", (unsigned long long)i);
+			return false;
+		}
+		if ((int64_t)counter <= last[producer] || (lossless && (int64_t)counter != last[producer] + 1))
+		{
+			printf("FAILED: producer %d record %llu follows %lld\n", producer, (unsigned long long)counter, (long long)last[producer]);
+			return false;
+		}
+		last[producer] = (int64_t)counter;
+		outOfTimeOrder += record[0] < lastTime ? 1 : 0;
+		lastTime = std::max(lastTime, record[0]);
+	}
+	return true;
+}
+
+// Records every periodNs (0 for as fast as possible) for durationNs, timing each call
+static void produce(core::CaptureRecorder& recorder, int producer, double startNs, double periodNs, double durationNs, ProducerResult& result)
+{
+	double record[RecordDoubles];
+	uint64_t counter = 0;
+	double next = startNs;
+	while (true)
+	{
+		double now = bench::nowNs();
+		if (now - startNs >= durationNs)
+		{
+			break;
+		}
+		if (periodNs > 0.0 && now < next)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		next += periodNs;
+
+		makeRecord(record, (now - startNs) / 1.0E9, producer, counter);
+		double before = bench::nowNs();
+		bool recorded = recorder.record(record);
+		result.CallNs.push_back(bench::nowNs() - before);
+		if (recorded)
+		{
+			result.Recorded++;
+			counter++;
+		}
+		else
+		{
+			result.Refused++;
+		}
+	}
+}
+
+// Producer rates in Hz: two reference trackers and the HMD. The bench runs them 4x faster than real time
+static const double ProducerRates[Producers] = { 250.0 * 4, 250.0 * 4, 1000.0 * 4 };
+
+static void runProducers(core::CaptureRecorder& recorder, bool paced, double durationNs, std::vector<ProducerResult>& results)
+{
+	results.assign(Producers, ProducerResult());
+	std::vector<std::thread> threads;
+	double startNs = bench::nowNs();
+	for (int p = 0; p < Producers; p++)
+	{
+		threads.emplace_back(produce, std::ref(recorder), p, startNs, paced ? 1.0E9 / ProducerRates[p] : 0.0, durationNs, std::ref(results[p]));
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+	if (values.empty())
+	{
+		return 0.0;
+	}
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, (size_t)(p * (double)values.size()))];
+}
+
+int main(int argc, char* argv[])
+{
+	double pacedMs = 1000.0;
+	std::string directory = ".";
+	if (argc > 1)
+	{
+		pacedMs = std::max(10.0, std::atof(argv[1]));
+	}
+	if (argc > 2)
+	{
+		directory = argv[2];
+	}
+	const std::string path = directory + "/bench_recorder.vrmccap";
+
+	bool ok = true;
+	core::CaptureRecorder recorder;
+	std::vector<ProducerResult> results;
+	uint64_t outOfTimeOrder = 0;
+
+	// Paced like pose updates: nothing may be dropped
+	if (!recorder.start(path.c_str(), benchChannels(), 1234567, 1000000) || recorder.getRecordDoubles() != RecordDoubles)
+	{
+		printf("FAILED: could not start a capture in %s\n", path.c_str());
+		return 1;
+	}
+	runProducers(recorder, true, pacedMs * 1.0E6, results);
+	recorder.stop();
+	uint64_t paced = 0;
+	std::vector<double> pacedNs;
+	for (const ProducerResult& result : results)
+	{
+		paced += result.Recorded;
+		pacedNs.insert(pacedNs.end(), result.CallNs.begin(), result.CallNs.end());
+		if (result.Refused != 0)
+		{
+			printf("FAILED: %llu paced records were dropped\n", (unsigned long long)result.Refused);
+			ok = false;
+		}
+	}
+	ok = checkCapture(path, paced, true, outOfTimeOrder) && ok;
+	printf("paced: %llu records of %d threads, %llu out of time order across threads\n", (unsigned long long)paced, Producers, (unsigned long long)outOfTimeOrder);
+
+	double record[RecordDoubles];
+	makeRecord(record, 0.0, 0, 0);
+	if (recorder.record(record))
+	{
+		printf("FAILED: a record was taken after stop\n");
+		ok = false;
+	}
+
+	// As fast as possible on the same recorder: new rings, drops allowed but counted
+	if (!recorder.start(path.c_str(), benchChannels(), 1234567, 100000000))
+	{
+		printf("FAILED: could not start a second capture\n");
+		return 1;
+	}
+	runProducers(recorder, false, 200.0E6, results);
+	uint64_t dropped = recorder.getDropped();
+	recorder.stop();
+	uint64_t flooded = 0;
+	uint64_t refused = 0;
+	std::vector<double> floodNs;
+	for (const ProducerResult& result : results)
+	{
+		flooded += result.Recorded;
+		refused += result.Refused;
+		floodNs.insert(floodNs.end(), result.CallNs.begin(), result.CallNs.end());
+	}
+	if (refused != dropped)
+	{
+		printf("FAILED: %llu records were refused but %llu counted as dropped\n", (unsigned long long)refused, (unsigned long long)dropped);
+		ok = false;
+	}
+	ok = checkCapture(path, flooded, false, outOfTimeOrder) && ok;
+	printf("flooded: %llu records, %llu dropped on full rings\n", (unsigned long long)flooded, (unsigned long long)dropped);
+
+	// A capture that fills up stops taking records
+	const uint64_t maxRecords = 5000;
+	recorder.start(path.c_str(), benchChannels(), 1234567, maxRecords);
+	runProducers(recorder, false, 100.0E6, results);
+	bool stillRunning = recorder.isRunning();
+	recorder.stop();
+	if (stillRunning)
+	{
+		printf("FAILED: a full capture is still running\n");
+		ok = false;
+	}
+	ok = checkCapture(path, maxRecords, false, outOfTimeOrder) && ok;
+
+	// The old logger: every record under one mutex, into a shared buffer
+	std::recursive_mutex mutex;
+	std::vector<double> buffer(RecordDoubles * 1000000);
+	std::atomic<size_t> used = { 0 };
+	std::vector<std::vector<double>> mutexNs(Producers);
+	{
+		std::vector<std::thread> threads;
+		double startNs = bench::nowNs();
+		for (int p = 0; p < Producers; p++)
+		{
+			threads.emplace_back([&, p]()
+			{
+				double values[RecordDoubles];
+				uint64_t counter = 0;
+				while (bench::nowNs() - startNs < 200.0E6)
+				{
+					makeRecord(values, 0.0, p, counter++);
+					double before = bench::nowNs();
+					{
+						std::lock_guard<std::recursive_mutex> lock(mutex);
+						size_t index = used.load(std::memory_order_relaxed) % 1000000;
+						std::memcpy(&buffer[index * RecordDoubles], values, sizeof(values));
+						used.store(index + 1, std::memory_order_relaxed);
+					}
+					mutexNs[p].push_back(bench::nowNs() - before);
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+	}
+	std::vector<double> oldNs;
+	for (const std::vector<double>& ns : mutexNs)
+	{
+		oldNs.insert(oldNs.end(), ns.begin(), ns.end());
+	}
+	bench::doNotOptimize(buffer);
+
+	printf("\n%-44s %10s %10s %10s\n", "ns per record", "p50", "p99", "p99.9");
+	printf("%-44s %10.1f %10.1f %10.1f\n", "rings, paced", percentile(pacedNs, 0.5), percentile(pacedNs, 0.99), percentile(pacedNs, 0.999));
+	printf("%-44s %10.1f %10.1f %10.1f\n", "rings, flooded", percentile(floodNs, 0.5), percentile(floodNs, 0.99), percentile(floodNs, 0.999));
+	printf("%-44s %10.1f %10.1f %10.1f\n", "mutex and shared buffer (old), flooded", percentile(oldNs, 0.5), percentile(oldNs, 0.99), percentile(oldNs, 0.999));
+
+	if (percentile(pacedNs, 0.5) > RecordBudgetNs)
+	{
+		printf("%s: a record takes %.1f ns, more than %.0f ns\n", bench::timingFailed(), percentile(pacedNs, 0.5), RecordBudgetNs);
+		ok = !bench::timingChecked() && ok;
+	}
+
+	std::remove(path.c_str());
+	return ok ? 0 : 1;
+}
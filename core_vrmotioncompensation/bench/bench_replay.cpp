@@ -0,0 +1,255 @@
+#include "BenchUtil.h"
+#include "PoseReplay.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+using namespace vrmotioncompensation;
+
+// Checks the offline replay on a synthetic session: a reference tracker at 250 Hz and an HMD at 1 kHz on a rig that rests
+// for two seconds and then moves, with some HMD poses out of range. The replay output is compared with the output of the
+// core driven directly the way the driver does it, with a second replay, and with the replay of the session written to csv
+// and read back.
+// Then an hour long session (or the given number of seconds) is replayed at full speed.
+// Exits with 1 if any of the outputs differ, a pose that is out of range is changed, no zero pose is calibrated,
+// or the replay runs less than 100 times faster than real time.
+// Usage: bench_vrmotioncompensation_replay [seconds]
+
+static const double RefRate = 250.0;
+static const double HmdRate = 1000.0;
+static const uint32_t RefDevice = 3;
+static const uint32_t HmdDevice = 0;
+static const long long StartUs = 1600000000000000LL;
+static const double MinSpeedFactor = 100.0;
+
+// The rig rests this long at the start of a session, for the zero pose calibration
+static const double RestSeconds = 2.0;
+
+// Samples of the session from second `from` up to `to`, in the order they arrive at the driver
+static void session(bench::SyntheticRig& rig, double from, double to, std::vector<core::ReplaySample>& samples)
+{
+	samples.clear();
+	long long hmd = (long long)std::ceil(from * HmdRate);
+	long long ref = (long long)std::ceil(from * RefRate);
+	for (;;)
+	{
+		double hmdTime = (double)hmd / HmdRate;
+		double refTime = (double)ref / RefRate;
+		double t = std::min(hmdTime, refTime);
+		if (t >= to)
+		{
+			break;
+		}
+
+		core::ReplaySample sample;
+		sample.TimestampUs = StartUs + (long long)std::llround(t * 1.0E6);
+		if (refTime <= hmdTime)
+		{
+			sample.DeviceId = RefDevice;
+			sample.Role = core::ReplayRole::Reference;
+			sample.Pose = rig.refPose(std::max(t - RestSeconds, 0.0));
+			ref++;
+		}
+		else
+		{
+			sample.DeviceId = HmdDevice;
+			sample.Role = core::ReplayRole::Compensated;
+			sample.Pose = rig.hmdPose(std::max(t - RestSeconds, 0.0));
+			if (hmd % 500 == 7)
+			{
+				sample.Pose.result = vr::TrackingResult_Running_OutOfRange;
+			}
+			hmd++;
+		}
+		samples.push_back(sample);
+	}
+}
+
+static void configure(core::MotionCompensationCore& mc)
+{
+	mc.setFilterType(MotionCompensationFilterType::Kalman);
+	mc.setKalmanPrediction(5000);
+}
+
+// Output as csv text, the numbers are written exactly, so equal text means equal poses
+static std::string csvText(const std::vector<core::ReplaySample>& samples)
+{
+	std::FILE* file = std::tmpfile();
+	for (const core::ReplaySample& sample : samples)
+	{
+		core::PoseReplay::writeCsv(file, sample);
+	}
+	std::string text((size_t)std::ftell(file), '\0');
+	std::rewind(file);
+	size_t read = std::fread(&text[0], 1, text.size(), file);
+	text.resize(read);
+	std::fclose(file);
+	return text;
+}
+
+int main(int argc, char* argv[])
+{
+	double seconds = 3600.0;
+	if (argc > 1)
+	{
+		seconds = std::max(1.0, std::atof(argv[1]));
+	}
+
+	bool ok = true;
+	const MotionCompensationDeviceOffset offset = { { 0.0, 0.05, -0.08 }, { 1, 0, 0, 0 } };
+
+	bench::SyntheticRig rig;
+	std::vector<core::ReplaySample> samples;
+	session(rig, 0.0, 60.0, samples);
+
+	// Replay
+	core::PoseReplay replay;
+	configure(replay.getCore());
+	replay.setReferenceTrackers(samples);
+	replay.setDeviceOffset(HmdDevice, offset);
+	std::vector<core::ReplaySample> replayed;
+	replay.run(samples, replayed);
+
+	// The same samples through the core, the way DeviceManipulationHandle::handlePoseUpdate and the
+	// MotionCompensationManager hand them on, with the sample timestamps as time
+	std::vector<core::ReplaySample> direct;
+	{
+		core::MotionCompensationCore mc;
+		core::ReferenceTrackers trackers(mc);
+		mc.setEnabled(true);
+		configure(mc);
+		trackers.setTracker((int)RefDevice);
+		for (const core::ReplaySample& sample : samples)
+		{
+			if (sample.Role == core::ReplayRole::Reference)
+			{
+				ZeroPoseCalibrationStatus status;
+				trackers.update(sample.DeviceId, sample.Pose, sample.TimestampUs, status);
+				continue;
+			}
+
+			core::ReplaySample out = sample;
+			if (out.Pose.poseIsValid && out.Pose.result == vr::TrackingResult_Running_OK)
+			{
+				mc.applyMotionCompensation(out.Pose, out.TimestampUs, offset, out.DeviceId);
+			}
+			direct.push_back(out);
+		}
+	}
+
+	std::string replayedText = csvText(replayed);
+	if (replayedText != csvText(direct))
+	{
+		printf("FAILED: the replay differs from the core driven directly\n");
+		ok = false;
+	}
+
+	// A second replay
+	{
+		core::PoseReplay again;
+		configure(again.getCore());
+		again.setReferenceTrackers(samples);
+		again.setDeviceOffset(HmdDevice, offset);
+		std::vector<core::ReplaySample> output;
+		again.run(samples, output);
+		if (csvText(output) != replayedText)
+		{
+			printf("FAILED: two replays of the same samples differ\n");
+			ok = false;
+		}
+	}
+
+	// The replay of the session written to csv and read back
+	{
+		std::FILE* file = std::tmpfile();
+		core::PoseReplay::writeCsvHeader(file);
+		for (const core::ReplaySample& sample : samples)
+		{
+			core::PoseReplay::writeCsv(file, sample);
+		}
+		std::rewind(file);
+		std::vector<core::ReplaySample> read;
+		size_t errorLine = 0;
+		bool parsed = core::PoseReplay::readCsv(file, read, errorLine);
+		std::fclose(file);
+
+		core::PoseReplay fromCsv;
+		configure(fromCsv.getCore());
+		fromCsv.setReferenceTrackers(read);
+		fromCsv.setDeviceOffset(HmdDevice, offset);
+		std::vector<core::ReplaySample> output;
+		fromCsv.run(read, output);
+		if (!parsed || read.size() != samples.size() || csvText(output) != replayedText)
+		{
+			printf("FAILED: the replay of the csv differs (read %zu of %zu samples, error in line %zu)\n", read.size(), samples.size(), errorLine);
+			ok = false;
+		}
+	}
+
+	// Poses out of range go on unchanged, the others are compensated once the zero pose is set
+	size_t unchanged = 0;
+	size_t compensated = 0;
+	size_t outOfRange = 0;
+	for (size_t i = 0, j = 0; i < samples.size(); i++)
+	{
+		if (samples[i].Role != core::ReplayRole::Compensated)
+		{
+			continue;
+		}
+		const core::ReplaySample& out = replayed[j++];
+		bool same = out.Pose.vecPosition[0] == samples[i].Pose.vecPosition[0] && out.Pose.vecPosition[1] == samples[i].Pose.vecPosition[1]
+			&& out.Pose.vecPosition[2] == samples[i].Pose.vecPosition[2];
+		if (samples[i].Pose.result != vr::TrackingResult_Running_OK)
+		{
+			outOfRange++;
+			unchanged += same ? 1 : 0;
+		}
+		else
+		{
+			compensated += same ? 0 : 1;
+		}
+	}
+	printf("60 s session: %zu samples, %zu compensated, %zu of %zu out of range unchanged, zero pose after %u calibration windows\n\n",
+		samples.size(), compensated, unchanged, outOfRange, replay.getCalibrationWindows());
+	if (unchanged != outOfRange || compensated == 0 || !replay.getCore().isZeroPoseValid())
+	{
+		printf("FAILED: poses out of range were changed, or nothing was compensated\n");
+		ok = false;
+	}
+
+	// Full speed, generated second by second so a long session does not have to fit into memory
+	{
+		core::PoseReplay speed;
+		configure(speed.getCore());
+		speed.getReferenceTrackers().setTracker((int)RefDevice);
+		speed.setDeviceOffset(HmdDevice, offset);
+
+		bench::SyntheticRig speedRig;
+		std::vector<core::ReplaySample> output;
+		output.reserve((size_t)(HmdRate * 2));
+		double totalNs = 0.0;
+		size_t count = 0;
+		for (double t = 0.0; t < seconds; t += 1.0)
+		{
+			session(speedRig, t, std::min(t + 1.0, seconds), samples);
+			output.clear();
+			double start = bench::nowNs();
+			speed.run(samples, output);
+			totalNs += bench::nowNs() - start;
+			count += samples.size();
+		}
+
+		double factor = seconds / (totalNs / 1.0E9);
+		bench::printHeader();
+		bench::printResult("replay, Kalman filter, with offset", totalNs, count);
+		printf("\n%.0f s session replayed in %.2f s, %.0f times real time\n", seconds, totalNs / 1.0E9, factor);
+		if (factor < MinSpeedFactor)
+		{
+			printf("%s: the replay is slower than %.0f times real time\n", bench::timingFailed(), MinSpeedFactor);
+			ok = !bench::timingChecked() && ok;
+		}
+	}
+
+	return ok ? 0 : 1;
+}
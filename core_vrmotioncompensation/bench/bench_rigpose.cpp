@@ -0,0 +1,355 @@
+#include "BenchUtil.h"
+#include "MotionCompensationCore.h"
+#include "RigPoseChannel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+using namespace vrmotioncompensation;
+
+// Checks the shared memory rig pose block and the rig pose input mode.
+// A writer thread updates the block as fast as it can while the reader copies it. Every field of a written pose
+// is derived from the same counter, so the reader can tell a torn copy. Copies without the sequence check are
+// counted next to it. Then a sine and a step rig motion are played through the block into the core with the
+// filter bypassed, and the compensated HMD is compared with the HMD pose on the rig, next to a reference tracker
+// sampling the same motion through the default filter.
+// Exits with 1 if a torn pose was accepted, no pose got through, or the rig pose compensation is not exact.
+// Usage: bench_vrmotioncompensation_rigpose [milliseconds]
+
+static const double PI = 3.14159265358979323846;
+static const long long RigPeriodUs = 1000;
+static const double TrackerRate = 369.0;
+static const int CostRounds = 7;
+
+static RigPose_v1 makePose(uint64_t n)
+{
+	RigPose_v1 pose = {};
+	double d = (double)n;
+	pose.TimestampUs = (int64_t)n;
+	pose.Flags = RigPoseFlag_Valid | RigPoseFlag_Derivatives;
+	pose.Position = { d, d + 1, d + 2 };
+	pose.Rotation = { d * 2, d * 2, d * 2, d * 2 };
+	pose.Velocity = { d * 3, d * 3, d * 3 };
+	pose.AngularVelocity = { d * 4, d * 4, d * 4 };
+	return pose;
+}
+
+static bool isConsistent(const RigPose_v1& pose)
+{
+	RigPose_v1 expected = makePose((uint64_t)pose.TimestampUs);
+	return std::memcmp(&pose, &expected, sizeof(expected)) == 0;
+}
+
+struct ContentionResult
+{
+	uint64_t Writes = 0;
+	uint64_t Reads = 0;
+	uint64_t Retries = 0;
+	uint64_t Accepted = 0;
+	uint64_t AcceptedTorn = 0;
+	uint64_t UncheckedTorn = 0;
+};
+
+static ContentionResult contention(MMFstruct_OVRMC_RigPose_v1& block, int milliseconds)
+{
+	ContentionResult result;
+	core::RigPoseWriter::init(block);
+
+	std::atomic<bool> stop = { false };
+	std::atomic<uint64_t> writes = { 0 };
+	std::thread writer([&]() {
+		uint64_t n = 1;
+		while (!stop.load(std::memory_order_relaxed))
+		{
+			core::RigPoseWriter::write(block, makePose(n++));
+		}
+		writes = n - 1;
+	});
+
+	double end = bench::nowNs() + (double)milliseconds * 1.0E6;
+	core::RigPoseReader reader;
+	while (bench::nowNs() < end)
+	{
+		for (int i = 0; i < 1000; i++)
+		{
+			RigPose_v1 pose;
+			uint32_t sequence;
+			result.Reads++;
+			if (core::RigPoseReader::tryRead(block, pose, sequence))
+			{
+				result.Accepted++;
+				result.AcceptedTorn += (pose.TimestampUs != 0 && !isConsistent(pose)) ? 1 : 0;
+			}
+			else
+			{
+				result.Retries++;
+			}
+
+			// The same copy without the sequence check
+			std::memcpy(&pose, &block.Pose, sizeof(pose));
+			result.UncheckedTorn += (pose.TimestampUs != 0 && !isConsistent(pose)) ? 1 : 0;
+
+			// And through the poll of the driver
+			vr::DriverPose_t driverPose;
+			reader.poll(block, 0, driverPose);
+		}
+	}
+
+	stop = true;
+	writer.join();
+	result.Writes = writes;
+	return result;
+}
+
+// Rig motion in tracking space
+typedef void (*RigMotionFn)(double t, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot);
+
+static void sineMotion(double t, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot)
+{
+	pos = { 0.05 * std::sin(2.0 * PI * 0.7 * t), 1.0 + 0.08 * std::sin(2.0 * PI * 1.3 * t), 0.04 * std::sin(2.0 * PI * 0.4 * t + 1.0) };
+	rot = vrmath::quaternionFromYawPitchRoll(0.10 * std::sin(2.0 * PI * 0.2 * t), 0.15 * std::sin(2.0 * PI * 0.9 * t), 0.12 * std::sin(2.0 * PI * 0.6 * t));
+}
+
+// Heave and yaw steps every half second
+static void stepMotion(double t, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot)
+{
+	double level = ((long long)(t * 2.0) & 1) ? 1.0 : -1.0;
+	pos = { 0.0, 1.0 + 0.03 * level, 0.0 };
+	rot = vrmath::quaternionFromYawPitchRoll(0.087 * level, 0.0, 0.0);
+}
+
+// The HMD sits on the rig and moves on its own, in the driver space of the synthetic rig
+static vr::DriverPose_t hmdOnRig(bench::SyntheticRig& rig, RigMotionFn motion, double t, vr::HmdVector3d_t& localPos, vr::HmdQuaternion_t& localRot)
+{
+	vr::HmdVector3d_t rigPos;
+	vr::HmdQuaternion_t rigRot;
+	motion(t, rigPos, rigRot);
+	localPos = { 0.1 * std::sin(t), 0.6, -0.3 + 0.05 * std::cos(1.7 * t) };
+	localRot = vrmath::quaternionFromRotationY(0.4 * std::sin(0.5 * t));
+
+	vr::HmdVector3d_t worldPos = vrmath::quaternionRotateVector(rigRot, localPos) + rigPos;
+	vr::HmdQuaternion_t worldRot = rigRot * localRot;
+
+	vr::DriverPose_t pose = rig.basePose();
+	vr::HmdQuaternion_t driverFromWorld = vrmath::quaternionConjugate(pose.qWorldFromDriverRotation);
+	vr::HmdVector3d_t driverPos = vrmath::quaternionRotateVector(driverFromWorld, worldPos - vr::HmdVector3d_t{ pose.vecWorldFromDriverTranslation[0], pose.vecWorldFromDriverTranslation[1], pose.vecWorldFromDriverTranslation[2] });
+	for (int axis = 0; axis < 3; axis++)
+	{
+		pose.vecPosition[axis] = driverPos.v[axis];
+	}
+	pose.qRotation = driverFromWorld * worldRot;
+	return pose;
+}
+
+// A reference tracker on the rig, reporting in the same driver space with sensor noise
+static vr::DriverPose_t trackerOnRig(bench::SyntheticRig& rig, RigMotionFn motion, double t, std::mt19937& rng)
+{
+	std::normal_distribution<double> noise(0.0, 0.0005);
+	vr::HmdVector3d_t rigPos;
+	vr::HmdQuaternion_t rigRot;
+	motion(t, rigPos, rigRot);
+
+	vr::DriverPose_t pose = rig.basePose();
+	vr::HmdQuaternion_t driverFromWorld = vrmath::quaternionConjugate(pose.qWorldFromDriverRotation);
+	vr::HmdVector3d_t driverPos = vrmath::quaternionRotateVector(driverFromWorld, rigPos - vr::HmdVector3d_t{ pose.vecWorldFromDriverTranslation[0], pose.vecWorldFromDriverTranslation[1], pose.vecWorldFromDriverTranslation[2] });
+	for (int axis = 0; axis < 3; axis++)
+	{
+		pose.vecPosition[axis] = driverPos.v[axis] + noise(rng);
+	}
+	pose.qRotation = driverFromWorld * rigRot;
+	return pose;
+}
+
+// Distance between the compensated HMD and where it would be on a rig that stayed at its zero pose
+static double compensationError(const vr::DriverPose_t& compensated, RigMotionFn motion, double zeroT, const vr::HmdVector3d_t& localPos)
+{
+	vr::HmdVector3d_t zeroPos;
+	vr::HmdQuaternion_t zeroRot;
+	motion(zeroT, zeroPos, zeroRot);
+	vr::HmdVector3d_t expected = vrmath::quaternionRotateVector(zeroRot, localPos) + zeroPos;
+
+	vr::HmdVector3d_t actual = vrmath::quaternionRotateVector(compensated.qWorldFromDriverRotation, vr::HmdVector3d_t{ compensated.vecPosition[0], compensated.vecPosition[1], compensated.vecPosition[2] })
+		+ vr::HmdVector3d_t{ compensated.vecWorldFromDriverTranslation[0], compensated.vecWorldFromDriverTranslation[1], compensated.vecWorldFromDriverTranslation[2] };
+	vr::HmdVector3d_t diff = actual - expected;
+	return std::sqrt(diff.v[0] * diff.v[0] + diff.v[1] * diff.v[1] + diff.v[2] * diff.v[2]);
+}
+
+struct CompensationResult
+{
+	double RigPoseMax = 0.0;
+	double RigPoseRms = 0.0;
+	double TrackerMax = 0.0;
+	double TrackerRms = 0.0;
+};
+
+// Plays the motion through the rig pose block into one core and through a reference tracker into another.
+// The HMD is compensated right after every rig pose, on a virtual clock
+static CompensationResult compensation(MMFstruct_OVRMC_RigPose_v1& block, RigMotionFn motion, double seconds)
+{
+	CompensationResult result;
+	bench::SyntheticRig rig;
+	std::mt19937 rng(7);
+
+	core::MotionCompensationCore rigCore;
+	rigCore.setFilterBypass(true);
+	rigCore.setEnabled(true);
+	core::RigPoseReader reader;
+	core::RigPoseWriter::init(block);
+
+	core::MotionCompensationCore trackerCore;
+	trackerCore.setAlpha(12);
+	trackerCore.setLpfBeta(0.85);
+	trackerCore.setEnabled(true);
+
+	const long long startUs = 1000000;
+	long long nextTrackerUs = startUs;
+	double rigSum = 0.0, trackerSum = 0.0;
+	size_t count = 0;
+
+	for (long long timestampUs = startUs; timestampUs < startUs + (long long)(seconds * 1.0E6); timestampUs += RigPeriodUs)
+	{
+		double t = (double)(timestampUs - startUs) / 1.0E6;
+
+		// Rig software side
+		RigPose_v1 rigPose = {};
+		rigPose.TimestampUs = timestampUs;
+		rigPose.Flags = RigPoseFlag_Valid;
+		motion(t, rigPose.Position, rigPose.Rotation);
+		core::RigPoseWriter::write(block, rigPose);
+
+		// Driver side, as MotionCompensationManager::pollRigPose
+		vr::DriverPose_t refPose;
+		if (reader.poll(block, timestampUs, refPose) == core::RigPoseReader::Result::NewPose)
+		{
+			if (!rigCore.isZeroPoseValid())
+			{
+				rigCore.setZeroPose(refPose);
+			}
+			else
+			{
+				rigCore.updateRefPose(refPose, timestampUs);
+			}
+		}
+
+		if (timestampUs >= nextTrackerUs)
+		{
+			vr::DriverPose_t trackerPose = trackerOnRig(rig, motion, t, rng);
+			if (!trackerCore.isZeroPoseValid())
+			{
+				trackerCore.setZeroPose(trackerPose);
+			}
+			else
+			{
+				trackerCore.updateRefPose(trackerPose, timestampUs);
+			}
+			nextTrackerUs += (long long)(1.0E6 / TrackerRate);
+		}
+
+		vr::HmdVector3d_t localPos;
+		vr::HmdQuaternion_t localRot;
+		vr::DriverPose_t hmd = hmdOnRig(rig, motion, t, localPos, localRot);
+		vr::DriverPose_t hmdRig = hmd;
+		vr::DriverPose_t hmdTracker = hmd;
+		rigCore.applyMotionCompensation(hmdRig, timestampUs);
+		trackerCore.applyMotionCompensation(hmdTracker, timestampUs);
+
+		// Both references are valid after their first 100 updates, compare from then on
+		if (t < 1.0)
+		{
+			continue;
+		}
+		double rigError = compensationError(hmdRig, motion, 0.0, localPos);
+		double trackerError = compensationError(hmdTracker, motion, 0.0, localPos);
+		result.RigPoseMax = std::max(result.RigPoseMax, rigError);
+		result.TrackerMax = std::max(result.TrackerMax, trackerError);
+		rigSum += rigError * rigError;
+		trackerSum += trackerError * trackerError;
+		count++;
+	}
+
+	result.RigPoseRms = std::sqrt(rigSum / (double)count);
+	result.TrackerRms = std::sqrt(trackerSum / (double)count);
+	return result;
+}
+
+static double costPoll(MMFstruct_OVRMC_RigPose_v1& block, size_t count, bool newPose)
+{
+	core::RigPoseWriter::init(block);
+	core::RigPoseReader reader;
+	vr::DriverPose_t pose;
+	double checksum = 0.0;
+	double best = 1.0E300;
+	for (int round = 0; round < CostRounds; round++)
+	{
+		double start = bench::nowNs();
+		for (size_t i = 0; i < count; i++)
+		{
+			if (newPose)
+			{
+				core::RigPoseWriter::write(block, makePose(i + 1));
+			}
+			checksum += (double)reader.poll(block, 0, pose) + pose.vecPosition[0];
+		}
+		best = std::min(best, bench::nowNs() - start);
+	}
+	bench::doNotOptimize(checksum);
+	return best;
+}
+
+int main(int argc, char* argv[])
+{
+	int milliseconds = 1000;
+	if (argc > 1)
+	{
+		milliseconds = std::max(10, std::atoi(argv[1]));
+	}
+
+	// Stands in for the OVRMC_MMFv1 mapping
+	static MMFstruct_OVRMC_RigPose_v1 block;
+	bool ok = true;
+
+	// ----------------------------------------------------------------------------------------------- //
+	// Torn reads
+	ContentionResult contended = contention(block, milliseconds);
+	printf("%llu poses written, %llu reads: %llu accepted, %llu retried, %llu torn accepted\n",
+		(unsigned long long)contended.Writes, (unsigned long long)contended.Reads, (unsigned long long)contended.Accepted,
+		(unsigned long long)contended.Retries, (unsigned long long)contended.AcceptedTorn);
+	printf("without the sequence check: %llu torn copies\n\n", (unsigned long long)contended.UncheckedTorn);
+	if (contended.AcceptedTorn != 0 || contended.Accepted == 0)
+	{
+		printf("FAILED: torn rig pose accepted or no pose read\n");
+		ok = false;
+	}
+
+	// ----------------------------------------------------------------------------------------------- //
+	// Compensation
+	const double seconds = 10.0;
+	const struct
+	{
+		const char* Name;
+		RigMotionFn Motion;
+	} motions[] = { { "sine", sineMotion }, { "step", stepMotion } };
+
+	printf("%-8s %-28s %14s %14s\n", "motion", "reference", "max error mm", "rms error mm");
+	for (const auto& motion : motions)
+	{
+		CompensationResult r = compensation(block, motion.Motion, seconds);
+		bool exact = r.RigPoseMax < 1.0E-6;
+		printf("%-8s %-28s %14.6f %14.6f%s\n", motion.Name, "rig pose, shared memory", r.RigPoseMax * 1000.0, r.RigPoseRms * 1000.0, exact ? "" : "  FAILED");
+		printf("%-8s %-28s %14.6f %14.6f\n", "", "tracker, DEMA 12 / LPF 0.85", r.TrackerMax * 1000.0, r.TrackerRms * 1000.0);
+		ok = ok && exact;
+	}
+	printf("\n");
+
+	// ----------------------------------------------------------------------------------------------- //
+	// Cost per poll on the HMD path
+	const size_t count = 1000000;
+	bench::printHeader();
+	bench::printResult("rig pose poll: unchanged", costPoll(block, count, false), count);
+	bench::printResult("rig pose poll: write + new pose", costPoll(block, count, true), count);
+
+	return ok ? 0 : 1;
+}
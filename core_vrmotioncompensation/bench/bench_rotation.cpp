@@ -0,0 +1,205 @@
+#include "BenchUtil.h"
+#include "MotionCompensationCore.h"
+
+#include <cstdlib>
+
+using namespace vrmotioncompensation;
+
+// Compares the matrix based HMD compensation against the previous quaternion sandwich implementation.
+// Checks that both give the same poses and measures both paths.
+// Exits with 1 if the results differ by more than the tolerance.
+// Usage: bench_vrmotioncompensation_rotation [pose count]
+
+static const double RefRate = 369.0;
+static const double HmdRate = 1120.0;
+static const double Tolerance = 1.0E-12;
+
+// The compensation as it was done before the rotation matrices were cached
+static void applyQuaternionPath(const core::ReferenceSnapshot& ref, vr::DriverPose_t& pose)
+{
+	if (!(ref.Enabled && ref.ZeroPoseValid && ref.RefPoseValid))
+	{
+		return;
+	}
+
+	vr::HmdQuaternion_t tmpConj = vrmath::quaternionConjugate(pose.qWorldFromDriverRotation);
+	vr::HmdVector3d_t poseWorldPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecPosition, false) + pose.vecWorldFromDriverTranslation;
+
+	vr::HmdQuaternion_t poseWorldRot = pose.qWorldFromDriverRotation * pose.qRotation;
+	vr::HmdVector3d_t compensatedPoseWorldPos = ref.ZeroPos + vrmath::quaternionRotateVector(ref.RefRot, ref.RefRotInv, poseWorldPos - ref.RefPos, true);
+	vr::HmdQuaternion_t compensatedPoseWorldRot = ref.RefRotInv * poseWorldRot;
+
+	if (ref.SetZeroMode)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			pose.vecVelocity[i] = pose.vecAcceleration[i] = pose.vecAngularVelocity[i] = pose.vecAngularAcceleration[i] = 0.0;
+		}
+	}
+	else
+	{
+		vr::HmdVector3d_t tmpPosVel = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, ref.RefVel, true);
+		vr::HmdVector3d_t tmpRotVel = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, ref.RefRotVel, true);
+		vr::HmdVector3d_t tmpPosAcc = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, ref.RefAcc, true);
+		vr::HmdVector3d_t tmpRotAcc = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, ref.RefRotAcc, true);
+		for (int i = 0; i < 3; i++)
+		{
+			pose.vecVelocity[i] -= tmpPosVel.v[i];
+			pose.vecAngularVelocity[i] -= tmpRotVel.v[i];
+			pose.vecAcceleration[i] -= tmpPosAcc.v[i];
+			pose.vecAngularAcceleration[i] -= tmpRotAcc.v[i];
+		}
+	}
+
+	pose.qRotation = tmpConj * compensatedPoseWorldRot;
+	vr::HmdVector3d_t adjPoseDriverPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, compensatedPoseWorldPos - pose.vecWorldFromDriverTranslation, true);
+	pose.vecPosition[0] = adjPoseDriverPos.v[0];
+	pose.vecPosition[1] = adjPoseDriverPos.v[1];
+	pose.vecPosition[2] = adjPoseDriverPos.v[2];
+}
+
+static double maxDifference(const vr::DriverPose_t& a, const vr::DriverPose_t& b)
+{
+	double diff = 0.0;
+	auto check = [&diff](double x, double y) {
+		diff = std::max(diff, std::fabs(x - y));
+	};
+
+	for (int i = 0; i < 3; i++)
+	{
+		check(a.vecPosition[i], b.vecPosition[i]);
+		check(a.vecVelocity[i], b.vecVelocity[i]);
+		check(a.vecAcceleration[i], b.vecAcceleration[i]);
+		check(a.vecAngularVelocity[i], b.vecAngularVelocity[i]);
+		check(a.vecAngularAcceleration[i], b.vecAngularAcceleration[i]);
+	}
+	check(a.qRotation.w, b.qRotation.w);
+	check(a.qRotation.x, b.qRotation.x);
+	check(a.qRotation.y, b.qRotation.y);
+	check(a.qRotation.z, b.qRotation.z);
+	return diff;
+}
+
+// Feeds reference and HMD poses at their native rates and compares both paths on every HMD pose
+static double checkEquivalence(bool setZero, bool sameDriverSpace, size_t count)
+{
+	core::MotionCompensationCore mc;
+	bench::SyntheticRig rig;
+	mc.setLpfBeta(0.2);
+	mc.setAlpha(12);
+	mc.setEnabled(true);
+	mc.setZeroPose(rig.refPose(0.0, false));
+	mc.setZeroMode(setZero);
+
+	double diff = 0.0;
+	size_t refIndex = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		double t = (double)i / HmdRate;
+		while ((double)refIndex / RefRate <= t)
+		{
+			mc.updateRefPose(rig.refPose((double)refIndex / RefRate), (long long)((double)refIndex / RefRate * 1.0E6));
+			refIndex++;
+		}
+
+		vr::DriverPose_t pose = rig.hmdPose(t);
+		if (!sameDriverSpace)
+		{
+			// e.g. an HMD from a different tracking system than the reference tracker
+			pose.qWorldFromDriverRotation = vrmath::quaternionFromYawPitchRoll(1.1, 0.02, -0.01);
+		}
+		vr::DriverPose_t expected = pose;
+
+		applyQuaternionPath(mc.getSnapshot(), expected);
+		mc.applyMotionCompensation(pose);
+
+		diff = std::max(diff, maxDifference(pose, expected));
+	}
+	return diff;
+}
+
+static void primeCore(core::MotionCompensationCore& mc, bench::SyntheticRig& rig)
+{
+	mc.setLpfBeta(0.2);
+	mc.setAlpha(12);
+	mc.setEnabled(true);
+	mc.setZeroPose(rig.refPose(0.0, false));
+	for (int i = 1; i <= 200; i++)
+	{
+		mc.updateRefPose(rig.refPose(i / RefRate), (long long)(i / RefRate * 1.0E6));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = 1000000;
+	if (argc > 1)
+	{
+		count = (size_t)std::strtoull(argv[1], nullptr, 10);
+	}
+
+	bench::SyntheticRig rig;
+	std::vector<vr::DriverPose_t> hmdPoses = rig.hmdStream(4096, HmdRate);
+
+	core::MotionCompensationCore mc;
+	primeCore(mc, rig);
+
+	printf("Pose count: %zu, budget per call: %.0f ns\n\n", count, bench::PoseBudgetNs);
+	bench::printHeader();
+
+	// Both paths load the snapshot once per pose
+	double checksum = 0.0;
+	double start = bench::nowNs();
+	for (size_t i = 0; i < count; i++)
+	{
+		vr::DriverPose_t pose = hmdPoses[i % hmdPoses.size()];
+		applyQuaternionPath(mc.getSnapshot(), pose);
+		checksum += pose.vecPosition[0];
+	}
+	bench::printResult("quaternion sandwich (before)", bench::nowNs() - start, count);
+
+	start = bench::nowNs();
+	for (size_t i = 0; i < count; i++)
+	{
+		vr::DriverPose_t pose = hmdPoses[i % hmdPoses.size()];
+		mc.applyMotionCompensation(pose);
+		checksum += pose.vecPosition[0];
+	}
+	bench::printResult("cached matrices", bench::nowNs() - start, count);
+
+	for (auto& pose : hmdPoses)
+	{
+		pose.qWorldFromDriverRotation = vrmath::quaternionFromYawPitchRoll(1.1, 0.02, -0.01);
+	}
+	start = bench::nowNs();
+	for (size_t i = 0; i < count; i++)
+	{
+		vr::DriverPose_t pose = hmdPoses[i % hmdPoses.size()];
+		mc.applyMotionCompensation(pose);
+		checksum += pose.vecPosition[0];
+	}
+	bench::printResult("matrices (other driver space)", bench::nowNs() - start, count);
+	bench::doNotOptimize(checksum);
+
+	printf("\nEquivalence with the quaternion path (tolerance %.0e):\n", Tolerance);
+	bool failed = false;
+	const struct
+	{
+		const char* Name;
+		bool SetZero;
+		bool SameDriverSpace;
+	} cases[] = {
+		{ "velocity compensation", false, true },
+		{ "setZero mode", true, true },
+		{ "other driver space", false, false },
+	};
+	for (const auto& c : cases)
+	{
+		double diff = checkEquivalence(c.SetZero, c.SameDriverSpace, 20000);
+		bool ok = diff <= Tolerance;
+		failed |= !ok;
+		printf("%-44s max diff %.3e %s\n", c.Name, diff, ok ? "OK" : "FAILED");
+	}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,267 @@
+#include "BenchUtil.h"
+#include "SettingsChannel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+using namespace vrmotioncompensation;
+
+// Checks the shared memory settings block.
+// Settings out of range have to be rejected, fields the writer does not control are not checked. A writer
+// thread ramps the offsets and filter settings as fast as it can while the reader polls the block like the
+// driver does and acknowledges what it took; every field of the published settings is derived from the same
+// counter, so the reader can tell a torn copy, and the writer checks the acknowledgements. Then the cost of a
+// poll without new settings, the check the driver makes on every reference update, is measured.
+// Exits with 1 if settings out of range were accepted or valid ones rejected, a torn copy was taken, settings
+// were taken out of order, the last settings were not acknowledged, or a poll without new settings costs more
+// than 10 ns.
+// Usage: bench_vrmotioncompensation_settings [milliseconds]
+
+static const double PollBudgetNs = 10.0;
+
+static MotionCompensationSettings_v1 makeSettings(uint32_t n)
+{
+	MotionCompensationSettings_v1 settings = {};
+	settings.Fields = SettingsField_All;
+	settings.Samples = n % 100 + 1;
+	settings.LpfBeta = (double)(n % 1000) / 1000.0;
+	settings.SetZero = n & 1;
+	settings.FilterType = (MotionCompensationFilterType)(n % 3);
+	settings.KalmanProcessNoise = 1.0 + n;
+	settings.KalmanObservationNoise = 0.001 * (1.0 + n);
+	settings.KalmanPredictionMs = (double)(n % 50);
+	settings.OneEuroMinCutoff = 0.5 + n;
+	settings.OneEuroBeta = 2.0 * n;
+	settings.OffsetTranslation = { 0.001 * n, 0.002 * n, 0.003 * n };
+	settings.OffsetRotation = { 0.01 * n, 0.0, -0.01 * n };
+	settings.OffsetQRotation = { 1, 0, 0, 0 };
+	return settings;
+}
+
+static bool isConsistent(const MotionCompensationSettings_v1& settings, uint32_t& n)
+{
+	n = (uint32_t)std::lround(settings.KalmanProcessNoise - 1.0);
+	MotionCompensationSettings_v1 expected = makeSettings(n);
+	return std::memcmp(&settings, &expected, sizeof(expected)) == 0;
+}
+
+static bool checkValidation()
+{
+	struct Case
+	{
+		const char* name;
+		void (*change)(MotionCompensationSettings_v1&);
+		SettingsStatus expected;
+	};
+	static double invalid;
+	invalid = std::numeric_limits<double>::quiet_NaN();
+	const Case cases[] = {
+		{ "valid", [](MotionCompensationSettings_v1&) {}, SettingsStatus::Applied },
+		{ "unknown field", [](MotionCompensationSettings_v1& s) { s.Fields |= 1u << 31; }, SettingsStatus::InvalidValue },
+		{ "LpfBeta > 1", [](MotionCompensationSettings_v1& s) { s.LpfBeta = 1.5; }, SettingsStatus::InvalidValue },
+		{ "LpfBeta NaN", [](MotionCompensationSettings_v1& s) { s.LpfBeta = invalid; }, SettingsStatus::InvalidValue },
+		{ "Samples 0", [](MotionCompensationSettings_v1& s) { s.Samples = 0; }, SettingsStatus::InvalidValue },
+		{ "SetZero 2", [](MotionCompensationSettings_v1& s) { s.SetZero = 2; }, SettingsStatus::InvalidValue },
+		{ "filter type 7", [](MotionCompensationSettings_v1& s) { s.FilterType = (MotionCompensationFilterType)7; }, SettingsStatus::InvalidValue },
+		{ "Kalman noise 0", [](MotionCompensationSettings_v1& s) { s.KalmanObservationNoise = 0.0; }, SettingsStatus::InvalidValue },
+		{ "prediction < 0", [](MotionCompensationSettings_v1& s) { s.KalmanPredictionMs = -1.0; }, SettingsStatus::InvalidValue },
+		{ "One Euro beta inf", [](MotionCompensationSettings_v1& s) { s.OneEuroBeta = std::numeric_limits<double>::infinity(); }, SettingsStatus::InvalidValue },
+		{ "offset NaN", [](MotionCompensationSettings_v1& s) { s.OffsetTranslation.v[1] = invalid; }, SettingsStatus::InvalidValue },
+		// Fields the writer does not control are left alone and not checked
+		{ "NaN beta, not controlled", [](MotionCompensationSettings_v1& s) { s.Fields = SettingsField_Offsets; s.LpfBeta = invalid; }, SettingsStatus::Applied },
+		{ "NaN offset, not controlled", [](MotionCompensationSettings_v1& s) { s.Fields = SettingsField_LpfBeta; s.OffsetQRotation.x = invalid; }, SettingsStatus::Applied },
+	};
+
+	bool ok = true;
+	for (const Case& c : cases)
+	{
+		MotionCompensationSettings_v1 settings = makeSettings(17);
+		c.change(settings);
+		if (core::SettingsReader::validate(settings) != c.expected)
+		{
+			printf("FAILED: %s settings are %s\n", c.name, c.expected == SettingsStatus::Applied ? "rejected" : "accepted");
+			ok = false;
+		}
+	}
+	printf("%d validation cases %s\n", (int)(sizeof(cases) / sizeof(cases[0])), ok ? "" : "FAILED");
+	return ok;
+}
+
+static bool checkProtocol()
+{
+	static MMFstruct_OVRMC_Settings_v1 block;
+	core::SettingsReader reader;
+	MotionCompensationSettings_v1 settings;
+	uint32_t sequence = 0;
+
+	bool ok = reader.poll(block, settings, sequence) == core::SettingsReader::Result::Unchanged;
+	block.Sequence = 2;
+	ok = reader.poll(block, settings, sequence) == core::SettingsReader::Result::Invalid && ok;
+
+	core::SettingsWriter::init(block);
+	ok = reader.poll(block, settings, sequence) == core::SettingsReader::Result::Unchanged && !reader.hasNewSettings(block) && ok;
+	uint32_t written = core::SettingsWriter::write(block, makeSettings(5));
+	uint32_t n = 0;
+	ok = reader.hasNewSettings(block) && reader.poll(block, settings, sequence) == core::SettingsReader::Result::NewSettings
+		&& sequence == written && isConsistent(settings, n) && n == 5 && ok;
+	ok = !reader.hasNewSettings(block) && reader.poll(block, settings, sequence) == core::SettingsReader::Result::Unchanged && ok;
+
+	uint32_t applied = 0;
+	SettingsStatus status = SettingsStatus::Applied;
+	ok = core::SettingsWriter::readStatus(block, applied, status) && applied == 0 && status == SettingsStatus::None && ok;
+	core::SettingsReader::acknowledge(block, sequence, SettingsStatus::InvalidValue);
+	ok = core::SettingsWriter::readStatus(block, applied, status) && applied == written && status == SettingsStatus::InvalidValue && ok;
+
+	// A writer that died in the middle of an update leaves an odd sequence, the next write goes on from there
+	block.Sequence |= 1;
+	ok = reader.poll(block, settings, sequence) == core::SettingsReader::Result::Busy && ok;
+	written = core::SettingsWriter::write(block, makeSettings(6));
+	ok = reader.poll(block, settings, sequence) == core::SettingsReader::Result::NewSettings && sequence == written && isConsistent(settings, n) && n == 6 && ok;
+
+	// The sequence wraps around without landing on 0, which the reader starts out with
+	block.Sequence = 0xFFFFFFFE;
+	written = core::SettingsWriter::write(block, makeSettings(7));
+	ok = written != 0 && reader.poll(block, settings, sequence) == core::SettingsReader::Result::NewSettings && sequence == written && ok;
+
+	printf("sequence protocol and acknowledgement %s\n", ok ? "" : "FAILED");
+	return ok;
+}
+
+static bool checkConcurrent(int milliseconds)
+{
+	static MMFstruct_OVRMC_Settings_v1 block;
+	core::SettingsWriter::init(block);
+
+	std::atomic<bool> stop = { false };
+	std::atomic<bool> done = { false };
+	uint32_t writes = 0;
+	uint32_t lastWritten = 0;
+	bool acknowledged = false;
+	std::thread writer([&]() {
+		uint32_t n = 1;
+		while (!stop.load(std::memory_order_relaxed))
+		{
+			lastWritten = core::SettingsWriter::write(block, makeSettings(n));
+			n++;
+		}
+		writes = n - 1;
+
+		// The reader goes on polling until it acknowledged the last settings
+		double end = bench::nowNs() + 1.0E9;
+		uint32_t applied;
+		SettingsStatus status;
+		while (bench::nowNs() < end && !acknowledged)
+		{
+			acknowledged = core::SettingsWriter::readStatus(block, applied, status) && applied == lastWritten && status == SettingsStatus::Applied;
+		}
+		done = true;
+	});
+
+	core::SettingsReader reader;
+	uint64_t polls = 0;
+	uint64_t taken = 0;
+	uint64_t busy = 0;
+	uint64_t torn = 0;
+	uint64_t backwards = 0;
+	uint32_t last = 0;
+	double end = bench::nowNs() + (double)milliseconds * 1.0E6;
+	while (!done.load())
+	{
+		if (bench::nowNs() >= end)
+		{
+			stop = true;
+		}
+
+		MotionCompensationSettings_v1 settings;
+		uint32_t sequence;
+		uint32_t n;
+		polls++;
+		switch (reader.poll(block, settings, sequence))
+		{
+		case core::SettingsReader::Result::NewSettings:
+			taken++;
+			if (!isConsistent(settings, n))
+			{
+				torn++;
+			}
+			else if (n <= last)
+			{
+				backwards++;
+			}
+			last = n;
+			core::SettingsReader::acknowledge(block, sequence, core::SettingsReader::validate(settings));
+			break;
+		case core::SettingsReader::Result::Busy:
+			busy++;
+			break;
+		default:
+			break;
+		}
+	}
+	writer.join();
+
+	bool ok = torn == 0 && backwards == 0 && taken > 0 && acknowledged;
+	printf("%u writes, %llu polls, %llu taken, %llu busy, %llu torn, %llu out of order, last %s %s\n", writes, (unsigned long long)polls,
+		(unsigned long long)taken, (unsigned long long)busy, (unsigned long long)torn, (unsigned long long)backwards,
+		acknowledged ? "acknowledged" : "not acknowledged", ok ? "" : "FAILED");
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	int milliseconds = 300;
+	if (argc > 1)
+	{
+		milliseconds = std::max(10, std::atoi(argv[1]));
+	}
+
+	bool ok = checkValidation();
+	ok = checkProtocol() && ok;
+	ok = checkConcurrent(milliseconds) && ok;
+
+	static MMFstruct_OVRMC_Settings_v1 block;
+	core::SettingsWriter::init(block);
+	core::SettingsWriter::write(block, makeSettings(1));
+	core::SettingsReader reader;
+	MotionCompensationSettings_v1 settings;
+	uint32_t sequence;
+	reader.poll(block, settings, sequence);
+
+	const size_t count = 10000000;
+	double pollNs = 1.0E300;
+	double checkNs = 1.0E300;
+	for (int round = 0; round < 5; round++)
+	{
+		size_t unchanged = 0;
+		double start = bench::nowNs();
+		for (size_t i = 0; i < count; i++)
+		{
+			unchanged += reader.poll(block, settings, sequence) == core::SettingsReader::Result::Unchanged ? 1 : 0;
+		}
+		pollNs = std::min(pollNs, (bench::nowNs() - start) / (double)count);
+		bench::doNotOptimize(unchanged);
+
+		start = bench::nowNs();
+		for (size_t i = 0; i < count; i++)
+		{
+			unchanged += reader.hasNewSettings(block) ? 0 : 1;
+		}
+		checkNs = std::min(checkNs, (bench::nowNs() - start) / (double)count);
+		bench::doNotOptimize(unchanged);
+	}
+
+	printf("\n%-44s %10s\n", "ns", "best");
+	printf("%-44s %10.2f\n", "poll, unchanged", pollNs);
+	printf("%-44s %10.2f\n", "hasNewSettings, unchanged", checkNs);
+	if (pollNs > PollBudgetNs || checkNs > PollBudgetNs)
+	{
+		printf("%s: a poll without new settings takes more than %.0f ns\n", bench::timingFailed(), PollBudgetNs);
+		ok = !bench::timingChecked() && ok;
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+#include "BenchUtil.h"
+#include "MotionCompensationCore.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+using namespace vrmotioncompensation;
+
+// Contention check for the reference state snapshot.
+// A writer thread publishes snapshots as fast as it can while reader threads copy them.
+// Every field of a published snapshot is derived from the same counter, so a reader can tell
+// when it got fields from two different updates (a torn read). Exits with 1 if any torn read was seen.
+// Usage: bench_vrmotioncompensation_snapshot [milliseconds] [reader threads]
+
+static core::ReferenceSnapshot makeSnapshot(uint32_t n)
+{
+	core::ReferenceSnapshot s = {};
+	double d = (double)n;
+	s.ZeroPos = { d, d + 1, d + 2 };
+	s.ZeroRot = { d, d, d, d };
+	s.RefPos = { -d, -d, -d };
+	s.RefRot = { d * 2, d * 2, d * 2, d * 2 };
+	s.RefRotInv = { d * 3, d * 3, d * 3, d * 3 };
+	s.RefVel = s.RefAcc = s.RefRotVel = s.RefRotAcc = { d * 4, d * 4, d * 4 };
+	s.RefUpdateCount = n;
+	s.Enabled = s.ZeroPoseValid = s.RefPoseValid = true;
+	s.SetZeroMode = (n & 1) != 0;
+	return s;
+}
+
+static bool isConsistent(const core::ReferenceSnapshot& s)
+{
+	core::ReferenceSnapshot e = makeSnapshot(s.RefUpdateCount);
+	return std::memcmp(&s, &e, sizeof(e)) == 0;
+}
+
+// The pattern used before: one spinlock guarding the whole state
+struct LockedState
+{
+	core::Spinlock Lock;
+	core::ReferenceSnapshot State;
+
+	void store(const core::ReferenceSnapshot& s)
+	{
+		Lock.lock();
+		State = s;
+		Lock.unlock();
+	}
+
+	core::ReferenceSnapshot load()
+	{
+		Lock.lock();
+		core::ReferenceSnapshot s = State;
+		Lock.unlock();
+		return s;
+	}
+};
+
+struct RunResult
+{
+	uint64_t Reads = 0;
+	uint64_t Writes = 0;
+	uint64_t Torn = 0;
+	double ReadNs = 0.0;
+};
+
+template<typename Store> static RunResult run(Store& store, int durationMs, int readers)
+{
+	std::atomic<bool> stop = { false };
+	std::atomic<uint64_t> reads = { 0 };
+	std::atomic<uint64_t> torn = { 0 };
+	std::atomic<uint64_t> readNs = { 0 };
+	uint64_t writes = 0;
+
+	std::thread writer([&]() {
+		uint32_t n = 0;
+		while (!stop.load(std::memory_order_relaxed))
+		{
+			store.store(makeSnapshot(++n));
+		}
+		writes = n;
+	});
+
+	std::vector<std::thread> readerThreads;
+	for (int r = 0; r < readers; r++)
+	{
+		readerThreads.emplace_back([&]() {
+			uint64_t localReads = 0;
+			uint64_t localTorn = 0;
+			double start = bench::nowNs();
+			while (!stop.load(std::memory_order_relaxed))
+			{
+				core::ReferenceSnapshot s = store.load();
+				if (!isConsistent(s))
+				{
+					localTorn++;
+				}
+				localReads++;
+			}
+			readNs += (uint64_t)(bench::nowNs() - start);
+			reads += localReads;
+			torn += localTorn;
+		});
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
+	stop = true;
+	writer.join();
+	for (auto& t : readerThreads)
+	{
+		t.join();
+	}
+
+	RunResult result;
+	result.Reads = reads;
+	result.Writes = writes;
+	result.Torn = torn;
+	result.ReadNs = (double)readNs.load() / (double)(result.Reads ? result.Reads : 1) * readers;
+	return result;
+}
+
+static void printRun(const char* name, const RunResult& r)
+{
+	printf("%-28s %14llu %14llu %12.1f %10llu\n", name, (unsigned long long)r.Reads, (unsigned long long)r.Writes, r.ReadNs, (unsigned long long)r.Torn);
+}
+
+int main(int argc, char* argv[])
+{
+	int durationMs = 1000;
+	int readers = 2;
+	if (argc > 1)
+	{
+		durationMs = std::atoi(argv[1]);
+	}
+	if (argc > 2)
+	{
+		readers = std::atoi(argv[2]);
+	}
+
+	printf("Duration: %d ms, reader threads: %d, payload: %zu bytes\n\n", durationMs, readers, sizeof(core::ReferenceSnapshot));
+	printf("%-28s %14s %14s %12s %10s\n", "store", "reads", "writes", "ns/read", "torn");
+
+	core::SeqLock<core::ReferenceSnapshot> seqLock;
+	seqLock.store(makeSnapshot(0));
+	RunResult seq = run(seqLock, durationMs, readers);
+	printRun("SeqLock snapshot", seq);
+
+	LockedState locked;
+	locked.store(makeSnapshot(0));
+	RunResult spin = run(locked, durationMs, readers);
+	printRun("Spinlock copy", spin);
+
+	// Uncontended reader cost on the HMD path
+	double checksum = 0.0;
+	const size_t count = 10000000;
+	double start = bench::nowNs();
+	for (size_t i = 0; i < count; i++)
+	{
+		checksum += seqLock.load().RefPos.v[0];
+	}
+	double seqNs = bench::nowNs() - start;
+	start = bench::nowNs();
+	for (size_t i = 0; i < count; i++)
+	{
+		checksum += locked.load().RefPos.v[0];
+	}
+	double spinNs = bench::nowNs() - start;
+	bench::doNotOptimize(checksum);
+
+	printf("\n");
+	bench::printHeader();
+	bench::printResult("SeqLock load (uncontended)", seqNs, count);
+	bench::printResult("Spinlock copy (uncontended)", spinNs, count);
+
+	if (seq.Torn != 0)
+	{
+		printf("\nFAILED: %llu torn snapshot reads\n", (unsigned long long)seq.Torn);
+		return 1;
+	}
+
+	printf("\nOK: no torn snapshot reads\n");
+	return 0;
+}
@@ -0,0 +1,326 @@
+#include "BenchUtil.h"
+#include "MotionCompensationCore.h"
+#include "TelemetryRing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace vrmotioncompensation;
+
+// Checks the shared memory telemetry ring and measures what it adds to the HMD path.
+// Two writer threads fill the ring as fast as they can while a reader tails it. Every field of an entry is
+// derived from the writer and its counter, so the reader can tell a torn copy and a writer whose entries come
+// out of order. After the writers stopped, the reader drains the ring and every entry has to be either read
+// or counted as lost. Then the core writes its telemetry for a synthetic rig, and the raw and compensated poses
+// in the ring are compared with the poses that went in and came out of applyMotionCompensation.
+// Exits with 1 if a torn or reordered entry was read, entries went missing, the core telemetry does not match,
+// or a write takes longer than 100 ns.
+// Usage: bench_vrmotioncompensation_telemetry [milliseconds]
+
+static const int Writers = 2;
+static const int CostRounds = 7;
+static const double WriteBudgetNs = 100.0;
+
+static TelemetryPose_v1 makeTelemetryPose(double d)
+{
+	return { { d, d + 1, d + 2 }, { d * 2, d * 2, d * 2, d * 2 } };
+}
+
+static TelemetryEntry_v1 makeEntry(uint32_t writer, uint64_t k)
+{
+	TelemetryEntry_v1 entry = {};
+	double d = (double)k + (double)writer * 0.5;
+	entry.TimeNs = (int64_t)k;
+	entry.DeviceSampleUs = (int64_t)k * 3;
+	entry.RefSampleUs = (int64_t)k * 5;
+	entry.DeviceId = writer;
+	entry.Flags = (uint32_t)k;
+	entry.RawReference = makeTelemetryPose(d);
+	entry.FilteredReference = makeTelemetryPose(d * 3);
+	entry.RawDevice = makeTelemetryPose(d * 5);
+	entry.CompensatedDevice = makeTelemetryPose(d * 7);
+	return entry;
+}
+
+static bool isConsistent(const TelemetryEntry_v1& entry)
+{
+	if (entry.DeviceId >= (uint32_t)Writers)
+	{
+		return false;
+	}
+	TelemetryEntry_v1 expected = makeEntry(entry.DeviceId, (uint64_t)entry.TimeNs);
+	return std::memcmp(reinterpret_cast<const char*>(&entry) + sizeof(uint64_t), reinterpret_cast<const char*>(&expected) + sizeof(uint64_t),
+		sizeof(TelemetryEntry_v1) - sizeof(uint64_t)) == 0;
+}
+
+struct ContentionResult
+{
+	uint64_t Written = 0;
+	uint64_t Read = 0;
+	uint64_t Lost = 0;
+	uint64_t Torn = 0;
+	uint64_t Reordered = 0;
+};
+
+static ContentionResult contention(MMFstruct_OVRMC_Telemetry_v1& ring, int milliseconds)
+{
+	ContentionResult result;
+	core::TelemetryWriter::init(ring);
+	core::TelemetryReader reader;
+	reader.attach(ring, false);
+
+	std::atomic<bool> stop = { false };
+	std::atomic<uint64_t> written = { 0 };
+	std::vector<std::thread> writers;
+	for (uint32_t w = 0; w < (uint32_t)Writers; w++)
+	{
+		writers.emplace_back([&, w]() {
+			uint64_t k = 1;
+			while (!stop.load(std::memory_order_relaxed))
+			{
+				core::TelemetryWriter::write(ring, makeEntry(w, k++));
+			}
+			written += k - 1;
+		});
+	}
+
+	std::vector<TelemetryEntry_v1> entries(256);
+	int64_t last[Writers] = {};
+	auto check = [&](size_t count) {
+		for (size_t i = 0; i < count; i++)
+		{
+			const TelemetryEntry_v1& entry = entries[i];
+			if (!isConsistent(entry))
+			{
+				result.Torn++;
+				continue;
+			}
+			result.Reordered += entry.TimeNs <= last[entry.DeviceId] ? 1 : 0;
+			last[entry.DeviceId] = entry.TimeNs;
+		}
+		result.Read += count;
+	};
+
+	double end = bench::nowNs() + (double)milliseconds * 1.0E6;
+	while (bench::nowNs() < end)
+	{
+		check(reader.read(ring, entries.data(), entries.size()));
+	}
+
+	stop = true;
+	for (std::thread& writer : writers)
+	{
+		writer.join();
+	}
+
+	// Drain
+	size_t count;
+	while ((count = reader.read(ring, entries.data(), entries.size())) > 0)
+	{
+		check(count);
+	}
+
+	result.Written = written;
+	result.Lost = reader.getLost();
+	return result;
+}
+
+static TelemetryPose_v1 worldPose(const vr::DriverPose_t& pose)
+{
+	return {
+		vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, pose.vecPosition) + pose.vecWorldFromDriverTranslation,
+		pose.qWorldFromDriverRotation * pose.qRotation
+	};
+}
+
+static double poseError(const TelemetryPose_v1& a, const TelemetryPose_v1& b)
+{
+	double error = 0.0;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		error = std::max(error, std::abs(a.Position.v[axis] - b.Position.v[axis]));
+	}
+	error = std::max(error, std::abs(a.Rotation.w - b.Rotation.w));
+	error = std::max(error, std::abs(a.Rotation.x - b.Rotation.x));
+	error = std::max(error, std::abs(a.Rotation.y - b.Rotation.y));
+	error = std::max(error, std::abs(a.Rotation.z - b.Rotation.z));
+	return error;
+}
+
+struct CoreResult
+{
+	uint64_t Entries = 0;
+	uint64_t Compensated = 0;
+	double MaxError = 0.0;
+};
+
+// The reference tracker updates at 250 Hz, the HMD is compensated at 1000 Hz with device id 3
+static CoreResult coreTelemetry(MMFstruct_OVRMC_Telemetry_v1& ring, double seconds)
+{
+	CoreResult result;
+	bench::SyntheticRig rig;
+	core::MotionCompensationCore core;
+	core.setEnabled(true);
+	core::TelemetryWriter::init(ring);
+	core.setTelemetry(&ring);
+	core::TelemetryReader reader;
+	reader.attach(ring, true);
+
+	vr::DriverPose_t lastRef = {};
+	long long lastRefUs = 0;
+	TelemetryEntry_v1 entry;
+	for (long long i = 0; i < (long long)(seconds * 1000.0); i++)
+	{
+		double t = (double)i / 1000.0;
+		long long timestampUs = 1000000 + i * 1000;
+		if (i % 4 == 0)
+		{
+			lastRef = rig.refPose(t);
+			lastRefUs = timestampUs;
+			if (!core.isZeroPoseValid())
+			{
+				core.setZeroPose(lastRef);
+			}
+			else
+			{
+				core.updateRefPose(lastRef, timestampUs);
+			}
+		}
+
+		vr::DriverPose_t raw = rig.hmdPose(t);
+		vr::DriverPose_t compensated = raw;
+		core.applyMotionCompensation(compensated, timestampUs, 3);
+
+		if (reader.read(ring, &entry, 1) != 1)
+		{
+			result.MaxError = 1.0E300;
+			continue;
+		}
+		result.Entries++;
+		// The HMD is compensated once the reference pose is valid, until then it passes through
+		bool flagged = (entry.Flags & TelemetryFlag_Compensated) != 0;
+		result.Compensated += flagged ? 1 : 0;
+		if (entry.DeviceId != 3 || entry.DeviceSampleUs != timestampUs || (!flagged && poseError(entry.RawDevice, entry.CompensatedDevice) != 0.0))
+		{
+			result.MaxError = 1.0E300;
+		}
+		result.MaxError = std::max(result.MaxError, poseError(entry.RawDevice, worldPose(raw)));
+		result.MaxError = std::max(result.MaxError, poseError(entry.CompensatedDevice, worldPose(compensated)));
+		if (flagged)
+		{
+			result.MaxError = std::max(result.MaxError, poseError(entry.RawReference, worldPose(lastRef)));
+			result.MaxError = std::max(result.MaxError, entry.RefSampleUs == lastRefUs ? 0.0 : 1.0E300);
+		}
+	}
+	core.setTelemetry(nullptr);
+	return result;
+}
+
+static double costWrite(MMFstruct_OVRMC_Telemetry_v1& ring, size_t count)
+{
+	core::TelemetryWriter::init(ring);
+	TelemetryEntry_v1 entry = makeEntry(0, 1);
+	double best = 1.0E300;
+	for (int round = 0; round < CostRounds; round++)
+	{
+		double start = bench::nowNs();
+		for (size_t i = 0; i < count; i++)
+		{
+			entry.TimeNs = (int64_t)i;
+			core::TelemetryWriter::write(ring, entry);
+		}
+		best = std::min(best, bench::nowNs() - start);
+	}
+	bench::doNotOptimize(ring.Entries[0]);
+	return best;
+}
+
+static double costCompensation(MMFstruct_OVRMC_Telemetry_v1* ring, size_t count)
+{
+	bench::SyntheticRig rig;
+	core::MotionCompensationCore core;
+	core.setEnabled(true);
+	core.setZeroPose(rig.refPose(0.0));
+	core.updateRefPose(rig.refPose(0.01), 10000);
+	if (ring)
+	{
+		core::TelemetryWriter::init(*ring);
+	}
+	core.setTelemetry(ring);
+
+	std::vector<vr::DriverPose_t> hmd = rig.hmdStream(1024, 1000.0);
+	double checksum = 0.0;
+	double best = 1.0E300;
+	for (int round = 0; round < CostRounds; round++)
+	{
+		double start = bench::nowNs();
+		for (size_t i = 0; i < count; i++)
+		{
+			vr::DriverPose_t pose = hmd[i & 1023];
+			core.applyMotionCompensation(pose, 10000 + (long long)i, 0);
+			checksum += pose.vecPosition[0];
+		}
+		best = std::min(best, bench::nowNs() - start);
+	}
+	bench::doNotOptimize(checksum);
+	core.setTelemetry(nullptr);
+	return best;
+}
+
+int main(int argc, char* argv[])
+{
+	int milliseconds = 1000;
+	if (argc > 1)
+	{
+		milliseconds = std::max(10, std::atoi(argv[1]));
+	}
+
+	// Stands in for the OVRMC_Telemetry_v1 mapping
+	static MMFstruct_OVRMC_Telemetry_v1 ring;
+	bool ok = true;
+
+	printf("%u entries of %u bytes, %.0f KiB\n\n", TelemetryEntryCount, (unsigned)sizeof(TelemetryEntry_v1), (double)sizeof(ring) / 1024.0);
+
+	// ----------------------------------------------------------------------------------------------- //
+	// Concurrent writers
+	ContentionResult contended = contention(ring, milliseconds);
+	printf("%d writers: %llu entries written, %llu read, %llu lost, %llu torn, %llu out of order\n", Writers,
+		(unsigned long long)contended.Written, (unsigned long long)contended.Read, (unsigned long long)contended.Lost,
+		(unsigned long long)contended.Torn, (unsigned long long)contended.Reordered);
+	if (contended.Torn != 0 || contended.Reordered != 0 || contended.Read == 0 || contended.Read + contended.Lost != contended.Written)
+	{
+		printf("FAILED: torn, reordered or missing entries\n");
+		ok = false;
+	}
+
+	// ----------------------------------------------------------------------------------------------- //
+	// Core telemetry
+	CoreResult coreResult = coreTelemetry(ring, 5.0);
+	printf("core: %llu entries, %llu compensated, max deviation from the poses in and out %g\n\n",
+		(unsigned long long)coreResult.Entries, (unsigned long long)coreResult.Compensated, coreResult.MaxError);
+	if (coreResult.Entries == 0 || coreResult.Compensated == 0 || coreResult.MaxError > 1.0E-12)
+	{
+		printf("FAILED: the core telemetry does not match the compensated poses\n");
+		ok = false;
+	}
+
+	// ----------------------------------------------------------------------------------------------- //
+	// Cost on the HMD path
+	const size_t count = 1000000;
+	double writeNs = costWrite(ring, count);
+	bench::printHeader();
+	bench::printResult("telemetry write", writeNs, count);
+	bench::printResult("compensation without telemetry", costCompensation(nullptr, count), count);
+	bench::printResult("compensation with telemetry", costCompensation(&ring, count), count);
+	if (writeNs / (double)count > WriteBudgetNs)
+	{
+		printf("%s: a telemetry write takes longer than %.0f ns\n", bench::timingFailed(), WriteBudgetNs);
+		ok = !bench::timingChecked() && ok;
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,244 @@
+#include "BenchUtil.h"
+#include "MotionCompensationCore.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace vrmotioncompensation;
+
+// Replays a moving-rig trace and measures how far the compensated HMD pose is off from the ideal one,
+// once with the latest reference pose and once with the reference moved to the HMD sample time.
+// The reference tracker poses arrive with a delivery latency (reported through poseTimeOffset),
+// the HMD poses arrive as they are sampled.
+// Then the reference is reset and moved, and the HMD is compensated at a time between the last sample before and
+// the first one after the reset. Exits with 1 if that mixes in a reference sample from before the reset.
+// Usage: bench_vrmotioncompensation_timealign [seconds] [reference latency in ms]
+
+static const double RefRate = 369.0;
+static const double HmdRate = 1120.0;
+
+struct Event
+{
+	double CallTime;
+	bool IsRef;
+	vr::DriverPose_t Pose;
+	vr::DriverPose_t Ideal;
+};
+
+struct ErrorStats
+{
+	std::vector<double> Pos;
+	std::vector<double> Rot;
+
+	void add(const vr::DriverPose_t& pose, const vr::DriverPose_t& ideal)
+	{
+		double dx = pose.vecPosition[0] - ideal.vecPosition[0];
+		double dy = pose.vecPosition[1] - ideal.vecPosition[1];
+		double dz = pose.vecPosition[2] - ideal.vecPosition[2];
+		Pos.push_back(std::sqrt(dx * dx + dy * dy + dz * dz) * 1000.0);
+
+		double dot = std::fabs(pose.qRotation.w * ideal.qRotation.w + pose.qRotation.x * ideal.qRotation.x + pose.qRotation.y * ideal.qRotation.y + pose.qRotation.z * ideal.qRotation.z);
+		Rot.push_back(2.0 * std::acos(std::min(1.0, dot)) * 180.0 / 3.14159265358979);
+	}
+
+	static double rms(const std::vector<double>& v)
+	{
+		double sum = 0.0;
+		for (double x : v)
+		{
+			sum += x * x;
+		}
+		return std::sqrt(sum / (double)v.size());
+	}
+
+	static double percentile(std::vector<double> v, double p)
+	{
+		std::sort(v.begin(), v.end());
+		return v[std::min(v.size() - 1, (size_t)(p * (double)v.size()))];
+	}
+
+	void print(const char* name) const
+	{
+		printf("%-32s %9.3f %9.3f %9.3f %10.4f %10.4f %10.4f\n", name,
+			rms(Pos), percentile(Pos, 0.99), percentile(Pos, 1.0),
+			rms(Rot), percentile(Rot, 0.99), percentile(Rot, 1.0));
+	}
+};
+
+// The ideal result: the HMD pose compensated with the exact, noise-free reference pose at the HMD sample time
+static vr::DriverPose_t idealPose(bench::SyntheticRig& rig, const vr::DriverPose_t& zeroPose, double t, const vr::DriverPose_t& hmd)
+{
+	core::MotionCompensationCore oracle;
+	oracle.setLpfBeta(1.0);
+	oracle.setAlpha(1);
+	oracle.setEnabled(true);
+	oracle.setZeroPose(zeroPose);
+	for (int i = 0; i < 102; i++)
+	{
+		oracle.updateRefPose(rig.refPose(t, false), 0);
+	}
+
+	vr::DriverPose_t ideal = hmd;
+	oracle.applyMotionCompensation(ideal);
+	return ideal;
+}
+
+static std::vector<Event> buildTrace(double seconds, double latency)
+{
+	bench::SyntheticRig rig;
+	std::vector<Event> events;
+
+	for (size_t i = 0; (double)i / RefRate < seconds; i++)
+	{
+		double t = (double)i / RefRate;
+		Event e;
+		e.CallTime = t + latency;
+		e.IsRef = true;
+		e.Pose = rig.refPose(t);
+		e.Pose.poseTimeOffset = -latency;
+		events.push_back(e);
+	}
+
+	vr::DriverPose_t zeroPose = rig.refPose(0.0, false);
+	for (size_t i = 0; (double)i / HmdRate < seconds; i++)
+	{
+		double t = (double)i / HmdRate;
+		Event e;
+		e.CallTime = t;
+		e.IsRef = false;
+		e.Pose = rig.hmdPose(t);
+		e.Ideal = idealPose(rig, zeroPose, t, e.Pose);
+		events.push_back(e);
+	}
+
+	std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+		return a.CallTime < b.CallTime;
+	});
+	return events;
+}
+
+struct FilterConfig
+{
+	const char* Name;
+	MotionCompensationFilterType FilterType;
+	double LpfBeta;
+	uint32_t Samples;
+	double ProcessNoise;
+	long long PredictionUs;
+};
+
+static ErrorStats replay(const std::vector<Event>& events, const FilterConfig& config, bool timeAligned)
+{
+	bench::SyntheticRig rig;
+	core::MotionCompensationCore mc;
+	mc.setFilterType(config.FilterType);
+	mc.setLpfBeta(config.LpfBeta);
+	mc.setAlpha(config.Samples);
+	mc.setKalmanNoise(config.ProcessNoise, 0.0005);
+	mc.setKalmanPrediction(config.PredictionUs);
+	mc.setEnabled(true);
+	mc.setZeroPose(rig.refPose(0.0, false));
+
+	ErrorStats stats;
+	for (const Event& e : events)
+	{
+		long long now = (long long)(e.CallTime * 1.0E6);
+		if (e.IsRef)
+		{
+			mc.updateRefPose(e.Pose, now);
+		}
+		else if (mc.isRefPoseValid() && e.CallTime > 1.0)
+		{
+			vr::DriverPose_t pose = e.Pose;
+			if (timeAligned)
+			{
+				mc.applyMotionCompensation(pose, now);
+			}
+			else
+			{
+				mc.applyMotionCompensation(pose);
+			}
+			stats.add(pose, e.Ideal);
+		}
+	}
+	return stats;
+}
+
+// After a reset only reference samples from after it may be used, with one sample the latest reference is used
+static bool checkReset()
+{
+	bench::SyntheticRig rig;
+	core::MotionCompensationCore mc;
+	mc.setFilterBypass(true);
+	mc.setEnabled(true);
+	mc.setZeroPose(rig.refPose(0.0, false));
+	long long now = 0;
+	for (int i = 0; i <= 101; i++)
+	{
+		now += 4000;
+		mc.updateRefPose(rig.refPose(0.0, false), now);
+	}
+
+	mc.resetRefPose();
+	mc.setZeroPose(rig.refPose(0.0, false));
+	vr::DriverPose_t moved = rig.refPose(0.0, false);
+	moved.vecPosition[0] += 1.0;
+	now += 4000;
+	mc.updateRefPose(moved, now);
+
+	vr::DriverPose_t aligned = rig.hmdPose(0.0);
+	vr::DriverPose_t latest = aligned;
+	mc.applyMotionCompensation(aligned, now - 2000);
+	mc.applyMotionCompensation(latest);
+
+	double dx = aligned.vecPosition[0] - latest.vecPosition[0];
+	double dy = aligned.vecPosition[1] - latest.vecPosition[1];
+	double dz = aligned.vecPosition[2] - latest.vecPosition[2];
+	double error = std::sqrt(dx * dx + dy * dy + dz * dz) * 1000.0;
+	bool ok = mc.isRefPoseValid() && error < 1.0E-6;
+	printf("\nreference reset: %.3f mm from the latest reference %s\n", error, ok ? "" : "FAILED");
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	double seconds = 20.0;
+	double latencyMs = 4.0;
+	if (argc > 1)
+	{
+		seconds = std::atof(argv[1]);
+	}
+	if (argc > 2)
+	{
+		latencyMs = std::atof(argv[2]);
+	}
+
+	std::vector<Event> events = buildTrace(seconds, latencyMs / 1000.0);
+
+	printf("Trace: %.0f s, reference %.0f Hz with %.1f ms latency, HMD %.0f Hz\n", seconds, RefRate, latencyMs, HmdRate);
+	printf("Error of the compensated HMD pose against the ideal one (first second skipped)\n\n");
+	printf("%-32s %9s %9s %9s %10s %10s %10s\n", "", "pos rms", "pos p99", "pos max", "rot rms", "rot p99", "rot max");
+	printf("%-32s %9s %9s %9s %10s %10s %10s\n", "", "mm", "mm", "mm", "deg", "deg", "deg");
+
+	const FilterConfig configs[] = {
+		{ "filters off", MotionCompensationFilterType::Default, 1.0, 1, 0.0, 0 },
+		{ "DEMA 4, LPF 0.6", MotionCompensationFilterType::Default, 0.6, 4, 0.0, 0 },
+		{ "Kalman q=1000", MotionCompensationFilterType::Kalman, 1.0, 2, 1000.0, 0 },
+		{ "Kalman q=1000, predict latency", MotionCompensationFilterType::Kalman, 1.0, 2, 1000.0, (long long)(latencyMs * 1000.0) },
+	};
+
+	for (const auto& c : configs)
+	{
+		ErrorStats latest = replay(events, c, false);
+		ErrorStats aligned = replay(events, c, true);
+
+		printf("%s:\n", c.Name);
+		latest.print("  latest reference");
+		aligned.print("  reference at HMD sample time");
+		printf("  %-30s %8.1f%% %9s %9s %9.1f%%\n", "rms reduction",
+			(1.0 - ErrorStats::rms(aligned.Pos) / ErrorStats::rms(latest.Pos)) * 100.0, "", "",
+			(1.0 - ErrorStats::rms(aligned.Rot) / ErrorStats::rms(latest.Rot)) * 100.0);
+	}
+
+	return checkReset() ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+#include "BenchUtil.h"
+#include "Filters.h"
+#include "ZeroPoseCalibration.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace vrmotioncompensation;
+
+// Checks the zero pose calibration on synthetic reference streams of a rig at rest: tracking noise only, noise with
+// tracking glitches, a rig that still moves before it settles, and mostly glitches. The calibrated zero pose is
+// compared with the true rest pose, next to the first sample that used to become the zero pose.
+// Exits with 1 if the calibrated zero pose is further off than the error limits, a glitch gets into it,
+// or a zero pose is published while the rig moves.
+// Usage: bench_vrmotioncompensation_zerocalibration [trials]
+
+static const double PI = 3.14159265358979323846;
+
+static const double PositionNoise = 0.0005;		// m, per axis
+static const double RotationNoise = 0.0009;		// rad, per axis (0.05 deg)
+static const double GlitchRate = 0.05;
+
+// Limits for the calibrated zero pose, a window of 100 samples brings the noise down by about 10
+static const double MaxPositionError = 0.0003;
+static const double MaxRotationError = 0.0005;
+
+struct Stream
+{
+	Stream(unsigned seed, double glitchRate) : Rng(seed), GlitchRate(glitchRate)
+	{
+		Rest = Rig.basePose();
+		Rest.vecPosition[0] = 0.2;
+		Rest.vecPosition[1] = 1.1;
+		Rest.vecPosition[2] = -0.4;
+		Rest.qRotation = vrmath::quaternionFromYawPitchRoll(0.7, 0.05, -0.03);
+	}
+
+	// Next sample of the rig at rest, or moving with a sine for the first settleSeconds
+	vr::DriverPose_t next(double t, double settleSeconds = 0.0)
+	{
+		std::normal_distribution<double> noise(0.0, 1.0);
+		std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+		vr::DriverPose_t pose = Rest;
+		vr::HmdVector3d_t rotNoise = { noise(Rng) * RotationNoise, noise(Rng) * RotationNoise, noise(Rng) * RotationNoise };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			pose.vecPosition[axis] += noise(Rng) * PositionNoise;
+		}
+
+		if (t < settleSeconds)
+		{
+			pose.vecPosition[1] += 0.03 * std::sin(2.0 * PI * 1.5 * t);
+			rotNoise.v[0] += 0.05 * std::sin(2.0 * PI * 1.1 * t);
+		}
+
+		// Tracking glitch: a jump of a few centimeters and degrees
+		if (uniform(Rng) < GlitchRate)
+		{
+			pose.vecPosition[0] += 0.03 + 0.05 * uniform(Rng);
+			pose.vecPosition[2] -= 0.02 + 0.05 * uniform(Rng);
+			rotNoise.v[1] += 0.05 + 0.1 * uniform(Rng);
+		}
+
+		pose.qRotation = core::quaternionExp(rotNoise) * pose.qRotation;
+		return pose;
+	}
+
+	bench::SyntheticRig Rig;
+	vr::DriverPose_t Rest;
+	std::mt19937 Rng;
+	double GlitchRate;
+};
+
+// Distance of a zero pose in app space from the rest pose, position in meters and rotation in radians
+static void zeroError(const vr::DriverPose_t& rest, const vr::DriverPose_t& zero, double& position, double& rotation)
+{
+	vr::HmdVector3d_t restPos = vrmath::quaternionRotateVector(rest.qWorldFromDriverRotation, rest.vecPosition) + rest.vecWorldFromDriverTranslation;
+	vr::HmdQuaternion_t restRot = rest.qWorldFromDriverRotation * rest.qRotation;
+	vr::HmdVector3d_t zeroPos = vrmath::quaternionRotateVector(zero.qWorldFromDriverRotation, zero.vecPosition) + zero.vecWorldFromDriverTranslation;
+	vr::HmdQuaternion_t zeroRot = zero.qWorldFromDriverRotation * zero.qRotation;
+
+	vr::HmdVector3d_t diff = zeroPos - restPos;
+	vr::HmdVector3d_t angle = core::quaternionLog(zeroRot * vrmath::quaternionConjugate(restRot));
+	position = std::sqrt(diff.v[0] * diff.v[0] + diff.v[1] * diff.v[1] + diff.v[2] * diff.v[2]);
+	rotation = std::sqrt(angle.v[0] * angle.v[0] + angle.v[1] * angle.v[1] + angle.v[2] * angle.v[2]);
+}
+
+struct ScenarioResult
+{
+	double FirstPositionMax = 0.0;
+	double FirstRotationMax = 0.0;
+	double PositionMax = 0.0;
+	double RotationMax = 0.0;
+	double SecondsMax = 0.0;
+	uint32_t WindowsMax = 0;
+	int Calibrated = 0;
+	int EarlyZero = 0;
+};
+
+// Feeds a 250 Hz stream into the calibration until it publishes a zero pose or maxSeconds are over
+static ScenarioResult scenario(const char* name, int trials, double glitchRate, double settleSeconds, double maxSeconds)
+{
+	ScenarioResult result;
+	for (int trial = 0; trial < trials; trial++)
+	{
+		Stream stream(1000 + trial, glitchRate);
+		core::ZeroPoseCalibration calibration;
+		vr::DriverPose_t zero;
+		bool first = true;
+
+		for (double t = 0.0; t < maxSeconds; t += 0.004)
+		{
+			vr::DriverPose_t sample = stream.next(t, settleSeconds);
+			if (first)
+			{
+				double position, rotation;
+				zeroError(stream.Rest, sample, position, rotation);
+				result.FirstPositionMax = std::max(result.FirstPositionMax, position);
+				result.FirstRotationMax = std::max(result.FirstRotationMax, rotation);
+				first = false;
+			}
+
+			if (calibration.addSample(sample, zero))
+			{
+				double position, rotation;
+				zeroError(stream.Rest, zero, position, rotation);
+				result.PositionMax = std::max(result.PositionMax, position);
+				result.RotationMax = std::max(result.RotationMax, rotation);
+				result.SecondsMax = std::max(result.SecondsMax, t);
+				result.WindowsMax = std::max(result.WindowsMax, calibration.getStatus().Windows);
+				result.Calibrated++;
+				result.EarlyZero += t < settleSeconds ? 1 : 0;
+				break;
+			}
+		}
+	}
+
+	printf("%-22s %8d/%-4d %9.3f %9.3f %11.3f %9.3f %9.2f %8u\n", name, result.Calibrated, trials,
+		result.FirstPositionMax * 1000.0, result.FirstRotationMax * 180.0 / PI, result.PositionMax * 1000.0, result.RotationMax * 180.0 / PI,
+		result.SecondsMax, result.WindowsMax);
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	int trials = 200;
+	if (argc > 1)
+	{
+		trials = std::max(1, std::atoi(argv[1]));
+	}
+
+	bool ok = true;
+	printf("%-22s %13s %19s %21s %9s %8s\n", "", "", "first sample (max)", "calibrated (max)", "", "");
+	printf("%-22s %13s %9s %9s %11s %9s %9s %8s\n", "stream", "calibrated", "mm", "deg", "mm", "deg", "seconds", "windows");
+
+	// Tracking noise only
+	ScenarioResult noise = scenario("noise", trials, 0.0, 0.0, 5.0);
+	if (noise.Calibrated != trials || noise.PositionMax > MaxPositionError || noise.RotationMax > MaxRotationError)
+	{
+		printf("FAILED: zero pose missing or off with tracking noise\n");
+		ok = false;
+	}
+
+	// Glitches in 5 % of the samples
+	ScenarioResult glitches = scenario("noise + 5% glitches", trials, GlitchRate, 0.0, 5.0);
+	if (glitches.Calibrated != trials || glitches.PositionMax > MaxPositionError || glitches.RotationMax > MaxRotationError)
+	{
+		printf("FAILED: a glitch got into the zero pose\n");
+		ok = false;
+	}
+
+	// The rig still moves for two seconds, no zero pose may be taken before it rests
+	ScenarioResult settling = scenario("settling for 2 s", trials, 0.0, 2.0, 6.0);
+	if (settling.Calibrated != trials || settling.EarlyZero != 0 || settling.PositionMax > MaxPositionError || settling.RotationMax > MaxRotationError)
+	{
+		printf("FAILED: zero pose taken while the rig moved, or missing after it settled\n");
+		ok = false;
+	}
+
+	// Mostly glitches: only the rare window with a clean majority may be accepted, and only with its clean samples
+	ScenarioResult broken = scenario("60% glitches", trials, 0.6, 0.0, 2.0);
+	if (broken.PositionMax > MaxPositionError || broken.RotationMax > MaxRotationError)
+	{
+		printf("FAILED: a zero pose was taken from the glitches\n");
+		ok = false;
+	}
+	printf("\n");
+
+	// One sample: the old behavior, the first sample is the zero pose
+	{
+		Stream stream(7, 0.0);
+		core::ZeroPoseCalibration calibration;
+		calibration.configure({ 1, 0.0, 0.0 });
+		vr::DriverPose_t sample = stream.next(0.0);
+		vr::DriverPose_t zero;
+		double position = 1.0, rotation = 1.0;
+		if (calibration.addSample(sample, zero))
+		{
+			zeroError(sample, zero, position, rotation);
+		}
+		printf("1 sample window: %.3g mm, %.3g deg from the first sample\n\n", position * 1000.0, rotation * 180.0 / PI);
+		if (position > 1.0E-9 || rotation > 1.0E-9)
+		{
+			printf("FAILED: a window of one sample does not take the first sample\n");
+			ok = false;
+		}
+	}
+
+	// Cost of a sample, including the evaluation of the full window
+	{
+		Stream stream(11, GlitchRate);
+		std::vector<vr::DriverPose_t> samples(1000);
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			samples[i] = stream.next((double)i * 0.004);
+		}
+
+		bench::printHeader();
+		uint32_t windows[] = { 100, 1000 };
+		for (uint32_t window : windows)
+		{
+			core::ZeroPoseCalibration calibration;
+			calibration.configure({ window, 0.0, 0.0 });
+			vr::DriverPose_t zero;
+			const size_t count = 100000;
+			double start = bench::nowNs();
+			for (size_t i = 0; i < count; i++)
+			{
+				bench::doNotOptimize(calibration.addSample(samples[i % samples.size()], zero));
+			}
+			char name[64];
+			snprintf(name, sizeof(name), "calibration sample, %u sample window", window);
+			bench::printResult(name, bench::nowNs() - start, count);
+		}
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstdio>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Capture files of the debug logger: a header that names the channels, then fixed-size records of doubles.
+// The writer appends through a memory mapping of the file, the reader maps it and hands out pointers into it.
+// All numbers are little endian, as on every platform SteamVR runs on.
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		const uint32_t CaptureMagic = 0x50414356;	// "VCAP"
+		const uint32_t CaptureVersion = 1;
+		const uint32_t CaptureMaxChannels = 64;
+		const uint32_t CaptureNameLength = 48;
+
+		enum class CaptureChannelType : uint32_t
+		{
+			Scalar = 0,			// 1 double
+			Vector3 = 1,		// x, y, z
+			Quaternion = 2,		// w, x, y, z
+		};
+
+		struct CaptureChannel_v1
+		{
+			char Name[CaptureNameLength];		// Zero terminated
+			uint32_t Type;						// CaptureChannelType
+			uint32_t Offset;					// Index of the first double of the channel in a record
+		};
+
+		// Followed by ChannelCount CaptureChannel_v1, then the records from HeaderSize on.
+		// Every record starts with the time in seconds since the start of the capture
+		struct CaptureHeader_v1
+		{
+			uint32_t Magic;
+			uint32_t Version;
+			uint32_t HeaderSize;		// Bytes before the first record
+			uint32_t RecordSize;		// Bytes per record, a multiple of 8
+			uint32_t ChannelCount;
+			uint32_t Reserved_int;
+			uint64_t RecordCount;		// Records written so far, updated with every record
+			int64_t StartTimeUs;		// System clock at the start of the capture
+			uint64_t Reserved[4];
+		};
+
+		// Channel of a capture, for the writer
+		struct CaptureChannel
+		{
+			std::string Name;
+			CaptureChannelType Type;
+		};
+
+		// Doubles of a channel type
+		inline uint32_t captureChannelSize(CaptureChannelType type)
+		{
+			return type == CaptureChannelType::Quaternion ? 4 : (type == CaptureChannelType::Vector3 ? 3 : 1);
+		}
+
+		// A file mapped into memory, read only or growing
+		class MappedFile
+		{
+		public:
+			MappedFile() = default;
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			~MappedFile()
+			{
+				close();
+			}
+
+			// Creates or truncates the file with size bytes
+			bool create(const char* path, size_t size);
+
+			bool openReadOnly(const char* path);
+
+			// Grows or shrinks the file and maps it again, the address changes
+			bool resize(size_t size);
+
+			// Unmaps and closes, the file keeps its current size
+			void close();
+
+			bool isOpen() const
+			{
+				return _Data != nullptr;
+			}
+
+			char* data() const
+			{
+				return _Data;
+			}
+
+			size_t size() const
+			{
+				return _Size;
+			}
+
+		private:
+			bool map(bool writable);
+
+			void unmap();
+
+			char* _Data = nullptr;
+			size_t _Size = 0;
+#ifdef _WIN32
+			void* _File = nullptr;
+			void* _Mapping = nullptr;
+#else
+			int _File = -1;
+#endif
+		};
+
+		// Appends records to a capture file. The file grows by doubling, so a record is a copy into the mapping
+		// most of the time. Not thread-safe, one writer per file
+		class CaptureWriter
+		{
+		public:
+			CaptureWriter() = default;
+			CaptureWriter(const CaptureWriter&) = delete;
+			CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+			~CaptureWriter()
+			{
+				close();
+			}
+
+			// Creates the file with room for initialRecords. Fails for more than CaptureMaxChannels channels
+			bool open(const char* path, const std::vector<CaptureChannel>& channels, int64_t startTimeUs, uint64_t initialRecords = 4096);
+
+			// Doubles per record: the time and the doubles of every channel
+			uint32_t getRecordDoubles() const
+			{
+				return _RecordDoubles;
+			}
+
+			// Appends a record of getRecordDoubles() doubles, false if the file cannot grow
+			bool append(const double* record);
+
+			uint64_t getRecordCount() const
+			{
+				return _RecordCount;
+			}
+
+			// Cuts the file to the written records
+			void close();
+
+			bool isOpen() const
+			{
+				return _File.isOpen();
+			}
+
+		private:
+			CaptureHeader_v1* header() const
+			{
+				return reinterpret_cast<CaptureHeader_v1*>(_File.data());
+			}
+
+			MappedFile _File;
+			uint32_t _HeaderSize = 0;
+			uint32_t _RecordDoubles = 0;
+			uint64_t _RecordCount = 0;
+			uint64_t _Capacity = 0;
+		};
+
+		// Reads a capture file without copying it. A file that is still being written shows the records up to
+		// its last RecordCount at the time it was opened
+		class CaptureReader
+		{
+		public:
+			// Returns false if the file is missing, too short or not a capture of a known version
+			bool open(const char* path);
+
+			void close()
+			{
+				_File.close();
+			}
+
+			const CaptureHeader_v1& getHeader() const
+			{
+				return *reinterpret_cast<const CaptureHeader_v1*>(_File.data());
+			}
+
+			uint32_t getChannelCount() const
+			{
+				return getHeader().ChannelCount;
+			}
+
+			const CaptureChannel_v1& getChannel(uint32_t index) const
+			{
+				return reinterpret_cast<const CaptureChannel_v1*>(_File.data() + sizeof(CaptureHeader_v1))[index];
+			}
+
+			uint64_t getRecordCount() const
+			{
+				return _RecordCount;
+			}
+
+			// Pointer into the mapping, valid until close
+			const double* getRecord(uint64_t index) const
+			{
+				return reinterpret_cast<const double*>(_File.data() + getHeader().HeaderSize + index * getHeader().RecordSize);
+			}
+
+			// One line per record with a title line of the channel components ("Name.x" ...), numbers written exactly
+			void writeCsv(std::FILE* file, char separator = ',') const;
+
+		private:
+			MappedFile _File;
+			uint64_t _RecordCount = 0;
+		};
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "CaptureFile.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// Captures records from the pose threads into a capture file without locks on their side.
+// Every producing thread gets its own single producer, single consumer ring of fixed-size records. A producer copies
+// its record into the ring and bumps the write index, a background thread drains the rings into a CaptureWriter.
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		class CaptureRecorder
+		{
+		public:
+			// Threads that can record during one capture, records of any further thread are dropped
+			static const uint32_t MaxProducers = 8;
+
+			// Records per ring, about a second of poses at 1 kHz
+			static const uint32_t RingRecords = 1024;
+
+			// How long the drain thread sleeps when all rings are empty
+			static const uint32_t DrainIntervalMs = 2;
+
+			CaptureRecorder() = default;
+			CaptureRecorder(const CaptureRecorder&) = delete;
+			CaptureRecorder& operator=(const CaptureRecorder&) = delete;
+
+			~CaptureRecorder()
+			{
+				stop();
+			}
+
+			// Allocates the rings, creates the file and starts the drain thread. The capture stops taking records
+			// once maxRecords are in the file. Fails if a capture is running or the file cannot be created
+			bool start(const char* path, const std::vector<CaptureChannel>& channels, int64_t startTimeUs, uint64_t maxRecords);
+
+			// Waits for producers that are in the middle of a record, writes what is left in the rings, closes the file
+			// and frees the rings. Must not be called from a producing thread
+			void stop();
+
+			// False once the capture is full
+			bool isRunning() const
+			{
+				return _Running.load(std::memory_order_acquire) && !_Full.load(std::memory_order_relaxed);
+			}
+
+			// Doubles per record: the time in seconds, then the doubles of the channels
+			uint32_t getRecordDoubles() const
+			{
+				return _RecordDoubles;
+			}
+
+			// Any thread, without locks or allocations. Copies getRecordDoubles() doubles into the ring of the calling thread.
+			// Returns false and drops the record if no capture is running, the capture is full, the ring of the thread
+			// is full or MaxProducers other threads already record
+			bool record(const double* values);
+
+			// Records in the file
+			uint64_t getRecordCount() const
+			{
+				return _RecordCount.load(std::memory_order_relaxed);
+			}
+
+			// Records dropped by the producers since start because their ring was full or they had none
+			uint64_t getDropped() const;
+
+		private:
+			// Write is only changed by the producer, Read only by the drain thread. Both sit on their own cache line
+			struct Ring
+			{
+				alignas(64) std::atomic<uint64_t> Write = { 0 };
+				std::atomic<bool> Busy = { false };		// The producer is between its check of _Running and the end of its record
+				std::atomic<uint64_t> Dropped = { 0 };
+				double* Data = nullptr;
+				alignas(64) std::atomic<uint64_t> Read = { 0 };
+			};
+
+			void drainLoop();
+
+			// Moves the records that are in the rings into the file, oldest first. Returns how many it moved
+			size_t drain();
+
+			Ring _Rings[MaxProducers];
+			std::vector<double> _RingData;
+			uint32_t _RecordDoubles = 0;
+
+			// Producers claim a ring with the first record of a capture. _Session tells a thread that its ring
+			// is from an earlier capture
+			std::atomic<uint32_t> _Producers = { 0 };
+			std::atomic<uint32_t> _Session = { 0 };
+			std::atomic<bool> _Running = { false };
+			std::atomic<bool> _Full = { false };
+			std::atomic<uint64_t> _RecordCount = { 0 };
+			std::atomic<uint64_t> _Unclaimed = { 0 };
+
+			CaptureWriter _Writer;
+			uint64_t _MaxRecords = 0;
+			std::thread _DrainThread;
+			std::atomic<bool> _DrainStop = { false };
+		};
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vrmotioncompensation_types.h>
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// The set of motion compensated devices. The devices keep their mode and offset in their own handles,
+		// so a device that leaves the set has to be handed back to default. Not thread-safe, the driver only
+		// changes it from the IPC thread
+		class CompensatedDevices
+		{
+		public:
+			// False if the device is already in the set
+			bool add(uint32_t device)
+			{
+				if (contains(device))
+				{
+					return false;
+				}
+				_Devices.push_back(device);
+				return true;
+			}
+
+			void remove(uint32_t device)
+			{
+				_Devices.erase(std::remove(_Devices.begin(), _Devices.end(), device), _Devices.end());
+			}
+
+			bool contains(uint32_t device) const
+			{
+				return std::find(_Devices.begin(), _Devices.end(), device) != _Devices.end();
+			}
+
+			const std::vector<uint32_t>& devices() const
+			{
+				return _Devices;
+			}
+
+			// Empties the set and returns every device in it to the default mode without an offset.
+			// lookup returns the handle of a device id or nullptr if the device is gone. A handle has
+			// setMotionCompensationDeviceMode and setOffset like the driver's DeviceManipulationHandle
+			template<typename Lookup> void releaseAll(Lookup lookup)
+			{
+				const MotionCompensationDeviceOffset noOffset = { { 0, 0, 0 }, { 1, 0, 0, 0 } };
+
+				std::vector<uint32_t> devices;
+				devices.swap(_Devices);
+				for (uint32_t device : devices)
+				{
+					auto handle = lookup(device);
+					if (handle)
+					{
+						handle->setOffset(noOffset);
+						handle->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::Default);
+					}
+				}
+			}
+
+		private:
+			std::vector<uint32_t> _Devices;
+		};
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "IpcRing.h"
+#include "vrmc_openvr.h"
+#include <vrmotioncompensation_types.h>
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+
+// Hands device events from the pose, hook and ipc threads of the driver to the one thread that pushes them to the
+// subscribed clients. An IpcRing in process memory: a push never blocks and never takes a lock, the delivering
+// thread sleeps in the kernel until an event arrives.
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		class DeviceEventQueue
+		{
+		public:
+			// Events that can wait for delivery, more are dropped
+			static const uint32_t Capacity = 256;
+
+			DeviceEventQueue() = default;
+
+			DeviceEventQueue(const DeviceEventQueue&) = delete;
+			DeviceEventQueue& operator=(const DeviceEventQueue&) = delete;
+
+			// name identifies the wake event on Windows and has to be unique in the system
+			bool create(const char* name);
+
+			bool isCreated() const
+			{
+				return _Ring.isAttached();
+			}
+
+			// Any thread. False if the queue is full or not created, the event is dropped and counted then
+			bool push(const DeviceEvent& event);
+
+			// The delivering thread only. Sleeps for up to timeoutMs if there is no event
+			bool pop(DeviceEvent& event, uint32_t timeoutMs);
+
+			uint64_t getDropped() const
+			{
+				return _Dropped.load(std::memory_order_relaxed);
+			}
+
+		private:
+			std::unique_ptr<char[]> _Memory;
+			IpcRing _Ring;
+			std::atomic<uint64_t> _Dropped = { 0 };
+		};
+	}
+}
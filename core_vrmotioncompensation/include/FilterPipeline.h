@@ -0,0 +1,71 @@
+#pragma once
+
+#include "vrmc_openvr.h"
+#include "KalmanFilter.h"
+#include "OneEuroFilter.h"
+#include <vrmotioncompensation_types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Reference tracker filter chain, composed at compile time from three policies:
+// a position filter, a rotation filter and a derivative estimator.
+// Every valid combination is instantiated once. The core selects one when a setting changes and calls it
+// through a single function pointer, so the per-sample path has no configuration branches.
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// Filtered reference pose in driver space
+		struct FilterOutput
+		{
+			vr::HmdVector3d_t Pos;
+			vr::HmdVector3d_t Vel;
+			vr::HmdVector3d_t Acc;
+			vr::HmdQuaternion_t Rot;
+			vr::HmdVector3d_t AngVel;
+			vr::HmdVector3d_t AngAcc;
+
+			// The output is valid this much after the sample time (prediction)
+			long long TimeShiftUs;
+		};
+
+		// Settings and state of all filters. Only touched by the reference tracker thread, or under the writer lock
+		struct FilterContext
+		{
+			// Settings
+			double Alpha = 2.0 / 101.0;
+			double LpfBeta = 0.2;
+			long long KalmanPredictionUs = 0;
+
+			// DEMA
+			vr::HmdVector3d_t Dema[2] = {};
+
+			// Two stage slerp low pass
+			vr::HmdQuaternion_t RotLpf[2] = { { 1, 0, 0, 0 }, { 1, 0, 0, 0 } };
+
+			// Finite differences, taken between consecutive filtered outputs
+			long long LastSampleUs = -1;
+			FilterOutput Last = {};
+
+			PoseKalmanFilter Kalman;
+			PoseKalmanFilter::State KalmanState = {};
+
+			PoseOneEuroFilter OneEuro;
+		};
+
+		typedef void (*FilterPipelineFn)(FilterContext& ctx, const vr::DriverPose_t& pose, long long sampleUs, FilterOutput& out);
+
+		struct FilterPipelineInfo
+		{
+			const char* Name;
+			FilterPipelineFn Run;
+		};
+
+		// Pipeline for the given settings
+		FilterPipelineFn selectFilterPipeline(MotionCompensationFilterType type, uint32_t samples, double lpfBeta, bool setZeroMode);
+
+		// All built-in pipelines, for tools and benchmarks
+		const FilterPipelineInfo* filterPipelines(size_t& count);
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "vrmc_openvr.h"
+
+// Stateless filter and conversion helpers used by the reference tracker filter chain
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		double vecVelocity(double time, const double vecPosition, const double Old_vecPosition);
+
+		double vecAcceleration(double time, const double vecVelocity, const double Old_vecVelocity);
+
+		vr::HmdVector3d_t LPF(double Beta, const double RawData[3], vr::HmdVector3d_t SmoothData);
+
+		vr::HmdVector3d_t LPF(double Beta, vr::HmdVector3d_t RawData, vr::HmdVector3d_t SmoothData);
+
+		vr::HmdQuaternion_t slerp(vr::HmdQuaternion_t q1, vr::HmdQuaternion_t q2, double lambda);
+
+		// Linear interpolation, t outside of [0, 1] extrapolates
+		vr::HmdVector3d_t lerp(const vr::HmdVector3d_t& v1, const vr::HmdVector3d_t& v2, double t);
+
+		// Spherical interpolation along the shortest arc, t outside of [0, 1] extrapolates. The result is normalized.
+		vr::HmdQuaternion_t slerpNormalized(vr::HmdQuaternion_t q1, vr::HmdQuaternion_t q2, double t);
+
+		// Unit length quaternion, identity for a zero quaternion
+		vr::HmdQuaternion_t quaternionNormalize(const vr::HmdQuaternion_t& q);
+
+		// Rotation vector (axis * angle in radians) to unit quaternion
+		vr::HmdQuaternion_t quaternionExp(const vr::HmdVector3d_t& rotVec);
+
+		// Unit quaternion to rotation vector, taking the shorter of q and -q
+		vr::HmdVector3d_t quaternionLog(const vr::HmdQuaternion_t& q);
+
+		// Angular velocity in radians per second that turns Old_q into q within time seconds, as a rotation vector
+		// in the same space as the quaternions. Zero for a time of zero.
+		vr::HmdVector3d_t quaternionVelocity(double time, const vr::HmdQuaternion_t& q, const vr::HmdQuaternion_t& Old_q);
+
+		// Derivative of a vector, zero for a time of zero
+		vr::HmdVector3d_t vecDerivative(double time, const vr::HmdVector3d_t& vec, const vr::HmdVector3d_t& Old_vec);
+
+		vr::HmdVector3d_t toEulerAngles(vr::HmdQuaternion_t q);
+	}
+}
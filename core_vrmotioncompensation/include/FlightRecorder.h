@@ -0,0 +1,152 @@
+#pragma once
+
+#include "TelemetryRing.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Always-on flight recorder: the last seconds of compensated poses, with the reference and the state of its filter,
+// in a preallocated ring in memory. A trigger, by request or from an anomaly in the poses, makes a background
+// thread write the poses around it into a capture file (CaptureFile.h). The pose threads never wait for a dump.
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// The telemetry of a compensated pose and the derivatives the reference filter estimated
+		struct FlightRecorderEntry
+		{
+			TelemetryEntry_v1 Telemetry;		// Telemetry.Sequence guards the entry in the ring
+			vr::HmdVector3d_t RefVelocity;
+			vr::HmdVector3d_t RefAcceleration;
+			vr::HmdVector3d_t RefAngularVelocity;
+			vr::HmdVector3d_t RefAngularAcceleration;
+		};
+
+		class FlightRecorder
+		{
+		public:
+			// Ring entries per second of FlightRecorderSettings::Seconds: the HMD at 1 kHz and a few trackers or controllers
+			static const uint32_t EntriesPerSecond = 2000;
+
+			static const uint32_t MaxSeconds = 60;
+			static const uint32_t MaxPostTriggerMs = 10000;
+
+			// Consecutive poses of a device further apart than this are not compared for a position jump
+			static const int64_t MaxJumpIntervalNs = 100000000;
+
+			// Device ids with their own anomaly state, like vr::k_unMaxTrackedDeviceCount
+			static const uint32_t MaxDevices = 64;
+
+			FlightRecorder() = default;
+			FlightRecorder(const FlightRecorder&) = delete;
+			FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+			~FlightRecorder();
+
+			// Defaults: off, 10 s before and 1 s after a trigger, 10 cm jumps, 50 cm compensation, dump on tracking lost
+			static FlightRecorderSettings defaultSettings();
+
+			// Returns false for settings out of range. The ring is allocated the first time the recorder is enabled and
+			// only grows, a smaller ring that writers may still use is kept until the recorder is destroyed
+			bool configure(const FlightRecorderSettings& settings);
+
+			FlightRecorderSettings getSettings();
+
+			bool isEnabled() const
+			{
+				return _Enabled.load(std::memory_order_relaxed);
+			}
+
+			// Directory the dumps are written to, empty for the working directory
+			void setDirectory(const std::string& directory);
+
+			// Called by the dump thread after each dump with the trigger, the file and the number of poses in it,
+			// or an empty path if the file could not be written
+			void setDumpCallback(std::function<void(FlightRecorderTrigger, const std::string&, size_t)> callback);
+
+			// Pose threads, allocation and lock free. Keeps the entry and checks it for anomalies. The TelemetryFlag_DeviceTracking
+			// flag of the entry is the tracking state of its device
+			void record(const FlightRecorderEntry& entry);
+
+			// Tracking state of a device that is not compensated, e.g. a reference tracker
+			void updateTracking(uint32_t deviceId, bool tracking, int64_t timeNs);
+
+			// Any thread. Asks for a dump of the poses around timeNs (TelemetryWriter::nowNs). Returns false if the recorder
+			// is off or another dump is still pending, the trigger is dropped then
+			bool trigger(FlightRecorderTrigger reason, int64_t timeNs);
+
+			// Dumps written since the recorder was created
+			uint32_t getDumpCount() const
+			{
+				return _Dumps.load(std::memory_order_acquire);
+			}
+
+		private:
+			struct Ring
+			{
+				uint64_t WriteIndex = 0;
+				uint32_t EntryCount = 0;
+				std::unique_ptr<FlightRecorderEntry[]> Entries;
+			};
+
+			// Written only by the pose thread of the device, in record
+			struct alignas(64) DeviceState
+			{
+				int64_t LastTimeNs = 0;
+				vr::HmdVector3d_t LastPosition = {};
+				vr::HmdVector3d_t LastReference = {};
+				bool Compensated = false;
+				bool Tracking = false;
+			};
+
+			// Written only by the reference thread, in updateTracking. Kept apart from DeviceState, a device can be
+			// compensated and used as a reference at the same time
+			struct alignas(64) TrackingState
+			{
+				bool Tracking = false;
+			};
+
+			void dumpLoop();
+
+			// Copies the poses around the trigger out of the ring and writes them, returns the file or "" on failure
+			std::string dump(FlightRecorderTrigger reason, int64_t triggerNs, const FlightRecorderSettings& settings, const std::string& directory, size_t& entries);
+
+			std::atomic<bool> _Enabled = { false };
+			std::atomic<Ring*> _Ring = { nullptr };
+			std::vector<std::unique_ptr<Ring>> _Rings;
+
+			// Anomaly thresholds, read by the pose threads
+			std::atomic<double> _MaxPositionJump = { 0.0 };
+			std::atomic<double> _MaxCompensationDelta = { 0.0 };
+			std::atomic<bool> _DumpOnTrackingLost = { false };
+			DeviceState _Devices[MaxDevices];
+			TrackingState _TrackedDevices[MaxDevices];
+
+			// Pending trigger. The first trigger claims it and publishes its time and reason, FlightRecorderTrigger::None
+			// while there is none. The dump thread releases it when the dump is written
+			std::atomic<bool> _TriggerClaimed = { false };
+			std::atomic<uint32_t> _Trigger = { 0 };
+			std::atomic<int64_t> _TriggerNs = { 0 };
+			std::atomic<uint32_t> _Dumps = { 0 };
+
+			// Settings, directory and callback of the dump thread
+			std::mutex _Mutex;
+			std::condition_variable _Wake;
+			FlightRecorderSettings _Settings = defaultSettings();
+			std::string _Directory;
+			std::function<void(FlightRecorderTrigger, const std::string&, size_t)> _Callback;
+			std::thread _DumpThread;
+			bool _Stop = false;
+
+			// Dump thread only, numbers the files so that dumps within the same millisecond do not overwrite each other
+			uint32_t _DumpSequence = 0;
+		};
+	}
+}
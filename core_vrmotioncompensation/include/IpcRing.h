@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bounded queue of fixed-size messages in memory shared between processes, the ipc transport of the driver and
+// the client library next to boost::interprocess::message_queue. Any number of threads and processes may send,
+// one thread receives. A receiver without messages sleeps in the kernel, on a futex on Linux and on a named event
+// on Windows, and the sender that fills the queue wakes it, so there is neither a polling interval nor a syscall
+// while the receiver is busy. Opening and mapping the memory is left to the caller.
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		struct IpcRingHeader
+		{
+			uint32_t Magic;
+			uint32_t Version;
+			uint32_t SlotCount;					// Power of two
+			uint32_t SlotSize;					// Largest message in bytes
+			alignas(64) std::atomic<uint64_t> Tail;		// Next index a sender claims
+			alignas(64) std::atomic<uint64_t> Head;		// Next index the receiver reads
+			alignas(64) std::atomic<uint32_t> Signal;	// Bumped after every send, the receiver sleeps on it
+			std::atomic<uint32_t> Sleepers;				// The receiver is about to sleep or sleeping
+		};
+
+		class IpcRing
+		{
+		public:
+			static const uint32_t Magic = 0x52495652;	// "RVIR"
+			static const uint32_t Version = 1;
+
+			IpcRing() = default;
+			~IpcRing();
+
+			IpcRing(const IpcRing&) = delete;
+			IpcRing& operator=(const IpcRing&) = delete;
+
+			// Bytes of shared memory a ring needs
+			static size_t requiredSize(uint32_t slotCount, uint32_t slotSize);
+
+			// Lays out an empty ring in memory (64 byte aligned, at least requiredSize). Only the side that created the
+			// memory calls it, before anyone else attaches. A ring already in memory is overwritten with its messages,
+			// so a driver can take over the memory of the one before it. name identifies the wake event on Windows
+			bool create(void* memory, size_t size, uint32_t slotCount, uint32_t slotSize, const char* name);
+
+			// Attaches to a ring that another process created. False if memory does not hold a ring of this version
+			bool attach(void* memory, size_t size, const char* name);
+
+			void detach();
+
+			bool isAttached() const
+			{
+				return _Header != nullptr;
+			}
+
+			uint32_t getSlotSize() const
+			{
+				return _Header ? _Header->SlotSize : 0;
+			}
+
+			// Any thread or process. Copies the message into a free slot and wakes the receiver. A full ring is
+			// retried for up to timeoutMs. False if the message is larger than a slot or the ring stayed full.
+			// A sender that dies between claiming and filling its slot blocks the ring for good
+			bool send(const void* data, uint32_t size, uint32_t timeoutMs);
+
+			// The receiving thread only. Copies the oldest message into data, sleeps for up to timeoutMs if there is none.
+			// False on timeout, or if the message does not fit into capacity, which drops it
+			bool receive(void* data, uint32_t capacity, uint32_t& size, uint32_t timeoutMs);
+
+			// Like receive, without sleeping
+			bool tryReceive(void* data, uint32_t capacity, uint32_t& size);
+
+		private:
+			struct Slot
+			{
+				std::atomic<uint64_t> Sequence;		// index while free, index + 1 once filled, index + SlotCount when read
+				uint32_t Size;
+				uint32_t Reserved;
+			};
+
+			Slot* slotAt(uint64_t index) const
+			{
+				return reinterpret_cast<Slot*>(_Slots + (size_t)(index & _Mask) * _SlotStride);
+			}
+
+			bool trySend(const void* data, uint32_t size);
+			bool openEvent(const char* name);
+			void wake();
+			void sleep(uint32_t key, uint32_t timeoutMs);
+
+			IpcRingHeader* _Header = nullptr;
+			char* _Slots = nullptr;
+			uint64_t _Mask = 0;
+			size_t _SlotStride = 0;
+			void* _Event = nullptr;		// Windows event handle
+		};
+
+		static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+			"The ipc ring needs address-free atomics to work across processes");
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "vrmc_openvr.h"
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// 6-DOF Kalman filter for the reference tracker pose.
+		// Each position axis uses a constant acceleration model with the state [position, velocity, acceleration].
+		// The orientation is filtered as an error state: the nominal rotation is propagated with the estimated
+		// angular velocity and acceleration (driver space), the filter state holds the small rotation
+		// vector away from it and is folded back into the nominal rotation after every measurement.
+		// Noise and time step are the same for all six axes, so they share one covariance and one gain.
+		class PoseKalmanFilter
+		{
+		public:
+			struct State
+			{
+				vr::HmdVector3d_t Pos;
+				vr::HmdVector3d_t Vel;
+				vr::HmdVector3d_t Acc;
+				vr::HmdQuaternion_t Rot;
+				vr::HmdVector3d_t AngVel;
+				vr::HmdVector3d_t AngAcc;
+			};
+
+			// A measurement further than this from the previous one restarts the filter
+			static const long long MaxGapUs = 500000;
+
+			// processNoise is the spectral density of the jerk (m^2/s^5, rad^2/s^5 for the rotation),
+			// observationNoise the standard deviation of the tracker pose (m, rad)
+			void setNoise(double processNoise, double observationNoise);
+
+			double getProcessNoise() const
+			{
+				return _ProcessNoise;
+			}
+
+			double getObservationNoise() const
+			{
+				return _ObservationNoise;
+			}
+
+			// Forgets the state, the next measurement initializes the filter again
+			void reset()
+			{
+				_Initialized = false;
+			}
+
+			bool isInitialized() const
+			{
+				return _Initialized;
+			}
+
+			// Adds a measurement sampled at timeUs
+			void update(long long timeUs, const double(&pos)[3], const vr::HmdQuaternion_t& rot);
+
+			// Filtered state, extrapolated by latency seconds past the last measurement
+			State predict(double latency) const;
+
+		private:
+			void initialize(long long timeUs, const double(&pos)[3], const vr::HmdQuaternion_t& rot);
+
+			double _ProcessNoise = 5.0;
+			double _ObservationNoise = 0.0005;
+
+			bool _Initialized = false;
+			long long _LastTimeUs = 0;
+
+			// Position state per axis: x = [p, v, a]
+			double _Pos[3][3] = {};
+
+			// Nominal rotation plus angular velocity and acceleration
+			vr::HmdQuaternion_t _Rot = { 1, 0, 0, 0 };
+			double _AngVel[3] = {};
+			double _AngAcc[3] = {};
+
+			// Shared covariance of [p, v, a]
+			double _P[3][3] = {};
+		};
+	}
+}
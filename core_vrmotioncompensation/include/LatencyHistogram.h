@@ -0,0 +1,145 @@
+#pragma once
+
+// Like vrmotioncompensation_types.h this expects the OpenVR types to be declared already
+#include <vrmotioncompensation_types.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Lock-free latency histograms for the pose path. Values are bucketed log-linearly like in an HDR histogram:
+// exact below 64 ns, then 32 buckets per power of two, so a percentile is at most 1/32 above the true value.
+// Any number of threads may record into a histogram while another one reads it.
+//
+// The pose path uses the VRMC_LATENCY_ macros at the end of this file. Defining VRMC_NO_LATENCY_HISTOGRAMS
+// compiles them out, the pose path then does not even read the clock.
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		class LatencyHistogram
+		{
+		public:
+			static const uint32_t SubBucketBits = 5;
+			static const uint32_t SubBuckets = 1u << SubBucketBits;
+
+			// Values from 2^MaxBits ns (about 134 ms) on share the last bucket, the maximum is still kept exactly
+			static const uint32_t MaxBits = 27;
+			static const uint32_t BucketCount = (MaxBits - SubBucketBits + 1) * SubBuckets;
+
+			LatencyHistogram()
+			{
+				reset();
+			}
+
+			LatencyHistogram(const LatencyHistogram&) = delete;
+			LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+			static uint32_t bucketOf(uint64_t ns)
+			{
+				if (ns < 2 * SubBuckets)
+				{
+					return (uint32_t)ns;
+				}
+				uint32_t msb = highestBit(ns);
+				if (msb >= MaxBits)
+				{
+					return BucketCount - 1;
+				}
+				uint32_t shift = msb - SubBucketBits;
+				return shift * SubBuckets + (uint32_t)(ns >> shift);
+			}
+
+			// Largest value that falls into a bucket
+			static uint64_t bucketUpperEdge(uint32_t bucket)
+			{
+				if (bucket < 2 * SubBuckets)
+				{
+					return bucket;
+				}
+				uint32_t shift = bucket / SubBuckets - 1;
+				uint64_t sub = bucket % SubBuckets + SubBuckets;
+				return ((sub + 1) << shift) - 1;
+			}
+
+			// Any thread, two relaxed atomic operations as long as the maximum does not grow
+			void record(uint64_t ns)
+			{
+				_Counts[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+				uint64_t max = _Max.load(std::memory_order_relaxed);
+				while (ns > max && !_Max.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+				{
+				}
+			}
+
+			// Sums the buckets while they are recorded into, a value recorded meanwhile may be left out
+			LatencyStatistics getStatistics() const;
+
+			// Values recorded during the reset may survive it
+			void reset();
+
+			// The clock of the VRMC_LATENCY_ macros
+			static int64_t nowNs()
+			{
+				return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+			}
+
+		private:
+			static uint32_t highestBit(uint64_t value)
+			{
+#if defined(_MSC_VER)
+				unsigned long index;
+				_BitScanReverse64(&index, value);
+				return (uint32_t)index;
+#else
+				return 63 - (uint32_t)__builtin_clzll(value);
+#endif
+			}
+
+			std::atomic<uint64_t> _Counts[BucketCount];
+			std::atomic<uint64_t> _Max;
+		};
+
+		// Records the time from its construction to the end of its scope
+		class LatencyScope
+		{
+		public:
+			explicit LatencyScope(LatencyHistogram& histogram) : _Histogram(histogram), _StartNs(LatencyHistogram::nowNs())
+			{
+			}
+
+			LatencyScope(const LatencyScope&) = delete;
+			LatencyScope& operator=(const LatencyScope&) = delete;
+
+			~LatencyScope()
+			{
+				_Histogram.record((uint64_t)(LatencyHistogram::nowNs() - _StartNs));
+			}
+
+		private:
+			LatencyHistogram& _Histogram;
+			int64_t _StartNs;
+		};
+	}
+}
+
+#ifndef VRMC_NO_LATENCY_HISTOGRAMS
+
+// Times the rest of the enclosing block, once per block
+#define VRMC_LATENCY_SCOPE(histogram) ::vrmotioncompensation::core::LatencyScope vrmcLatencyScope(histogram)
+
+// Times the code from VRMC_LATENCY_START to VRMC_LATENCY_RECORD with the same name
+#define VRMC_LATENCY_START(name) const int64_t name = ::vrmotioncompensation::core::LatencyHistogram::nowNs()
+#define VRMC_LATENCY_RECORD(name, histogram) (histogram).record((uint64_t)(::vrmotioncompensation::core::LatencyHistogram::nowNs() - name))
+
+#else
+
+#define VRMC_LATENCY_SCOPE(histogram) ((void)0)
+#define VRMC_LATENCY_START(name) ((void)0)
+#define VRMC_LATENCY_RECORD(name, histogram) ((void)0)
+
+#endif
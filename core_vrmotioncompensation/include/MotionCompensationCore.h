@@ -0,0 +1,278 @@
+#pragma once
+
+#include "vrmc_openvr.h"
+#include "Spinlock.h"
+#include "SeqLock.h"
+#include "ReferenceHistory.h"
+#include "FilterPipeline.h"
+#include "TelemetryRing.h"
+#include "FlightRecorder.h"
+#include <openvr_math.h>
+#include <vrmotioncompensation_types.h>
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+
+// Platform-neutral motion compensation core.
+// Holds the reference tracker filter chain and the compensation math. It has no dependency on
+// SteamVR, Windows or shared memory, so it can be driven by the driver as well as by tools and benchmarks.
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// Everything the HMD thread needs for one compensation step. Published as a whole by the writer,
+		// so the reader always sees zero pose, reference pose and its derivatives from the same update.
+		struct ReferenceSnapshot
+		{
+			// Zero position
+			vr::HmdVector3d_t ZeroPos;
+			vr::HmdQuaternion_t ZeroRot;
+
+			// Reference position
+			vr::HmdVector3d_t RefPos;
+			vr::HmdQuaternion_t RefRot;
+			vr::HmdQuaternion_t RefRotInv;
+
+			vr::HmdVector3d_t RefVel;
+			vr::HmdVector3d_t RefAcc;
+			vr::HmdVector3d_t RefRotVel;
+			vr::HmdVector3d_t RefRotAcc;
+
+			// Rotation matrices cached when the reference is published, so the HMD path only needs
+			// matrix-vector products. The transpose of RefRotMat is the RefRotInv rotation.
+			vrmath::Matrix33d RefRotMat;
+			vr::HmdQuaternion_t WorldFromDriverRot;
+			vrmath::Matrix33d WorldFromDriverMat;
+
+			// Newest reference pose before filtering, in app space, and its sample time. Only for telemetry
+			vr::HmdVector3d_t RawRefPos;
+			vr::HmdQuaternion_t RawRefRot;
+			long long RefSampleUs;
+
+			// Number of reference updates since the reference was (re)started
+			uint32_t RefUpdateCount;
+
+			bool Enabled;
+			bool ZeroPoseValid;
+			bool RefPoseValid;
+			bool SetZeroMode;
+		};
+
+		class MotionCompensationCore
+		{
+		public:
+			MotionCompensationCore();
+
+			// Enables or disables compensation. Enabling invalidates the zero and reference pose
+			void setEnabled(bool enabled);
+
+			bool isEnabled() const
+			{
+				return _Snapshot.load().Enabled;
+			}
+
+			void setAlpha(uint32_t samples);
+
+			uint32_t getSamples() const
+			{
+				std::lock_guard<Spinlock> lock(_WriterLock);
+				return _Samples;
+			}
+
+			void setLpfBeta(double NewBeta);
+
+			double getLpfBeta() const
+			{
+				std::lock_guard<Spinlock> lock(_WriterLock);
+				return _Filter.LpfBeta;
+			}
+
+			// Selects the reference tracker filter. Changing it restarts the filter
+			void setFilterType(MotionCompensationFilterType type);
+
+			MotionCompensationFilterType getFilterType() const
+			{
+				std::lock_guard<Spinlock> lock(_WriterLock);
+				return _FilterType;
+			}
+
+			// Noise model of the Kalman filter, see PoseKalmanFilter::setNoise
+			void setKalmanNoise(double processNoise, double observationNoise);
+
+			double getKalmanProcessNoise() const
+			{
+				std::lock_guard<Spinlock> lock(_WriterLock);
+				return _Filter.Kalman.getProcessNoise();
+			}
+
+			double getKalmanObservationNoise() const
+			{
+				std::lock_guard<Spinlock> lock(_WriterLock);
+				return _Filter.Kalman.getObservationNoise();
+			}
+
+			// How far the Kalman filter predicts the reference pose past its sample time,
+			// usually the delivery latency of the reference tracker
+			void setKalmanPrediction(long long us);
+
+			long long getKalmanPrediction() const
+			{
+				std::lock_guard<Spinlock> lock(_WriterLock);
+				return _Filter.KalmanPredictionUs;
+			}
+
+			// Cutoff at rest (Hz) and speed coefficient of the One Euro filter
+			void setOneEuroParameters(double minCutoff, double beta);
+
+			double getOneEuroMinCutoff() const
+			{
+				std::lock_guard<Spinlock> lock(_WriterLock);
+				return _Filter.OneEuro.getMinCutoff();
+			}
+
+			double getOneEuroBeta() const
+			{
+				std::lock_guard<Spinlock> lock(_WriterLock);
+				return _Filter.OneEuro.getBeta();
+			}
+
+			// Passes the reference pose through unfiltered, with the derivatives it carries. For reference poses that are
+			// not measured but commanded, like the rig pose, where filtering would only add lag
+			void setFilterBypass(bool bypass);
+
+			bool getFilterBypass() const
+			{
+				std::lock_guard<Spinlock> lock(_WriterLock);
+				return _FilterBypass;
+			}
+
+			void setZeroMode(bool setZero);
+
+			bool getZeroMode() const
+			{
+				return _Snapshot.load().SetZeroMode;
+			}
+
+			bool isZeroPoseValid() const
+			{
+				return _Snapshot.load().ZeroPoseValid;
+			}
+
+			bool isRefPoseValid() const
+			{
+				return _Snapshot.load().RefPoseValid;
+			}
+
+			// Consistent copy of the state last published by the reference tracker thread
+			ReferenceSnapshot getSnapshot() const
+			{
+				return _Snapshot.load();
+			}
+
+			void resetZeroPose();
+
+			// Invalidates the zero and reference pose, e.g. after the reference tracker changed
+			void resetRefPose();
+
+			void setZeroPose(const vr::DriverPose_t& pose);
+
+			// timestampUs is the time of the call in microseconds. The driver passes the system clock,
+			// tools can pass a virtual clock.
+			void updateRefPose(const vr::DriverPose_t& pose, long long timestampUs);
+
+			// Compensates with the latest reference pose
+			bool applyMotionCompensation(vr::DriverPose_t& pose);
+
+			// Compensates with the reference pose interpolated or extrapolated to the time the device pose was sampled
+			// (timestampUs + poseTimeOffset). timestampUs has to come from the same clock as for updateRefPose.
+			// deviceId only tags the telemetry entry
+			bool applyMotionCompensation(vr::DriverPose_t& pose, long long timestampUs, uint32_t deviceId = TelemetryNoDevice);
+
+			// Same as above, then moves the compensated pose by the offset of the device. A pose that is not compensated
+			// (disabled, or no valid zero or reference pose) keeps its place without the offset, so the device does not jump
+			// by its offset when compensation drops out or comes back. All compensated devices read the same published snapshot, so every additional device costs one snapshot read and no locking or filtering
+			bool applyMotionCompensation(vr::DriverPose_t& pose, long long timestampUs, const MotionCompensationDeviceOffset& offset, uint32_t deviceId = TelemetryNoDevice);
+
+			// Publishes every compensated pose together with the raw and filtered reference into the ring, nullptr stops it.
+			// The ring has to be initialized and stay mapped while it is set
+			void setTelemetry(MMFstruct_OVRMC_Telemetry_v1* ring)
+			{
+				_Telemetry.store(ring, std::memory_order_release);
+			}
+
+			// Hands every compensated pose with the reference and its filter state to the flight recorder while it is enabled,
+			// nullptr stops it. The recorder has to outlive the core or be reset first
+			void setFlightRecorder(FlightRecorder* recorder)
+			{
+				_FlightRecorder.store(recorder, std::memory_order_release);
+			}
+
+			// Moves a pose by a rigid offset given in the pose's own frame
+			static void applyDeviceOffset(vr::DriverPose_t& pose, const MotionCompensationDeviceOffset& offset);
+
+			// Limits how far the reference pose may be extrapolated past its newest sample
+			void setMaxExtrapolation(long long us)
+			{
+				_MaxExtrapolationUs.store(us, std::memory_order_relaxed);
+			}
+
+			long long getMaxExtrapolation() const
+			{
+				return _MaxExtrapolationUs.load(std::memory_order_relaxed);
+			}
+
+		private:
+			void compensate(const ReferenceSnapshot& ref, vr::DriverPose_t& pose);
+
+			// Both timestamped applyMotionCompensation overloads, offset may be nullptr
+			bool compensateAt(vr::DriverPose_t& pose, long long timestampUs, const MotionCompensationDeviceOffset* offset, uint32_t deviceId);
+
+			static TelemetryPose_v1 toTelemetryPose(const vr::DriverPose_t& pose);
+
+			static long long sampleTime(const vr::DriverPose_t& pose, long long timestampUs)
+			{
+				return timestampUs + (long long)(pose.poseTimeOffset * 1.0E6);
+			}
+
+			// Picks the filter pipeline for the current settings. Called with _WriterLock held
+			void selectPipeline()
+			{
+				_Pipeline = _FilterBypass
+					? selectFilterPipeline(MotionCompensationFilterType::Default, 1, 1.0, _State.SetZeroMode)
+					: selectFilterPipeline(_FilterType, _Samples, _Filter.LpfBeta, _State.SetZeroMode);
+			}
+
+			inline void _zeroVec(double(&d)[3])
+			{
+				d[0] = d[1] = d[2] = 0.0;
+			}
+
+			inline void _zeroVec(vr::HmdVector3d_t & d)
+			{
+				d.v[0] = d.v[1] = d.v[2] = 0.0;
+			}
+
+			// Filter settings and state, modified and read under _WriterLock
+			MotionCompensationFilterType _FilterType = MotionCompensationFilterType::Default;
+			uint32_t _Samples = 100;
+			bool _FilterBypass = false;
+			FilterContext _Filter;
+			FilterPipelineFn _Pipeline = nullptr;
+
+			// Writer side copy of the published state. Writers (reference tracker thread and IPC thread)
+			// modify it under _WriterLock and then publish it. The HMD thread only reads _Snapshot.
+			mutable Spinlock _WriterLock;
+			ReferenceSnapshot _State;
+			SeqLock<ReferenceSnapshot> _Snapshot;
+
+			// Timestamped reference poses in app space (world rotation, not relative to the zero pose). Written and
+			// cleared under _WriterLock, read lock-free by the HMD thread
+			ReferenceHistory _History;
+			std::atomic<long long> _MaxExtrapolationUs = { 20000 };
+
+			std::atomic<MMFstruct_OVRMC_Telemetry_v1*> _Telemetry = { nullptr };
+			std::atomic<FlightRecorder*> _FlightRecorder = { nullptr };
+		};
+	}
+}
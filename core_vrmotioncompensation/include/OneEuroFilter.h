@@ -0,0 +1,78 @@
+#pragma once
+
+#include "vrmc_openvr.h"
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// One Euro filter (Casiez et al.) for the reference tracker pose.
+		// A first order low pass whose cutoff rises with the filtered speed: little jitter at rest, little lag in motion.
+		// The position uses the speed of the position vector, the rotation the angular speed. The rotation is
+		// smoothed on the shortest arc towards the measurement, with the same exp / log maps as the Kalman filter.
+		// Cutoff and beta are shared by position (m, m/s) and rotation (rad, rad/s).
+		class PoseOneEuroFilter
+		{
+		public:
+			// The velocities are the rates of the filtered pose over the last step, so they match the motion of the pose
+			// that is published with them. The speed that raises the cutoff lags behind them, see DerivativeCutoff
+			struct State
+			{
+				vr::HmdVector3d_t Pos;
+				vr::HmdVector3d_t Vel;
+				vr::HmdQuaternion_t Rot;
+				vr::HmdVector3d_t AngVel;
+			};
+
+			// A measurement further than this from the previous one restarts the filter
+			static const long long MaxGapUs = 500000;
+
+			// Cutoff of the speed filter in Hz. The filtered speed only sets the cutoff and is not published
+			static constexpr double DerivativeCutoff = 1.0;
+
+			// minCutoff is the cutoff at rest in Hz, beta how fast the cutoff rises with the speed
+			void setParameters(double minCutoff, double beta);
+
+			double getMinCutoff() const
+			{
+				return _MinCutoff;
+			}
+
+			double getBeta() const
+			{
+				return _Beta;
+			}
+
+			// Forgets the state, the next measurement initializes the filter again
+			void reset()
+			{
+				_Initialized = false;
+			}
+
+			// Adds a measurement sampled at timeUs
+			void update(long long timeUs, const double(&pos)[3], const vr::HmdQuaternion_t& rot);
+
+			const State& state() const
+			{
+				return _State;
+			}
+
+		private:
+			double _MinCutoff = 1.0;
+			double _Beta = 1.0;
+
+			bool _Initialized = false;
+			long long _LastTimeUs = 0;
+
+			// Last measurement, the speed is estimated from the raw poses
+			double _LastPos[3] = {};
+			vr::HmdQuaternion_t _LastRot = { 1, 0, 0, 0 };
+
+			// Filtered speeds that set the cutoffs
+			vr::HmdVector3d_t _Speed = {};
+			vr::HmdVector3d_t _AngularSpeed = {};
+
+			State _State = {};
+		};
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "vrmc_openvr.h"
+#include <vrmotioncompensation_types.h>
+#include "MotionCompensationCore.h"
+#include "ReferenceTrackers.h"
+
+#include <cstdio>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		enum class ReplayRole : uint32_t
+		{
+			Reference,		// Pose of a reference tracker
+			Compensated,	// Pose of a motion compensated device
+		};
+
+		// One recorded pose as the driver got it from the device driver, stamped with the time it arrived
+		struct ReplaySample
+		{
+			long long TimestampUs;
+			uint32_t DeviceId;
+			ReplayRole Role;
+			vr::DriverPose_t Pose;
+		};
+
+		// Replays recorded poses offline, without SteamVR. Every sample goes the way DeviceManipulationHandle::handlePoseUpdate
+		// sends it through the MotionCompensationManager, but on a virtual clock: the time of a sample is its timestamp
+		// instead of the system clock, so a replay gives the same output on every run and as fast as the poses can be computed.
+		// The rig pose mode is not replayed, the rig pose comes from the shared memory and not from a device.
+		// Not thread-safe, the samples are replayed one after the other
+		class PoseReplay
+		{
+		public:
+			PoseReplay();
+
+			// Filter settings, like the IPC requests of the overlay set them in the driver
+			MotionCompensationCore& getCore()
+			{
+				return _Core;
+			}
+
+			// Reference tracker ids and zero pose calibration. Without any reference tracker set, every reference sample
+			// counts as the one reference tracker, like the driver does in a single tracker setup
+			ReferenceTrackers& getReferenceTrackers()
+			{
+				return _ReferenceTrackers;
+			}
+
+			// Offset of a compensated device, see DeviceManipulationHandle::setOffset
+			void setDeviceOffset(uint32_t deviceId, const MotionCompensationDeviceOffset& offset);
+
+			// Makes every device with reference samples a reference tracker, in the order of their first sample
+			void setReferenceTrackers(const std::vector<ReplaySample>& samples);
+
+			// Replays one sample at its timestamp. Returns true for the sample of a compensated device,
+			// output then holds the pose the driver would hand on to SteamVR
+			bool process(const ReplaySample& sample, ReplaySample& output);
+
+			// Replays samples in their order and appends the poses of the compensated devices to output
+			void run(const std::vector<ReplaySample>& samples, std::vector<ReplaySample>& output);
+
+			// Current time of the virtual clock, the timestamp of the last sample
+			long long getTime() const
+			{
+				return _TimeUs;
+			}
+
+			// Calibration windows the replay has completed, see ReferenceTrackers::update
+			uint32_t getCalibrationWindows() const
+			{
+				return _CalibrationWindows;
+			}
+
+			// Recorded poses as csv, one sample per line, with the columns of writeCsvHeader.
+			// The numbers are written with as many digits as needed to read back the same doubles, so a replay of a file
+			// gives the same output as the replay of the samples it was written from.
+			// Lines starting with # are comments. Returns false and the line number if a line cannot be read
+			static bool readCsv(std::FILE* file, std::vector<ReplaySample>& samples, size_t& errorLine);
+
+			static void writeCsvHeader(std::FILE* file);
+
+			static void writeCsv(std::FILE* file, const ReplaySample& sample);
+
+		private:
+			MotionCompensationCore _Core;
+			ReferenceTrackers _ReferenceTrackers{ _Core };
+			std::unordered_map<uint32_t, MotionCompensationDeviceOffset> _Offsets;
+			long long _TimeUs = 0;
+			uint32_t _CalibrationWindows = 0;
+		};
+	}
+}
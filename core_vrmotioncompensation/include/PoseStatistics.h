@@ -0,0 +1,72 @@
+#pragma once
+
+#include "vrmc_openvr.h"
+#include <vrmotioncompensation_types.h>
+#include "LatencyHistogram.h"
+
+#include <atomic>
+#include <stdint.h>
+
+// Update rate, inter-arrival jitter, poseTimeOffset and tracking state of the poses of one device, and both
+// sides of the shared memory block they are published in (MMFstruct_OVRMC_PoseStatistics_v1).
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		class PoseStatisticsCounter
+		{
+		public:
+			PoseStatisticsCounter()
+			{
+				reset();
+			}
+
+			PoseStatisticsCounter(const PoseStatisticsCounter&) = delete;
+			PoseStatisticsCounter& operator=(const PoseStatisticsCounter&) = delete;
+
+			// Pose threads, lock free. nowNs is the arrival time on LatencyHistogram::nowNs
+			void record(const vr::DriverPose_t& pose, int64_t nowNs);
+
+			// Any thread. OpenVRId is left 0
+			PoseStatistics_v1 getStatistics() const;
+
+			// Poses recorded during the reset may survive it
+			void reset();
+
+		private:
+			std::atomic<uint64_t> _Count;
+			std::atomic<uint64_t> _InvalidCount;
+			std::atomic<uint64_t> _NotRunningOkCount;
+			std::atomic<int64_t> _FirstNs;
+			std::atomic<int64_t> _LastNs;
+			std::atomic<int64_t> _TimeOffsetMinNs;
+			std::atomic<int64_t> _TimeOffsetMaxNs;
+			std::atomic<int64_t> _TimeOffsetSumNs;
+			LatencyHistogram _Interval;
+			LatencyHistogram _TimeOffset;
+		};
+
+		// Writing side, the driver. One writer per block
+		class PoseStatisticsWriter
+		{
+		public:
+			// Writes magic, version and sizes and empty statistics. Only call it while no reader relies on the block
+			static void init(MMFstruct_OVRMC_PoseStatistics_v1& block);
+
+			// devices is indexed by OpenVR id and holds PoseStatisticsDeviceCount entries
+			static void publish(MMFstruct_OVRMC_PoseStatistics_v1& block, const PoseStatistics_v1* devices, int64_t timeNs);
+		};
+
+		// Reading side, e.g. the overlay
+		class PoseStatisticsReader
+		{
+		public:
+			// Retries of a torn copy before the read gives up
+			static const int MaxRetries = 8;
+
+			// Consistent copy of the statistics of all devices into devices (PoseStatisticsDeviceCount entries).
+			// False if the block was never written, has another version or the driver kept updating it
+			static bool read(const MMFstruct_OVRMC_PoseStatistics_v1& block, PoseStatistics_v1* devices, int64_t& timeNs);
+		};
+	}
+}
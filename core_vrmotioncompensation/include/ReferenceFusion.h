@@ -0,0 +1,95 @@
+#pragma once
+
+#include "vrmc_openvr.h"
+#include <vrmotioncompensation_types.h>
+
+#include <stdint.h>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// Fuses several reference trackers mounted on the same rig into one reference pose.
+		// At calibration each tracker's rigid offset to the rig frame is measured, the rig frame being the pose of the
+		// first tracker at that time. Afterwards every tracker gives its own estimate of the rig pose. The estimates of all
+		// trackers that are Running_OK are averaged with their weights, the rotation on the quaternion manifold.
+		// A tracker that drops out is left out until it reports again, so occluding one tracker does not freeze the reference.
+		// Only touched by the reference tracker thread, or under the caller's lock.
+		class ReferenceFusion
+		{
+		public:
+			static const uint32_t MaxTrackers = MaxReferenceTrackers;
+
+			// A tracker sample older than this is not used
+			static const long long MaxAgeUs = 50000;
+
+			// Frames with all trackers running the offsets are averaged over
+			static const uint32_t CalibrationFrames = 64;
+
+			// Sets the number of trackers and their weights (nullptr for equal weights). Forgets the calibration
+			void setTrackers(uint32_t count, const double* weights = nullptr);
+
+			uint32_t trackerCount() const
+			{
+				return _Count;
+			}
+
+			double getWeight(uint32_t slot) const
+			{
+				return slot < _Count ? _Slots[slot].Weight : 0.0;
+			}
+
+			// Forgets the calibration and all samples, the next samples calibrate again
+			void reset();
+
+			bool isCalibrated() const
+			{
+				return _Calibrated;
+			}
+
+			// Adds a sample of the tracker in the given slot. timestampUs is the time of the call in microseconds.
+			// Returns true and the fused rig pose when this sample completes a frame: the first tracker that is
+			// running paces the output, the others only update their slot. Calibrates as soon as every tracker is running,
+			// there is no output until then.
+			bool update(uint32_t slot, const vr::DriverPose_t& pose, long long timestampUs, vr::DriverPose_t& fused);
+
+			// Number of trackers used for the last fused pose
+			uint32_t usedTrackers() const
+			{
+				return _UsedTrackers;
+			}
+
+		private:
+			struct Slot
+			{
+				double Weight = 1.0;
+
+				// Last sample, in driver space
+				bool Valid = false;
+				long long SampleUs = 0;
+				vr::DriverPose_t Pose;
+
+				// Tracker pose in the rig frame
+				vr::HmdVector3d_t OffsetPos;
+				vr::HmdQuaternion_t OffsetRot;
+
+				// Sum of the rotation offsets relative to the first calibration frame
+				vr::HmdVector3d_t CalibrationRot;
+			};
+
+			// Tracker pose moved to timeUs with its velocities
+			void trackerPose(const Slot& slot, long long timeUs, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot) const;
+
+			// Rig pose estimated from one slot, moved to timeUs with the tracker's velocities
+			void rigEstimate(const Slot& slot, long long timeUs, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot) const;
+
+			bool calibrate(long long timeUs);
+
+			uint32_t _Count = 1;
+			bool _Calibrated = false;
+			uint32_t _CalibrationFrames = 0;
+			uint32_t _UsedTrackers = 0;
+			Slot _Slots[MaxTrackers];
+		};
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "vrmc_openvr.h"
+#include "SeqLock.h"
+
+#include <atomic>
+#include <stdint.h>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// Filtered reference pose in app space, stamped with the time the tracker sampled it
+		struct ReferenceSample
+		{
+			long long TimeUs;
+			vr::HmdVector3d_t Pos;
+			vr::HmdQuaternion_t Rot;
+
+			// Position in the sample sequence, used to detect a slot that was overwritten while reading it
+			uint32_t Index;
+		};
+
+		// Ring of the last reference samples, so a device pose can be compensated with the reference
+		// as it was at the time the device pose was sampled.
+		// One writer (the reference tracker thread), any number of lock-free readers.
+		class ReferenceHistory
+		{
+		public:
+			static const uint32_t Size = 16;
+
+			// Extrapolation uses two samples at least this far apart, so sensor noise is not blown up
+			// by extrapolating from two neighbouring samples
+			static const long long ExtrapolationBaselineUs = 10000;
+
+			void push(long long timeUs, const vr::HmdVector3d_t& pos, const vr::HmdQuaternion_t& rot);
+
+			// Writer only. Forgets all samples, e.g. when the reference restarts, so that nothing is interpolated
+			// between a sample from before and one from after
+			void clear();
+
+			// Reference pose at timeUs. Interpolated between the two samples around timeUs, or extrapolated from the
+			// newest samples by at most maxExtrapolationUs. Times older than the ring use the oldest sample pair.
+			// Returns false if there are less than two samples since the last clear.
+			bool sampleAt(long long timeUs, long long maxExtrapolationUs, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot) const;
+
+			uint32_t count() const
+			{
+				return _Count.load(std::memory_order_acquire) - _First.load(std::memory_order_acquire);
+			}
+
+		private:
+			bool readSample(uint32_t index, ReferenceSample& sample) const;
+
+			SeqLock<ReferenceSample> _Slots[Size];
+			std::atomic<uint32_t> _Count = { 0 };
+
+			// Index of the first sample after the last clear
+			std::atomic<uint32_t> _First = { 0 };
+		};
+	}
+}
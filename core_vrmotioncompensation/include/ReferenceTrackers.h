@@ -0,0 +1,72 @@
+#pragma once
+
+#include "vrmc_openvr.h"
+#include <vrmotioncompensation_types.h>
+#include "MotionCompensationCore.h"
+#include "ReferenceFusion.h"
+#include "Spinlock.h"
+#include "ZeroPoseCalibration.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// The reference tracker path of the driver: which devices are reference trackers, the fusion of several of them,
+		// and the zero pose calibration, feeding one MotionCompensationCore.
+		// The time of every call is passed in, so the driver runs it on the system clock and a replay on its own clock.
+		// Thread-safe, every reference tracker updates from its own thread
+		class ReferenceTrackers
+		{
+		public:
+			ReferenceTrackers(MotionCompensationCore& core) : _Core(core)
+			{
+			}
+
+			// One reference tracker, -1 for none. Restarts the zero pose calibration, the zero pose itself stays
+			void setTracker(int RtDevice);
+
+			// Several reference trackers to fuse, the first one is the main tracker. weights may be nullptr for equal weights.
+			// Resets the zero pose, the tracker offsets are calibrated together with it
+			void setTrackers(const std::vector<uint32_t>& RtDevices, const double* weights = nullptr);
+
+			bool isTracker(uint32_t RtDevice);
+
+			// Main reference tracker, -1 for none
+			int getTracker();
+
+			std::vector<uint32_t> getTrackers();
+
+			// The next samples calibrate the fusion and the zero pose again
+			void resetZeroPose();
+
+			// Applies to the next calibration, or restarts the one that is still collecting
+			void setZeroPoseCalibration(const ZeroPoseCalibrationSettings& settings);
+
+			ZeroPoseCalibrationStatus getZeroPoseCalibrationStatus();
+
+			// New pose of one of the reference trackers at timestampUs, also the poses that are not Running_OK.
+			// Calibrates the zero pose if it is not valid yet, otherwise updates the reference pose.
+			// Returns true if the sample completed a calibration window, the status then tells whether it was accepted
+			bool update(uint32_t RtDevice, const vr::DriverPose_t& pose, long long timestampUs, ZeroPoseCalibrationStatus& status);
+
+		private:
+			bool calibrateZeroPose(const vr::DriverPose_t& pose, ZeroPoseCalibrationStatus& status);
+
+			void restartZeroPoseCalibration();
+
+			MotionCompensationCore& _Core;
+
+			// Reference trackers and their fusion, guarded by _RtLock
+			std::vector<uint32_t> _RtDeviceIDs;
+			ReferenceFusion _Fusion;
+			Spinlock _RtLock;
+
+			// Zero pose from a window of reference samples, guarded by _ZeroCalibrationLock
+			ZeroPoseCalibration _ZeroCalibration;
+			Spinlock _ZeroCalibrationLock;
+		};
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "vrmc_openvr.h"
+#include <vrmotioncompensation_types.h>
+
+#include <atomic>
+#include <stdint.h>
+
+// Both sides of the shared memory rig pose block (MMFstruct_OVRMC_RigPose_v1).
+// They only work on the mapped memory, opening the mapping is left to the driver and the tools.
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// Writing side, for rig software written in C++ and for the test writer.
+		// One writer per block, several writers have to be serialized by the caller
+		class RigPoseWriter
+		{
+		public:
+			// Writes magic and version and an invalid pose. Only call it while no reader relies on the block
+			static void init(MMFstruct_OVRMC_RigPose_v1& block);
+
+			static void write(MMFstruct_OVRMC_RigPose_v1& block, const RigPose_v1& pose);
+		};
+
+		// Reading side, polled by the driver. Never blocks: if the writer is in the middle of an update after
+		// a few retries, the poll reports no new pose and the previous one stays in use
+		class RigPoseReader
+		{
+		public:
+			// Retries of a torn copy before the poll gives up
+			static const int MaxRetries = 4;
+
+			enum class Result
+			{
+				NewPose,		// pose holds a new pose
+				Unchanged,		// No new pose since the last poll
+				Busy,			// The writer was updating the pose during every retry
+				Invalid,		// The block was never written, has another version or the pose is not valid
+			};
+
+			// Builds a DriverPose_t in tracking space from a new rig pose. timestampUs is the current time on the clock
+			// of RigPose_v1::TimestampUs, the sample time ends up in poseTimeOffset
+			Result poll(const MMFstruct_OVRMC_RigPose_v1& block, long long timestampUs, vr::DriverPose_t& pose);
+
+			// Consistent copy of the pose and its sequence number, false if the writer was updating it
+			static bool tryRead(const MMFstruct_OVRMC_RigPose_v1& block, RigPose_v1& pose, uint32_t& sequence);
+
+			// Makes the next poll report the current pose again
+			void reset()
+			{
+				_LastSequence = 0;
+			}
+
+			uint64_t getTornReads() const
+			{
+				return _TornReads;
+			}
+
+		private:
+			uint32_t _LastSequence = 0;
+			uint64_t _TornReads = 0;
+		};
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Spinlock.h"
+
+#include <atomic>
+#include <cstring>
+#include <stdint.h>
+#include <type_traits>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// Single-writer sequence lock for small, trivially copyable structs.
+		// The writer never blocks and readers never write shared state, so a reader on the HMD thread
+		// can not be stalled by the reference tracker thread. A reader retries only if it overlapped a store.
+		// The payload is kept in relaxed atomic words, so there is no data race in the C++ sense.
+		// Multiple writers must be serialized by the caller.
+		template<typename T> class SeqLock
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "SeqLock payload must be trivially copyable");
+
+			static const size_t WordCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+		public:
+			SeqLock()
+			{
+				T value = {};
+				store(value);
+			}
+
+			void store(const T& value) noexcept
+			{
+				uint64_t words[WordCount] = {};
+				std::memcpy(words, &value, sizeof(T));
+
+				uint32_t seq = _Seq.load(std::memory_order_relaxed);
+				_Seq.store(seq + 1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+
+				for (size_t i = 0; i < WordCount; i++)
+				{
+					_Words[i].store(words[i], std::memory_order_relaxed);
+				}
+
+				_Seq.store(seq + 2, std::memory_order_release);
+			}
+
+			// Returns false if a store was in progress or happened during the copy
+			bool tryLoad(T& value) const noexcept
+			{
+				uint32_t seq1 = _Seq.load(std::memory_order_acquire);
+				if (seq1 & 1)
+				{
+					return false;
+				}
+
+				uint64_t words[WordCount];
+				for (size_t i = 0; i < WordCount; i++)
+				{
+					words[i] = _Words[i].load(std::memory_order_relaxed);
+				}
+
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (_Seq.load(std::memory_order_relaxed) != seq1)
+				{
+					return false;
+				}
+
+				std::memcpy(&value, words, sizeof(T));
+				return true;
+			}
+
+			T load() const noexcept
+			{
+				T value;
+				while (!tryLoad(value))
+				{
+					VRMC_CPU_PAUSE();
+				}
+				return value;
+			}
+
+			// Number of completed stores
+			uint32_t version() const noexcept
+			{
+				return _Seq.load(std::memory_order_acquire) / 2;
+			}
+
+		private:
+			std::atomic<uint32_t> _Seq = { 0 };
+			std::atomic<uint64_t> _Words[WordCount];
+		};
+	}
+}
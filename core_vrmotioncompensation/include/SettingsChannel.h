@@ -0,0 +1,78 @@
+#pragma once
+
+#include "vrmc_openvr.h"
+#include <vrmotioncompensation_types.h>
+
+#include <atomic>
+#include <stdint.h>
+
+// Both sides of the shared memory settings block (MMFstruct_OVRMC_Settings_v1).
+// They only work on the mapped memory, opening the mapping is left to the driver and the client library.
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// Writing side, the rig software through the client library. One writer per block,
+		// several writers have to be serialized by the caller
+		class SettingsWriter
+		{
+		public:
+			// Writes magic and version and settings without fields. Only call it while the driver does not rely on the block
+			static void init(MMFstruct_OVRMC_Settings_v1& block);
+
+			// Returns the Sequence the settings were published with, to wait for in readStatus
+			static uint32_t write(MMFstruct_OVRMC_Settings_v1& block, const MotionCompensationSettings_v1& settings);
+
+			// The Sequence of the settings the driver took last and their status.
+			// False if the driver was acknowledging during every retry
+			static bool readStatus(const MMFstruct_OVRMC_Settings_v1& block, uint32_t& appliedSequence, SettingsStatus& status);
+		};
+
+		// Reading side, polled by the driver on the reference update path. Never blocks: if the writer is in the
+		// middle of an update after a few retries, the poll reports no new settings and tries again the next time
+		class SettingsReader
+		{
+		public:
+			// Retries of a torn copy before the poll gives up
+			static const int MaxRetries = 4;
+
+			enum class Result
+			{
+				NewSettings,	// settings holds new settings, acknowledge them once they are applied
+				Unchanged,		// No new settings since the last poll
+				Busy,			// The writer was updating the settings during every retry
+				Invalid,		// The block was never written or has another version
+			};
+
+			// Lock-free check for a poll from several threads, one acquire load of the sequence counter
+			bool hasNewSettings(const MMFstruct_OVRMC_Settings_v1& block) const
+			{
+				return reinterpret_cast<const std::atomic<uint32_t>*>(&block.Sequence)->load(std::memory_order_acquire) != _LastSequence.load(std::memory_order_relaxed);
+			}
+
+			// A single acquire load of the sequence counter while nothing changed. One thread at a time
+			Result poll(const MMFstruct_OVRMC_Settings_v1& block, MotionCompensationSettings_v1& settings, uint32_t& sequence);
+
+			// Tells the writer what became of the settings of sequence
+			static void acknowledge(MMFstruct_OVRMC_Settings_v1& block, uint32_t sequence, SettingsStatus status);
+
+			// Checks the fields the settings control against the ranges in MotionCompensationSettings_v1
+			static SettingsStatus validate(const MotionCompensationSettings_v1& settings);
+
+			// Makes the next poll report the current settings again
+			void reset()
+			{
+				_LastSequence.store(0, std::memory_order_relaxed);
+			}
+
+			uint64_t getTornReads() const
+			{
+				return _TornReads;
+			}
+
+		private:
+			std::atomic<uint32_t> _LastSequence = { 0 };
+			uint64_t _TornReads = 0;
+		};
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define VRMC_CPU_PAUSE() _mm_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define VRMC_CPU_PAUSE() __asm__ __volatile__("yield")
+#else
+#define VRMC_CPU_PAUSE() std::this_thread::yield()
+#endif
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		class Spinlock
+		{
+			// Source: https://rigtorp.se/spinlock/
+			std::atomic<bool> lock_ = { 0 };
+
+		public:
+			void lock() noexcept
+			{
+				for (;;)
+				{
+					// Optimistically assume the lock is free on the first try
+					if (!lock_.exchange(true, std::memory_order_acquire))
+					{
+						return;
+					}
+					// Wait for lock to be released without generating cache misses
+					while (lock_.load(std::memory_order_relaxed))
+					{
+						// Issue X86 PAUSE or ARM YIELD instruction to reduce contention between
+						// hyper-threads
+						VRMC_CPU_PAUSE();
+					}
+				}
+			}
+
+			bool try_lock() noexcept
+			{
+				// First do a relaxed load to check if lock is free in order to prevent
+				// unnecessary cache misses if someone does while(!try_lock())
+				return !lock_.load(std::memory_order_relaxed) &&
+					!lock_.exchange(true, std::memory_order_acquire);
+			}
+
+			void unlock() noexcept
+			{
+				lock_.store(false, std::memory_order_release);
+			}
+		};
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Like vrmotioncompensation_types.h this expects the OpenVR types to be declared already (vrmc_openvr.h, openvr_driver.h
+// or openvr.h), so the client library can use it next to openvr.h
+#include <vrmotioncompensation_types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Both sides of the shared memory telemetry ring (MMFstruct_OVRMC_Telemetry_v1).
+// Like the rig pose block, they only work on the mapped memory.
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// The ring protocol of MMFstruct_OVRMC_Telemetry_v1 on any array of entries that start with their 64 bit Sequence.
+		// The flight recorder keeps its own, larger ring with it
+		class SequencedRing
+		{
+		public:
+			// Claims the next index and copies entry into its slot, see TelemetryWriter::write
+			static void write(uint64_t& writeIndex, void* entries, size_t entrySize, uint32_t entryCount, const void* entry);
+
+			// Copies up to maxCount entries from index next on into out, see TelemetryReader::read. Advances next and
+			// counts the entries that were overwritten before they could be read in lost
+			static size_t read(const uint64_t& writeIndex, const void* entries, size_t entrySize, uint32_t entryCount,
+				uint64_t& next, uint64_t& lost, void* out, size_t maxCount);
+		};
+
+		class TelemetryWriter
+		{
+		public:
+			// Resets the ring. Only call it before the first write
+			static void init(MMFstruct_OVRMC_Telemetry_v1& ring);
+
+			// Allocation-free, any number of threads may write at the same time. A writer only waits for another one
+			// that was preempted for a whole lap of the ring while copying into the same entry.
+			// The Sequence of entry is ignored
+			static void write(MMFstruct_OVRMC_Telemetry_v1& ring, const TelemetryEntry_v1& entry);
+
+			// Steady clock for TelemetryEntry_v1::TimeNs
+			static int64_t nowNs();
+		};
+
+		// Tails the ring. Each reader keeps its own position, readers do not see or slow down each other
+		class TelemetryReader
+		{
+		public:
+			// Starts with the oldest entry still in the ring, or with the next one written if skipBacklog is set
+			void attach(const MMFstruct_OVRMC_Telemetry_v1& ring, bool skipBacklog);
+
+			// Copies up to maxCount entries written since the last call, oldest first, and returns how many.
+			// Stops at an entry that is still being written. Entries overwritten before they could be read are counted as lost
+			size_t read(const MMFstruct_OVRMC_Telemetry_v1& ring, TelemetryEntry_v1* entries, size_t maxCount);
+
+			uint64_t getLost() const
+			{
+				return _Lost;
+			}
+
+			// Index of the next entry to be read
+			uint64_t getPosition() const
+			{
+				return _Next;
+			}
+
+		private:
+			uint64_t _Next = 0;
+			uint64_t _Lost = 0;
+		};
+
+		// The ring is shared with other processes, a wrong layout would not show up at compile time there
+		static_assert(sizeof(TelemetryEntry_v1) % 8 == 0, "Telemetry entries have to keep their 8 byte alignment");
+	}
+}
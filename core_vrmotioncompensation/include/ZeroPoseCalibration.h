@@ -0,0 +1,73 @@
+#pragma once
+
+#include "vrmc_openvr.h"
+#include <vrmotioncompensation_types.h>
+
+#include <stdint.h>
+#include <vector>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// Calibrates the zero pose from a window of reference samples instead of the first one.
+		// When the window is full, samples further from the median than OutlierThreshold robust standard deviations
+		// (1.4826 * median absolute deviation) are dropped. The position of the remaining ones is averaged, the rotation
+		// on the quaternion manifold. The mean becomes the zero pose if the inliers stay within the configured deviations,
+		// otherwise the window is thrown away and the next one is collected, e.g. while the rig still moves.
+		// Not thread-safe, the caller serializes the reference samples.
+		class ZeroPoseCalibration
+		{
+		public:
+			static const uint32_t MaxSamples = 1000;
+
+			// Deviations below these are never outliers, a noise free reference would otherwise lose samples to rounding
+			static const double MinOutlierDistance;
+			static const double MinOutlierAngle;
+
+			static const double OutlierThreshold;
+
+			// A window with fewer inliers is rejected, the median is not trustworthy then
+			static const double MinInlierRatio;
+
+			ZeroPoseCalibration();
+
+			// Restarts the window with the new settings
+			void configure(const ZeroPoseCalibrationSettings& settings);
+
+			const ZeroPoseCalibrationSettings& getSettings() const
+			{
+				return _Settings;
+			}
+
+			// Forgets the collected samples, the next sample starts a new calibration
+			void reset();
+
+			// Adds a reference sample in driver space. Returns true and the zero pose in app space (identity world
+			// from driver transform) when the sample completes a window that is accepted.
+			// A sample after a finished calibration starts a new one
+			bool addSample(const vr::DriverPose_t& pose, vr::DriverPose_t& zeroPose);
+
+			const ZeroPoseCalibrationStatus& getStatus() const
+			{
+				return _Status;
+			}
+
+		private:
+			bool evaluate(vr::DriverPose_t& zeroPose);
+
+			// Upper bound of the inlier distances for distances to a median
+			double outlierLimit(const std::vector<double>& distances, double minimum);
+
+			ZeroPoseCalibrationSettings _Settings;
+			ZeroPoseCalibrationStatus _Status;
+
+			// Window in app space, and scratch space for the medians. Allocated by configure only
+			std::vector<vr::HmdVector3d_t> _Positions;
+			std::vector<vr::HmdQuaternion_t> _Rotations;
+			std::vector<double> _PositionDistances;
+			std::vector<double> _Angles;
+			std::vector<double> _Scratch;
+		};
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+// The compensation core only needs a few plain data types from openvr_driver.h.
+// Inside the driver the real OpenVR headers are used. For standalone builds without
+// the openvr submodule (e.g. the Linux benchmark build) VRMC_CORE_NO_OPENVR is defined
+// and a minimal, layout-compatible copy of these types is used instead.
+// The client library includes openvr.h and its own copy of DriverPose_t before the core headers,
+// openvr_driver.h would define them a second time there.
+
+#if defined(_OPENVR_API) && !defined(VRMC_CORE_NO_OPENVR)
+
+// openvr.h is already included
+
+#elif !defined(VRMC_CORE_NO_OPENVR)
+
+#include <openvr_driver.h>
+
+#else
+
+#include <stdint.h>
+
+namespace vr
+{
+	// Copied from openvr_driver.h
+	static const uint32_t k_unMaxTrackedDeviceCount = 64;
+	static const uint32_t k_unTrackedDeviceIndexInvalid = 0xFFFFFFFF;
+
+	struct HmdMatrix34_t
+	{
+		float m[3][4];
+	};
+
+	struct HmdVector3_t
+	{
+		float v[3];
+	};
+
+	struct HmdVector3d_t
+	{
+		double v[3];
+	};
+
+	struct HmdQuaternion_t
+	{
+		double w, x, y, z;
+	};
+
+	enum ETrackedDeviceClass
+	{
+		TrackedDeviceClass_Invalid = 0,
+		TrackedDeviceClass_HMD = 1,
+		TrackedDeviceClass_Controller = 2,
+		TrackedDeviceClass_GenericTracker = 3,
+		TrackedDeviceClass_TrackingReference = 4,
+		TrackedDeviceClass_DisplayRedirect = 5,
+		TrackedDeviceClass_Max
+	};
+
+	enum ETrackingResult
+	{
+		TrackingResult_Uninitialized = 1,
+
+		TrackingResult_Calibrating_InProgress = 100,
+		TrackingResult_Calibrating_OutOfRange = 101,
+
+		TrackingResult_Running_OK = 200,
+		TrackingResult_Running_OutOfRange = 201,
+
+		TrackingResult_Fallback_RotationOnly = 300,
+	};
+
+	struct DriverPose_t
+	{
+		double poseTimeOffset;
+
+		vr::HmdQuaternion_t qWorldFromDriverRotation;
+		double vecWorldFromDriverTranslation[3];
+
+		vr::HmdQuaternion_t qDriverFromHeadRotation;
+		double vecDriverFromHeadTranslation[3];
+
+		double vecPosition[3];
+		double vecVelocity[3];
+		double vecAcceleration[3];
+
+		vr::HmdQuaternion_t qRotation;
+
+		double vecAngularVelocity[3];
+		double vecAngularAcceleration[3];
+
+		ETrackingResult result;
+
+		bool poseIsValid;
+		bool willDriftInYaw;
+		bool shouldApplyHeadModel;
+		bool deviceIsConnected;
+	};
+} // end namespace vr
+
+#endif
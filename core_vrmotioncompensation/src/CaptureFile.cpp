@@ -0,0 +1,350 @@
+#include "CaptureFile.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// The records start on a cache line
+		static const uint32_t HeaderAlignment = 64;
+
+#ifdef _WIN32
+		bool MappedFile::create(const char* path, size_t size)
+		{
+			close();
+			HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+			_File = file;
+			return resize(size);
+		}
+
+		bool MappedFile::openReadOnly(const char* path)
+		{
+			close();
+			HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+			_File = file;
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+			{
+				close();
+				return false;
+			}
+			_Size = (size_t)size.QuadPart;
+			if (!map(false))
+			{
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		bool MappedFile::resize(size_t size)
+		{
+			unmap();
+			LARGE_INTEGER position;
+			position.QuadPart = (LONGLONG)size;
+			if (!SetFilePointerEx(_File, position, nullptr, FILE_BEGIN) || !SetEndOfFile(_File))
+			{
+				return false;
+			}
+			_Size = size;
+			return map(true);
+		}
+
+		bool MappedFile::map(bool writable)
+		{
+			if (_Size == 0)
+			{
+				return false;
+			}
+			_Mapping = CreateFileMappingA(_File, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+			if (_Mapping == nullptr)
+			{
+				return false;
+			}
+			_Data = static_cast<char*>(MapViewOfFile(_Mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, _Size));
+			return _Data != nullptr;
+		}
+
+		void MappedFile::unmap()
+		{
+			if (_Data != nullptr)
+			{
+				UnmapViewOfFile(_Data);
+				_Data = nullptr;
+			}
+			if (_Mapping != nullptr)
+			{
+				CloseHandle(_Mapping);
+				_Mapping = nullptr;
+			}
+		}
+
+		void MappedFile::close()
+		{
+			unmap();
+			if (_File != nullptr)
+			{
+				CloseHandle(_File);
+				_File = nullptr;
+			}
+			_Size = 0;
+		}
+#else
+		bool MappedFile::create(const char* path, size_t size)
+		{
+			close();
+			_File = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+			if (_File < 0)
+			{
+				return false;
+			}
+			return resize(size);
+		}
+
+		bool MappedFile::openReadOnly(const char* path)
+		{
+			close();
+			_File = ::open(path, O_RDONLY);
+			if (_File < 0)
+			{
+				return false;
+			}
+
+			struct stat status;
+			if (fstat(_File, &status) != 0 || status.st_size == 0)
+			{
+				close();
+				return false;
+			}
+			_Size = (size_t)status.st_size;
+			if (!map(false))
+			{
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		bool MappedFile::resize(size_t size)
+		{
+			unmap();
+			if (ftruncate(_File, (off_t)size) != 0)
+			{
+				return false;
+			}
+			_Size = size;
+			return map(true);
+		}
+
+		bool MappedFile::map(bool writable)
+		{
+			if (_Size == 0)
+			{
+				return false;
+			}
+			void* data = mmap(nullptr, _Size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, _File, 0);
+			_Data = data == MAP_FAILED ? nullptr : static_cast<char*>(data);
+			return _Data != nullptr;
+		}
+
+		void MappedFile::unmap()
+		{
+			if (_Data != nullptr)
+			{
+				munmap(_Data, _Size);
+				_Data = nullptr;
+			}
+		}
+
+		void MappedFile::close()
+		{
+			unmap();
+			if (_File >= 0)
+			{
+				::close(_File);
+				_File = -1;
+			}
+			_Size = 0;
+		}
+#endif
+
+		bool CaptureWriter::open(const char* path, const std::vector<CaptureChannel>& channels, int64_t startTimeUs, uint64_t initialRecords)
+		{
+			close();
+			if (channels.size() > CaptureMaxChannels)
+			{
+				return false;
+			}
+
+			size_t headerSize = sizeof(CaptureHeader_v1) + channels.size() * sizeof(CaptureChannel_v1);
+			_HeaderSize = (uint32_t)((headerSize + HeaderAlignment - 1) / HeaderAlignment * HeaderAlignment);
+			_RecordDoubles = 1;
+			for (const CaptureChannel& channel : channels)
+			{
+				_RecordDoubles += captureChannelSize(channel.Type);
+			}
+			_Capacity = std::max<uint64_t>(initialRecords, 1);
+			_RecordCount = 0;
+
+			if (!_File.create(path, _HeaderSize + _Capacity * _RecordDoubles * sizeof(double)))
+			{
+				_File.close();
+				return false;
+			}
+
+			CaptureHeader_v1* file = header();
+			std::memset(file, 0, _HeaderSize);
+			file->Magic = CaptureMagic;
+			file->Version = CaptureVersion;
+			file->HeaderSize = _HeaderSize;
+			file->RecordSize = _RecordDoubles * sizeof(double);
+			file->ChannelCount = (uint32_t)channels.size();
+			file->StartTimeUs = startTimeUs;
+
+			CaptureChannel_v1* fileChannels = reinterpret_cast<CaptureChannel_v1*>(_File.data() + sizeof(CaptureHeader_v1));
+			uint32_t offset = 1;
+			for (size_t i = 0; i < channels.size(); i++)
+			{
+				size_t length = std::min<size_t>(channels[i].Name.size(), CaptureNameLength - 1);
+				std::memcpy(fileChannels[i].Name, channels[i].Name.data(), length);
+				fileChannels[i].Type = (uint32_t)channels[i].Type;
+				fileChannels[i].Offset = offset;
+				offset += captureChannelSize(channels[i].Type);
+			}
+			return true;
+		}
+
+		bool CaptureWriter::append(const double* record)
+		{
+			if (!_File.isOpen())
+			{
+				return false;
+			}
+
+			size_t recordSize = _RecordDoubles * sizeof(double);
+			if (_RecordCount == _Capacity)
+			{
+				if (!_File.resize(_HeaderSize + _Capacity * 2 * recordSize))
+				{
+					return false;
+				}
+				_Capacity *= 2;
+			}
+
+			std::memcpy(_File.data() + _HeaderSize + _RecordCount * recordSize, record, recordSize);
+			_RecordCount++;
+			header()->RecordCount = _RecordCount;
+			return true;
+		}
+
+		void CaptureWriter::close()
+		{
+			if (_File.isOpen())
+			{
+				_File.resize(_HeaderSize + _RecordCount * _RecordDoubles * sizeof(double));
+			}
+			_File.close();
+			_Capacity = 0;
+		}
+
+		bool CaptureReader::open(const char* path)
+		{
+			_RecordCount = 0;
+			if (!_File.openReadOnly(path) || _File.size() < sizeof(CaptureHeader_v1))
+			{
+				_File.close();
+				return false;
+			}
+
+			const CaptureHeader_v1& file = getHeader();
+			if (file.Magic != CaptureMagic || file.Version != CaptureVersion || file.ChannelCount > CaptureMaxChannels
+				|| file.HeaderSize < sizeof(CaptureHeader_v1) + file.ChannelCount * sizeof(CaptureChannel_v1) || file.HeaderSize > _File.size()
+				|| file.RecordSize < sizeof(double) || file.RecordSize % sizeof(double) != 0)
+			{
+				_File.close();
+				return false;
+			}
+
+			for (uint32_t i = 0; i < file.ChannelCount; i++)
+			{
+				const CaptureChannel_v1& channel = getChannel(i);
+				if (channel.Type > (uint32_t)CaptureChannelType::Quaternion
+					|| (channel.Offset + captureChannelSize((CaptureChannelType)channel.Type)) * sizeof(double) > file.RecordSize)
+				{
+					_File.close();
+					return false;
+				}
+			}
+
+			_RecordCount = std::min<uint64_t>(file.RecordCount, (_File.size() - file.HeaderSize) / file.RecordSize);
+			return true;
+		}
+
+		void CaptureReader::writeCsv(std::FILE* file, char separator) const
+		{
+			static const char* const VectorComponents[] = { ".x", ".y", ".z" };
+			static const char* const QuaternionComponents[] = { ".w", ".x", ".y", ".z" };
+
+			std::fputs("Time", file);
+			for (uint32_t i = 0; i < getChannelCount(); i++)
+			{
+				const CaptureChannel_v1& channel = getChannel(i);
+				std::string name(channel.Name, strnlen(channel.Name, CaptureNameLength));
+				CaptureChannelType type = (CaptureChannelType)channel.Type;
+				for (uint32_t component = 0; component < captureChannelSize(type); component++)
+				{
+					std::fputc(separator, file);
+					std::fputs(name.c_str(), file);
+					if (type != CaptureChannelType::Scalar)
+					{
+						std::fputs(type == CaptureChannelType::Quaternion ? QuaternionComponents[component] : VectorComponents[component], file);
+					}
+				}
+			}
+			std::fputc('\n', file);
+
+			// Shortest text that reads back as the same double
+			std::vector<char> line(getHeader().RecordSize / sizeof(double) * 32 + 1);
+			for (uint64_t i = 0; i < _RecordCount; i++)
+			{
+				const double* record = getRecord(i);
+				char* end = line.data() + line.size();
+				char* pos = std::to_chars(line.data(), end, record[0]).ptr;
+				for (uint32_t j = 0; j < getChannelCount(); j++)
+				{
+					const CaptureChannel_v1& channel = getChannel(j);
+					for (uint32_t component = 0; component < captureChannelSize((CaptureChannelType)channel.Type); component++)
+					{
+						*pos++ = separator;
+						pos = std::to_chars(pos, end, record[channel.Offset + component]).ptr;
+					}
+				}
+				*pos++ = '\n';
+				std::fwrite(line.data(), 1, pos - line.data(), file);
+			}
+		}
+	}
+}
@@ -0,0 +1,213 @@
+#include "CaptureRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// Sessions count over all recorders, a thread cannot mistake a new recorder at the address of an old one for its own
+		static std::atomic<uint32_t> NextSession = { 1 };
+
+		// The ring the calling thread claimed, for the recorder and session it claimed it in
+		struct ProducerSlot
+		{
+			const CaptureRecorder* Recorder = nullptr;
+			uint32_t Session = 0;
+			uint32_t Ring = 0;
+		};
+
+		static thread_local ProducerSlot Producer;
+
+		bool CaptureRecorder::start(const char* path, const std::vector<CaptureChannel>& channels, int64_t startTimeUs, uint64_t maxRecords)
+		{
+			if (_DrainThread.joinable())
+			{
+				return false;
+			}
+
+			if (!_Writer.open(path, channels, startTimeUs, std::min<uint64_t>(std::max<uint64_t>(maxRecords, 1), 4096)))
+			{
+				return false;
+			}
+			_RecordDoubles = _Writer.getRecordDoubles();
+
+			try
+			{
+				_RingData.assign((size_t)MaxProducers * RingRecords * _RecordDoubles, 0.0);
+			}
+			catch (std::bad_alloc&)
+			{
+				_Writer.close();
+				return false;
+			}
+
+			for (uint32_t i = 0; i < MaxProducers; i++)
+			{
+				_Rings[i].Write.store(0, std::memory_order_relaxed);
+				_Rings[i].Read.store(0, std::memory_order_relaxed);
+				_Rings[i].Dropped.store(0, std::memory_order_relaxed);
+				_Rings[i].Data = &_RingData[(size_t)i * RingRecords * _RecordDoubles];
+			}
+			_MaxRecords = std::max<uint64_t>(maxRecords, 1);
+			_RecordCount.store(0, std::memory_order_relaxed);
+			_Unclaimed.store(0, std::memory_order_relaxed);
+			_Producers.store(0, std::memory_order_relaxed);
+			_Full.store(false, std::memory_order_relaxed);
+			_DrainStop.store(false, std::memory_order_relaxed);
+
+			// A producer that sees _Running also sees the new session and claims a new ring
+			_Session.store(NextSession.fetch_add(1, std::memory_order_relaxed), std::memory_order_seq_cst);
+			_DrainThread = std::thread(&CaptureRecorder::drainLoop, this);
+			_Running.store(true, std::memory_order_seq_cst);
+			return true;
+		}
+
+		void CaptureRecorder::stop()
+		{
+			if (!_DrainThread.joinable())
+			{
+				return;
+			}
+
+			// Producers mark their ring busy before they check _Running, so after this loop none of them is
+			// writing and none will start
+			_Running.store(false, std::memory_order_seq_cst);
+			for (Ring& ring : _Rings)
+			{
+				while (ring.Busy.load(std::memory_order_seq_cst))
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			_DrainStop.store(true, std::memory_order_release);
+			_DrainThread.join();
+			_Writer.close();
+
+			for (Ring& ring : _Rings)
+			{
+				ring.Data = nullptr;
+			}
+			std::vector<double>().swap(_RingData);
+		}
+
+		bool CaptureRecorder::record(const double* values)
+		{
+			if (!_Running.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+
+			uint32_t session = _Session.load(std::memory_order_acquire);
+			ProducerSlot& slot = Producer;
+			if (slot.Recorder != this || slot.Session != session)
+			{
+				slot.Recorder = this;
+				slot.Session = session;
+				slot.Ring = _Producers.fetch_add(1, std::memory_order_relaxed);
+			}
+			if (slot.Ring >= MaxProducers)
+			{
+				_Unclaimed.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			Ring& ring = _Rings[slot.Ring];
+			ring.Busy.store(true, std::memory_order_seq_cst);
+			if (!_Running.load(std::memory_order_seq_cst) || _Session.load(std::memory_order_seq_cst) != slot.Session
+				|| _Full.load(std::memory_order_relaxed))
+			{
+				ring.Busy.store(false, std::memory_order_release);
+				return false;
+			}
+
+			uint64_t write = ring.Write.load(std::memory_order_relaxed);
+			if (write - ring.Read.load(std::memory_order_acquire) >= RingRecords)
+			{
+				ring.Dropped.store(ring.Dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				ring.Busy.store(false, std::memory_order_release);
+				return false;
+			}
+
+			std::memcpy(ring.Data + (write % RingRecords) * _RecordDoubles, values, _RecordDoubles * sizeof(double));
+			ring.Write.store(write + 1, std::memory_order_release);
+			ring.Busy.store(false, std::memory_order_release);
+			return true;
+		}
+
+		uint64_t CaptureRecorder::getDropped() const
+		{
+			uint64_t dropped = _Unclaimed.load(std::memory_order_relaxed);
+			for (const Ring& ring : _Rings)
+			{
+				dropped += ring.Dropped.load(std::memory_order_relaxed);
+			}
+			return dropped;
+		}
+
+		void CaptureRecorder::drainLoop()
+		{
+			while (!_DrainStop.load(std::memory_order_acquire))
+			{
+				if (drain() == 0)
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(DrainIntervalMs));
+				}
+			}
+
+			// The producers are done, take what they left
+			drain();
+		}
+
+		size_t CaptureRecorder::drain()
+		{
+			uint64_t read[MaxProducers];
+			uint64_t write[MaxProducers];
+			for (uint32_t i = 0; i < MaxProducers; i++)
+			{
+				read[i] = _Rings[i].Read.load(std::memory_order_relaxed);
+				write[i] = _Rings[i].Write.load(std::memory_order_acquire);
+			}
+
+			// Each ring is in time order, merging them by the time of their oldest record keeps the file in order
+			size_t moved = 0;
+			uint64_t count = _RecordCount.load(std::memory_order_relaxed);
+			while (true)
+			{
+				int next = -1;
+				for (uint32_t i = 0; i < MaxProducers; i++)
+				{
+					if (read[i] != write[i] && (next < 0 || _Rings[i].Data[(read[i] % RingRecords) * _RecordDoubles]
+						< _Rings[next].Data[(read[next] % RingRecords) * _RecordDoubles]))
+					{
+						next = (int)i;
+					}
+				}
+				if (next < 0)
+				{
+					break;
+				}
+
+				// A full capture takes no more records, the rest is only taken out of the rings
+				if (count < _MaxRecords && _Writer.append(&_Rings[next].Data[(read[next] % RingRecords) * _RecordDoubles]))
+				{
+					count++;
+				}
+				read[next]++;
+				_Rings[next].Read.store(read[next], std::memory_order_release);
+				moved++;
+			}
+
+			_RecordCount.store(count, std::memory_order_relaxed);
+			if (count >= _MaxRecords)
+			{
+				_Full.store(true, std::memory_order_relaxed);
+			}
+			return moved;
+		}
+	}
+}
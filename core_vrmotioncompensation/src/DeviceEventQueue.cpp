@@ -0,0 +1,32 @@
+#include "DeviceEventQueue.h"
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		bool DeviceEventQueue::create(const char* name)
+		{
+			// The ring wants 64 byte aligned memory
+			size_t size = IpcRing::requiredSize(Capacity, sizeof(DeviceEvent));
+			_Memory.reset(new char[size + 64]);
+			char* memory = _Memory.get() + (64 - (uintptr_t)_Memory.get() % 64) % 64;
+			return _Ring.create(memory, size, Capacity, sizeof(DeviceEvent), name);
+		}
+
+		bool DeviceEventQueue::push(const DeviceEvent& event)
+		{
+			if (!_Ring.isAttached() || !_Ring.send(&event, sizeof(event), 0))
+			{
+				_Dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			return true;
+		}
+
+		bool DeviceEventQueue::pop(DeviceEvent& event, uint32_t timeoutMs)
+		{
+			uint32_t size;
+			return _Ring.isAttached() && _Ring.receive(&event, sizeof(event), size, timeoutMs) && size == sizeof(event);
+		}
+	}
+}
@@ -0,0 +1,229 @@
+#include "FilterPipeline.h"
+#include "Filters.h"
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// ----------------------------------------------------------------------------------------------- //
+		// ----------------------------------------------------------------------------------------------- //
+		// Position filters
+		// filter() writes out.Pos, derive() writes out.Vel and out.Acc. tdiff is the time since the last sample in seconds.
+
+		struct PositionPassThrough
+		{
+			static inline void filter(FilterContext&, const vr::DriverPose_t& pose, long long, FilterOutput& out)
+			{
+				out.Pos = { pose.vecPosition[0], pose.vecPosition[1], pose.vecPosition[2] };
+			}
+
+			static inline void derive(FilterContext&, const vr::DriverPose_t& pose, double, FilterOutput& out)
+			{
+				out.Vel = { pose.vecVelocity[0], pose.vecVelocity[1], pose.vecVelocity[2] };
+			}
+		};
+
+		// Double exponential moving average
+		struct PositionDema
+		{
+			static inline void filter(FilterContext& ctx, const vr::DriverPose_t& pose, long long, FilterOutput& out)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					ctx.Dema[0].v[axis] += ctx.Alpha * (pose.vecPosition[axis] - ctx.Dema[1].v[axis]);
+					ctx.Dema[1].v[axis] += ctx.Alpha * (ctx.Dema[0].v[axis] - ctx.Dema[1].v[axis]);
+					out.Pos.v[axis] = 2 * ctx.Dema[0].v[axis] - ctx.Dema[1].v[axis];
+				}
+			}
+
+			// No velocity and acceleration. The filter this replaced divided its differences by the time since the epoch,
+			// so they were zero in effect, and differences of the DEMA output would add its noise to the HMD velocity
+			static inline void derive(FilterContext&, const vr::DriverPose_t&, double, FilterOutput&)
+			{
+			}
+		};
+
+		// Runs the whole Kalman filter step, the rotation stage picks up its result
+		struct PositionKalman
+		{
+			static inline void filter(FilterContext& ctx, const vr::DriverPose_t& pose, long long sampleUs, FilterOutput& out)
+			{
+				ctx.Kalman.update(sampleUs, pose.vecPosition, pose.qRotation);
+				ctx.KalmanState = ctx.Kalman.predict((double)ctx.KalmanPredictionUs / 1.0E6);
+				out.Pos = ctx.KalmanState.Pos;
+				out.TimeShiftUs = ctx.KalmanPredictionUs;
+			}
+
+			static inline void derive(FilterContext& ctx, const vr::DriverPose_t&, double, FilterOutput& out)
+			{
+				out.Vel = ctx.KalmanState.Vel;
+				out.Acc = ctx.KalmanState.Acc;
+			}
+		};
+
+		// Runs the whole One Euro filter step, the rotation stage picks up its result
+		struct PositionOneEuro
+		{
+			static inline void filter(FilterContext& ctx, const vr::DriverPose_t& pose, long long sampleUs, FilterOutput& out)
+			{
+				ctx.OneEuro.update(sampleUs, pose.vecPosition, pose.qRotation);
+				out.Pos = ctx.OneEuro.state().Pos;
+			}
+
+			static inline void derive(FilterContext& ctx, const vr::DriverPose_t&, double, FilterOutput& out)
+			{
+				out.Vel = ctx.OneEuro.state().Vel;
+			}
+		};
+
+		// ----------------------------------------------------------------------------------------------- //
+		// ----------------------------------------------------------------------------------------------- //
+		// Rotation filters
+		// filter() writes out.Rot, derive() writes out.AngVel and out.AngAcc
+
+		struct RotationPassThrough
+		{
+			static inline void filter(FilterContext&, const vr::DriverPose_t& pose, long long, FilterOutput& out)
+			{
+				out.Rot = pose.qRotation;
+			}
+
+			static inline void derive(FilterContext&, const vr::DriverPose_t& pose, double, FilterOutput& out)
+			{
+				out.AngVel = { pose.vecAngularVelocity[0], pose.vecAngularVelocity[1], pose.vecAngularVelocity[2] };
+				out.AngAcc = { pose.vecAngularAcceleration[0], pose.vecAngularAcceleration[1], pose.vecAngularAcceleration[2] };
+			}
+		};
+
+		// Two stage slerp low pass
+		struct RotationSlerpLpf
+		{
+			static inline void filter(FilterContext& ctx, const vr::DriverPose_t& pose, long long, FilterOutput& out)
+			{
+				ctx.RotLpf[0] = slerp(ctx.RotLpf[0], pose.qRotation, ctx.LpfBeta);
+				ctx.RotLpf[1] = slerp(ctx.RotLpf[1], ctx.RotLpf[0], ctx.LpfBeta);
+				out.Rot = ctx.RotLpf[1];
+			}
+
+			// Angular velocity from the relative rotation between consecutive outputs, angular acceleration from the rate change
+			static inline void derive(FilterContext& ctx, const vr::DriverPose_t&, double tdiff, FilterOutput& out)
+			{
+				out.AngVel = quaternionVelocity(tdiff, out.Rot, ctx.Last.Rot);
+				out.AngAcc = vecDerivative(tdiff, out.AngVel, ctx.Last.AngVel);
+			}
+		};
+
+		struct RotationKalman
+		{
+			static inline void filter(FilterContext& ctx, const vr::DriverPose_t&, long long, FilterOutput& out)
+			{
+				out.Rot = ctx.KalmanState.Rot;
+			}
+
+			static inline void derive(FilterContext& ctx, const vr::DriverPose_t&, double, FilterOutput& out)
+			{
+				out.AngVel = ctx.KalmanState.AngVel;
+				out.AngAcc = ctx.KalmanState.AngAcc;
+			}
+		};
+
+		struct RotationOneEuro
+		{
+			static inline void filter(FilterContext& ctx, const vr::DriverPose_t&, long long, FilterOutput& out)
+			{
+				out.Rot = ctx.OneEuro.state().Rot;
+			}
+
+			static inline void derive(FilterContext& ctx, const vr::DriverPose_t&, double, FilterOutput& out)
+			{
+				out.AngVel = ctx.OneEuro.state().AngVel;
+			}
+		};
+
+		// ----------------------------------------------------------------------------------------------- //
+		// ----------------------------------------------------------------------------------------------- //
+		// Derivative estimators
+
+		// Velocity and acceleration stay zero, for the "set velocity and acceleration to zero" mode
+		struct NoDerivatives
+		{
+			template<class Position, class Rotation> static inline void estimate(FilterContext&, const vr::DriverPose_t&, long long, FilterOutput&)
+			{
+			}
+		};
+
+		// Derivatives as each stage provides them: none for DEMA, finite differences for the slerp low pass,
+		// the device values for the pass-through stages and the filter state for Kalman and One Euro
+		struct StageDerivatives
+		{
+			template<class Position, class Rotation> static inline void estimate(FilterContext& ctx, const vr::DriverPose_t& pose, long long sampleUs, FilterOutput& out)
+			{
+				// No derivatives from the first sample
+				double tdiff = ctx.LastSampleUs < 0 ? 0.0 : (double)(sampleUs - ctx.LastSampleUs) / 1.0E6;
+				Position::derive(ctx, pose, tdiff, out);
+				Rotation::derive(ctx, pose, tdiff, out);
+			}
+		};
+
+		// ----------------------------------------------------------------------------------------------- //
+		// ----------------------------------------------------------------------------------------------- //
+		// The rotation stage runs after the position stage, so it can use a result the position stage computed for both
+
+		template<class Position, class Rotation, class Derivatives>
+		static void runPipeline(FilterContext& ctx, const vr::DriverPose_t& pose, long long sampleUs, FilterOutput& out)
+		{
+			out = {};
+			Position::filter(ctx, pose, sampleUs, out);
+			Rotation::filter(ctx, pose, sampleUs, out);
+			Derivatives::template estimate<Position, Rotation>(ctx, pose, sampleUs, out);
+			ctx.LastSampleUs = sampleUs;
+			ctx.Last = out;
+		}
+
+		static const FilterPipelineInfo Pipelines[] = {
+			{ "pass-through / pass-through / stage", runPipeline<PositionPassThrough, RotationPassThrough, StageDerivatives> },
+			{ "pass-through / pass-through / zero", runPipeline<PositionPassThrough, RotationPassThrough, NoDerivatives> },
+			{ "pass-through / slerp LPF / stage", runPipeline<PositionPassThrough, RotationSlerpLpf, StageDerivatives> },
+			{ "pass-through / slerp LPF / zero", runPipeline<PositionPassThrough, RotationSlerpLpf, NoDerivatives> },
+			{ "DEMA / pass-through / stage", runPipeline<PositionDema, RotationPassThrough, StageDerivatives> },
+			{ "DEMA / pass-through / zero", runPipeline<PositionDema, RotationPassThrough, NoDerivatives> },
+			{ "DEMA / slerp LPF / stage", runPipeline<PositionDema, RotationSlerpLpf, StageDerivatives> },
+			{ "DEMA / slerp LPF / zero", runPipeline<PositionDema, RotationSlerpLpf, NoDerivatives> },
+			{ "Kalman / Kalman / stage", runPipeline<PositionKalman, RotationKalman, StageDerivatives> },
+			{ "Kalman / Kalman / zero", runPipeline<PositionKalman, RotationKalman, NoDerivatives> },
+			{ "One Euro / One Euro / stage", runPipeline<PositionOneEuro, RotationOneEuro, StageDerivatives> },
+			{ "One Euro / One Euro / zero", runPipeline<PositionOneEuro, RotationOneEuro, NoDerivatives> },
+		};
+
+		template<class Position, class Rotation> static FilterPipelineFn selectDerivatives(bool setZeroMode)
+		{
+			return setZeroMode ? runPipeline<Position, Rotation, NoDerivatives> : runPipeline<Position, Rotation, StageDerivatives>;
+		}
+
+		template<class Position> static FilterPipelineFn selectRotation(double lpfBeta, bool setZeroMode)
+		{
+			return lpfBeta <= 0.9999 ? selectDerivatives<Position, RotationSlerpLpf>(setZeroMode) : selectDerivatives<Position, RotationPassThrough>(setZeroMode);
+		}
+
+		FilterPipelineFn selectFilterPipeline(MotionCompensationFilterType type, uint32_t samples, double lpfBeta, bool setZeroMode)
+		{
+			switch (type)
+			{
+			case MotionCompensationFilterType::Kalman:
+				return selectDerivatives<PositionKalman, RotationKalman>(setZeroMode);
+
+			case MotionCompensationFilterType::OneEuro:
+				return selectDerivatives<PositionOneEuro, RotationOneEuro>(setZeroMode);
+
+			default:
+				return samples >= 2 ? selectRotation<PositionDema>(lpfBeta, setZeroMode) : selectRotation<PositionPassThrough>(lpfBeta, setZeroMode);
+			}
+		}
+
+		const FilterPipelineInfo* filterPipelines(size_t& count)
+		{
+			count = sizeof(Pipelines) / sizeof(Pipelines[0]);
+			return Pipelines;
+		}
+	}
+}
@@ -0,0 +1,241 @@
+#include "Filters.h"
+
+#include <cmath>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		static const double PI = 3.14159265358979323846;
+
+		double vecVelocity(double time, const double vecPosition, const double Old_vecPosition)
+		{
+			double NewVelocity = 0.0;
+
+			if (time != (double)0.0)
+			{
+				NewVelocity = (vecPosition - Old_vecPosition) / time;
+			}
+
+			return NewVelocity;
+		}
+
+		double vecAcceleration(double time, const double vecVelocity, const double Old_vecVelocity)
+		{
+			double NewAcceleration = 0.0;
+
+			if (time != (double)0.0)
+			{
+				NewAcceleration = (vecVelocity - Old_vecVelocity) / time;
+			}
+
+			return NewAcceleration;
+		}
+
+		// Low Pass Filter for 3d Vectors
+		vr::HmdVector3d_t LPF(double Beta, const double RawData[3], vr::HmdVector3d_t SmoothData)
+		{
+			vr::HmdVector3d_t RetVal;
+
+			RetVal.v[0] = SmoothData.v[0] - (Beta * (SmoothData.v[0] - RawData[0]));
+			RetVal.v[1] = SmoothData.v[1] - (Beta * (SmoothData.v[1] - RawData[1]));
+			RetVal.v[2] = SmoothData.v[2] - (Beta * (SmoothData.v[2] - RawData[2]));
+
+			return RetVal;
+		}
+
+		// Low Pass Filter for 3d Vectors
+		vr::HmdVector3d_t LPF(double Beta, vr::HmdVector3d_t RawData, vr::HmdVector3d_t SmoothData)
+		{
+			return LPF(Beta, RawData.v, SmoothData);
+		}
+
+		// Spherical Linear Interpolation for Quaternions
+		vr::HmdQuaternion_t slerp(vr::HmdQuaternion_t q1, vr::HmdQuaternion_t q2, double lambda)
+		{
+			vr::HmdQuaternion_t qr;
+
+			double dotproduct = q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w;
+
+			// if q1 and q2 are the same, we can return either of the values
+			if (dotproduct >= 1.0 || dotproduct <= -1.0)
+			{
+				return q1;
+			}
+
+			double theta, st, sut, sout, coeff1, coeff2;
+
+			// algorithm adapted from Shoemake's paper
+			lambda = lambda / 2.0;
+
+			theta = (double)acos(dotproduct);
+			if (theta < 0.0) theta = -theta;
+
+			st = (double)sin(theta);
+			sut = (double)sin(lambda * theta);
+			sout = (double)sin((1 - lambda) * theta);
+			coeff1 = sout / st;
+			coeff2 = sut / st;
+
+			qr.x = coeff1 * q1.x + coeff2 * q2.x;
+			qr.y = coeff1 * q1.y + coeff2 * q2.y;
+			qr.z = coeff1 * q1.z + coeff2 * q2.z;
+			qr.w = coeff1 * q1.w + coeff2 * q2.w;
+
+
+			//Normalize
+			double norm = sqrt(qr.x * qr.x + qr.y * qr.y + qr.z * qr.z + qr.w * qr.w);
+			qr.x /= norm;
+			qr.y /= norm;
+			qr.z /= norm;
+
+			return qr;
+		}
+
+		vr::HmdVector3d_t lerp(const vr::HmdVector3d_t& v1, const vr::HmdVector3d_t& v2, double t)
+		{
+			return {
+				v1.v[0] + (v2.v[0] - v1.v[0]) * t,
+				v1.v[1] + (v2.v[1] - v1.v[1]) * t,
+				v1.v[2] + (v2.v[2] - v1.v[2]) * t
+			};
+		}
+
+		vr::HmdQuaternion_t quaternionNormalize(const vr::HmdQuaternion_t& q)
+		{
+			double norm = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+			if (norm <= 0.0)
+			{
+				return { 1, 0, 0, 0 };
+			}
+			return { q.w / norm, q.x / norm, q.y / norm, q.z / norm };
+		}
+
+		vr::HmdQuaternion_t slerpNormalized(vr::HmdQuaternion_t q1, vr::HmdQuaternion_t q2, double t)
+		{
+			q1 = quaternionNormalize(q1);
+			q2 = quaternionNormalize(q2);
+
+			double dotproduct = q1.w * q2.w + q1.x * q2.x + q1.y * q2.y + q1.z * q2.z;
+
+			// q and -q are the same rotation, take the shorter way
+			if (dotproduct < 0.0)
+			{
+				q2 = { -q2.w, -q2.x, -q2.y, -q2.z };
+				dotproduct = -dotproduct;
+			}
+
+			double c1, c2;
+			if (dotproduct > 0.9999999)
+			{
+				// Nearly identical, sin(theta) would be too small. Fall back to a normalized lerp
+				c1 = 1.0 - t;
+				c2 = t;
+			}
+			else
+			{
+				double theta = std::acos(dotproduct);
+				double st = std::sin(theta);
+				c1 = std::sin((1.0 - t) * theta) / st;
+				c2 = std::sin(t * theta) / st;
+			}
+
+			return quaternionNormalize({
+				c1 * q1.w + c2 * q2.w,
+				c1 * q1.x + c2 * q2.x,
+				c1 * q1.y + c2 * q2.y,
+				c1 * q1.z + c2 * q2.z
+			});
+		}
+
+		vr::HmdQuaternion_t quaternionExp(const vr::HmdVector3d_t& rotVec)
+		{
+			double angle = std::sqrt(rotVec.v[0] * rotVec.v[0] + rotVec.v[1] * rotVec.v[1] + rotVec.v[2] * rotVec.v[2]);
+
+			// sin(angle / 2) / angle, with its Taylor series near zero
+			double s = angle < 1.0E-6 ? 0.5 - angle * angle / 48.0 : std::sin(angle * 0.5) / angle;
+			return quaternionNormalize({ std::cos(angle * 0.5), rotVec.v[0] * s, rotVec.v[1] * s, rotVec.v[2] * s });
+		}
+
+		vr::HmdVector3d_t quaternionLog(const vr::HmdQuaternion_t& q)
+		{
+			double sign = q.w < 0.0 ? -1.0 : 1.0;
+			double n = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z);
+
+			// angle / sin(angle / 2), with its Taylor series near zero
+			double s = n < 1.0E-9 ? 2.0 / std::fabs(q.w) : 2.0 * std::atan2(n, std::fabs(q.w)) / n;
+			s *= sign;
+			return { q.x * s, q.y * s, q.z * s };
+		}
+
+		vr::HmdVector3d_t quaternionVelocity(double time, const vr::HmdQuaternion_t& q, const vr::HmdQuaternion_t& Old_q)
+		{
+			if (time == 0.0)
+			{
+				return { 0, 0, 0 };
+			}
+
+			// Rotation from Old_q to q in the frame of Old_q: q = Old_q * q_rel
+			vr::HmdQuaternion_t oldInv = { Old_q.w, -Old_q.x, -Old_q.y, -Old_q.z };
+			vr::HmdQuaternion_t rel = {
+				oldInv.w * q.w - oldInv.x * q.x - oldInv.y * q.y - oldInv.z * q.z,
+				oldInv.w * q.x + oldInv.x * q.w + oldInv.y * q.z - oldInv.z * q.y,
+				oldInv.w * q.y - oldInv.x * q.z + oldInv.y * q.w + oldInv.z * q.x,
+				oldInv.w * q.z + oldInv.x * q.y - oldInv.y * q.x + oldInv.z * q.w
+			};
+			vr::HmdVector3d_t body = quaternionLog(quaternionNormalize(rel));
+
+			// Rotated into the space of the quaternions: log(q * Old_q^-1) = Old_q * log(q_rel)
+			vr::HmdVector3d_t u = { Old_q.x, Old_q.y, Old_q.z };
+			vr::HmdVector3d_t t = {
+				2.0 * (u.v[1] * body.v[2] - u.v[2] * body.v[1]),
+				2.0 * (u.v[2] * body.v[0] - u.v[0] * body.v[2]),
+				2.0 * (u.v[0] * body.v[1] - u.v[1] * body.v[0])
+			};
+			return {
+				(body.v[0] + Old_q.w * t.v[0] + u.v[1] * t.v[2] - u.v[2] * t.v[1]) / time,
+				(body.v[1] + Old_q.w * t.v[1] + u.v[2] * t.v[0] - u.v[0] * t.v[2]) / time,
+				(body.v[2] + Old_q.w * t.v[2] + u.v[0] * t.v[1] - u.v[1] * t.v[0]) / time
+			};
+		}
+
+		vr::HmdVector3d_t vecDerivative(double time, const vr::HmdVector3d_t& vec, const vr::HmdVector3d_t& Old_vec)
+		{
+			return {
+				vecVelocity(time, vec.v[0], Old_vec.v[0]),
+				vecVelocity(time, vec.v[1], Old_vec.v[1]),
+				vecVelocity(time, vec.v[2], Old_vec.v[2])
+			};
+		}
+
+		// Convert Quaternion to Euler Angles in Radians
+		vr::HmdVector3d_t toEulerAngles(vr::HmdQuaternion_t q)
+		{
+			vr::HmdVector3d_t angles;
+
+			// roll (x-axis rotation)
+			double sinr_cosp = 2 * (q.w * q.x + q.y * q.z);
+			double cosr_cosp = 1 - 2 * (q.x * q.x + q.y * q.y);
+			angles.v[0] = std::atan2(sinr_cosp, cosr_cosp);
+
+			// pitch (y-axis rotation)
+			double sinp = 2 * (q.w * q.y - q.z * q.x);
+
+			if (std::abs(sinp) >= 1)
+			{
+				angles.v[1] = std::copysign(PI / 2, sinp); // use 90 degrees if out of range
+			}
+			else
+			{
+				angles.v[1] = std::asin(sinp);
+			}
+
+			// yaw (z-axis rotation)
+			double siny_cosp = 2 * (q.w * q.z + q.x * q.y);
+			double cosy_cosp = 1 - 2 * (q.y * q.y + q.z * q.z);
+			angles.v[2] = std::atan2(siny_cosp, cosy_cosp);
+
+			return angles;
+		}
+	}
+}
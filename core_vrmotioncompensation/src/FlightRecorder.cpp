@@ -0,0 +1,363 @@
+#include "vrmc_openvr.h"
+#include "FlightRecorder.h"
+#include "CaptureFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <new>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// How often the dump thread looks for a trigger. The pose threads only set it and never wake the thread
+		static const int DumpPollMs = 20;
+
+		static double distance(const vr::HmdVector3d_t& a, const vr::HmdVector3d_t& b)
+		{
+			double x = a.v[0] - b.v[0];
+			double y = a.v[1] - b.v[1];
+			double z = a.v[2] - b.v[2];
+			return std::sqrt(x * x + y * y + z * z);
+		}
+
+		static const char* triggerName(FlightRecorderTrigger reason)
+		{
+			switch (reason)
+			{
+			case FlightRecorderTrigger::Request:
+				return "request";
+			case FlightRecorderTrigger::PositionJump:
+				return "jump";
+			case FlightRecorderTrigger::TrackingLost:
+				return "trackinglost";
+			case FlightRecorderTrigger::CompensationDelta:
+				return "compensation";
+			default:
+				return "unknown";
+			}
+		}
+
+		FlightRecorder::~FlightRecorder()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_Mutex);
+				_Stop = true;
+			}
+			_Wake.notify_all();
+			if (_DumpThread.joinable())
+			{
+				_DumpThread.join();
+			}
+		}
+
+		FlightRecorderSettings FlightRecorder::defaultSettings()
+		{
+			FlightRecorderSettings settings;
+			settings.Enabled = false;
+			settings.Seconds = 10;
+			settings.PostTriggerMs = 1000;
+			settings.MaxPositionJump = 0.1;
+			settings.MaxCompensationDelta = 0.5;
+			settings.DumpOnTrackingLost = true;
+			return settings;
+		}
+
+		bool FlightRecorder::configure(const FlightRecorderSettings& settings)
+		{
+			if (settings.Seconds == 0 || settings.Seconds > MaxSeconds || settings.PostTriggerMs > MaxPostTriggerMs
+				|| !(settings.MaxPositionJump >= 0.0) || !(settings.MaxCompensationDelta >= 0.0)
+				|| !std::isfinite(settings.MaxPositionJump) || !std::isfinite(settings.MaxCompensationDelta))
+			{
+				return false;
+			}
+
+			std::lock_guard<std::mutex> lock(_Mutex);
+			if (settings.Enabled)
+			{
+				uint32_t entries = settings.Seconds * EntriesPerSecond + settings.PostTriggerMs * EntriesPerSecond / 1000;
+				Ring* ring = _Ring.load(std::memory_order_relaxed);
+				if (ring == nullptr || ring->EntryCount < entries)
+				{
+					std::unique_ptr<Ring> grown(new Ring());
+					try
+					{
+						// Value initialized, every Sequence starts at 0
+						grown->Entries.reset(new FlightRecorderEntry[entries]());
+					}
+					catch (std::bad_alloc&)
+					{
+						return false;
+					}
+					grown->EntryCount = entries;
+					_Ring.store(grown.get(), std::memory_order_release);
+					_Rings.push_back(std::move(grown));
+				}
+
+				if (!_DumpThread.joinable())
+				{
+					_DumpThread = std::thread(&FlightRecorder::dumpLoop, this);
+				}
+			}
+
+			_Settings = settings;
+			_MaxPositionJump.store(settings.MaxPositionJump, std::memory_order_relaxed);
+			_MaxCompensationDelta.store(settings.MaxCompensationDelta, std::memory_order_relaxed);
+			_DumpOnTrackingLost.store(settings.DumpOnTrackingLost, std::memory_order_relaxed);
+			_Enabled.store(settings.Enabled, std::memory_order_release);
+			return true;
+		}
+
+		FlightRecorderSettings FlightRecorder::getSettings()
+		{
+			std::lock_guard<std::mutex> lock(_Mutex);
+			return _Settings;
+		}
+
+		void FlightRecorder::setDirectory(const std::string& directory)
+		{
+			std::lock_guard<std::mutex> lock(_Mutex);
+			_Directory = directory;
+		}
+
+		void FlightRecorder::setDumpCallback(std::function<void(FlightRecorderTrigger, const std::string&, size_t)> callback)
+		{
+			std::lock_guard<std::mutex> lock(_Mutex);
+			_Callback = std::move(callback);
+		}
+
+		void FlightRecorder::record(const FlightRecorderEntry& entry)
+		{
+			if (!_Enabled.load(std::memory_order_acquire))
+			{
+				return;
+			}
+
+			Ring* ring = _Ring.load(std::memory_order_acquire);
+			SequencedRing::write(ring->WriteIndex, ring->Entries.get(), sizeof(FlightRecorderEntry), ring->EntryCount, &entry);
+
+			const TelemetryEntry_v1& pose = entry.Telemetry;
+			FlightRecorderTrigger anomaly = FlightRecorderTrigger::None;
+
+			double maxDelta = _MaxCompensationDelta.load(std::memory_order_relaxed);
+			if (maxDelta > 0.0 && distance(pose.CompensatedDevice.Position, pose.RawDevice.Position) > maxDelta)
+			{
+				anomaly = FlightRecorderTrigger::CompensationDelta;
+			}
+
+			if (pose.DeviceId < MaxDevices)
+			{
+				DeviceState& device = _Devices[pose.DeviceId];
+				bool tracking = (pose.Flags & TelemetryFlag_DeviceTracking) != 0;
+				bool compensated = (pose.Flags & TelemetryFlag_Compensated) != 0;
+
+				double maxJump = _MaxPositionJump.load(std::memory_order_relaxed);
+				if (maxJump > 0.0 && pose.TimeNs - device.LastTimeNs < MaxJumpIntervalNs)
+				{
+					if ((tracking && device.Tracking && distance(pose.RawDevice.Position, device.LastPosition) > maxJump)
+						|| (compensated && device.Compensated && distance(pose.RawReference.Position, device.LastReference) > maxJump))
+					{
+						anomaly = FlightRecorderTrigger::PositionJump;
+					}
+				}
+				if (device.Tracking && !tracking && _DumpOnTrackingLost.load(std::memory_order_relaxed))
+				{
+					anomaly = FlightRecorderTrigger::TrackingLost;
+				}
+
+				device.LastTimeNs = pose.TimeNs;
+				device.LastPosition = pose.RawDevice.Position;
+				device.LastReference = pose.RawReference.Position;
+				device.Compensated = compensated;
+				device.Tracking = tracking;
+			}
+
+			if (anomaly != FlightRecorderTrigger::None)
+			{
+				trigger(anomaly, pose.TimeNs);
+			}
+		}
+
+		void FlightRecorder::updateTracking(uint32_t deviceId, bool tracking, int64_t timeNs)
+		{
+			if (deviceId >= MaxDevices || !_Enabled.load(std::memory_order_relaxed))
+			{
+				return;
+			}
+
+			TrackingState& device = _TrackedDevices[deviceId];
+			if (device.Tracking && !tracking && _DumpOnTrackingLost.load(std::memory_order_relaxed))
+			{
+				trigger(FlightRecorderTrigger::TrackingLost, timeNs);
+			}
+			device.Tracking = tracking;
+		}
+
+		bool FlightRecorder::trigger(FlightRecorderTrigger reason, int64_t timeNs)
+		{
+			bool claimed = false;
+			if (!_Enabled.load(std::memory_order_relaxed) || !_TriggerClaimed.compare_exchange_strong(claimed, true, std::memory_order_acquire))
+			{
+				return false;
+			}
+			_TriggerNs.store(timeNs, std::memory_order_relaxed);
+			_Trigger.store((uint32_t)reason, std::memory_order_release);
+			return true;
+		}
+
+		void FlightRecorder::dumpLoop()
+		{
+			std::unique_lock<std::mutex> lock(_Mutex);
+			while (!_Stop)
+			{
+				_Wake.wait_for(lock, std::chrono::milliseconds(DumpPollMs));
+
+				FlightRecorderTrigger reason = (FlightRecorderTrigger)_Trigger.load(std::memory_order_acquire);
+				if (reason == FlightRecorderTrigger::None || _Stop)
+				{
+					continue;
+				}
+
+				// The poses after the trigger have to be recorded first
+				int64_t triggerNs = _TriggerNs.load(std::memory_order_relaxed);
+				if (TelemetryWriter::nowNs() < triggerNs + (int64_t)_Settings.PostTriggerMs * 1000000)
+				{
+					continue;
+				}
+
+				FlightRecorderSettings settings = _Settings;
+				std::string directory = _Directory;
+				auto callback = _Callback;
+				lock.unlock();
+
+				size_t entries = 0;
+				std::string path = dump(reason, triggerNs, settings, directory, entries);
+
+				// Released before the dump is published, a caller that sees the new count can trigger the next one
+				_Trigger.store((uint32_t)FlightRecorderTrigger::None, std::memory_order_relaxed);
+				_TriggerClaimed.store(false, std::memory_order_release);
+
+				_Dumps.fetch_add(path.empty() ? 0 : 1, std::memory_order_release);
+				if (callback)
+				{
+					callback(reason, path, entries);
+				}
+				lock.lock();
+			}
+		}
+
+		std::string FlightRecorder::dump(FlightRecorderTrigger reason, int64_t triggerNs, const FlightRecorderSettings& settings, const std::string& directory, size_t& entries)
+		{
+			entries = 0;
+			Ring* ring = _Ring.load(std::memory_order_acquire);
+			if (ring == nullptr)
+			{
+				return "";
+			}
+
+			std::vector<FlightRecorderEntry> poses;
+			try
+			{
+				poses.resize(ring->EntryCount);
+			}
+			catch (std::bad_alloc&)
+			{
+				return "";
+			}
+
+			// Everything still in the ring, then the window around the trigger in time order
+			uint64_t next = 0;
+			uint64_t lost = 0;
+			size_t count = SequencedRing::read(ring->WriteIndex, ring->Entries.get(), sizeof(FlightRecorderEntry), ring->EntryCount, next, lost, poses.data(), poses.size());
+			int64_t firstNs = triggerNs - (int64_t)settings.Seconds * 1000000000;
+			int64_t lastNs = triggerNs + (int64_t)settings.PostTriggerMs * 1000000;
+			poses.erase(std::remove_if(poses.begin(), poses.begin() + count, [&](const FlightRecorderEntry& pose)
+			{
+				return pose.Telemetry.TimeNs < firstNs || pose.Telemetry.TimeNs > lastNs;
+			}), poses.end());
+			std::stable_sort(poses.begin(), poses.end(), [](const FlightRecorderEntry& a, const FlightRecorderEntry& b)
+			{
+				return a.Telemetry.TimeNs < b.Telemetry.TimeNs;
+			});
+
+			// The capture starts at the trigger on the system clock, the times of the poses are relative to it
+			int64_t triggerUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count()
+				- (TelemetryWriter::nowNs() - triggerNs) / 1000;
+			std::time_t triggerTime = (std::time_t)(triggerUs / 1000000);
+			char stamp[32];
+			std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&triggerTime));
+			char sequence[32];
+			std::snprintf(sequence, sizeof(sequence), ".%03d-%u-", (int)(triggerUs / 1000 % 1000), ++_DumpSequence);
+			std::string path = (directory.empty() ? std::string() : directory + "/") + "FlightRecorder-" + stamp + sequence + triggerName(reason) + ".vrmccap";
+
+			std::vector<CaptureChannel> channels = {
+				{ "Device", CaptureChannelType::Scalar },
+				{ "Flags", CaptureChannelType::Scalar },
+				{ "ReferenceAgeMs", CaptureChannelType::Scalar },
+				{ "RawReferencePosition", CaptureChannelType::Vector3 },
+				{ "RawReferenceRotation", CaptureChannelType::Quaternion },
+				{ "FilteredReferencePosition", CaptureChannelType::Vector3 },
+				{ "FilteredReferenceRotation", CaptureChannelType::Quaternion },
+				{ "RefVelocity", CaptureChannelType::Vector3 },
+				{ "RefAcceleration", CaptureChannelType::Vector3 },
+				{ "RefAngularVelocity", CaptureChannelType::Vector3 },
+				{ "RefAngularAcceleration", CaptureChannelType::Vector3 },
+				{ "DevicePosition", CaptureChannelType::Vector3 },
+				{ "DeviceRotation", CaptureChannelType::Quaternion },
+				{ "CompensatedPosition", CaptureChannelType::Vector3 },
+				{ "CompensatedRotation", CaptureChannelType::Quaternion },
+			};
+
+			CaptureWriter capture;
+			if (!capture.open(path.c_str(), channels, triggerUs, std::max<size_t>(poses.size(), 1)))
+			{
+				return "";
+			}
+
+			std::vector<double> record(capture.getRecordDoubles());
+			for (const FlightRecorderEntry& pose : poses)
+			{
+				const TelemetryEntry_v1& t = pose.Telemetry;
+				double* value = record.data();
+				auto vector = [&](const vr::HmdVector3d_t& v)
+				{
+					*value++ = v.v[0];
+					*value++ = v.v[1];
+					*value++ = v.v[2];
+				};
+				auto quaternion = [&](const vr::HmdQuaternion_t& q)
+				{
+					*value++ = q.w;
+					*value++ = q.x;
+					*value++ = q.y;
+					*value++ = q.z;
+				};
+
+				*value++ = (double)(t.TimeNs - triggerNs) / 1.0E9;
+				*value++ = t.DeviceId == TelemetryNoDevice ? -1.0 : (double)t.DeviceId;
+				*value++ = (double)t.Flags;
+				*value++ = (double)(t.DeviceSampleUs - t.RefSampleUs) / 1000.0;
+				vector(t.RawReference.Position);
+				quaternion(t.RawReference.Rotation);
+				vector(t.FilteredReference.Position);
+				quaternion(t.FilteredReference.Rotation);
+				vector(pose.RefVelocity);
+				vector(pose.RefAcceleration);
+				vector(pose.RefAngularVelocity);
+				vector(pose.RefAngularAcceleration);
+				vector(t.RawDevice.Position);
+				quaternion(t.RawDevice.Rotation);
+				vector(t.CompensatedDevice.Position);
+				quaternion(t.CompensatedDevice.Rotation);
+				capture.append(record.data());
+			}
+			capture.close();
+
+			entries = poses.size();
+			return path;
+		}
+	}
+}
@@ -0,0 +1,278 @@
+#include "IpcRing.h"
+
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// Slots start on a cache line, so neighbouring messages do not share one
+		static const size_t SlotAlignment = 64;
+
+		static size_t slotStride(uint32_t slotSize)
+		{
+			size_t stride = sizeof(uint64_t) * 2 + (size_t)slotSize;
+			return (stride + SlotAlignment - 1) / SlotAlignment * SlotAlignment;
+		}
+
+		static size_t headerSize()
+		{
+			return (sizeof(IpcRingHeader) + SlotAlignment - 1) / SlotAlignment * SlotAlignment;
+		}
+
+		IpcRing::~IpcRing()
+		{
+			detach();
+		}
+
+		size_t IpcRing::requiredSize(uint32_t slotCount, uint32_t slotSize)
+		{
+			return headerSize() + (size_t)slotCount * slotStride(slotSize);
+		}
+
+		bool IpcRing::create(void* memory, size_t size, uint32_t slotCount, uint32_t slotSize, const char* name)
+		{
+			detach();
+			if (slotCount == 0 || (slotCount & (slotCount - 1)) != 0 || size < requiredSize(slotCount, slotSize)
+				|| ((uintptr_t)memory % SlotAlignment) != 0)
+			{
+				return false;
+			}
+
+			IpcRingHeader* header = new (memory) IpcRingHeader();
+			header->SlotCount = slotCount;
+			header->SlotSize = slotSize;
+			header->Tail.store(0, std::memory_order_relaxed);
+			header->Head.store(0, std::memory_order_relaxed);
+			header->Signal.store(0, std::memory_order_relaxed);
+			header->Sleepers.store(0, std::memory_order_relaxed);
+
+			char* slots = static_cast<char*>(memory) + headerSize();
+			for (uint32_t i = 0; i < slotCount; i++)
+			{
+				Slot* slot = new (slots + (size_t)i * slotStride(slotSize)) Slot();
+				slot->Sequence.store(i, std::memory_order_relaxed);
+				slot->Size = 0;
+			}
+
+			header->Version = Version;
+			std::atomic_thread_fence(std::memory_order_release);
+			header->Magic = Magic;
+			std::atomic_thread_fence(std::memory_order_release);
+
+			return attach(memory, size, name);
+		}
+
+		bool IpcRing::attach(void* memory, size_t size, const char* name)
+		{
+			detach();
+			IpcRingHeader* header = static_cast<IpcRingHeader*>(memory);
+			if (size < sizeof(IpcRingHeader) || header->Magic != Magic || header->Version != Version)
+			{
+				return false;
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (header->SlotCount == 0 || (header->SlotCount & (header->SlotCount - 1)) != 0 || size < requiredSize(header->SlotCount, header->SlotSize))
+			{
+				return false;
+			}
+
+			_Header = header;
+			_Slots = static_cast<char*>(memory) + headerSize();
+			_Mask = header->SlotCount - 1;
+			_SlotStride = slotStride(header->SlotSize);
+			if (!openEvent(name))
+			{
+				_Header = nullptr;
+				return false;
+			}
+			return true;
+		}
+
+		void IpcRing::detach()
+		{
+#ifdef _WIN32
+			if (_Event)
+			{
+				CloseHandle((HANDLE)_Event);
+			}
+#endif
+			_Event = nullptr;
+			_Header = nullptr;
+			_Slots = nullptr;
+		}
+
+		bool IpcRing::trySend(const void* data, uint32_t size)
+		{
+			uint64_t index = _Header->Tail.load(std::memory_order_relaxed);
+			Slot* slot;
+			for (;;)
+			{
+				slot = slotAt(index);
+				uint64_t sequence = slot->Sequence.load(std::memory_order_acquire);
+				int64_t difference = (int64_t)(sequence - index);
+				if (difference == 0)
+				{
+					if (_Header->Tail.compare_exchange_weak(index, index + 1, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (difference < 0)
+				{
+					// The receiver has not read the slot of the previous lap yet
+					return false;
+				}
+				else
+				{
+					index = _Header->Tail.load(std::memory_order_relaxed);
+				}
+			}
+
+			slot->Size = size;
+			std::memcpy(reinterpret_cast<char*>(slot) + sizeof(Slot), data, size);
+			slot->Sequence.store(index + 1, std::memory_order_release);
+			return true;
+		}
+
+		bool IpcRing::send(const void* data, uint32_t size, uint32_t timeoutMs)
+		{
+			if (!_Header || size > _Header->SlotSize)
+			{
+				return false;
+			}
+
+			// A full ring means the receiver is far behind, so there is no point in a wake up for free slots
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+			while (!trySend(data, size))
+			{
+				if (std::chrono::steady_clock::now() >= deadline)
+				{
+					return false;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			wake();
+			return true;
+		}
+
+		bool IpcRing::tryReceive(void* data, uint32_t capacity, uint32_t& size)
+		{
+			if (!_Header)
+			{
+				return false;
+			}
+
+			uint64_t index = _Header->Head.load(std::memory_order_relaxed);
+			Slot* slot = slotAt(index);
+			if (slot->Sequence.load(std::memory_order_acquire) != index + 1)
+			{
+				return false;
+			}
+
+			size = slot->Size;
+			bool fits = size <= capacity;
+			if (fits)
+			{
+				std::memcpy(data, reinterpret_cast<const char*>(slot) + sizeof(Slot), size);
+			}
+			slot->Sequence.store(index + _Mask + 1, std::memory_order_release);
+			_Header->Head.store(index + 1, std::memory_order_relaxed);
+			return fits;
+		}
+
+		bool IpcRing::receive(void* data, uint32_t capacity, uint32_t& size, uint32_t timeoutMs)
+		{
+			if (!_Header)
+			{
+				return false;
+			}
+
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+			for (;;)
+			{
+				// A send after this load changes Signal, so the sleep below returns at once instead of missing it
+				uint32_t key = _Header->Signal.load(std::memory_order_seq_cst);
+				if (tryReceive(data, capacity, size))
+				{
+					return true;
+				}
+
+				auto now = std::chrono::steady_clock::now();
+				if (now >= deadline)
+				{
+					return false;
+				}
+
+				// Senders only make the wake up syscall while Sleepers is set
+				_Header->Sleepers.fetch_add(1, std::memory_order_seq_cst);
+				if (_Header->Signal.load(std::memory_order_seq_cst) == key)
+				{
+					sleep(key, (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1);
+				}
+				_Header->Sleepers.fetch_sub(1, std::memory_order_seq_cst);
+			}
+		}
+
+		void IpcRing::wake()
+		{
+			_Header->Signal.fetch_add(1, std::memory_order_seq_cst);
+			if (_Header->Sleepers.load(std::memory_order_seq_cst) == 0)
+			{
+				return;
+			}
+#ifdef _WIN32
+			SetEvent((HANDLE)_Event);
+#elif defined(__linux__)
+			syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_Header->Signal), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+		}
+
+		void IpcRing::sleep(uint32_t key, uint32_t timeoutMs)
+		{
+#ifdef _WIN32
+			// Auto-reset, a wake up that came in before the wait is not lost but may make the next wait return early
+			(void)key;
+			WaitForSingleObject((HANDLE)_Event, timeoutMs);
+#elif defined(__linux__)
+			// Not FUTEX_PRIVATE_FLAG, the sender is in another process. Returns at once if Signal is no longer key
+			timespec timeout;
+			timeout.tv_sec = timeoutMs / 1000;
+			timeout.tv_nsec = (long)(timeoutMs % 1000) * 1000000;
+			syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_Header->Signal), FUTEX_WAIT, key, &timeout, nullptr, 0);
+#else
+			(void)key;
+			(void)timeoutMs;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif
+		}
+
+		bool IpcRing::openEvent(const char* name)
+		{
+#ifdef _WIN32
+			// Both sides create or open the same named auto-reset event
+			std::string eventName = std::string(name ? name : "vrmotioncompensation.ring") + ".event";
+			_Event = CreateEventA(nullptr, FALSE, FALSE, eventName.c_str());
+			return _Event != nullptr;
+#else
+			(void)name;
+			return true;
+#endif
+		}
+	}
+}
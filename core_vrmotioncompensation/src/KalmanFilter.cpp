@@ -0,0 +1,163 @@
+#include "KalmanFilter.h"
+#include "Filters.h"
+#include <openvr_math.h>
+
+#include <cmath>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// Initial variance of velocity and acceleration, large enough to let the first measurements settle them
+		static const double InitialVelVariance = 1.0;
+		static const double InitialAccVariance = 100.0;
+
+		void PoseKalmanFilter::setNoise(double processNoise, double observationNoise)
+		{
+			_ProcessNoise = processNoise;
+			_ObservationNoise = observationNoise;
+			_Initialized = false;
+		}
+
+		void PoseKalmanFilter::initialize(long long timeUs, const double(&pos)[3], const vr::HmdQuaternion_t& rot)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				_Pos[axis][0] = pos[axis];
+				_Pos[axis][1] = 0.0;
+				_Pos[axis][2] = 0.0;
+				_AngVel[axis] = 0.0;
+				_AngAcc[axis] = 0.0;
+			}
+			_Rot = quaternionNormalize(rot);
+
+			for (int i = 0; i < 3; i++)
+			{
+				for (int j = 0; j < 3; j++)
+				{
+					_P[i][j] = 0.0;
+				}
+			}
+			_P[0][0] = _ObservationNoise * _ObservationNoise;
+			_P[1][1] = InitialVelVariance;
+			_P[2][2] = InitialAccVariance;
+
+			_LastTimeUs = timeUs;
+			_Initialized = true;
+		}
+
+		void PoseKalmanFilter::update(long long timeUs, const double(&pos)[3], const vr::HmdQuaternion_t& rot)
+		{
+			if (!_Initialized || timeUs <= _LastTimeUs || timeUs - _LastTimeUs > MaxGapUs)
+			{
+				initialize(timeUs, pos, rot);
+				return;
+			}
+
+			double dt = (double)(timeUs - _LastTimeUs) / 1.0E6;
+			double dt2 = dt * dt;
+			double dt3 = dt2 * dt;
+			_LastTimeUs = timeUs;
+
+			// ----------------------------------------------------------------------------------------------- //
+			// Predict: x = F x with F = [1 dt dt^2/2; 0 1 dt; 0 0 1]
+			for (int axis = 0; axis < 3; axis++)
+			{
+				double* x = _Pos[axis];
+				x[0] += x[1] * dt + x[2] * dt2 * 0.5;
+				x[1] += x[2] * dt;
+			}
+
+			vr::HmdVector3d_t rotStep;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				rotStep.v[axis] = _AngVel[axis] * dt + _AngAcc[axis] * dt2 * 0.5;
+				_AngVel[axis] += _AngAcc[axis] * dt;
+			}
+			_Rot = quaternionExp(rotStep) * _Rot;
+
+			// P = F P F' + Q
+			double FP[3][3];
+			for (int j = 0; j < 3; j++)
+			{
+				FP[0][j] = _P[0][j] + _P[1][j] * dt + _P[2][j] * dt2 * 0.5;
+				FP[1][j] = _P[1][j] + _P[2][j] * dt;
+				FP[2][j] = _P[2][j];
+			}
+			for (int i = 0; i < 3; i++)
+			{
+				_P[i][0] = FP[i][0] + FP[i][1] * dt + FP[i][2] * dt2 * 0.5;
+				_P[i][1] = FP[i][1] + FP[i][2] * dt;
+				_P[i][2] = FP[i][2];
+			}
+
+			// Discrete white noise jerk model
+			double q = _ProcessNoise;
+			_P[0][0] += q * dt3 * dt2 / 20.0;
+			_P[0][1] += q * dt2 * dt2 / 8.0;
+			_P[0][2] += q * dt3 / 6.0;
+			_P[1][0] += q * dt2 * dt2 / 8.0;
+			_P[1][1] += q * dt3 / 3.0;
+			_P[1][2] += q * dt2 / 2.0;
+			_P[2][0] += q * dt3 / 6.0;
+			_P[2][1] += q * dt2 / 2.0;
+			_P[2][2] += q * dt;
+
+			// ----------------------------------------------------------------------------------------------- //
+			// Update with the measured position and the measured rotation error
+			double S = _P[0][0] + _ObservationNoise * _ObservationNoise;
+			double K[3] = { _P[0][0] / S, _P[1][0] / S, _P[2][0] / S };
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				double* x = _Pos[axis];
+				double y = pos[axis] - x[0];
+				x[0] += K[0] * y;
+				x[1] += K[1] * y;
+				x[2] += K[2] * y;
+			}
+
+			vr::HmdVector3d_t rotError = quaternionLog(rot * vrmath::quaternionConjugate(_Rot));
+			vr::HmdVector3d_t rotCorrection;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				rotCorrection.v[axis] = K[0] * rotError.v[axis];
+				_AngVel[axis] += K[1] * rotError.v[axis];
+				_AngAcc[axis] += K[2] * rotError.v[axis];
+			}
+			_Rot = quaternionNormalize(quaternionExp(rotCorrection) * _Rot);
+
+			// P = (I - K H) P
+			double P0[3] = { _P[0][0], _P[0][1], _P[0][2] };
+			for (int i = 0; i < 3; i++)
+			{
+				for (int j = 0; j < 3; j++)
+				{
+					_P[i][j] -= K[i] * P0[j];
+				}
+			}
+		}
+
+		PoseKalmanFilter::State PoseKalmanFilter::predict(double latency) const
+		{
+			State state;
+			double l2 = latency * latency * 0.5;
+
+			vr::HmdVector3d_t rotStep;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				const double* x = _Pos[axis];
+				state.Pos.v[axis] = x[0] + x[1] * latency + x[2] * l2;
+				state.Vel.v[axis] = x[1] + x[2] * latency;
+				state.Acc.v[axis] = x[2];
+
+				rotStep.v[axis] = _AngVel[axis] * latency + _AngAcc[axis] * l2;
+				state.AngVel.v[axis] = _AngVel[axis] + _AngAcc[axis] * latency;
+				state.AngAcc.v[axis] = _AngAcc[axis];
+			}
+			state.Rot = quaternionExp(rotStep) * _Rot;
+
+			return state;
+		}
+	}
+}
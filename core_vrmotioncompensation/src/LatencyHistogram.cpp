@@ -0,0 +1,59 @@
+#include "vrmc_openvr.h"
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		LatencyStatistics LatencyHistogram::getStatistics() const
+		{
+			// One copy of the buckets, so the count and the percentiles agree with each other
+			uint64_t counts[BucketCount];
+			uint64_t total = 0;
+			for (uint32_t i = 0; i < BucketCount; i++)
+			{
+				counts[i] = _Counts[i].load(std::memory_order_relaxed);
+				total += counts[i];
+			}
+
+			LatencyStatistics statistics = {};
+			statistics.Count = total;
+			statistics.MaxNs = _Max.load(std::memory_order_relaxed);
+			if (total == 0)
+			{
+				return statistics;
+			}
+
+			// The smallest value that at least p of the values do not exceed
+			const double percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+			uint64_t* results[] = { &statistics.P50Ns, &statistics.P90Ns, &statistics.P99Ns, &statistics.P999Ns };
+			uint64_t seen = 0;
+			uint32_t bucket = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(percentiles[i] * (double)total));
+				while (bucket < BucketCount - 1 && seen + counts[bucket] < rank)
+				{
+					seen += counts[bucket];
+					bucket++;
+				}
+
+				// The last bucket is open ended, only the maximum is known there
+				*results[i] = bucket == BucketCount - 1 ? statistics.MaxNs : std::min(bucketUpperEdge(bucket), statistics.MaxNs);
+			}
+			return statistics;
+		}
+
+		void LatencyHistogram::reset()
+		{
+			for (std::atomic<uint64_t>& count : _Counts)
+			{
+				count.store(0, std::memory_order_relaxed);
+			}
+			_Max.store(0, std::memory_order_relaxed);
+		}
+	}
+}
@@ -0,0 +1,390 @@
+#include "MotionCompensationCore.h"
+#include "Filters.h"
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		MotionCompensationCore::MotionCompensationCore()
+		{
+			_State = {};
+			_State.ZeroRot = { 1, 0, 0, 0 };
+			_State.RefRot = { 1, 0, 0, 0 };
+			_State.RefRotInv = { 1, 0, 0, 0 };
+			_State.RawRefRot = { 1, 0, 0, 0 };
+			_State.RefRotMat = vrmath::quaternionToMatrix33(_State.RefRot);
+			_State.WorldFromDriverRot = { 1, 0, 0, 0 };
+			_State.WorldFromDriverMat = vrmath::quaternionToMatrix33(_State.WorldFromDriverRot);
+			_Snapshot.store(_State);
+			selectPipeline();
+		}
+
+		void MotionCompensationCore::setEnabled(bool enabled)
+		{
+			_WriterLock.lock();
+			if (enabled)
+			{
+				_State.RefPoseValid = false;
+				_State.RefUpdateCount = 0;
+				_State.ZeroPoseValid = false;
+
+				_History.clear();
+				_Filter.Kalman.reset();
+				_Filter.OneEuro.reset();
+			}
+
+			_State.Enabled = enabled;
+			_Snapshot.store(_State);
+			_WriterLock.unlock();
+		}
+
+		void MotionCompensationCore::setAlpha(uint32_t samples)
+		{
+			_WriterLock.lock();
+			_Samples = samples;
+			_Filter.Alpha = 2.0 / (1.0 + (double)samples);
+			selectPipeline();
+			_WriterLock.unlock();
+		}
+
+		void MotionCompensationCore::setLpfBeta(double NewBeta)
+		{
+			_WriterLock.lock();
+			_Filter.LpfBeta = NewBeta;
+			selectPipeline();
+			_WriterLock.unlock();
+		}
+
+		void MotionCompensationCore::setFilterType(MotionCompensationFilterType type)
+		{
+			_WriterLock.lock();
+			_FilterType = type;
+			_Filter.Kalman.reset();
+			_Filter.OneEuro.reset();
+			selectPipeline();
+			_WriterLock.unlock();
+		}
+
+		void MotionCompensationCore::setKalmanNoise(double processNoise, double observationNoise)
+		{
+			_WriterLock.lock();
+			_Filter.Kalman.setNoise(processNoise, observationNoise);
+			_WriterLock.unlock();
+		}
+
+		void MotionCompensationCore::setKalmanPrediction(long long us)
+		{
+			_WriterLock.lock();
+			_Filter.KalmanPredictionUs = us;
+			_WriterLock.unlock();
+		}
+
+		void MotionCompensationCore::setOneEuroParameters(double minCutoff, double beta)
+		{
+			_WriterLock.lock();
+			_Filter.OneEuro.setParameters(minCutoff, beta);
+			_WriterLock.unlock();
+		}
+
+		void MotionCompensationCore::setFilterBypass(bool bypass)
+		{
+			_WriterLock.lock();
+			_FilterBypass = bypass;
+			selectPipeline();
+			_WriterLock.unlock();
+		}
+
+		void MotionCompensationCore::setZeroMode(bool setZero)
+		{
+			_WriterLock.lock();
+			_State.SetZeroMode = setZero;
+			selectPipeline();
+
+			_zeroVec(_State.RefVel);
+			_zeroVec(_State.RefRotVel);
+			_zeroVec(_State.RefAcc);
+			_zeroVec(_State.RefRotAcc);
+			_Snapshot.store(_State);
+			_WriterLock.unlock();
+		}
+
+		void MotionCompensationCore::resetZeroPose()
+		{
+			_WriterLock.lock();
+			_State.ZeroPoseValid = false;
+			_Snapshot.store(_State);
+			_WriterLock.unlock();
+		}
+
+		void MotionCompensationCore::resetRefPose()
+		{
+			_WriterLock.lock();
+			_State.RefPoseValid = false;
+			_State.ZeroPoseValid = false;
+			_History.clear();
+			_Filter.Kalman.reset();
+			_Filter.OneEuro.reset();
+			_Snapshot.store(_State);
+			_WriterLock.unlock();
+		}
+
+		void MotionCompensationCore::setZeroPose(const vr::DriverPose_t& pose)
+		{
+			// convert pose from driver space to app space
+			vr::HmdQuaternion_t tmpConj = vrmath::quaternionConjugate(pose.qWorldFromDriverRotation);
+
+			// Save zero points
+			_WriterLock.lock();
+			_State.ZeroPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecPosition, false) + pose.vecWorldFromDriverTranslation;
+			_State.ZeroRot = pose.qWorldFromDriverRotation * pose.qRotation;
+
+			_State.ZeroPoseValid = true;
+			_Snapshot.store(_State);
+			_WriterLock.unlock();
+		}
+
+		void MotionCompensationCore::updateRefPose(const vr::DriverPose_t& pose, long long timestampUs)
+		{
+			// From https://github.com/ValveSoftware/driver_hydra/blob/master/drivers/driver_hydra/driver_hydra.cpp Line 835:
+			// "True acceleration is highly volatile, so it's not really reasonable to
+			// extrapolate much from it anyway.  Passing it as 0 from any driver should
+			// be fine."
+
+			// Line 832:
+			// "The trade-off here is that setting a valid velocity causes the controllers
+			// to jitter, but the controllers feel much more "alive" and lighter.
+			// The jitter while stationary is more annoying than the laggy feeling caused
+			// by disabling velocity (which effectively disables prediction for rendering)."
+			// That means that we have to calculate the velocity to not interfere with the prediction for rendering
+
+			// Oculus devices do use acceleration. It also seems that the HMD uses theses values for render-prediction
+
+			vrmath::Matrix33d worldFromDriver = vrmath::quaternionToMatrix33(pose.qWorldFromDriverRotation);
+			long long sampleUs = sampleTime(pose, timestampUs);
+
+			// Filtered pose in driver space, from the pipeline selected for the current settings
+			FilterOutput filtered;
+
+			_WriterLock.lock();
+			bool setZeroMode = _State.SetZeroMode;
+			_Pipeline(_Filter, pose, sampleUs, filtered);
+
+			// convert pose from driver space to app space
+			_State.RefPos = vrmath::matMul33(worldFromDriver, filtered.Pos) + pose.vecWorldFromDriverTranslation;
+
+			// calculate orientation difference and its inverse
+			vr::HmdQuaternion_t poseWorldRot = pose.qWorldFromDriverRotation * filtered.Rot;
+			_State.RefRot = poseWorldRot * vrmath::quaternionConjugate(_State.ZeroRot);
+			_State.RefRotInv = vrmath::quaternionConjugate(_State.RefRot);
+			_State.RefRotMat = vrmath::quaternionToMatrix33(_State.RefRot);
+			_State.WorldFromDriverRot = pose.qWorldFromDriverRotation;
+			_State.WorldFromDriverMat = worldFromDriver;
+
+			_History.push(sampleUs + filtered.TimeShiftUs, _State.RefPos, poseWorldRot);
+
+			_State.RawRefPos = vrmath::matMul33(worldFromDriver, pose.vecPosition) + pose.vecWorldFromDriverTranslation;
+			_State.RawRefRot = pose.qWorldFromDriverRotation * pose.qRotation;
+			_State.RefSampleUs = sampleUs;
+
+			if (!setZeroMode)
+			{
+				// Convert velocity and acceleration values into app space
+				_State.RefVel = vrmath::matMul33(worldFromDriver, filtered.Vel);
+				_State.RefRotVel = vrmath::matMul33(worldFromDriver, filtered.AngVel);
+
+				_State.RefAcc = vrmath::matMul33(worldFromDriver, filtered.Acc);
+				_State.RefRotAcc = vrmath::matMul33(worldFromDriver, filtered.AngAcc);
+			}
+
+			// ----------------------------------------------------------------------------------------------- //
+			// ----------------------------------------------------------------------------------------------- //
+			// Wait 100 frames before setting reference pose to valid
+			if (_State.RefUpdateCount > 100)
+			{
+				_State.RefPoseValid = true;
+			}
+			else
+			{
+				_State.RefUpdateCount++;
+			}
+
+			// Publish everything the HMD thread needs in one go
+			_Snapshot.store(_State);
+			_WriterLock.unlock();
+		}
+
+		bool MotionCompensationCore::applyMotionCompensation(vr::DriverPose_t& pose)
+		{
+			// Lock-free copy of the last published reference state
+			const ReferenceSnapshot ref = _Snapshot.load();
+
+			if (ref.Enabled && ref.ZeroPoseValid && ref.RefPoseValid)
+			{
+				compensate(ref, pose);
+			}
+			return true;
+		}
+
+		bool MotionCompensationCore::applyMotionCompensation(vr::DriverPose_t& pose, long long timestampUs, uint32_t deviceId)
+		{
+			return compensateAt(pose, timestampUs, nullptr, deviceId);
+		}
+
+		bool MotionCompensationCore::applyMotionCompensation(vr::DriverPose_t& pose, long long timestampUs, const MotionCompensationDeviceOffset& offset, uint32_t deviceId)
+		{
+			return compensateAt(pose, timestampUs, &offset, deviceId);
+		}
+
+		bool MotionCompensationCore::compensateAt(vr::DriverPose_t& pose, long long timestampUs, const MotionCompensationDeviceOffset* offset, uint32_t deviceId)
+		{
+			ReferenceSnapshot ref = _Snapshot.load();
+			MMFstruct_OVRMC_Telemetry_v1* telemetry = _Telemetry.load(std::memory_order_acquire);
+			FlightRecorder* recorder = _FlightRecorder.load(std::memory_order_acquire);
+			bool recording = recorder != nullptr && recorder->isEnabled();
+
+			FlightRecorderEntry record;
+			TelemetryEntry_v1& entry = record.Telemetry;
+			if (telemetry != nullptr || recording)
+			{
+				entry.RawDevice = toTelemetryPose(pose);
+			}
+
+			bool compensated = false;
+			if (ref.Enabled && ref.ZeroPoseValid && ref.RefPoseValid)
+			{
+				// Move the reference to the time the device pose was sampled
+				vr::HmdVector3d_t refPos;
+				vr::HmdQuaternion_t refWorldRot;
+				if (_History.sampleAt(sampleTime(pose, timestampUs), _MaxExtrapolationUs.load(std::memory_order_relaxed), refPos, refWorldRot))
+				{
+					ref.RefPos = refPos;
+					ref.RefRot = refWorldRot * vrmath::quaternionConjugate(ref.ZeroRot);
+					ref.RefRotInv = vrmath::quaternionConjugate(ref.RefRot);
+					ref.RefRotMat = vrmath::quaternionToMatrix33(ref.RefRot);
+				}
+
+				compensate(ref, pose);
+				compensated = true;
+
+				// The offset is part of the compensation, an uncompensated device is passed through as it is
+				if (offset != nullptr)
+				{
+					applyDeviceOffset(pose, *offset);
+				}
+			}
+
+			if (telemetry != nullptr || recording)
+			{
+				entry.TimeNs = TelemetryWriter::nowNs();
+				entry.DeviceSampleUs = sampleTime(pose, timestampUs);
+				entry.RefSampleUs = ref.RefSampleUs;
+				entry.DeviceId = deviceId;
+				entry.Flags = (compensated ? TelemetryFlag_Compensated : 0)
+					| (pose.poseIsValid && pose.result == vr::TrackingResult_Running_OK ? TelemetryFlag_DeviceTracking : 0);
+				entry.RawReference = { ref.RawRefPos, ref.RawRefRot };
+				entry.FilteredReference = { ref.RefPos, ref.RefRot * ref.ZeroRot };
+				entry.CompensatedDevice = toTelemetryPose(pose);
+				if (telemetry != nullptr)
+				{
+					TelemetryWriter::write(*telemetry, entry);
+				}
+				if (recording)
+				{
+					record.RefVelocity = ref.RefVel;
+					record.RefAcceleration = ref.RefAcc;
+					record.RefAngularVelocity = ref.RefRotVel;
+					record.RefAngularAcceleration = ref.RefRotAcc;
+					recorder->record(record);
+				}
+			}
+			return true;
+		}
+
+		TelemetryPose_v1 MotionCompensationCore::toTelemetryPose(const vr::DriverPose_t& pose)
+		{
+			return {
+				vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, pose.vecPosition) + pose.vecWorldFromDriverTranslation,
+				pose.qWorldFromDriverRotation * pose.qRotation
+			};
+		}
+
+		void MotionCompensationCore::applyDeviceOffset(vr::DriverPose_t& pose, const MotionCompensationDeviceOffset& offset)
+		{
+			// Offset in driver space
+			vr::HmdVector3d_t arm = vrmath::quaternionRotateVector(pose.qRotation, offset.Translation);
+			pose.vecPosition[0] += arm.v[0];
+			pose.vecPosition[1] += arm.v[1];
+			pose.vecPosition[2] += arm.v[2];
+
+			// The offset point moves with the angular velocity around the device
+			const double(&w)[3] = pose.vecAngularVelocity;
+			pose.vecVelocity[0] += w[1] * arm.v[2] - w[2] * arm.v[1];
+			pose.vecVelocity[1] += w[2] * arm.v[0] - w[0] * arm.v[2];
+			pose.vecVelocity[2] += w[0] * arm.v[1] - w[1] * arm.v[0];
+
+			pose.qRotation = pose.qRotation * offset.Rotation;
+		}
+
+		void MotionCompensationCore::compensate(const ReferenceSnapshot& ref, vr::DriverPose_t& pose)
+		{
+			// All filter calculations are done within the function for the reference tracker, because the HMD position is updated 3x more often.
+			// The HMD normally shares the driver-to-world transform with the reference tracker, so the cached matrix can be used
+			const vr::HmdQuaternion_t& qWorldFromDriver = pose.qWorldFromDriverRotation;
+			vrmath::Matrix33d otherWorldFromDriver;
+			const vrmath::Matrix33d* pWorldFromDriver = &ref.WorldFromDriverMat;
+			if (qWorldFromDriver.w != ref.WorldFromDriverRot.w || qWorldFromDriver.x != ref.WorldFromDriverRot.x
+				|| qWorldFromDriver.y != ref.WorldFromDriverRot.y || qWorldFromDriver.z != ref.WorldFromDriverRot.z)
+			{
+				otherWorldFromDriver = vrmath::quaternionToMatrix33(qWorldFromDriver);
+				pWorldFromDriver = &otherWorldFromDriver;
+			}
+			const vrmath::Matrix33d& worldFromDriver = *pWorldFromDriver;
+
+			// Convert pose from driver space to app space
+			vr::HmdVector3d_t poseWorldPos = vrmath::matMul33(worldFromDriver, pose.vecPosition) + pose.vecWorldFromDriverTranslation;
+
+			// Do motion compensation
+			vr::HmdQuaternion_t poseWorldRot = qWorldFromDriver * pose.qRotation;
+			vr::HmdVector3d_t compensatedPoseWorldPos = ref.ZeroPos + vrmath::matTransposeMul33(ref.RefRotMat, poseWorldPos - ref.RefPos);
+			vr::HmdQuaternion_t compensatedPoseWorldRot = ref.RefRotInv * poseWorldRot;
+
+			if (ref.SetZeroMode)
+			{
+				_zeroVec(pose.vecVelocity);
+				_zeroVec(pose.vecAcceleration);
+				_zeroVec(pose.vecAngularVelocity);
+				_zeroVec(pose.vecAngularAcceleration);
+			}
+			else
+			{
+				// Translate the motion ref Velocity / Acceleration values into driver space and directly subtract them
+				vr::HmdVector3d_t tmpPosVel = vrmath::matTransposeMul33(worldFromDriver, ref.RefVel);
+				pose.vecVelocity[0] -= tmpPosVel.v[0];
+				pose.vecVelocity[1] -= tmpPosVel.v[1];
+				pose.vecVelocity[2] -= tmpPosVel.v[2];
+
+				vr::HmdVector3d_t tmpRotVel = vrmath::matTransposeMul33(worldFromDriver, ref.RefRotVel);
+				pose.vecAngularVelocity[0] -= tmpRotVel.v[0];
+				pose.vecAngularVelocity[1] -= tmpRotVel.v[1];
+				pose.vecAngularVelocity[2] -= tmpRotVel.v[2];
+
+				vr::HmdVector3d_t tmpPosAcc = vrmath::matTransposeMul33(worldFromDriver, ref.RefAcc);
+				pose.vecAcceleration[0] -= tmpPosAcc.v[0];
+				pose.vecAcceleration[1] -= tmpPosAcc.v[1];
+				pose.vecAcceleration[2] -= tmpPosAcc.v[2];
+
+				vr::HmdVector3d_t tmpRotAcc = vrmath::matTransposeMul33(worldFromDriver, ref.RefRotAcc);
+				pose.vecAngularAcceleration[0] -= tmpRotAcc.v[0];
+				pose.vecAngularAcceleration[1] -= tmpRotAcc.v[1];
+				pose.vecAngularAcceleration[2] -= tmpRotAcc.v[2];
+			}
+
+			// convert back to driver space
+			pose.qRotation = vrmath::quaternionConjugate(qWorldFromDriver) * compensatedPoseWorldRot;
+			vr::HmdVector3d_t adjPoseDriverPos = vrmath::matTransposeMul33(worldFromDriver, compensatedPoseWorldPos - pose.vecWorldFromDriverTranslation);
+			pose.vecPosition[0] = adjPoseDriverPos.v[0];
+			pose.vecPosition[1] = adjPoseDriverPos.v[1];
+			pose.vecPosition[2] = adjPoseDriverPos.v[2];
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#include "OneEuroFilter.h"
+#include "Filters.h"
+#include <openvr_math.h>
+
+#include <cmath>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		static const double PI = 3.14159265358979323846;
+
+		// Smoothing factor of a first order low pass with the given cutoff for one time step
+		static inline double smoothingFactor(double cutoff, double dt)
+		{
+			double r = 2.0 * PI * cutoff * dt;
+			return r / (r + 1.0);
+		}
+
+		void PoseOneEuroFilter::setParameters(double minCutoff, double beta)
+		{
+			_MinCutoff = minCutoff;
+			_Beta = beta;
+			_Initialized = false;
+		}
+
+		void PoseOneEuroFilter::update(long long timeUs, const double(&pos)[3], const vr::HmdQuaternion_t& rot)
+		{
+			if (!_Initialized || timeUs <= _LastTimeUs || timeUs - _LastTimeUs > MaxGapUs)
+			{
+				_State = {};
+				_Speed = {};
+				_AngularSpeed = {};
+				_State.Pos = { pos[0], pos[1], pos[2] };
+				_State.Rot = quaternionNormalize(rot);
+				_LastPos[0] = pos[0];
+				_LastPos[1] = pos[1];
+				_LastPos[2] = pos[2];
+				_LastRot = _State.Rot;
+				_LastTimeUs = timeUs;
+				_Initialized = true;
+				return;
+			}
+
+			double dt = (double)(timeUs - _LastTimeUs) / 1.0E6;
+			_LastTimeUs = timeUs;
+			double derivativeAlpha = smoothingFactor(DerivativeCutoff, dt);
+
+			// ----------------------------------------------------------------------------------------------- //
+			// Position
+			double speed = 0.0;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				_Speed.v[axis] += derivativeAlpha * ((pos[axis] - _LastPos[axis]) / dt - _Speed.v[axis]);
+				speed += _Speed.v[axis] * _Speed.v[axis];
+				_LastPos[axis] = pos[axis];
+			}
+
+			double alpha = smoothingFactor(_MinCutoff + _Beta * std::sqrt(speed), dt);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				double step = alpha * (pos[axis] - _State.Pos.v[axis]);
+				_State.Pos.v[axis] += step;
+				_State.Vel.v[axis] = step / dt;
+			}
+
+			// ----------------------------------------------------------------------------------------------- //
+			// Rotation
+			vr::HmdVector3d_t rotStep = quaternionLog(rot * vrmath::quaternionConjugate(_LastRot));
+			double angularSpeed = 0.0;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				_AngularSpeed.v[axis] += derivativeAlpha * (rotStep.v[axis] / dt - _AngularSpeed.v[axis]);
+				angularSpeed += _AngularSpeed.v[axis] * _AngularSpeed.v[axis];
+			}
+			_LastRot = rot;
+
+			// Move along the rotation vector from the filtered to the measured rotation
+			vr::HmdVector3d_t rotError = quaternionLog(rot * vrmath::quaternionConjugate(_State.Rot));
+			alpha = smoothingFactor(_MinCutoff + _Beta * std::sqrt(angularSpeed), dt);
+			rotError.v[0] *= alpha;
+			rotError.v[1] *= alpha;
+			rotError.v[2] *= alpha;
+			_State.Rot = quaternionNormalize(quaternionExp(rotError) * _State.Rot);
+			_State.AngVel = { rotError.v[0] / dt, rotError.v[1] / dt, rotError.v[2] / dt };
+		}
+	}
+}
@@ -0,0 +1,296 @@
+#include "PoseReplay.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// Doubles of a pose in the order of the csv columns
+		static const int PoseFields = 34;
+
+		static const char* CsvHeader = "timestamp_us,device,role,result,valid,connected,drift_in_yaw,head_model,time_offset,"
+			"wfd_qw,wfd_qx,wfd_qy,wfd_qz,wfd_x,wfd_y,wfd_z,dfh_qw,dfh_qx,dfh_qy,dfh_qz,dfh_x,dfh_y,dfh_z,"
+			"x,y,z,vx,vy,vz,ax,ay,az,qw,qx,qy,qz,wx,wy,wz,awx,awy,awz";
+
+		static const size_t MaxLineLength = 2048;
+
+		template <typename Pose, typename Double>
+		static void poseFields(Pose& pose, Double* fields[PoseFields])
+		{
+			int i = 0;
+			fields[i++] = &pose.poseTimeOffset;
+			fields[i++] = &pose.qWorldFromDriverRotation.w;
+			fields[i++] = &pose.qWorldFromDriverRotation.x;
+			fields[i++] = &pose.qWorldFromDriverRotation.y;
+			fields[i++] = &pose.qWorldFromDriverRotation.z;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				fields[i++] = &pose.vecWorldFromDriverTranslation[axis];
+			}
+			fields[i++] = &pose.qDriverFromHeadRotation.w;
+			fields[i++] = &pose.qDriverFromHeadRotation.x;
+			fields[i++] = &pose.qDriverFromHeadRotation.y;
+			fields[i++] = &pose.qDriverFromHeadRotation.z;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				fields[i++] = &pose.vecDriverFromHeadTranslation[axis];
+			}
+			for (int axis = 0; axis < 3; axis++)
+			{
+				fields[i++] = &pose.vecPosition[axis];
+			}
+			for (int axis = 0; axis < 3; axis++)
+			{
+				fields[i++] = &pose.vecVelocity[axis];
+			}
+			for (int axis = 0; axis < 3; axis++)
+			{
+				fields[i++] = &pose.vecAcceleration[axis];
+			}
+			fields[i++] = &pose.qRotation.w;
+			fields[i++] = &pose.qRotation.x;
+			fields[i++] = &pose.qRotation.y;
+			fields[i++] = &pose.qRotation.z;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				fields[i++] = &pose.vecAngularVelocity[axis];
+			}
+			for (int axis = 0; axis < 3; axis++)
+			{
+				fields[i++] = &pose.vecAngularAcceleration[axis];
+			}
+		}
+
+		// Next comma separated field of a line, false at the end of the line
+		static bool nextField(const char*& pos, const char* end, const char*& first, const char*& last)
+		{
+			if (pos > end)
+			{
+				return false;
+			}
+			while (pos < end && *pos == ' ')
+			{
+				pos++;
+			}
+			first = pos;
+			const char* comma = static_cast<const char*>(std::memchr(pos, ',', end - pos));
+			last = comma != nullptr ? comma : end;
+			pos = last + 1;
+			return true;
+		}
+
+		template <typename T>
+		static bool parseField(const char*& pos, const char* end, T& value)
+		{
+			const char* first;
+			const char* last;
+			if (!nextField(pos, end, first, last))
+			{
+				return false;
+			}
+			std::from_chars_result result = std::from_chars(first, last, value);
+			return result.ec == std::errc() && (result.ptr == last || *result.ptr == ' ');
+		}
+
+		static bool parseLine(const char* line, const char* end, ReplaySample& sample)
+		{
+			const char* pos = line;
+			const char* first;
+			const char* last;
+			int result, valid, connected, driftInYaw, headModel;
+			if (!parseField(pos, end, sample.TimestampUs) || !parseField(pos, end, sample.DeviceId) || !nextField(pos, end, first, last))
+			{
+				return false;
+			}
+
+			while (last > first && last[-1] == ' ')
+			{
+				last--;
+			}
+			if (last - first == 3 && std::strncmp(first, "ref", 3) == 0)
+			{
+				sample.Role = ReplayRole::Reference;
+			}
+			else if (last - first == 2 && std::strncmp(first, "mc", 2) == 0)
+			{
+				sample.Role = ReplayRole::Compensated;
+			}
+			else
+			{
+				return false;
+			}
+
+			if (!parseField(pos, end, result) || !parseField(pos, end, valid) || !parseField(pos, end, connected)
+				|| !parseField(pos, end, driftInYaw) || !parseField(pos, end, headModel))
+			{
+				return false;
+			}
+			sample.Pose = {};
+			sample.Pose.result = (vr::ETrackingResult)result;
+			sample.Pose.poseIsValid = valid != 0;
+			sample.Pose.deviceIsConnected = connected != 0;
+			sample.Pose.willDriftInYaw = driftInYaw != 0;
+			sample.Pose.shouldApplyHeadModel = headModel != 0;
+
+			double* fields[PoseFields];
+			poseFields(sample.Pose, fields);
+			for (double* field : fields)
+			{
+				if (!parseField(pos, end, *field))
+				{
+					return false;
+				}
+			}
+			return pos > end;
+		}
+
+		PoseReplay::PoseReplay()
+		{
+			_Core.setEnabled(true);
+		}
+
+		void PoseReplay::setDeviceOffset(uint32_t deviceId, const MotionCompensationDeviceOffset& offset)
+		{
+			// Same test as DeviceManipulationHandle::setOffset, a device without offset takes the path without it
+			bool hasOffset = offset.Translation.v[0] != 0.0 || offset.Translation.v[1] != 0.0 || offset.Translation.v[2] != 0.0
+				|| offset.Rotation.w != 1.0 || offset.Rotation.x != 0.0 || offset.Rotation.y != 0.0 || offset.Rotation.z != 0.0;
+			if (hasOffset)
+			{
+				_Offsets[deviceId] = offset;
+			}
+			else
+			{
+				_Offsets.erase(deviceId);
+			}
+		}
+
+		void PoseReplay::setReferenceTrackers(const std::vector<ReplaySample>& samples)
+		{
+			std::vector<uint32_t> devices;
+			for (const ReplaySample& sample : samples)
+			{
+				if (sample.Role == ReplayRole::Reference && std::find(devices.begin(), devices.end(), sample.DeviceId) == devices.end())
+				{
+					devices.push_back(sample.DeviceId);
+				}
+			}
+
+			if (devices.size() <= 1)
+			{
+				_ReferenceTrackers.setTracker(devices.empty() ? -1 : (int)devices[0]);
+			}
+			else
+			{
+				_ReferenceTrackers.setTrackers(devices);
+			}
+		}
+
+		bool PoseReplay::process(const ReplaySample& sample, ReplaySample& output)
+		{
+			_TimeUs = sample.TimestampUs;
+
+			if (sample.Role == ReplayRole::Reference)
+			{
+				// Poses that are not valid are passed on as well, so a fused reference tracker that lost tracking is left out
+				ZeroPoseCalibrationStatus status;
+				if (_ReferenceTrackers.update(sample.DeviceId, sample.Pose, _TimeUs, status))
+				{
+					_CalibrationWindows++;
+				}
+				return false;
+			}
+
+			output = sample;
+			if (sample.Pose.poseIsValid && sample.Pose.result == vr::TrackingResult_Running_OK)
+			{
+				auto offset = _Offsets.find(sample.DeviceId);
+				if (offset != _Offsets.end())
+				{
+					_Core.applyMotionCompensation(output.Pose, _TimeUs, offset->second, sample.DeviceId);
+				}
+				else
+				{
+					_Core.applyMotionCompensation(output.Pose, _TimeUs, sample.DeviceId);
+				}
+			}
+			return true;
+		}
+
+		void PoseReplay::run(const std::vector<ReplaySample>& samples, std::vector<ReplaySample>& output)
+		{
+			ReplaySample compensated;
+			for (const ReplaySample& sample : samples)
+			{
+				if (process(sample, compensated))
+				{
+					output.push_back(compensated);
+				}
+			}
+		}
+
+		bool PoseReplay::readCsv(std::FILE* file, std::vector<ReplaySample>& samples, size_t& errorLine)
+		{
+			char line[MaxLineLength];
+			size_t lineNumber = 0;
+			ReplaySample sample;
+			while (std::fgets(line, sizeof(line), file) != nullptr)
+			{
+				lineNumber++;
+				size_t length = std::strlen(line);
+				if (length == sizeof(line) - 1 && line[length - 1] != '\n')
+				{
+					errorLine = lineNumber;
+					return false;
+				}
+				while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+				{
+					length--;
+				}
+
+				if (length == 0 || line[0] == '#' || std::strncmp(line, "timestamp_us", 12) == 0)
+				{
+					continue;
+				}
+				if (!parseLine(line, line + length, sample))
+				{
+					errorLine = lineNumber;
+					return false;
+				}
+				samples.push_back(sample);
+			}
+			return true;
+		}
+
+		void PoseReplay::writeCsvHeader(std::FILE* file)
+		{
+			std::fputs(CsvHeader, file);
+			std::fputc('\n', file);
+		}
+
+		void PoseReplay::writeCsv(std::FILE* file, const ReplaySample& sample)
+		{
+			char line[MaxLineLength];
+			char* pos = line;
+			char* end = line + sizeof(line);
+
+			const vr::DriverPose_t& pose = sample.Pose;
+			pos += std::snprintf(pos, end - pos, "%lld,%u,%s,%d,%d,%d,%d,%d", sample.TimestampUs, sample.DeviceId,
+				sample.Role == ReplayRole::Reference ? "ref" : "mc", (int)pose.result, pose.poseIsValid ? 1 : 0, pose.deviceIsConnected ? 1 : 0,
+				pose.willDriftInYaw ? 1 : 0, pose.shouldApplyHeadModel ? 1 : 0);
+
+			// Shortest text that reads back as the same double
+			const double* fields[PoseFields];
+			poseFields(pose, fields);
+			for (const double* field : fields)
+			{
+				*pos++ = ',';
+				pos = std::to_chars(pos, end, *field).ptr;
+			}
+			*pos++ = '\n';
+			std::fwrite(line, 1, pos - line, file);
+		}
+	}
+}
@@ -0,0 +1,174 @@
+#include "PoseStatistics.h"
+#include "Spinlock.h"
+
+#include <cstring>
+#include <limits>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		static_assert(PoseStatisticsDeviceCount == vr::k_unMaxTrackedDeviceCount, "The pose statistics block needs an entry per OpenVR id");
+
+		// The block is shared with other processes and languages, so it holds a plain uint32_t.
+		// It is accessed as a lock-free atomic of the same size and alignment
+		static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && alignof(std::atomic<uint32_t>) == alignof(uint32_t),
+			"The pose statistics sequence counter must be accessible as an atomic");
+
+		static inline std::atomic<uint32_t>& sequenceOf(MMFstruct_OVRMC_PoseStatistics_v1& block)
+		{
+			return *reinterpret_cast<std::atomic<uint32_t>*>(&block.Sequence);
+		}
+
+		static inline const std::atomic<uint32_t>& sequenceOf(const MMFstruct_OVRMC_PoseStatistics_v1& block)
+		{
+			return *reinterpret_cast<const std::atomic<uint32_t>*>(&block.Sequence);
+		}
+
+		static inline void storeMin(std::atomic<int64_t>& target, int64_t value)
+		{
+			int64_t current = target.load(std::memory_order_relaxed);
+			while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+			{
+			}
+		}
+
+		static inline void storeMax(std::atomic<int64_t>& target, int64_t value)
+		{
+			int64_t current = target.load(std::memory_order_relaxed);
+			while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+			{
+			}
+		}
+
+		void PoseStatisticsCounter::record(const vr::DriverPose_t& pose, int64_t nowNs)
+		{
+			_Count.fetch_add(1, std::memory_order_relaxed);
+
+			int64_t lastNs = _LastNs.exchange(nowNs, std::memory_order_relaxed);
+			if (lastNs == 0)
+			{
+				int64_t none = 0;
+				_FirstNs.compare_exchange_strong(none, nowNs, std::memory_order_relaxed);
+			}
+			else if (nowNs > lastNs)
+			{
+				_Interval.record((uint64_t)(nowNs - lastNs));
+			}
+
+			if (!pose.poseIsValid)
+			{
+				_InvalidCount.fetch_add(1, std::memory_order_relaxed);
+			}
+			if (pose.result != vr::TrackingResult_Running_OK)
+			{
+				_NotRunningOkCount.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			// Invalid poses often carry no sample time, they would only blur the offset
+			if (pose.poseIsValid)
+			{
+				int64_t offsetNs = (int64_t)(pose.poseTimeOffset * 1.0E9);
+				storeMin(_TimeOffsetMinNs, offsetNs);
+				storeMax(_TimeOffsetMaxNs, offsetNs);
+				_TimeOffsetSumNs.fetch_add(offsetNs, std::memory_order_relaxed);
+				_TimeOffset.record((uint64_t)(offsetNs < 0 ? -offsetNs : offsetNs));
+			}
+		}
+
+		PoseStatistics_v1 PoseStatisticsCounter::getStatistics() const
+		{
+			PoseStatistics_v1 statistics = {};
+			statistics.Count = _Count.load(std::memory_order_relaxed);
+			statistics.InvalidCount = _InvalidCount.load(std::memory_order_relaxed);
+			statistics.NotRunningOkCount = _NotRunningOkCount.load(std::memory_order_relaxed);
+			statistics.Interval = _Interval.getStatistics();
+			statistics.TimeOffset = _TimeOffset.getStatistics();
+
+			int64_t firstNs = _FirstNs.load(std::memory_order_relaxed);
+			int64_t lastNs = _LastNs.load(std::memory_order_relaxed);
+			if (firstNs != 0 && lastNs > firstNs && statistics.Interval.Count > 0)
+			{
+				statistics.RateHz = (double)statistics.Interval.Count * 1.0E9 / (double)(lastNs - firstNs);
+			}
+
+			if (statistics.TimeOffset.Count > 0)
+			{
+				statistics.TimeOffsetMinS = (double)_TimeOffsetMinNs.load(std::memory_order_relaxed) / 1.0E9;
+				statistics.TimeOffsetMaxS = (double)_TimeOffsetMaxNs.load(std::memory_order_relaxed) / 1.0E9;
+				statistics.TimeOffsetMeanS = (double)_TimeOffsetSumNs.load(std::memory_order_relaxed) / 1.0E9 / (double)statistics.TimeOffset.Count;
+			}
+			return statistics;
+		}
+
+		void PoseStatisticsCounter::reset()
+		{
+			_Count.store(0, std::memory_order_relaxed);
+			_InvalidCount.store(0, std::memory_order_relaxed);
+			_NotRunningOkCount.store(0, std::memory_order_relaxed);
+			_FirstNs.store(0, std::memory_order_relaxed);
+			_LastNs.store(0, std::memory_order_relaxed);
+			_TimeOffsetMinNs.store(std::numeric_limits<int64_t>::max(), std::memory_order_relaxed);
+			_TimeOffsetMaxNs.store(std::numeric_limits<int64_t>::min(), std::memory_order_relaxed);
+			_TimeOffsetSumNs.store(0, std::memory_order_relaxed);
+			_Interval.reset();
+			_TimeOffset.reset();
+		}
+
+		void PoseStatisticsWriter::init(MMFstruct_OVRMC_PoseStatistics_v1& block)
+		{
+			std::memset(&block, 0, sizeof(block));
+			block.DeviceCount = PoseStatisticsDeviceCount;
+			block.EntrySize = sizeof(PoseStatistics_v1);
+			for (uint32_t id = 0; id < PoseStatisticsDeviceCount; id++)
+			{
+				block.Devices[id].OpenVRId = id;
+			}
+			block.Version = PoseStatisticsVersion;
+			std::atomic_thread_fence(std::memory_order_release);
+			block.Magic = PoseStatisticsMagic;
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+
+		void PoseStatisticsWriter::publish(MMFstruct_OVRMC_PoseStatistics_v1& block, const PoseStatistics_v1* devices, int64_t timeNs)
+		{
+			std::atomic<uint32_t>& seq = sequenceOf(block);
+			uint32_t start = seq.load(std::memory_order_relaxed) | 1;
+			seq.store(start, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			block.TimeNs = timeNs;
+			std::memcpy(block.Devices, devices, sizeof(block.Devices));
+
+			seq.store(start + 1, std::memory_order_release);
+		}
+
+		bool PoseStatisticsReader::read(const MMFstruct_OVRMC_PoseStatistics_v1& block, PoseStatistics_v1* devices, int64_t& timeNs)
+		{
+			if (block.Magic != PoseStatisticsMagic || block.Version != PoseStatisticsVersion || block.DeviceCount != PoseStatisticsDeviceCount)
+			{
+				return false;
+			}
+
+			const std::atomic<uint32_t>& seq = sequenceOf(block);
+			for (int retries = 0; retries <= MaxRetries; retries++)
+			{
+				uint32_t seq1 = seq.load(std::memory_order_acquire);
+				if (!(seq1 & 1))
+				{
+					// The copy may overlap a publish, the second sequence load discards it then
+					std::memcpy(devices, block.Devices, sizeof(block.Devices));
+					timeNs = block.TimeNs;
+
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (seq.load(std::memory_order_relaxed) == seq1)
+					{
+						return true;
+					}
+				}
+				VRMC_CPU_PAUSE();
+			}
+			return false;
+		}
+	}
+}
@@ -0,0 +1,228 @@
+#include "ReferenceFusion.h"
+#include "Filters.h"
+#include <openvr_math.h>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// Iterations of the weighted rotation mean. The estimates are close together, so it converges after very few
+		static const int RotationMeanIterations = 3;
+
+		static inline vr::HmdVector3d_t cross(const vr::HmdVector3d_t& a, const vr::HmdVector3d_t& b)
+		{
+			return { a.v[1] * b.v[2] - a.v[2] * b.v[1], a.v[2] * b.v[0] - a.v[0] * b.v[2], a.v[0] * b.v[1] - a.v[1] * b.v[0] };
+		}
+
+		static inline vr::HmdVector3d_t toVector(const double(&v)[3])
+		{
+			return { v[0], v[1], v[2] };
+		}
+
+		void ReferenceFusion::setTrackers(uint32_t count, const double* weights)
+		{
+			_Count = count < 1 ? 1 : (count > MaxTrackers ? MaxTrackers : count);
+			for (uint32_t i = 0; i < MaxTrackers; i++)
+			{
+				_Slots[i].Weight = (weights != nullptr && i < _Count && weights[i] > 0.0) ? weights[i] : 1.0;
+			}
+			reset();
+		}
+
+		void ReferenceFusion::reset()
+		{
+			_Calibrated = false;
+			_CalibrationFrames = 0;
+			_UsedTrackers = 0;
+			for (Slot& slot : _Slots)
+			{
+				slot.Valid = false;
+			}
+		}
+
+		bool ReferenceFusion::calibrate(long long timeUs)
+		{
+			for (uint32_t i = 0; i < _Count; i++)
+			{
+				if (!_Slots[i].Valid || timeUs - _Slots[i].SampleUs > MaxAgeUs)
+				{
+					return false;
+				}
+			}
+
+			// The rig frame is the first tracker, moved to the same time as the others
+			vr::HmdVector3d_t rigPos;
+			vr::HmdQuaternion_t rigRot;
+			trackerPose(_Slots[0], timeUs, rigPos, rigRot);
+			vr::HmdQuaternion_t rigRotInv = vrmath::quaternionConjugate(rigRot);
+
+			// The offsets are averaged over several frames, a single noisy frame would bias the fused pose for good
+			for (uint32_t i = 0; i < _Count; i++)
+			{
+				Slot& slot = _Slots[i];
+				vr::HmdVector3d_t pos;
+				vr::HmdQuaternion_t rot;
+				trackerPose(slot, timeUs, pos, rot);
+
+				vr::HmdQuaternion_t offsetRot = quaternionNormalize(rigRotInv * rot);
+				vr::HmdVector3d_t offsetPos = vrmath::quaternionRotateVector(rigRotInv, pos - rigPos);
+				if (_CalibrationFrames == 0)
+				{
+					slot.OffsetPos = { 0, 0, 0 };
+					slot.OffsetRot = offsetRot;
+					slot.CalibrationRot = { 0, 0, 0 };
+				}
+				slot.OffsetPos = slot.OffsetPos + offsetPos;
+				slot.CalibrationRot = slot.CalibrationRot + quaternionLog(offsetRot * vrmath::quaternionConjugate(slot.OffsetRot));
+			}
+
+			if (++_CalibrationFrames < CalibrationFrames)
+			{
+				return false;
+			}
+
+			for (uint32_t i = 0; i < _Count; i++)
+			{
+				Slot& slot = _Slots[i];
+				slot.OffsetPos = slot.OffsetPos / (double)_CalibrationFrames;
+				slot.OffsetRot = quaternionNormalize(quaternionExp(slot.CalibrationRot / (double)_CalibrationFrames) * slot.OffsetRot);
+			}
+
+			_Calibrated = true;
+			return true;
+		}
+
+		void ReferenceFusion::trackerPose(const Slot& slot, long long timeUs, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot) const
+		{
+			double dt = (double)(timeUs - slot.SampleUs) / 1.0E6;
+
+			pos = toVector(slot.Pose.vecPosition) + toVector(slot.Pose.vecVelocity) * dt;
+			rot = slot.Pose.qRotation;
+			if (dt != 0.0)
+			{
+				rot = quaternionExp(toVector(slot.Pose.vecAngularVelocity) * dt) * rot;
+			}
+		}
+
+		void ReferenceFusion::rigEstimate(const Slot& slot, long long timeUs, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot) const
+		{
+			vr::HmdVector3d_t trackerPos;
+			vr::HmdQuaternion_t trackerRot;
+			trackerPose(slot, timeUs, trackerPos, trackerRot);
+
+			// T_tracker = T_rig * T_offset
+			rot = quaternionNormalize(trackerRot * vrmath::quaternionConjugate(slot.OffsetRot));
+			pos = trackerPos - vrmath::quaternionRotateVector(rot, slot.OffsetPos);
+		}
+
+		bool ReferenceFusion::update(uint32_t slotIndex, const vr::DriverPose_t& pose, long long timestampUs, vr::DriverPose_t& fused)
+		{
+			if (slotIndex >= _Count)
+			{
+				return false;
+			}
+
+			Slot& slot = _Slots[slotIndex];
+			if (!pose.poseIsValid || pose.result != vr::TrackingResult_Running_OK)
+			{
+				slot.Valid = false;
+				return false;
+			}
+
+			long long sampleUs = timestampUs + (long long)(pose.poseTimeOffset * 1.0E6);
+			slot.Valid = true;
+			slot.SampleUs = sampleUs;
+			slot.Pose = pose;
+
+			// The first tracker that is running paces the output
+			for (uint32_t i = 0; i < slotIndex; i++)
+			{
+				if (_Slots[i].Valid && sampleUs - _Slots[i].SampleUs <= MaxAgeUs)
+				{
+					return false;
+				}
+			}
+
+			if (!_Calibrated && !calibrate(sampleUs))
+			{
+				return false;
+			}
+
+			vr::HmdVector3d_t positions[MaxTrackers];
+			vr::HmdQuaternion_t rotations[MaxTrackers];
+			double weights[MaxTrackers];
+			uint32_t used[MaxTrackers];
+			uint32_t count = 0;
+			double weightSum = 0.0;
+
+			for (uint32_t i = 0; i < _Count; i++)
+			{
+				const Slot& s = _Slots[i];
+				if (!s.Valid || sampleUs - s.SampleUs > MaxAgeUs)
+				{
+					continue;
+				}
+				rigEstimate(s, sampleUs, positions[count], rotations[count]);
+				weights[count] = s.Weight;
+				used[count] = i;
+				weightSum += s.Weight;
+				count++;
+			}
+
+			// Weighted position mean
+			vr::HmdVector3d_t pos = { 0, 0, 0 };
+			for (uint32_t i = 0; i < count; i++)
+			{
+				pos = pos + positions[i] * weights[i];
+			}
+			pos = pos / weightSum;
+
+			// Weighted rotation mean on the manifold: move the mean along the average of the rotation vectors to all estimates
+			vr::HmdQuaternion_t rot = rotations[0];
+			if (count > 1)
+			{
+				for (int iteration = 0; iteration < RotationMeanIterations; iteration++)
+				{
+					vr::HmdQuaternion_t rotInv = vrmath::quaternionConjugate(rot);
+					vr::HmdVector3d_t delta = { 0, 0, 0 };
+					for (uint32_t i = 0; i < count; i++)
+					{
+						delta = delta + quaternionLog(rotations[i] * rotInv) * weights[i];
+					}
+					rot = quaternionNormalize(quaternionExp(delta / weightSum) * rot);
+				}
+			}
+
+			// Derivatives: the trackers share the rig's angular velocity, their linear velocity includes the lever arm.
+			// The lever arm terms of the acceleration are left out, they are small next to the tracker noise
+			vr::HmdVector3d_t angVel = { 0, 0, 0 };
+			vr::HmdVector3d_t angAcc = { 0, 0, 0 };
+			vr::HmdVector3d_t vel = { 0, 0, 0 };
+			vr::HmdVector3d_t acc = { 0, 0, 0 };
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const Slot& s = _Slots[used[i]];
+				vr::HmdVector3d_t omega = toVector(s.Pose.vecAngularVelocity);
+				vr::HmdVector3d_t arm = vrmath::quaternionRotateVector(rot, s.OffsetPos);
+				angVel = angVel + omega * weights[i];
+				angAcc = angAcc + toVector(s.Pose.vecAngularAcceleration) * weights[i];
+				vel = vel + (toVector(s.Pose.vecVelocity) - cross(omega, arm)) * weights[i];
+				acc = acc + toVector(s.Pose.vecAcceleration) * weights[i];
+			}
+
+			fused = pose;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				fused.vecPosition[axis] = pos.v[axis];
+				fused.vecVelocity[axis] = vel.v[axis] / weightSum;
+				fused.vecAcceleration[axis] = acc.v[axis] / weightSum;
+				fused.vecAngularVelocity[axis] = angVel.v[axis] / weightSum;
+				fused.vecAngularAcceleration[axis] = angAcc.v[axis] / weightSum;
+			}
+			fused.qRotation = rot;
+
+			_UsedTrackers = count;
+			return true;
+		}
+	}
+}
@@ -0,0 +1,126 @@
+#include "ReferenceHistory.h"
+#include "Filters.h"
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		void ReferenceHistory::push(long long timeUs, const vr::HmdVector3d_t& pos, const vr::HmdQuaternion_t& rot)
+		{
+			uint32_t index = _Count.load(std::memory_order_relaxed);
+
+			ReferenceSample sample;
+			sample.TimeUs = timeUs;
+			sample.Pos = pos;
+			sample.Rot = rot;
+			sample.Index = index;
+
+			_Slots[index % Size].store(sample);
+			_Count.store(index + 1, std::memory_order_release);
+		}
+
+		void ReferenceHistory::clear()
+		{
+			_First.store(_Count.load(std::memory_order_relaxed), std::memory_order_release);
+		}
+
+		bool ReferenceHistory::readSample(uint32_t index, ReferenceSample& sample) const
+		{
+			sample = _Slots[index % Size].load();
+			return sample.Index == index;
+		}
+
+		bool ReferenceHistory::sampleAt(long long timeUs, long long maxExtrapolationUs, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot) const
+		{
+			// A retry is only needed if the writer went around the whole ring while we were reading
+			for (int attempt = 0; attempt < 4; attempt++)
+			{
+				uint32_t first = _First.load(std::memory_order_acquire);
+				uint32_t count = _Count.load(std::memory_order_acquire);
+				if (count - first < 2)
+				{
+					return false;
+				}
+
+				// The slot of the oldest sample is the next one to be overwritten, so leave it alone
+				uint32_t oldest = count > Size ? count - Size + 1 : 0;
+				if (oldest < first)
+				{
+					oldest = first;
+				}
+
+				ReferenceSample newer, older;
+				if (!readSample(count - 1, newer))
+				{
+					continue;
+				}
+
+				// Walk back until the sample pair brackets timeUs. Past the newest sample, walk back to a sample far
+				// enough from the newest one to extrapolate from instead.
+				bool extrapolate = timeUs > newer.TimeUs;
+				uint32_t index = count - 1;
+				bool overwritten = false;
+				while (true)
+				{
+					if (!readSample(index - 1, older))
+					{
+						overwritten = true;
+						break;
+					}
+
+					if (index - 1 == oldest)
+					{
+						break;
+					}
+					else if (extrapolate)
+					{
+						if (newer.TimeUs - older.TimeUs >= ExtrapolationBaselineUs)
+						{
+							break;
+						}
+						index--;
+					}
+					else if (older.TimeUs <= timeUs)
+					{
+						break;
+					}
+					else
+					{
+						newer = older;
+						index--;
+					}
+				}
+
+				// Samples from before a clear that happened while reading must not be used
+				if (overwritten || _First.load(std::memory_order_acquire) != first)
+				{
+					continue;
+				}
+
+				long long span = newer.TimeUs - older.TimeUs;
+				if (span <= 0)
+				{
+					pos = newer.Pos;
+					rot = newer.Rot;
+					return true;
+				}
+
+				if (timeUs > newer.TimeUs + maxExtrapolationUs)
+				{
+					timeUs = newer.TimeUs + maxExtrapolationUs;
+				}
+				else if (timeUs < older.TimeUs)
+				{
+					timeUs = older.TimeUs;
+				}
+
+				double t = (double)(timeUs - older.TimeUs) / (double)span;
+				pos = lerp(older.Pos, newer.Pos, t);
+				rot = slerpNormalized(older.Rot, newer.Rot, t);
+				return true;
+			}
+
+			return false;
+		}
+	}
+}
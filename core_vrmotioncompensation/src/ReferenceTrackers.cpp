@@ -0,0 +1,142 @@
+#include "ReferenceTrackers.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		void ReferenceTrackers::setTracker(int RtDevice)
+		{
+			{
+				std::lock_guard<Spinlock> lock(_RtLock);
+				_RtDeviceIDs.clear();
+				if (RtDevice >= 0)
+				{
+					_RtDeviceIDs.push_back((uint32_t)RtDevice);
+				}
+				_Fusion.setTrackers(1);
+			}
+			restartZeroPoseCalibration();
+		}
+
+		void ReferenceTrackers::setTrackers(const std::vector<uint32_t>& RtDevices, const double* weights)
+		{
+			{
+				std::lock_guard<Spinlock> lock(_RtLock);
+				_RtDeviceIDs.assign(RtDevices.begin(), RtDevices.begin() + std::min<size_t>(RtDevices.size(), MaxReferenceTrackers));
+				_Fusion.setTrackers((uint32_t)_RtDeviceIDs.size(), weights);
+			}
+
+			// The tracker offsets are calibrated together with the zero pose
+			restartZeroPoseCalibration();
+			_Core.resetZeroPose();
+		}
+
+		bool ReferenceTrackers::isTracker(uint32_t RtDevice)
+		{
+			std::lock_guard<Spinlock> lock(_RtLock);
+			return std::find(_RtDeviceIDs.begin(), _RtDeviceIDs.end(), RtDevice) != _RtDeviceIDs.end();
+		}
+
+		int ReferenceTrackers::getTracker()
+		{
+			std::lock_guard<Spinlock> lock(_RtLock);
+			return _RtDeviceIDs.empty() ? -1 : (int)_RtDeviceIDs[0];
+		}
+
+		std::vector<uint32_t> ReferenceTrackers::getTrackers()
+		{
+			std::lock_guard<Spinlock> lock(_RtLock);
+			return _RtDeviceIDs;
+		}
+
+		void ReferenceTrackers::resetZeroPose()
+		{
+			{
+				std::lock_guard<Spinlock> lock(_RtLock);
+				_Fusion.reset();
+			}
+			restartZeroPoseCalibration();
+			_Core.resetZeroPose();
+		}
+
+		void ReferenceTrackers::setZeroPoseCalibration(const ZeroPoseCalibrationSettings& settings)
+		{
+			std::lock_guard<Spinlock> lock(_ZeroCalibrationLock);
+			_ZeroCalibration.configure(settings);
+		}
+
+		ZeroPoseCalibrationStatus ReferenceTrackers::getZeroPoseCalibrationStatus()
+		{
+			std::lock_guard<Spinlock> lock(_ZeroCalibrationLock);
+			return _ZeroCalibration.getStatus();
+		}
+
+		void ReferenceTrackers::restartZeroPoseCalibration()
+		{
+			std::lock_guard<Spinlock> lock(_ZeroCalibrationLock);
+			_ZeroCalibration.reset();
+		}
+
+		bool ReferenceTrackers::calibrateZeroPose(const vr::DriverPose_t& pose, ZeroPoseCalibrationStatus& status)
+		{
+			// The zero pose is set under the lock, so a second tracker thread cannot start another window meanwhile
+			std::lock_guard<Spinlock> lock(_ZeroCalibrationLock);
+			if (_Core.isZeroPoseValid())
+			{
+				return false;
+			}
+
+			vr::DriverPose_t zeroPose;
+			uint32_t windows = _ZeroCalibration.getStatus().Windows;
+			if (_ZeroCalibration.addSample(pose, zeroPose))
+			{
+				_Core.setZeroPose(zeroPose);
+			}
+			status = _ZeroCalibration.getStatus();
+			return status.Windows != windows;
+		}
+
+		bool ReferenceTrackers::update(uint32_t RtDevice, const vr::DriverPose_t& pose, long long timestampUs, ZeroPoseCalibrationStatus& status)
+		{
+			vr::DriverPose_t fused;
+			const vr::DriverPose_t* refPose = nullptr;
+
+			{
+				std::lock_guard<Spinlock> lock(_RtLock);
+				if (_RtDeviceIDs.size() <= 1)
+				{
+					// Single reference tracker, only valid poses are used to prevent unwanted jitter and movement
+					if (pose.poseIsValid && pose.result == vr::TrackingResult_Running_OK)
+					{
+						refPose = &pose;
+					}
+				}
+				else
+				{
+					auto it = std::find(_RtDeviceIDs.begin(), _RtDeviceIDs.end(), RtDevice);
+					if (it != _RtDeviceIDs.end() && _Fusion.update((uint32_t)(it - _RtDeviceIDs.begin()), pose, timestampUs, fused))
+					{
+						refPose = &fused;
+					}
+				}
+			}
+
+			if (refPose == nullptr)
+			{
+				return false;
+			}
+
+			// Set the Zero-Point for the reference tracker if not done yet, from a window of samples
+			if (!_Core.isZeroPoseValid())
+			{
+				return calibrateZeroPose(*refPose, status);
+			}
+
+			_Core.updateRefPose(*refPose, timestampUs);
+			return false;
+		}
+	}
+}
@@ -0,0 +1,130 @@
+#include "RigPoseChannel.h"
+#include "Spinlock.h"
+
+#include <cstring>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// The block is shared with other processes and languages, so it holds a plain uint32_t.
+		// It is accessed as a lock-free atomic of the same size and alignment
+		static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && alignof(std::atomic<uint32_t>) == alignof(uint32_t),
+			"The rig pose sequence counter must be accessible as an atomic");
+
+		static inline std::atomic<uint32_t>& sequenceOf(MMFstruct_OVRMC_RigPose_v1& block)
+		{
+			return *reinterpret_cast<std::atomic<uint32_t>*>(&block.Sequence);
+		}
+
+		static inline const std::atomic<uint32_t>& sequenceOf(const MMFstruct_OVRMC_RigPose_v1& block)
+		{
+			return *reinterpret_cast<const std::atomic<uint32_t>*>(&block.Sequence);
+		}
+
+		void RigPoseWriter::init(MMFstruct_OVRMC_RigPose_v1& block)
+		{
+			std::memset(&block, 0, sizeof(block));
+			block.Pose.Rotation = { 1, 0, 0, 0 };
+			block.Version = RigPoseVersion;
+			std::atomic_thread_fence(std::memory_order_release);
+			block.Magic = RigPoseMagic;
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+
+		void RigPoseWriter::write(MMFstruct_OVRMC_RigPose_v1& block, const RigPose_v1& pose)
+		{
+			std::atomic<uint32_t>& seq = sequenceOf(block);
+			uint32_t start = seq.load(std::memory_order_relaxed);
+
+			// An odd start value is left by a writer that died during an update
+			start |= 1;
+			seq.store(start, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			std::memcpy(&block.Pose, &pose, sizeof(pose));
+
+			seq.store(start + 1, std::memory_order_release);
+		}
+
+		bool RigPoseReader::tryRead(const MMFstruct_OVRMC_RigPose_v1& block, RigPose_v1& pose, uint32_t& sequence)
+		{
+			const std::atomic<uint32_t>& seq = sequenceOf(block);
+			uint32_t seq1 = seq.load(std::memory_order_acquire);
+			if (seq1 & 1)
+			{
+				return false;
+			}
+
+			// The copy may overlap an update of the writer, the second sequence load discards it then
+			std::memcpy(&pose, &block.Pose, sizeof(pose));
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (seq.load(std::memory_order_relaxed) != seq1)
+			{
+				return false;
+			}
+
+			sequence = seq1;
+			return true;
+		}
+
+		RigPoseReader::Result RigPoseReader::poll(const MMFstruct_OVRMC_RigPose_v1& block, long long timestampUs, vr::DriverPose_t& pose)
+		{
+			if (block.Magic != RigPoseMagic || block.Version != RigPoseVersion)
+			{
+				return Result::Invalid;
+			}
+
+			// Cheap check first, the HMD path polls far more often than the rig writes
+			if (sequenceOf(block).load(std::memory_order_acquire) == _LastSequence)
+			{
+				return Result::Unchanged;
+			}
+
+			RigPose_v1 rig;
+			uint32_t sequence = 0;
+			int retries = 0;
+			while (!tryRead(block, rig, sequence))
+			{
+				_TornReads++;
+				if (++retries > MaxRetries)
+				{
+					return Result::Busy;
+				}
+				VRMC_CPU_PAUSE();
+			}
+
+			if (sequence == _LastSequence)
+			{
+				return Result::Unchanged;
+			}
+			_LastSequence = sequence;
+
+			if (!(rig.Flags & RigPoseFlag_Valid))
+			{
+				return Result::Invalid;
+			}
+
+			pose = {};
+			pose.qWorldFromDriverRotation = { 1, 0, 0, 0 };
+			pose.qDriverFromHeadRotation = { 1, 0, 0, 0 };
+			pose.qRotation = rig.Rotation;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				pose.vecPosition[axis] = rig.Position.v[axis];
+				if (rig.Flags & RigPoseFlag_Derivatives)
+				{
+					pose.vecVelocity[axis] = rig.Velocity.v[axis];
+					pose.vecAngularVelocity[axis] = rig.AngularVelocity.v[axis];
+				}
+			}
+			pose.poseTimeOffset = rig.TimestampUs != 0 ? (double)(rig.TimestampUs - timestampUs) / 1.0E6 : 0.0;
+			pose.poseIsValid = true;
+			pose.result = vr::TrackingResult_Running_OK;
+			pose.deviceIsConnected = true;
+
+			return Result::NewPose;
+		}
+	}
+}
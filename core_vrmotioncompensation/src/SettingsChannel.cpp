@@ -0,0 +1,164 @@
+#include "SettingsChannel.h"
+#include "Spinlock.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// The block is shared with other processes and languages, so it holds plain uint32_t counters.
+		// They are accessed as lock-free atomics of the same size and alignment
+		static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && alignof(std::atomic<uint32_t>) == alignof(uint32_t),
+			"The settings sequence counters must be accessible as atomics");
+
+		static inline std::atomic<uint32_t>& atomicOf(uint32_t& value)
+		{
+			return *reinterpret_cast<std::atomic<uint32_t>*>(&value);
+		}
+
+		static inline const std::atomic<uint32_t>& atomicOf(const uint32_t& value)
+		{
+			return *reinterpret_cast<const std::atomic<uint32_t>*>(&value);
+		}
+
+		static inline bool isFinite(const vr::HmdVector3d_t& v)
+		{
+			return std::isfinite(v.v[0]) && std::isfinite(v.v[1]) && std::isfinite(v.v[2]);
+		}
+
+		void SettingsWriter::init(MMFstruct_OVRMC_Settings_v1& block)
+		{
+			std::memset(&block, 0, sizeof(block));
+			block.Settings.OffsetQRotation = { 1, 0, 0, 0 };
+			block.Version = SettingsVersion;
+			std::atomic_thread_fence(std::memory_order_release);
+			block.Magic = SettingsMagic;
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+
+		uint32_t SettingsWriter::write(MMFstruct_OVRMC_Settings_v1& block, const MotionCompensationSettings_v1& settings)
+		{
+			std::atomic<uint32_t>& seq = atomicOf(block.Sequence);
+			uint32_t start = seq.load(std::memory_order_relaxed);
+
+			// An odd start value is left by a writer that died during an update
+			start |= 1;
+			seq.store(start, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			std::memcpy(&block.Settings, &settings, sizeof(settings));
+
+			// Skips 0 when the counter wraps, the reader starts out with 0 as "nothing taken yet"
+			uint32_t end = start + 1 != 0 ? start + 1 : 2;
+			seq.store(end, std::memory_order_release);
+			return end;
+		}
+
+		bool SettingsWriter::readStatus(const MMFstruct_OVRMC_Settings_v1& block, uint32_t& appliedSequence, SettingsStatus& status)
+		{
+			const std::atomic<uint32_t>& applied = atomicOf(block.AppliedSequence);
+			for (int retries = 0; retries <= SettingsReader::MaxRetries; retries++)
+			{
+				uint32_t sequence = applied.load(std::memory_order_acquire);
+				uint32_t value = atomicOf(block.Status).load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (applied.load(std::memory_order_relaxed) == sequence)
+				{
+					appliedSequence = sequence;
+					status = (SettingsStatus)value;
+					return true;
+				}
+				VRMC_CPU_PAUSE();
+			}
+			return false;
+		}
+
+		SettingsReader::Result SettingsReader::poll(const MMFstruct_OVRMC_Settings_v1& block, MotionCompensationSettings_v1& settings, uint32_t& sequence)
+		{
+			// Cheap check first, the reference tracker updates far more often than the settings change
+			const std::atomic<uint32_t>& seq = atomicOf(block.Sequence);
+			uint32_t last = _LastSequence.load(std::memory_order_relaxed);
+			if (seq.load(std::memory_order_acquire) == last)
+			{
+				return Result::Unchanged;
+			}
+
+			if (block.Magic != SettingsMagic || block.Version != SettingsVersion)
+			{
+				return Result::Invalid;
+			}
+
+			for (int retries = 0; retries <= MaxRetries; retries++)
+			{
+				uint32_t seq1 = seq.load(std::memory_order_acquire);
+				if (!(seq1 & 1))
+				{
+					// The copy may overlap an update of the writer, the second sequence load discards it then
+					std::memcpy(&settings, &block.Settings, sizeof(settings));
+
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (seq.load(std::memory_order_relaxed) == seq1)
+					{
+						if (seq1 == last)
+						{
+							return Result::Unchanged;
+						}
+						_LastSequence.store(seq1, std::memory_order_relaxed);
+						sequence = seq1;
+						return Result::NewSettings;
+					}
+				}
+				_TornReads++;
+				VRMC_CPU_PAUSE();
+			}
+			return Result::Busy;
+		}
+
+		void SettingsReader::acknowledge(MMFstruct_OVRMC_Settings_v1& block, uint32_t sequence, SettingsStatus status)
+		{
+			atomicOf(block.Status).store((uint32_t)status, std::memory_order_relaxed);
+			atomicOf(block.AppliedSequence).store(sequence, std::memory_order_release);
+		}
+
+		SettingsStatus SettingsReader::validate(const MotionCompensationSettings_v1& settings)
+		{
+			// Written so that NaN fails every check
+			uint32_t fields = settings.Fields;
+			if (fields & ~SettingsField_All)
+			{
+				return SettingsStatus::InvalidValue;
+			}
+			if ((fields & SettingsField_LpfBeta) && !(settings.LpfBeta >= 0.0 && settings.LpfBeta <= 1.0))
+			{
+				return SettingsStatus::InvalidValue;
+			}
+			if ((fields & SettingsField_Samples) && settings.Samples < 1)
+			{
+				return SettingsStatus::InvalidValue;
+			}
+			if ((fields & SettingsField_SetZero) && settings.SetZero > 1)
+			{
+				return SettingsStatus::InvalidValue;
+			}
+			if ((fields & SettingsField_Filter) && ((settings.FilterType != MotionCompensationFilterType::Default
+				&& settings.FilterType != MotionCompensationFilterType::Kalman && settings.FilterType != MotionCompensationFilterType::OneEuro)
+				|| !(settings.KalmanProcessNoise > 0.0 && std::isfinite(settings.KalmanProcessNoise))
+				|| !(settings.KalmanObservationNoise > 0.0 && std::isfinite(settings.KalmanObservationNoise))
+				|| !(settings.KalmanPredictionMs >= 0.0 && settings.KalmanPredictionMs <= 1000.0)
+				|| !(settings.OneEuroMinCutoff > 0.0 && std::isfinite(settings.OneEuroMinCutoff))
+				|| !(settings.OneEuroBeta >= 0.0 && std::isfinite(settings.OneEuroBeta))))
+			{
+				return SettingsStatus::InvalidValue;
+			}
+			if ((fields & SettingsField_Offsets) && !(isFinite(settings.OffsetTranslation) && isFinite(settings.OffsetRotation)
+				&& std::isfinite(settings.OffsetQRotation.w) && std::isfinite(settings.OffsetQRotation.x)
+				&& std::isfinite(settings.OffsetQRotation.y) && std::isfinite(settings.OffsetQRotation.z)))
+			{
+				return SettingsStatus::InvalidValue;
+			}
+			return SettingsStatus::Applied;
+		}
+	}
+}
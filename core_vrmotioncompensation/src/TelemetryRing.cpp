@@ -0,0 +1,162 @@
+#include "vrmc_openvr.h"
+#include "TelemetryRing.h"
+#include "Spinlock.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		// Plain integers in the shared layout, accessed as lock-free atomics of the same size and alignment
+		static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t) && alignof(std::atomic<uint64_t>) <= alignof(uint64_t),
+			"The telemetry counters must be accessible as atomics");
+
+		static inline std::atomic<uint64_t>& atomicOf(uint64_t& value)
+		{
+			return *reinterpret_cast<std::atomic<uint64_t>*>(&value);
+		}
+
+		static inline const std::atomic<uint64_t>& atomicOf(const uint64_t& value)
+		{
+			return *reinterpret_cast<const std::atomic<uint64_t>*>(&value);
+		}
+
+		void TelemetryWriter::init(MMFstruct_OVRMC_Telemetry_v1& ring)
+		{
+			ring.Magic = 0;
+			std::atomic_thread_fence(std::memory_order_release);
+			ring.Version = TelemetryVersion;
+			ring.EntryCount = TelemetryEntryCount;
+			ring.EntrySize = (uint32_t)sizeof(TelemetryEntry_v1);
+			atomicOf(ring.WriteIndex).store(0, std::memory_order_relaxed);
+			for (TelemetryEntry_v1& entry : ring.Entries)
+			{
+				atomicOf(entry.Sequence).store(0, std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_release);
+			ring.Magic = TelemetryMagic;
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+
+		void TelemetryWriter::write(MMFstruct_OVRMC_Telemetry_v1& ring, const TelemetryEntry_v1& entry)
+		{
+			SequencedRing::write(ring.WriteIndex, ring.Entries, sizeof(TelemetryEntry_v1), TelemetryEntryCount, &entry);
+		}
+
+		int64_t TelemetryWriter::nowNs()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		void TelemetryReader::attach(const MMFstruct_OVRMC_Telemetry_v1& ring, bool skipBacklog)
+		{
+			uint64_t end = atomicOf(ring.WriteIndex).load(std::memory_order_acquire);
+			_Next = skipBacklog ? end : (end > TelemetryEntryCount ? end - TelemetryEntryCount : 0);
+			_Lost = 0;
+		}
+
+		size_t TelemetryReader::read(const MMFstruct_OVRMC_Telemetry_v1& ring, TelemetryEntry_v1* entries, size_t maxCount)
+		{
+			if (ring.Magic != TelemetryMagic || ring.Version != TelemetryVersion || ring.EntrySize != sizeof(TelemetryEntry_v1))
+			{
+				return 0;
+			}
+			return SequencedRing::read(ring.WriteIndex, ring.Entries, sizeof(TelemetryEntry_v1), TelemetryEntryCount, _Next, _Lost, entries, maxCount);
+		}
+
+		void SequencedRing::write(uint64_t& writeIndex, void* entries, size_t entrySize, uint32_t entryCount, const void* entry)
+		{
+			uint64_t index = atomicOf(writeIndex).fetch_add(1, std::memory_order_relaxed);
+			char* slot = static_cast<char*>(entries) + (index % entryCount) * entrySize;
+			std::atomic<uint64_t>& seq = atomicOf(*reinterpret_cast<uint64_t*>(slot));
+
+			// Take the slot. A writer one lap behind that still copies into it is waited for, that only happens when it
+			// was preempted for a whole lap of the ring. If a writer one lap ahead already took it, the entry is dropped,
+			// readers count it as lost
+			uint64_t current = seq.load(std::memory_order_relaxed);
+			for (int spins = 0;; spins++)
+			{
+				if (current >= index * 2 + 1)
+				{
+					return;
+				}
+				if ((current & 1) == 0 && seq.compare_exchange_weak(current, index * 2 + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+				if (current & 1)
+				{
+					if (spins < 64)
+					{
+						VRMC_CPU_PAUSE();
+					}
+					else
+					{
+						std::this_thread::yield();
+					}
+					current = seq.load(std::memory_order_relaxed);
+				}
+			}
+			std::atomic_thread_fence(std::memory_order_release);
+
+			// Everything after the sequence counter
+			std::memcpy(slot + sizeof(uint64_t), static_cast<const char*>(entry) + sizeof(uint64_t), entrySize - sizeof(uint64_t));
+
+			seq.store(index * 2 + 2, std::memory_order_release);
+		}
+
+		size_t SequencedRing::read(const uint64_t& writeIndex, const void* entries, size_t entrySize, uint32_t entryCount,
+			uint64_t& next, uint64_t& lost, void* out, size_t maxCount)
+		{
+			uint64_t end = atomicOf(writeIndex).load(std::memory_order_acquire);
+			if (end < next)
+			{
+				// The writer started over
+				next = end > entryCount ? end - entryCount : 0;
+			}
+			else if (end - next > entryCount)
+			{
+				lost += end - entryCount - next;
+				next = end - entryCount;
+			}
+
+			size_t count = 0;
+			while (next < end && count < maxCount)
+			{
+				const char* slot = static_cast<const char*>(entries) + (next % entryCount) * entrySize;
+				const std::atomic<uint64_t>& seq = atomicOf(*reinterpret_cast<const uint64_t*>(slot));
+				uint64_t expected = next * 2 + 2;
+
+				uint64_t seq1 = seq.load(std::memory_order_acquire);
+				if (seq1 < expected)
+				{
+					// Claimed but not written yet, it is picked up by the next call
+					break;
+				}
+
+				if (seq1 == expected)
+				{
+					char* copy = static_cast<char*>(out) + count * entrySize;
+					std::memcpy(copy, slot, entrySize);
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (seq.load(std::memory_order_relaxed) == expected)
+					{
+						std::memcpy(copy, &expected, sizeof(uint64_t));
+						count++;
+						next++;
+						continue;
+					}
+				}
+
+				// A writer one lap ahead has taken the entry
+				lost++;
+				next++;
+			}
+			return count;
+		}
+	}
+}
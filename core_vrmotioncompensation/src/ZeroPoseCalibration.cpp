@@ -0,0 +1,245 @@
+#include "ZeroPoseCalibration.h"
+#include "Filters.h"
+#include <openvr_math.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace vrmotioncompensation
+{
+	namespace core
+	{
+		const double ZeroPoseCalibration::MinOutlierDistance = 0.0005;
+		const double ZeroPoseCalibration::MinOutlierAngle = 0.0017;
+		const double ZeroPoseCalibration::OutlierThreshold = 3.0;
+		const double ZeroPoseCalibration::MinInlierRatio = 0.5;
+
+		// Iterations of the rotation mean at most. It starts at the median, so it converges after very few
+		static const int RotationMeanIterations = 8;
+
+		static inline double length(const vr::HmdVector3d_t& v)
+		{
+			return std::sqrt(v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2]);
+		}
+
+		// Median of values, reordering scratch
+		static double median(const std::vector<double>& values, std::vector<double>& scratch)
+		{
+			scratch.assign(values.begin(), values.end());
+			size_t middle = scratch.size() / 2;
+			std::nth_element(scratch.begin(), scratch.begin() + middle, scratch.end());
+			double upper = scratch[middle];
+			if (scratch.size() % 2 != 0)
+			{
+				return upper;
+			}
+			return (*std::max_element(scratch.begin(), scratch.begin() + middle) + upper) * 0.5;
+		}
+
+		ZeroPoseCalibration::ZeroPoseCalibration()
+		{
+			// About half a second of a tracker at rest, with room for the tracking noise
+			configure({ 100, 0.002, 0.0087 });
+		}
+
+		void ZeroPoseCalibration::configure(const ZeroPoseCalibrationSettings& settings)
+		{
+			_Settings = settings;
+			_Settings.Samples = std::min(std::max(settings.Samples, 1u), MaxSamples);
+			_Settings.MaxPositionDeviation = std::max(settings.MaxPositionDeviation, 0.0);
+			_Settings.MaxRotationDeviation = std::max(settings.MaxRotationDeviation, 0.0);
+
+			_Positions.reserve(_Settings.Samples);
+			_Rotations.reserve(_Settings.Samples);
+			_PositionDistances.reserve(_Settings.Samples);
+			_Angles.reserve(_Settings.Samples);
+			_Scratch.reserve(_Settings.Samples);
+			reset();
+		}
+
+		void ZeroPoseCalibration::reset()
+		{
+			_Positions.clear();
+			_Rotations.clear();
+			_Status = {};
+			_Status.State = ZeroPoseCalibrationState::Idle;
+			_Status.WindowSize = _Settings.Samples;
+		}
+
+		bool ZeroPoseCalibration::addSample(const vr::DriverPose_t& pose, vr::DriverPose_t& zeroPose)
+		{
+			if (_Status.State == ZeroPoseCalibrationState::Done)
+			{
+				reset();
+			}
+
+			// Convert pose from driver space to app space
+			vr::HmdVector3d_t pos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, pose.vecPosition) + pose.vecWorldFromDriverTranslation;
+			vr::HmdQuaternion_t rot = quaternionNormalize(pose.qWorldFromDriverRotation * pose.qRotation);
+
+			// All rotations of the window on the same hemisphere, so their components can be compared
+			if (!_Rotations.empty())
+			{
+				const vr::HmdQuaternion_t& first = _Rotations.front();
+				if (first.w * rot.w + first.x * rot.x + first.y * rot.y + first.z * rot.z < 0.0)
+				{
+					rot = { -rot.w, -rot.x, -rot.y, -rot.z };
+				}
+			}
+
+			_Positions.push_back(pos);
+			_Rotations.push_back(rot);
+			_Status.State = ZeroPoseCalibrationState::Collecting;
+			_Status.Samples = (uint32_t)_Positions.size();
+
+			if (_Positions.size() < _Settings.Samples)
+			{
+				return false;
+			}
+
+			bool accepted = evaluate(zeroPose);
+			_Status.Windows++;
+			_Positions.clear();
+			_Rotations.clear();
+			_Status.Samples = 0;
+			if (accepted)
+			{
+				_Status.State = ZeroPoseCalibrationState::Done;
+			}
+			return accepted;
+		}
+
+		double ZeroPoseCalibration::outlierLimit(const std::vector<double>& distances, double minimum)
+		{
+			double center = median(distances, _Scratch);
+			_Scratch.clear();
+			for (double distance : distances)
+			{
+				_Scratch.push_back(std::fabs(distance - center));
+			}
+			std::vector<double>& deviations = _Scratch;
+			size_t middle = deviations.size() / 2;
+			std::nth_element(deviations.begin(), deviations.begin() + middle, deviations.end());
+			double mad = deviations[middle];
+			return std::max(center + OutlierThreshold * 1.4826 * mad, minimum);
+		}
+
+		bool ZeroPoseCalibration::evaluate(vr::DriverPose_t& zeroPose)
+		{
+			size_t count = _Positions.size();
+
+			// Robust center: component wise medians. The rotations are close together on one hemisphere,
+			// so the normalized median quaternion is a good start for the mean
+			vr::HmdVector3d_t medianPos;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				_PositionDistances.clear();
+				for (const vr::HmdVector3d_t& pos : _Positions)
+				{
+					_PositionDistances.push_back(pos.v[axis]);
+				}
+				medianPos.v[axis] = median(_PositionDistances, _Scratch);
+			}
+
+			double medianRot[4];
+			for (int component = 0; component < 4; component++)
+			{
+				_Angles.clear();
+				for (const vr::HmdQuaternion_t& rot : _Rotations)
+				{
+					_Angles.push_back(component == 0 ? rot.w : (component == 1 ? rot.x : (component == 2 ? rot.y : rot.z)));
+				}
+				medianRot[component] = median(_Angles, _Scratch);
+			}
+			vr::HmdQuaternion_t centerRot = quaternionNormalize({ medianRot[0], medianRot[1], medianRot[2], medianRot[3] });
+			vr::HmdQuaternion_t centerRotInv = vrmath::quaternionConjugate(centerRot);
+
+			// Outliers
+			_PositionDistances.clear();
+			_Angles.clear();
+			for (size_t i = 0; i < count; i++)
+			{
+				_PositionDistances.push_back(length(_Positions[i] - medianPos));
+				_Angles.push_back(length(quaternionLog(_Rotations[i] * centerRotInv)));
+			}
+			double positionLimit = outlierLimit(_PositionDistances, MinOutlierDistance);
+			double angleLimit = outlierLimit(_Angles, MinOutlierAngle);
+
+			// Mean of the inliers, the rotation moved along the average rotation vector to all inliers
+			vr::HmdVector3d_t meanPos = { 0, 0, 0 };
+			uint32_t inliers = 0;
+			for (size_t i = 0; i < count; i++)
+			{
+				if (_PositionDistances[i] <= positionLimit && _Angles[i] <= angleLimit)
+				{
+					meanPos = meanPos + _Positions[i];
+					inliers++;
+				}
+			}
+
+			_Status.Inliers = inliers;
+			if (inliers == 0 || (double)inliers < MinInlierRatio * (double)count)
+			{
+				_Status.PositionDeviation = 0.0;
+				_Status.RotationDeviation = 0.0;
+				return false;
+			}
+			meanPos = meanPos / (double)inliers;
+
+			vr::HmdQuaternion_t meanRot = centerRot;
+			for (int iteration = 0; iteration < RotationMeanIterations; iteration++)
+			{
+				vr::HmdQuaternion_t meanRotInv = vrmath::quaternionConjugate(meanRot);
+				vr::HmdVector3d_t delta = { 0, 0, 0 };
+				for (size_t i = 0; i < count; i++)
+				{
+					if (_PositionDistances[i] <= positionLimit && _Angles[i] <= angleLimit)
+					{
+						delta = delta + quaternionLog(_Rotations[i] * meanRotInv);
+					}
+				}
+				delta = delta / (double)inliers;
+				meanRot = quaternionNormalize(quaternionExp(delta) * meanRot);
+				if (length(delta) < 1.0E-12)
+				{
+					break;
+				}
+			}
+
+			// Residual of the inliers
+			vr::HmdQuaternion_t meanRotInv = vrmath::quaternionConjugate(meanRot);
+			double positionSum = 0.0;
+			double rotationSum = 0.0;
+			for (size_t i = 0; i < count; i++)
+			{
+				if (_PositionDistances[i] <= positionLimit && _Angles[i] <= angleLimit)
+				{
+					double distance = length(_Positions[i] - meanPos);
+					double angle = length(quaternionLog(_Rotations[i] * meanRotInv));
+					positionSum += distance * distance;
+					rotationSum += angle * angle;
+				}
+			}
+			_Status.PositionDeviation = std::sqrt(positionSum / (double)inliers);
+			_Status.RotationDeviation = std::sqrt(rotationSum / (double)inliers);
+
+			if ((_Settings.MaxPositionDeviation > 0.0 && _Status.PositionDeviation > _Settings.MaxPositionDeviation)
+				|| (_Settings.MaxRotationDeviation > 0.0 && _Status.RotationDeviation > _Settings.MaxRotationDeviation))
+			{
+				return false;
+			}
+
+			zeroPose = {};
+			zeroPose.qWorldFromDriverRotation = { 1, 0, 0, 0 };
+			zeroPose.qDriverFromHeadRotation = { 1, 0, 0, 0 };
+			zeroPose.vecPosition[0] = meanPos.v[0];
+			zeroPose.vecPosition[1] = meanPos.v[1];
+			zeroPose.vecPosition[2] = meanPos.v[2];
+			zeroPose.qRotation = meanRot;
+			zeroPose.poseIsValid = true;
+			zeroPose.result = vr::TrackingResult_Running_OK;
+			zeroPose.deviceIsConnected = true;
+			return true;
+		}
+	}
+}
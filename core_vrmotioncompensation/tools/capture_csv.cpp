@@ -0,0 +1,64 @@
+#include "CaptureFile.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace vrmotioncompensation;
+
+// Converts a capture of the debug logger (MotionData.vrmccap) into csv for a spreadsheet, one line per data point
+// with the channel names from the capture header as titles. Without an output file the csv goes to stdout.
+// --semicolon separates the columns like the old MotionData.txt did.
+// Usage: vrmotioncompensation_capture_csv <capture> [output.csv] [--semicolon]
+
+int main(int argc, char* argv[])
+{
+	const char* input = nullptr;
+	const char* output = nullptr;
+	char separator = ',';
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--semicolon") == 0)
+		{
+			separator = ';';
+		}
+		else if (input == nullptr)
+		{
+			input = argv[i];
+		}
+		else if (output == nullptr)
+		{
+			output = argv[i];
+		}
+		else
+		{
+			input = nullptr;
+			break;
+		}
+	}
+	if (input == nullptr)
+	{
+		printf("Usage: vrmotioncompensation_capture_csv <capture> [output.csv] [--semicolon]\n");
+		return 1;
+	}
+
+	core::CaptureReader capture;
+	if (!capture.open(input))
+	{
+		fprintf(stderr, "%s is not a capture file of version %u\n", input, core::CaptureVersion);
+		return 1;
+	}
+
+	std::FILE* file = output != nullptr ? std::fopen(output, "w") : stdout;
+	if (file == nullptr)
+	{
+		fprintf(stderr, "Could not create %s\n", output);
+		return 1;
+	}
+	capture.writeCsv(file, separator);
+	if (output != nullptr)
+	{
+		std::fclose(file);
+		printf("%llu data points of %u channels written to %s\n", (unsigned long long)capture.getRecordCount(), capture.getChannelCount(), output);
+	}
+	return 0;
+}
@@ -0,0 +1,151 @@
+#include "PoseReplay.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace vrmotioncompensation;
+
+// Replays recorded reference and device poses through the driver's compensation offline, at full speed and without SteamVR,
+// and writes the poses the compensated devices would get. The settings are those of the overlay, the defaults are the driver's.
+// Input and output are csv files in the format of core::PoseReplay::writeCsv, the output has the compensated devices only.
+// Usage: vrmotioncompensation_pose_replay <input.csv> <output.csv> [--filter default|kalman|oneeuro] [--samples n] [--lpf-beta beta]
+//        [--kalman process observation prediction_ms] [--oneeuro min_cutoff beta] [--zero-samples n] [--offset device x y z]
+
+static void usage()
+{
+	printf("Usage: vrmotioncompensation_pose_replay <input.csv> <output.csv> [--filter default|kalman|oneeuro] [--samples n] [--lpf-beta beta]\n"
+		"       [--kalman process observation prediction_ms] [--oneeuro min_cutoff beta] [--zero-samples n] [--offset device x y z]\n");
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		usage();
+		return 1;
+	}
+
+	core::PoseReplay replay;
+	core::MotionCompensationCore& mc = replay.getCore();
+	ZeroPoseCalibrationSettings calibration = core::ZeroPoseCalibration().getSettings();
+	std::vector<std::pair<uint32_t, MotionCompensationDeviceOffset>> offsets;
+
+	for (int i = 3; i < argc; i++)
+	{
+		int left = argc - i - 1;
+		if (std::strcmp(argv[i], "--filter") == 0 && left >= 1)
+		{
+			const char* type = argv[++i];
+			if (std::strcmp(type, "default") == 0)
+			{
+				mc.setFilterType(MotionCompensationFilterType::Default);
+			}
+			else if (std::strcmp(type, "kalman") == 0)
+			{
+				mc.setFilterType(MotionCompensationFilterType::Kalman);
+			}
+			else if (std::strcmp(type, "oneeuro") == 0)
+			{
+				mc.setFilterType(MotionCompensationFilterType::OneEuro);
+			}
+			else
+			{
+				usage();
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--samples") == 0 && left >= 1)
+		{
+			mc.setAlpha((uint32_t)std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--lpf-beta") == 0 && left >= 1)
+		{
+			mc.setLpfBeta(std::atof(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--kalman") == 0 && left >= 3)
+		{
+			mc.setKalmanNoise(std::atof(argv[i + 1]), std::atof(argv[i + 2]));
+			mc.setKalmanPrediction((long long)(std::atof(argv[i + 3]) * 1000.0));
+			i += 3;
+		}
+		else if (std::strcmp(argv[i], "--oneeuro") == 0 && left >= 2)
+		{
+			mc.setOneEuroParameters(std::atof(argv[i + 1]), std::atof(argv[i + 2]));
+			i += 2;
+		}
+		else if (std::strcmp(argv[i], "--zero-samples") == 0 && left >= 1)
+		{
+			calibration.Samples = (uint32_t)std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--offset") == 0 && left >= 4)
+		{
+			MotionCompensationDeviceOffset offset = { { std::atof(argv[i + 2]), std::atof(argv[i + 3]), std::atof(argv[i + 4]) }, { 1, 0, 0, 0 } };
+			offsets.push_back({ (uint32_t)std::atoi(argv[i + 1]), offset });
+			i += 4;
+		}
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	std::FILE* input = std::fopen(argv[1], "r");
+	if (input == nullptr)
+	{
+		printf("Could not open %s\n", argv[1]);
+		return 1;
+	}
+	std::vector<core::ReplaySample> samples;
+	size_t errorLine = 0;
+	bool read = core::PoseReplay::readCsv(input, samples, errorLine);
+	std::fclose(input);
+	if (!read)
+	{
+		printf("%s: line %zu is not a pose sample\n", argv[1], errorLine);
+		return 1;
+	}
+	if (samples.empty())
+	{
+		printf("%s has no pose samples\n", argv[1]);
+		return 1;
+	}
+
+	replay.setReferenceTrackers(samples);
+	replay.getReferenceTrackers().setZeroPoseCalibration(calibration);
+	for (const auto& offset : offsets)
+	{
+		replay.setDeviceOffset(offset.first, offset.second);
+	}
+
+	std::vector<core::ReplaySample> output;
+	output.reserve(samples.size());
+	auto start = std::chrono::steady_clock::now();
+	replay.run(samples, output);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::FILE* file = std::fopen(argv[2], "w");
+	if (file == nullptr)
+	{
+		printf("Could not create %s\n", argv[2]);
+		return 1;
+	}
+	core::PoseReplay::writeCsvHeader(file);
+	for (const core::ReplaySample& sample : output)
+	{
+		core::PoseReplay::writeCsv(file, sample);
+	}
+	std::fclose(file);
+
+	double recorded = (double)(samples.back().TimestampUs - samples.front().TimestampUs) / 1.0E6;
+	std::vector<uint32_t> trackers = replay.getReferenceTrackers().getTrackers();
+	printf("%zu samples, %zu of compensated devices, %zu reference trackers, %.1f s recorded\n", samples.size(), output.size(), trackers.size(), recorded);
+	printf("Zero pose %s after %u calibration windows\n", mc.isZeroPoseValid() ? "calibrated" : "not calibrated",
+		replay.getCalibrationWindows());
+	printf("Replayed in %.3f s, %.0f times real time, %.0f ns per sample\n", seconds, seconds > 0.0 ? recorded / seconds : 0.0,
+		seconds * 1.0E9 / (double)samples.size());
+	return 0;
+}
@@ -0,0 +1,195 @@
+#include "Filters.h"
+#include "RigPoseChannel.h"
+#include <openvr_math.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include <boost/interprocess/mapped_region.hpp>
+#ifdef _WIN32
+#include <boost/interprocess/windows_shared_memory.hpp>
+#else
+#include <boost/interprocess/shared_memory_object.hpp>
+#endif
+
+using namespace vrmotioncompensation;
+
+// Stands in for the motion rig software: plays a sine or step motion into the rig pose block of the
+// OVRMC_MMFv1 shared memory, or reads the block back like the driver does.
+// With the driver in rig pose mode, the world should stay still while the rig pose moves.
+// Usage: vrmotioncompensation_rigpose_writer <sine|step|read> [seconds] [rate Hz]
+
+static const double PI = 3.14159265358979323846;
+static const char* SharedMemoryName = "OVRMC_MMFv1";
+static const size_t SharedMemorySize = 4096;
+
+static long long now()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Heave, pitch and roll sines around the origin of the tracking space
+static void sineMotion(double t, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot)
+{
+	pos = { 0.0, 0.03 * std::sin(2.0 * PI * 0.5 * t), 0.0 };
+	rot = vrmath::quaternionFromYawPitchRoll(0.0, 0.052 * std::sin(2.0 * PI * 0.3 * t), 0.035 * std::sin(2.0 * PI * 0.4 * t));
+}
+
+// Heave and pitch steps every two seconds
+static void stepMotion(double t, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot)
+{
+	double level = ((long long)(t / 2.0) & 1) ? 1.0 : 0.0;
+	pos = { 0.0, 0.02 * level, 0.0 };
+	rot = vrmath::quaternionFromYawPitchRoll(0.0, 0.052 * level, 0.0);
+}
+
+static int playMotion(MMFstruct_OVRMC_RigPose_v1& block, bool sine, double seconds, double rate)
+{
+	core::RigPoseWriter::init(block);
+
+	const double h = 0.001;
+	auto period = std::chrono::duration<double>(1.0 / rate);
+	auto start = std::chrono::steady_clock::now();
+	auto next = start;
+	unsigned long long count = 0;
+
+	printf("Writing a %s motion at %.0f Hz for %.0f s\n", sine ? "sine" : "step", rate, seconds);
+	for (;;)
+	{
+		double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (t >= seconds)
+		{
+			break;
+		}
+
+		RigPose_v1 pose = {};
+		pose.TimestampUs = now();
+		pose.Flags = RigPoseFlag_Valid;
+		if (sine)
+		{
+			// Central differences, the rig software would send the velocities of its actuators
+			vr::HmdVector3d_t posBefore, posAfter;
+			vr::HmdQuaternion_t rotBefore, rotAfter;
+			sineMotion(t, pose.Position, pose.Rotation);
+			sineMotion(t - h, posBefore, rotBefore);
+			sineMotion(t + h, posAfter, rotAfter);
+			pose.Velocity = core::vecDerivative(2.0 * h, posAfter, posBefore);
+			pose.AngularVelocity = core::quaternionVelocity(2.0 * h, rotAfter, rotBefore);
+			pose.Flags |= RigPoseFlag_Derivatives;
+		}
+		else
+		{
+			stepMotion(t, pose.Position, pose.Rotation);
+		}
+		core::RigPoseWriter::write(block, pose);
+
+		if (++count % (unsigned long long)rate == 0)
+		{
+			printf("%6.1f s: heave %7.2f cm\n", t, pose.Position.v[1] * 100.0);
+		}
+
+		next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+		std::this_thread::sleep_until(next);
+	}
+
+	// Leave the rig at rest, then stop. The driver keeps the last valid pose
+	RigPose_v1 rest = {};
+	rest.TimestampUs = now();
+	rest.Flags = RigPoseFlag_Valid;
+	rest.Rotation = { 1, 0, 0, 0 };
+	core::RigPoseWriter::write(block, rest);
+	rest.Flags = 0;
+	core::RigPoseWriter::write(block, rest);
+
+	printf("%llu poses written\n", count);
+	return 0;
+}
+
+static int readBack(const MMFstruct_OVRMC_RigPose_v1& block, double seconds)
+{
+	core::RigPoseReader reader;
+	unsigned long long poses = 0, busy = 0;
+	vr::DriverPose_t pose = {};
+	auto start = std::chrono::steady_clock::now();
+	auto report = start + std::chrono::seconds(1);
+
+	for (;;)
+	{
+		auto current = std::chrono::steady_clock::now();
+		if (std::chrono::duration<double>(current - start).count() >= seconds)
+		{
+			break;
+		}
+
+		switch (reader.poll(block, now(), pose))
+		{
+		case core::RigPoseReader::Result::NewPose:
+			poses++;
+			break;
+		case core::RigPoseReader::Result::Busy:
+			busy++;
+			break;
+		default:
+			break;
+		}
+
+		if (current >= report)
+		{
+			if (block.Magic != RigPoseMagic)
+			{
+				printf("No rig pose written yet\n");
+			}
+			else
+			{
+				printf("%llu poses/s, %llu torn copies, %llu busy polls, age %.2f ms, position %.4f %.4f %.4f, rotation %.4f %.4f %.4f %.4f\n",
+					poses, (unsigned long long)reader.getTornReads(), busy, -pose.poseTimeOffset * 1000.0,
+					pose.vecPosition[0], pose.vecPosition[1], pose.vecPosition[2], pose.qRotation.w, pose.qRotation.x, pose.qRotation.y, pose.qRotation.z);
+			}
+			poses = 0;
+			report += std::chrono::seconds(1);
+		}
+
+		std::this_thread::sleep_for(std::chrono::microseconds(1000));
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string mode = argc > 1 ? argv[1] : "";
+	double seconds = argc > 2 ? std::atof(argv[2]) : 30.0;
+	double rate = argc > 3 ? std::atof(argv[3]) : 1000.0;
+	if ((mode != "sine" && mode != "step" && mode != "read") || seconds <= 0.0 || rate <= 0.0)
+	{
+		printf("Usage: vrmotioncompensation_rigpose_writer <sine|step|read> [seconds] [rate Hz]\n");
+		return 1;
+	}
+
+	try
+	{
+#ifdef _WIN32
+		// Same mapping as the driver, it exists as long as one of the two has it open
+		boost::interprocess::windows_shared_memory shm(boost::interprocess::open_or_create, SharedMemoryName, boost::interprocess::read_write, SharedMemorySize);
+#else
+		boost::interprocess::shared_memory_object shm(boost::interprocess::open_or_create, SharedMemoryName, boost::interprocess::read_write);
+		boost::interprocess::offset_t size = 0;
+		if (!shm.get_size(size) || size < (boost::interprocess::offset_t)SharedMemorySize)
+		{
+			shm.truncate(SharedMemorySize);
+		}
+#endif
+		boost::interprocess::mapped_region region(shm, boost::interprocess::read_write);
+		MMFstruct_OVRMC_RigPose_v1* block = reinterpret_cast<MMFstruct_OVRMC_RigPose_v1*>(static_cast<char*>(region.get_address()) + RigPoseBlockOffset);
+
+		return mode == "read" ? readBack(*block, seconds) : playMotion(*block, mode == "sine", seconds, rate);
+	}
+	catch (boost::interprocess::interprocess_exception& e)
+	{
+		printf("Could not open the shared memory %s: %s\n", SharedMemoryName, e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,152 @@
+#include "vrmc_openvr.h"
+#include "TelemetryRing.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <boost/interprocess/mapped_region.hpp>
+#ifdef _WIN32
+#include <boost/interprocess/windows_shared_memory.hpp>
+#else
+#include <boost/interprocess/shared_memory_object.hpp>
+#endif
+
+using namespace vrmotioncompensation;
+
+// Tails the telemetry ring of the driver (OVRMC_Telemetry_v1) and prints the poses of every entry,
+// or of every Nth entry. The ring is mapped read only, the driver does not notice the reader.
+// With --csv one line per entry is written, ready for a spreadsheet or a plot script.
+// Usage: vrmotioncompensation_telemetry_tail [every Nth entry] [--csv] [--backlog]
+
+static const size_t BatchSize = 256;
+
+static void printPose(const char* name, const TelemetryPose_v1& pose)
+{
+	printf("  %-11s %9.5f %9.5f %9.5f   %8.5f %8.5f %8.5f %8.5f\n", name,
+		pose.Position.v[0], pose.Position.v[1], pose.Position.v[2], pose.Rotation.w, pose.Rotation.x, pose.Rotation.y, pose.Rotation.z);
+}
+
+static void printCsvPose(const TelemetryPose_v1& pose)
+{
+	printf(",%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f",
+		pose.Position.v[0], pose.Position.v[1], pose.Position.v[2], pose.Rotation.w, pose.Rotation.x, pose.Rotation.y, pose.Rotation.z);
+}
+
+static void printCsvHeader()
+{
+	printf("sequence,time_ns,device_sample_us,ref_sample_us,device,compensated");
+	const char* poses[] = { "raw_ref", "filtered_ref", "raw_device", "compensated_device" };
+	for (const char* pose : poses)
+	{
+		printf(",%s_x,%s_y,%s_z,%s_qw,%s_qx,%s_qy,%s_qz", pose, pose, pose, pose, pose, pose, pose);
+	}
+	printf("\n");
+}
+
+static void printEntry(const TelemetryEntry_v1& entry, bool csv)
+{
+	if (csv)
+	{
+		printf("%llu,%lld,%lld,%lld,%d,%d", (unsigned long long)entry.Sequence / 2 - 1, (long long)entry.TimeNs, (long long)entry.DeviceSampleUs,
+			(long long)entry.RefSampleUs, entry.DeviceId == TelemetryNoDevice ? -1 : (int)entry.DeviceId, (entry.Flags & TelemetryFlag_Compensated) ? 1 : 0);
+		printCsvPose(entry.RawReference);
+		printCsvPose(entry.FilteredReference);
+		printCsvPose(entry.RawDevice);
+		printCsvPose(entry.CompensatedDevice);
+		printf("\n");
+		return;
+	}
+
+	printf("#%llu at %.6f s, device %d, %s, reference sample %.2f ms older than the device sample\n",
+		(unsigned long long)entry.Sequence / 2 - 1, (double)entry.TimeNs / 1.0E9, entry.DeviceId == TelemetryNoDevice ? -1 : (int)entry.DeviceId,
+		(entry.Flags & TelemetryFlag_Compensated) ? "compensated" : "not compensated", (double)(entry.DeviceSampleUs - entry.RefSampleUs) / 1000.0);
+	printPose("raw ref", entry.RawReference);
+	printPose("filtered", entry.FilteredReference);
+	printPose("raw device", entry.RawDevice);
+	printPose("compensated", entry.CompensatedDevice);
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned long long every = 1;
+	bool csv = false;
+	bool backlog = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--csv") == 0)
+		{
+			csv = true;
+		}
+		else if (std::strcmp(argv[i], "--backlog") == 0)
+		{
+			backlog = true;
+		}
+		else if (std::atoll(argv[i]) > 0)
+		{
+			every = (unsigned long long)std::atoll(argv[i]);
+		}
+		else
+		{
+			printf("Usage: vrmotioncompensation_telemetry_tail [every Nth entry] [--csv] [--backlog]\n");
+			return 1;
+		}
+	}
+
+	try
+	{
+#ifdef _WIN32
+		boost::interprocess::windows_shared_memory shm(boost::interprocess::open_only, TelemetrySharedMemoryName, boost::interprocess::read_only);
+#else
+		boost::interprocess::shared_memory_object shm(boost::interprocess::open_only, TelemetrySharedMemoryName, boost::interprocess::read_only);
+#endif
+		boost::interprocess::mapped_region region(shm, boost::interprocess::read_only);
+		if (region.get_size() < sizeof(MMFstruct_OVRMC_Telemetry_v1))
+		{
+			printf("The shared memory %s is too small\n", TelemetrySharedMemoryName);
+			return 1;
+		}
+		const MMFstruct_OVRMC_Telemetry_v1& ring = *static_cast<const MMFstruct_OVRMC_Telemetry_v1*>(region.get_address());
+
+		core::TelemetryReader reader;
+		reader.attach(ring, !backlog);
+		static TelemetryEntry_v1 entries[BatchSize];
+		uint64_t lost = 0;
+		if (csv)
+		{
+			printCsvHeader();
+		}
+
+		for (;;)
+		{
+			size_t count = reader.read(ring, entries, BatchSize);
+			for (size_t i = 0; i < count; i++)
+			{
+				if ((entries[i].Sequence / 2 - 1) % every == 0)
+				{
+					printEntry(entries[i], csv);
+				}
+			}
+
+			if (reader.getLost() != lost)
+			{
+				// On stderr, so the csv output stays clean
+				fprintf(stderr, "%llu entries lost, the reader fell behind\n", (unsigned long long)(reader.getLost() - lost));
+				lost = reader.getLost();
+			}
+
+			if (count < BatchSize)
+			{
+				fflush(stdout);
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			}
+		}
+	}
+	catch (boost::interprocess::interprocess_exception& e)
+	{
+		printf("Could not open the shared memory %s, is the driver running? %s\n", TelemetrySharedMemoryName, e.what());
+		return 1;
+	}
+}
@@ -3,9 +3,15 @@
 #include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <openvr_driver.h>
 #include <ipc_protocol.h>
+#include <ipc_transport.h>
 #include <openvr_math.h>
 #include "../../driver/ServerDriver.h"
 #include "../../devicemanipulation/DeviceManipulationHandle.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
 
 
 namespace vrmotioncompensation
@@ -16,79 +22,61 @@ namespace vrmotioncompensation
 		{
 			_driver = driver;
 			_ipcThreadStopFlag = false;
-			_ipcThread = std::thread(_ipcThreadFunc, this, driver);
+			_ipcThread = std::thread(_ipcThreadFunc, this, driver, ipc::TransportType::MessageQueue);
+			_ipcRingThread = std::thread(_ipcThreadFunc, this, driver, ipc::TransportType::SharedMemoryRing);
+			if (_events.create("driver_vrmotioncompensation.events"))
+			{
+				_eventThread = std::thread(_eventThreadFunc, this);
+			}
+			else
+			{
+				LOG(ERROR) << "Could not create the device event queue, events are not pushed to clients";
+			}
 		}
 
 		void IpcShmCommunicator::shutdown()
 		{
-			if (_ipcThreadRunning)
+			_ipcThreadStopFlag = true;
+			if (_ipcThread.joinable())
 			{
-				_ipcThreadStopFlag = true;
 				_ipcThread.join();
 			}
+			if (_ipcRingThread.joinable())
+			{
+				_ipcRingThread.join();
+			}
+			if (_eventThread.joinable())
+			{
+				_eventThread.join();
+			}
 		}
 
-		void IpcShmCommunicator::_ipcThreadFunc(IpcShmCommunicator* _this, ServerDriver* driver)
+		void IpcShmCommunicator::_ipcThreadFunc(IpcShmCommunicator* _this, ServerDriver* driver, ipc::TransportType transportType)
 		{
-			_this->_ipcThreadRunning = true;
-			LOG(DEBUG) << "CServerDriver::_ipcThreadFunc: thread started";
+			LOG(DEBUG) << "CServerDriver::_ipcThreadFunc: thread started (transport " << (int)transportType << ")";
 			try
 			{
-		   // Create message queue
-				boost::interprocess::message_queue::remove(_this->_ipcQueueName.c_str());
-				boost::interprocess::message_queue messageQueue(
-					boost::interprocess::create_only,
-					_this->_ipcQueueName.c_str(),
-					100,					//max message number
-					sizeof(ipc::Request)    //max message size
-				);
+				// Create the server endpoint, the receive returns as soon as a request arrives. The timeout only bounds the shutdown
+				std::unique_ptr<ipc::Transport> transport = ipc::createTransport(transportType, _this->_ipcQueueName, sizeof(ipc::Request));
 
 				while (!_this->_ipcThreadStopFlag)
 				{
 					try
 					{
 						ipc::Request message;
-						uint64_t recv_size;
-						unsigned priority;
-						boost::posix_time::ptime timeout = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(50);
-						if (messageQueue.timed_receive(&message, sizeof(ipc::Request), recv_size, priority, timeout))
+						uint32_t recv_size;
+						if (transport->receive(&message, sizeof(ipc::Request), recv_size, 50))
 						{
 							LOG(TRACE) << "CServerDriver::_ipcThreadFunc: IPC request received ( type " << (int)message.type << ")";
 							if (recv_size == sizeof(ipc::Request))
 							{
+								std::lock_guard<std::mutex> dispatchLock(_this->_dispatchMutex);
 								switch (message.type)
 								{
 
 								case ipc::RequestType::IPC_ClientConnect:
 								{
-									try
-									{
-										auto queue = std::make_shared<boost::interprocess::message_queue>(boost::interprocess::open_only, message.msg.ipc_ClientConnect.queueName);
-										ipc::Reply reply(ipc::ReplyType::IPC_ClientConnect);
-										reply.messageId = message.msg.ipc_ClientConnect.messageId;
-										reply.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
-										uint32_t clientId = 0;
-										if (message.msg.ipc_ClientConnect.ipcProcotolVersion == IPC_PROTOCOL_VERSION)
-										{
-											clientId = _this->_ipcClientIdNext++;
-											_this->_ipcEndpoints.insert({ clientId, queue });
-											reply.msg.ipc_ClientConnect.clientId = clientId;
-											reply.status = ipc::ReplyStatus::Ok;
-											LOG(INFO) << "New client connected: endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\", cliendId " << clientId;
-										}
-										else
-										{
-											reply.msg.ipc_ClientConnect.clientId = 0;
-											reply.status = ipc::ReplyStatus::InvalidVersion;
-											LOG(INFO) << "Client (endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\") reports incompatible ipc version "
-												<< message.msg.ipc_ClientConnect.ipcProcotolVersion;
-										}
-										_this->sendReply(clientId, reply);
-									}
-									catch (std::exception & e)
-									{
-										LOG(ERROR) << "Error during client connect: " << e.what();
-									}
+									_this->clientConnect(message, recv_size);
 								}
 								break;
 
@@ -106,6 +94,8 @@ namespace vrmotioncompensation
 											_this->sendReply(message.msg.ipc_ClientDisconnect.clientId, reply);
 										}
 										_this->_ipcEndpoints.erase(i);
+										_this->_eventSubscriptions.erase(message.msg.ipc_ClientDisconnect.clientId);
+										_this->_eventSubscribers = (uint32_t)_this->_eventSubscriptions.size();
 									}
 									else
 									{
@@ -187,7 +177,7 @@ namespace vrmotioncompensation
 											LOG(ERROR) << "DeviceManipulation_MotionCompensationMode: MCdevice not found";
 											resp.status = ipc::ReplyStatus::NotFound;
 										}
-										else if (!RTdevice)
+										else if (!RTdevice && message.msg.dm_MotionCompensationMode.CompensationMode == MotionCompensationMode::ReferenceTracker)
 										{
 											LOG(ERROR) << "DeviceManipulation_MotionCompensationMode: RTdevice not found";
 											resp.status = ipc::ReplyStatus::NotFound;
@@ -204,55 +194,108 @@ namespace vrmotioncompensation
 													LOG(INFO) << "Tracker OpenVR Id: " << message.msg.dm_MotionCompensationMode.RTdeviceId;
 													LOG(INFO) << "HMD OpenVR Id: " << message.msg.dm_MotionCompensationMode.MCdeviceId;
 
-													// Check if an old device needs a mode change
-													if (serverDriver->motionCompensation().getMotionCompensationMode() == MotionCompensationMode::ReferenceTracker)
-													{
-														// New MCdevice is different from old
-														if (serverDriver->motionCompensation().getMCdeviceID() != MCdeviceID)
-														{
-															// Set old MCdevice to default
-															DeviceManipulationHandle* OldMCdevice = driver->getDeviceManipulationHandleById(serverDriver->motionCompensation().getMCdeviceID());
-															OldMCdevice->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::MotionCompensated);
-
-															// Set new MCdevice to motion compensated
-															MCdevice->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::MotionCompensated);
-															serverDriver->motionCompensation().setNewReferenceTracker(MCdeviceID);
-														}
+													MotionCompensationManager& mc = serverDriver->motionCompensation();
 
+													if (MCdeviceID == RTdeviceID)
+													{
+														LOG(ERROR) << "DeviceManipulation_MotionCompensationMode: MCdevice and RTdevice are the same device";
+														resp.status = ipc::ReplyStatus::InvalidOperation;
+													}
+													else if (mc.getMotionCompensationMode() == MotionCompensationMode::ReferenceTracker)
+													{
 														// New RTdevice is different from old
-														if (serverDriver->motionCompensation().getRTdeviceID() != RTdeviceID)
+														if (mc.getRTdeviceID() != RTdeviceID)
 														{
-															// Set old RTdevice to default
-															DeviceManipulationHandle* OldRTdevice = driver->getDeviceManipulationHandleById(serverDriver->motionCompensation().getRTdeviceID());
-															OldRTdevice->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::MotionCompensated);
+															// Set old RTdevices to default
+															for (uint32_t id : mc.getRTdeviceIDs())
+															{
+																DeviceManipulationHandle* OldRTdevice = driver->getDeviceManipulationHandleById(id);
+																if (OldRTdevice)
+																{
+																	OldRTdevice->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::Default);
+																}
+															}
 
-															// Set new RTdevice to reference tracker
+															// Set new RTdevice to reference tracker, it cannot stay compensated
+															mc.removeMotionCompensatedDevice(RTdeviceID);
 															RTdevice->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::ReferenceTracker);
-															serverDriver->motionCompensation().setNewReferenceTracker(RTdeviceID);
+															mc.setNewReferenceTracker(RTdeviceID);
 														}
+
+														// Add MCdevice to the compensated devices
+														MCdevice->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::MotionCompensated);
+														mc.addMotionCompensatedDevice(MCdeviceID);
+														resp.status = ipc::ReplyStatus::Ok;
 													}
 													else
 													{
+														// Set motion compensation mode, this returns the devices compensated so far to default
+														mc.setMotionCompensationMode(MotionCompensationMode::ReferenceTracker, MCdeviceID, RTdeviceID);
+
 														// Activate motion compensation mode for specified device
 														MCdevice->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::MotionCompensated);
 														RTdevice->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::ReferenceTracker);
+														resp.status = ipc::ReplyStatus::Ok;
+													}
+												}
+												else if (message.msg.dm_MotionCompensationMode.CompensationMode == MotionCompensationMode::RigPose)
+												{
+													LOG(INFO) << "Setting driver into rig pose mode";
+													LOG(INFO) << "HMD OpenVR Id: " << message.msg.dm_MotionCompensationMode.MCdeviceId;
+
+													MotionCompensationManager& mc = serverDriver->motionCompensation();
 
-														// Set motion compensation mode
-														serverDriver->motionCompensation().setMotionCompensationMode(MotionCompensationMode::ReferenceTracker, MCdeviceID, RTdeviceID);
+													// The reference pose comes from shared memory, reference trackers are not used
+													for (uint32_t id : mc.getRTdeviceIDs())
+													{
+														DeviceManipulationHandle* OldRTdevice = driver->getDeviceManipulationHandleById(id);
+														if (OldRTdevice)
+														{
+															OldRTdevice->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::Default);
+														}
 													}
+
+													if (mc.getMotionCompensationMode() == MotionCompensationMode::RigPose)
+													{
+														// Add MCdevice to the compensated devices
+														MCdevice->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::MotionCompensated);
+														mc.addMotionCompensatedDevice(MCdeviceID);
+													}
+													else
+													{
+														// Devices compensated against a reference tracker start over with the new reference
+														mc.setMotionCompensationMode(MotionCompensationMode::RigPose, MCdeviceID, -1);
+														MCdevice->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::MotionCompensated);
+													}
+													resp.status = ipc::ReplyStatus::Ok;
 												}
 												else if (message.msg.dm_MotionCompensationMode.CompensationMode == MotionCompensationMode::Disabled)
 												{
 													LOG(INFO) << "Setting driver into default mode";
 
+													// The reference trackers go back to default
+													for (uint32_t id : serverDriver->motionCompensation().getRTdeviceIDs())
+													{
+														DeviceManipulationHandle* device = driver->getDeviceManipulationHandleById(id);
+														if (device)
+														{
+															device->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::Default);
+														}
+													}
 													MCdevice->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::Default);
-													RTdevice->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::Default);
+													if (RTdevice)
+													{
+														RTdevice->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::Default);
+													}
 
-													// Reset and set some vars for every device
+													// Reset and set some vars for every device, every compensated device goes back to default
 													serverDriver->motionCompensation().setMotionCompensationMode(MotionCompensationMode::Disabled, -1, -1);
+													resp.status = ipc::ReplyStatus::Ok;
+												}
+												else
+												{
+													resp.status = ipc::ReplyStatus::InvalidType;
 												}
-
-												resp.status = ipc::ReplyStatus::Ok;
 											}
 											else
 											{
@@ -274,22 +317,190 @@ namespace vrmotioncompensation
 								}
 								break;
 
+								case ipc::RequestType::DeviceManipulation_SetDeviceCompensation:
+								{
+									ipc::Reply resp(ipc::ReplyType::GenericReply);
+									resp.messageId = message.msg.dm_SetDeviceCompensation.messageId;
+									uint32_t deviceId = message.msg.dm_SetDeviceCompensation.OpenVRId;
+									auto serverDriver = ServerDriver::getInstance();
+
+									if (deviceId >= vr::k_unMaxTrackedDeviceCount)
+									{
+										resp.status = ipc::ReplyStatus::InvalidId;
+									}
+									else if (!serverDriver)
+									{
+										resp.status = ipc::ReplyStatus::UnknownError;
+									}
+									else
+									{
+										DeviceManipulationHandle* device = driver->getDeviceManipulationHandleById(deviceId);
+										MotionCompensationManager& mc = serverDriver->motionCompensation();
+
+										if (!device)
+										{
+											LOG(ERROR) << "DeviceManipulation_SetDeviceCompensation: device not found";
+											resp.status = ipc::ReplyStatus::NotFound;
+										}
+										else if (device->getDeviceMode() == MotionCompensationDeviceMode::ReferenceTracker
+											|| (message.msg.dm_SetDeviceCompensation.compensated && mc.getMotionCompensationMode() == MotionCompensationMode::Disabled))
+										{
+											resp.status = ipc::ReplyStatus::InvalidOperation;
+										}
+										else
+										{
+											device->setOffset(message.msg.dm_SetDeviceCompensation.offset);
+
+											if (message.msg.dm_SetDeviceCompensation.compensated)
+											{
+												LOG(INFO) << "Adding device " << deviceId << " to the motion compensated devices";
+												device->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::MotionCompensated);
+												mc.addMotionCompensatedDevice(deviceId);
+											}
+											else if (device->getDeviceMode() == MotionCompensationDeviceMode::MotionCompensated)
+											{
+												LOG(INFO) << "Removing device " << deviceId << " from the motion compensated devices";
+												device->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::Default);
+												mc.removeMotionCompensatedDevice(deviceId);
+											}
+											resp.status = ipc::ReplyStatus::Ok;
+										}
+									}
+
+									if (resp.status != ipc::ReplyStatus::Ok)
+									{
+										LOG(ERROR) << "Error while setting device compensation: Error code " << (int)resp.status << ", device " << deviceId;
+									}
+
+									if (resp.messageId != 0)
+									{
+										_this->sendReply(message.msg.dm_SetDeviceCompensation.clientId, resp);
+									}
+								}
+								break;
+
+								case ipc::RequestType::DeviceManipulation_SetReferenceTrackers:
+								{
+									ipc::Reply resp(ipc::ReplyType::GenericReply);
+									resp.messageId = message.msg.dm_SetReferenceTrackers.messageId;
+									uint32_t count = message.msg.dm_SetReferenceTrackers.count;
+									auto serverDriver = ServerDriver::getInstance();
+									std::vector<uint32_t> ids;
+									resp.status = ipc::ReplyStatus::Ok;
+
+									if (count < 1 || count > MaxReferenceTrackers)
+									{
+										resp.status = ipc::ReplyStatus::InvalidId;
+									}
+									else if (!serverDriver)
+									{
+										resp.status = ipc::ReplyStatus::UnknownError;
+									}
+									else if (serverDriver->motionCompensation().getMotionCompensationMode() != MotionCompensationMode::ReferenceTracker)
+									{
+										resp.status = ipc::ReplyStatus::InvalidOperation;
+									}
+									else
+									{
+										for (uint32_t i = 0; i < count && resp.status == ipc::ReplyStatus::Ok; i++)
+										{
+											uint32_t id = message.msg.dm_SetReferenceTrackers.RTdeviceIds[i];
+											if (id >= vr::k_unMaxTrackedDeviceCount || std::find(ids.begin(), ids.end(), id) != ids.end())
+											{
+												resp.status = ipc::ReplyStatus::InvalidId;
+											}
+											else if (!driver->getDeviceManipulationHandleById(id))
+											{
+												LOG(ERROR) << "DeviceManipulation_SetReferenceTrackers: device " << id << " not found";
+												resp.status = ipc::ReplyStatus::NotFound;
+											}
+											ids.push_back(id);
+										}
+									}
+
+									if (resp.status == ipc::ReplyStatus::Ok)
+									{
+										MotionCompensationManager& mc = serverDriver->motionCompensation();
+										LOG(INFO) << "Fusing " << count << " reference trackers";
+
+										// Trackers that are no longer used go back to default
+										for (uint32_t id : mc.getRTdeviceIDs())
+										{
+											DeviceManipulationHandle* device = driver->getDeviceManipulationHandleById(id);
+											if (device && std::find(ids.begin(), ids.end(), id) == ids.end())
+											{
+												device->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::Default);
+											}
+										}
+
+										// A reference tracker cannot stay compensated
+										for (uint32_t id : ids)
+										{
+											mc.removeMotionCompensatedDevice(id);
+											driver->getDeviceManipulationHandleById(id)->setMotionCompensationDeviceMode(MotionCompensationDeviceMode::ReferenceTracker);
+										}
+										mc.setReferenceTrackers(ids, message.msg.dm_SetReferenceTrackers.weights);
+									}
+									else
+									{
+										LOG(ERROR) << "Error while setting the reference trackers: Error code " << (int)resp.status;
+									}
+
+									if (resp.messageId != 0)
+									{
+										_this->sendReply(message.msg.dm_SetReferenceTrackers.clientId, resp);
+									}
+								}
+								break;
+
 								case ipc::RequestType::DeviceManipulation_SetMotionCompensationProperties:
 								{
 									ipc::Reply resp(ipc::ReplyType::GenericReply);
 									resp.messageId = message.msg.dm_SetMotionCompensationProperties.messageId;
 									auto serverDriver = ServerDriver::getInstance();
-									if (serverDriver)
+									if (serverDriver && message.msg.dm_SetMotionCompensationProperties.filterType != MotionCompensationFilterType::Default
+										&& message.msg.dm_SetMotionCompensationProperties.filterType != MotionCompensationFilterType::Kalman
+										&& message.msg.dm_SetMotionCompensationProperties.filterType != MotionCompensationFilterType::OneEuro)
+									{
+										resp.status = ipc::ReplyStatus::InvalidType;
+									}
+									else if (serverDriver && (!(message.msg.dm_SetMotionCompensationProperties.kalmanProcessNoise > 0.0 && std::isfinite(message.msg.dm_SetMotionCompensationProperties.kalmanProcessNoise))
+										|| !(message.msg.dm_SetMotionCompensationProperties.kalmanObservationNoise > 0.0 && std::isfinite(message.msg.dm_SetMotionCompensationProperties.kalmanObservationNoise))
+										|| !(message.msg.dm_SetMotionCompensationProperties.kalmanPredictionMs >= 0.0 && message.msg.dm_SetMotionCompensationProperties.kalmanPredictionMs <= 1000.0)
+										|| !(message.msg.dm_SetMotionCompensationProperties.oneEuroMinCutoff > 0.0 && std::isfinite(message.msg.dm_SetMotionCompensationProperties.oneEuroMinCutoff))
+										|| !(message.msg.dm_SetMotionCompensationProperties.oneEuroBeta >= 0.0 && std::isfinite(message.msg.dm_SetMotionCompensationProperties.oneEuroBeta))))
+									{
+										// Same limits as for the settings block, a noise of 0 would divide by zero in the Kalman filter
+										// and a cutoff of 0 or less would freeze the One Euro filter or make it diverge
+										resp.status = ipc::ReplyStatus::InvalidValue;
+									}
+									else if (serverDriver)
 									{
 										LOG(INFO) << "Setting driver motion compensation properties:";
 										LOG(INFO) << "LPF_Beta: " << message.msg.dm_SetMotionCompensationProperties.LPFBeta;
 										LOG(INFO) << "samples: " << message.msg.dm_SetMotionCompensationProperties.samples;
 										LOG(INFO) << "set Zero: " << message.msg.dm_SetMotionCompensationProperties.setZero;
+										LOG(INFO) << "filter type: " << (int)message.msg.dm_SetMotionCompensationProperties.filterType;
+										LOG(INFO) << "Kalman process noise: " << message.msg.dm_SetMotionCompensationProperties.kalmanProcessNoise;
+										LOG(INFO) << "Kalman observation noise: " << message.msg.dm_SetMotionCompensationProperties.kalmanObservationNoise;
+										LOG(INFO) << "Kalman prediction (ms): " << message.msg.dm_SetMotionCompensationProperties.kalmanPredictionMs;
+										LOG(INFO) << "One Euro min cutoff: " << message.msg.dm_SetMotionCompensationProperties.oneEuroMinCutoff;
+										LOG(INFO) << "One Euro beta: " << message.msg.dm_SetMotionCompensationProperties.oneEuroBeta;
 										LOG(INFO) << "End of property listing";
 
-										serverDriver->motionCompensation().setLpfBeta(message.msg.dm_SetMotionCompensationProperties.LPFBeta);
-										serverDriver->motionCompensation().setAlpha(message.msg.dm_SetMotionCompensationProperties.samples);
-										serverDriver->motionCompensation().setZeroMode(message.msg.dm_SetMotionCompensationProperties.setZero);
+										// Some setters restart the filter, only what changed is set
+										MotionCompensationSettings_v1 settings = {};
+										settings.Fields = SettingsField_LpfBeta | SettingsField_Samples | SettingsField_SetZero | SettingsField_Filter;
+										settings.LpfBeta = message.msg.dm_SetMotionCompensationProperties.LPFBeta;
+										settings.Samples = message.msg.dm_SetMotionCompensationProperties.samples;
+										settings.SetZero = message.msg.dm_SetMotionCompensationProperties.setZero ? 1 : 0;
+										settings.FilterType = message.msg.dm_SetMotionCompensationProperties.filterType;
+										settings.KalmanProcessNoise = message.msg.dm_SetMotionCompensationProperties.kalmanProcessNoise;
+										settings.KalmanObservationNoise = message.msg.dm_SetMotionCompensationProperties.kalmanObservationNoise;
+										settings.KalmanPredictionMs = message.msg.dm_SetMotionCompensationProperties.kalmanPredictionMs;
+										settings.OneEuroMinCutoff = message.msg.dm_SetMotionCompensationProperties.oneEuroMinCutoff;
+										settings.OneEuroBeta = message.msg.dm_SetMotionCompensationProperties.oneEuroBeta;
+										serverDriver->motionCompensation().applySettings(settings);
 
 										resp.status = ipc::ReplyStatus::Ok;
 									}
@@ -340,6 +551,67 @@ namespace vrmotioncompensation
 								}
 								break;
 
+								case ipc::RequestType::DeviceManipulation_SetZeroPoseCalibration:
+								{
+									ipc::Reply resp(ipc::ReplyType::GenericReply);
+									resp.messageId = message.msg.dm_SetZeroPoseCalibration.messageId;
+									const ZeroPoseCalibrationSettings& settings = message.msg.dm_SetZeroPoseCalibration.settings;
+									auto serverDriver = ServerDriver::getInstance();
+
+									if (settings.Samples < 1 || settings.Samples > core::ZeroPoseCalibration::MaxSamples
+										|| !(settings.MaxPositionDeviation >= 0.0) || !(settings.MaxRotationDeviation >= 0.0))
+									{
+										resp.status = ipc::ReplyStatus::InvalidValue;
+									}
+									else if (serverDriver)
+									{
+										LOG(INFO) << "Zero pose calibration: " << settings.Samples << " samples, max deviation "
+											<< settings.MaxPositionDeviation * 1000.0 << " mm, " << settings.MaxRotationDeviation << " rad";
+
+										serverDriver->motionCompensation().setZeroPoseCalibration(settings);
+
+										resp.status = ipc::ReplyStatus::Ok;
+									}
+									else
+									{
+										resp.status = ipc::ReplyStatus::UnknownError;
+									}
+
+									if (resp.status != ipc::ReplyStatus::Ok)
+									{
+										LOG(ERROR) << "Error while setting the zero pose calibration: Error code " << (int)resp.status;
+									}
+
+									if (resp.messageId != 0)
+									{
+										_this->sendReply(message.msg.dm_SetZeroPoseCalibration.clientId, resp);
+									}
+								}
+								break;
+
+								case ipc::RequestType::DeviceManipulation_GetZeroPoseCalibration:
+								{
+									ipc::Reply resp(ipc::ReplyType::GenericReply);
+									resp.messageId = message.msg.ovr_GenericClientMessage.messageId;
+									auto serverDriver = ServerDriver::getInstance();
+
+									if (serverDriver)
+									{
+										resp.msg.dm_zeroPoseCalibration.status = serverDriver->motionCompensation().getZeroPoseCalibrationStatus();
+										resp.status = ipc::ReplyStatus::Ok;
+									}
+									else
+									{
+										resp.status = ipc::ReplyStatus::UnknownError;
+									}
+
+									if (resp.messageId != 0)
+									{
+										_this->sendReply(message.msg.ovr_GenericClientMessage.clientId, resp);
+									}
+								}
+								break;
+
 								case ipc::RequestType::DeviceManipulation_SetOffsets:
 								{
 									ipc::Reply resp(ipc::ReplyType::GenericReply);
@@ -377,23 +649,26 @@ namespace vrmotioncompensation
 									{
 										if (message.msg.dl_Settings.enabled)
 										{
-											/*if (!serverDriver->motionCompensation().StartDebugData())
+											if (serverDriver->motionCompensation().getMotionCompensationMode() == MotionCompensationMode::Disabled)
 											{
 												LOG(INFO) << "Could not start debug logger: Motion Compensation must be enabled";
 												resp.status = ipc::ReplyStatus::InvalidId;
 											}
+											else if (!serverDriver->motionCompensation().startDebugData(message.msg.dl_Settings.MaxDebugPoints))
+											{
+												resp.status = ipc::ReplyStatus::UnknownError;
+											}
 											else
 											{
 												LOG(INFO) << "Debug logger enabled";
 												LOG(INFO) << "Max debug data points = " << message.msg.dl_Settings.MaxDebugPoints;
 												resp.status = ipc::ReplyStatus::Ok;
-											}	*/
-											resp.status = ipc::ReplyStatus::Ok;
+											}
 										}
 										else
 										{
+											serverDriver->motionCompensation().stopDebugData();
 											LOG(INFO) << "Debug logger disabled";
-											//serverDriver->motionCompensation().StopDebugData();
 											resp.status = ipc::ReplyStatus::Ok;
 										}
 									}
@@ -414,11 +689,206 @@ namespace vrmotioncompensation
 								}
 								break;
 
+								case ipc::RequestType::FlightRecorder_Settings:
+								{
+									ipc::Reply resp(ipc::ReplyType::GenericReply);
+									resp.messageId = message.msg.fr_Settings.messageId;
+									auto serverDriver = ServerDriver::getInstance();
+
+									if (serverDriver)
+									{
+										resp.status = serverDriver->motionCompensation().setFlightRecorder(message.msg.fr_Settings.settings) ? ipc::ReplyStatus::Ok : ipc::ReplyStatus::InvalidValue;
+									}
+									else
+									{
+										resp.status = ipc::ReplyStatus::UnknownError;
+									}
+
+									if (resp.status != ipc::ReplyStatus::Ok)
+									{
+										LOG(ERROR) << "Error while setting the flight recorder: Error code " << (int)resp.status;
+									}
+
+									if (resp.messageId != 0)
+									{
+										_this->sendReply(message.msg.fr_Settings.clientId, resp);
+									}
+								}
+								break;
+
+								case ipc::RequestType::FlightRecorder_Dump:
+								{
+									ipc::Reply resp(ipc::ReplyType::GenericReply);
+									resp.messageId = message.msg.ovr_GenericClientMessage.messageId;
+									auto serverDriver = ServerDriver::getInstance();
+
+									if (!serverDriver)
+									{
+										resp.status = ipc::ReplyStatus::UnknownError;
+									}
+									else if (!serverDriver->motionCompensation().getFlightRecorder().Enabled)
+									{
+										resp.status = ipc::ReplyStatus::InvalidOperation;
+									}
+									else if (!serverDriver->motionCompensation().dumpFlightRecorder())
+									{
+										resp.status = ipc::ReplyStatus::AlreadyInUse;
+									}
+									else
+									{
+										LOG(INFO) << "Flight recorder dump requested";
+										resp.status = ipc::ReplyStatus::Ok;
+									}
+
+									if (resp.status != ipc::ReplyStatus::Ok)
+									{
+										LOG(ERROR) << "Error while dumping the flight recorder: Error code " << (int)resp.status;
+									}
+
+									if (resp.messageId != 0)
+									{
+										_this->sendReply(message.msg.ovr_GenericClientMessage.clientId, resp);
+									}
+								}
+								break;
+
+								case ipc::RequestType::DeviceManipulation_GetLatencyStatistics:
+								{
+									ipc::Reply resp(ipc::ReplyType::GenericReply);
+									resp.messageId = message.msg.dm_GetLatencyStatistics.messageId;
+
+#ifdef VRMC_NO_LATENCY_HISTOGRAMS
+									resp.status = ipc::ReplyStatus::InvalidOperation;
+#else
+									if (message.msg.dm_GetLatencyStatistics.OpenVRId >= vr::k_unMaxTrackedDeviceCount)
+									{
+										resp.status = ipc::ReplyStatus::InvalidId;
+									}
+									else
+									{
+										DeviceManipulationHandle* info = driver->getDeviceManipulationHandleById(message.msg.dm_GetLatencyStatistics.OpenVRId);
+										if (!info || !info->isValid())
+										{
+											resp.status = ipc::ReplyStatus::NotFound;
+										}
+										else
+										{
+											resp.msg.dm_latencyStatistics.statistics = info->getLatencyStatistics(message.msg.dm_GetLatencyStatistics.reset);
+											resp.status = ipc::ReplyStatus::Ok;
+										}
+									}
+#endif
+
+									if (resp.status != ipc::ReplyStatus::Ok && resp.status != ipc::ReplyStatus::NotFound)
+									{
+										LOG(ERROR) << "Error while getting latency statistics: Error code " << (int)resp.status;
+									}
+
+									if (resp.messageId != 0)
+									{
+										_this->sendReply(message.msg.dm_GetLatencyStatistics.clientId, resp);
+									}
+								}
+								break;
+
+								case ipc::RequestType::DeviceManipulation_GetPoseStatistics:
+								{
+									ipc::Reply resp(ipc::ReplyType::GenericReply);
+									resp.messageId = message.msg.dm_GetPoseStatistics.messageId;
+
+									if (message.msg.dm_GetPoseStatistics.OpenVRId >= vr::k_unMaxTrackedDeviceCount)
+									{
+										resp.status = ipc::ReplyStatus::InvalidId;
+									}
+									else
+									{
+										DeviceManipulationHandle* info = driver->getDeviceManipulationHandleById(message.msg.dm_GetPoseStatistics.OpenVRId);
+										if (!info)
+										{
+											resp.status = ipc::ReplyStatus::NotFound;
+										}
+										else
+										{
+											resp.msg.dm_poseStatistics.statistics = info->getPoseStatistics(message.msg.dm_GetPoseStatistics.reset);
+											resp.status = ipc::ReplyStatus::Ok;
+										}
+									}
+
+									if (resp.status != ipc::ReplyStatus::Ok && resp.status != ipc::ReplyStatus::NotFound)
+									{
+										LOG(ERROR) << "Error while getting pose statistics: Error code " << (int)resp.status;
+									}
+
+									if (resp.messageId != 0)
+									{
+										_this->sendReply(message.msg.dm_GetPoseStatistics.clientId, resp);
+									}
+								}
+								break;
+
+								case ipc::RequestType::DeviceManipulation_GetAllDeviceInfo:
+								{
+									ipc::Reply resp(ipc::ReplyType::GenericReply);
+									resp.messageId = message.msg.dm_GetAllDeviceInfo.messageId;
+									driver->getAllDeviceInfo(resp.msg.dm_allDeviceInfo.devices, message.msg.dm_GetAllDeviceInfo.knownGeneration);
+									resp.status = ipc::ReplyStatus::Ok;
+
+									if (resp.messageId != 0)
+									{
+										_this->sendReply(message.msg.dm_GetAllDeviceInfo.clientId, resp);
+									}
+								}
+								break;
+
+								case ipc::RequestType::IPC_SubscribeEvents:
+								{
+									ipc::Reply resp(ipc::ReplyType::GenericReply);
+									resp.messageId = message.msg.ipc_SubscribeEvents.messageId;
+									uint32_t clientId = message.msg.ipc_SubscribeEvents.clientId;
+
+									if (_this->_ipcEndpoints.find(clientId) == _this->_ipcEndpoints.end())
+									{
+										resp.status = ipc::ReplyStatus::InvalidId;
+										LOG(ERROR) << "Error while subscribing to events: unknown clientID " << clientId;
+									}
+									else if (message.msg.ipc_SubscribeEvents.eventMask & ~DeviceEventMask_All)
+									{
+										resp.status = ipc::ReplyStatus::InvalidValue;
+									}
+									else
+									{
+										if (message.msg.ipc_SubscribeEvents.eventMask != 0)
+										{
+											_this->_eventSubscriptions[clientId] = message.msg.ipc_SubscribeEvents.eventMask;
+										}
+										else
+										{
+											_this->_eventSubscriptions.erase(clientId);
+										}
+										_this->_eventSubscribers = (uint32_t)_this->_eventSubscriptions.size();
+										resp.status = ipc::ReplyStatus::Ok;
+										LOG(INFO) << "Client " << clientId << " subscribed to events 0x" << std::hex << message.msg.ipc_SubscribeEvents.eventMask << std::dec;
+									}
+
+									if (resp.messageId != 0)
+									{
+										_this->sendReply(clientId, resp);
+									}
+								}
+								break;
+
 								default:
 									LOG(ERROR) << "Error in ipc server receive loop: Unknown message type (" << (int)message.type << ")";
 									break;
 								}
 							}
+							else if (message.type == ipc::RequestType::IPC_ClientConnect
+								&& recv_size >= offsetof(ipc::Request, msg) + offsetof(ipc::Request_IPC_ClientConnect, transport))
+							{
+								// Requests of older protocol versions have a different size, their connect request starts the same
+								std::lock_guard<std::mutex> dispatchLock(_this->_dispatchMutex);
+								_this->clientConnect(message, recv_size);
+							}
 							else
 							{
 								LOG(ERROR) << "Error in ipc server receive loop: received size is wrong (" << recv_size << " != " << sizeof(ipc::Request) << ")";
@@ -430,14 +900,120 @@ namespace vrmotioncompensation
 						LOG(ERROR) << "Exception caught in ipc server receive loop: " << ex.what();
 					}
 				}
-				boost::interprocess::message_queue::remove(_this->_ipcQueueName.c_str());
 			}
 			catch (std::exception & ex)
 			{
-				LOG(ERROR) << "Exception caught in ipc server thread: " << ex.what();
+				LOG(ERROR) << "Exception caught in ipc server thread (transport " << (int)transportType << "): " << ex.what();
+			}
+			LOG(DEBUG) << "CServerDriver::_ipcThreadFunc: thread stopped (transport " << (int)transportType << ")";
+		}
+
+		void IpcShmCommunicator::_eventThreadFunc(IpcShmCommunicator* _this)
+		{
+			LOG(DEBUG) << "IpcShmCommunicator::_eventThreadFunc: thread started";
+			uint64_t dropped = 0;
+			while (!_this->_ipcThreadStopFlag)
+			{
+				// Wakes up as soon as an event is pushed, the timeout only bounds the shutdown
+				DeviceEvent event;
+				if (!_this->_events.pop(event, 50))
+				{
+					continue;
+				}
+
+				if (_this->_events.getDropped() != dropped)
+				{
+					LOG(WARNING) << "Device event queue was full, " << _this->_events.getDropped() - dropped << " events dropped";
+					dropped = _this->_events.getDropped();
+				}
+
+				// The endpoints are collected under the dispatch lock, a client whose endpoint stays full must not hold up the requests
+				std::vector<std::pair<uint32_t, std::shared_ptr<ipc::Transport>>> endpoints;
+				{
+					std::lock_guard<std::mutex> dispatchLock(_this->_dispatchMutex);
+					for (auto& subscription : _this->_eventSubscriptions)
+					{
+						auto i = _this->_ipcEndpoints.find(subscription.first);
+						if ((subscription.second & deviceEventBit(event.Type)) && i != _this->_ipcEndpoints.end())
+						{
+							endpoints.push_back(*i);
+						}
+					}
+				}
+
+				ipc::Reply reply(ipc::ReplyType::DeviceEvent);
+				reply.messageId = 0;
+				reply.status = ipc::ReplyStatus::Ok;
+				reply.msg.deviceEvent.event = event;
+				for (auto& endpoint : endpoints)
+				{
+					try
+					{
+						// Both transports take senders from several threads, so this neither waits for _sendMutex nor for a full
+						// endpoint. A client that does not keep up loses the event and finds the change with its next device info request
+						if (!endpoint.second->trySend(&reply, sizeof(ipc::Reply)))
+						{
+							LOG(WARNING) << "Endpoint of client " << endpoint.first << " is full, dropped a device event";
+						}
+					}
+					catch (std::exception& e)
+					{
+						LOG(ERROR) << "Could not push an event to client " << endpoint.first << ", unsubscribing it: " << e.what();
+						std::lock_guard<std::mutex> dispatchLock(_this->_dispatchMutex);
+						_this->_eventSubscriptions.erase(endpoint.first);
+						_this->_eventSubscribers = (uint32_t)_this->_eventSubscriptions.size();
+					}
+				}
+			}
+			LOG(DEBUG) << "IpcShmCommunicator::_eventThreadFunc: thread stopped";
+		}
+
+		void IpcShmCommunicator::clientConnect(const ipc::Request& message, uint32_t requestSize)
+		{
+			try
+			{
+				const ipc::Request_IPC_ClientConnect& connect = message.msg.ipc_ClientConnect;
+				std::string queueName(connect.queueName, strnlen(connect.queueName, sizeof(connect.queueName)));
+				bool current = requestSize == sizeof(ipc::Request) && connect.ipcProcotolVersion == IPC_PROTOCOL_VERSION;
+
+				// Clients of protocol versions before the transport field only know message queues
+				ipc::TransportType clientTransport = ipc::TransportType::MessageQueue;
+				if (requestSize == sizeof(ipc::Request) && connect.ipcProcotolVersion >= IPC_PROTOCOL_VERSION_TRANSPORT)
+				{
+					clientTransport = connect.transport;
+				}
+				std::shared_ptr<ipc::Transport> queue = ipc::openTransport(clientTransport, queueName);
+
+				ipc::Reply reply(ipc::ReplyType::IPC_ClientConnect);
+				reply.messageId = connect.messageId;
+				reply.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
+				if (current)
+				{
+					uint32_t clientId = _ipcClientIdNext++;
+					_ipcEndpoints.insert({ clientId, queue });
+					reply.msg.ipc_ClientConnect.clientId = clientId;
+					reply.status = ipc::ReplyStatus::Ok;
+					LOG(INFO) << "New client connected: endpoint \"" << queueName << "\", transport " << (int)clientTransport << ", cliendId " << clientId;
+					sendReply(clientId, reply);
+				}
+				else
+				{
+					reply.msg.ipc_ClientConnect.clientId = 0;
+					reply.status = ipc::ReplyStatus::InvalidVersion;
+					LOG(INFO) << "Client (endpoint \"" << queueName << "\") reports incompatible ipc version " << connect.ipcProcotolVersion;
+
+					// The client only takes replies of its own size. The header and the connect reply are laid out the same
+					// in every version, the rest is zero
+					std::vector<char> padded(std::max<size_t>(queue->getMessageSize(), offsetof(ipc::Reply, msg) + sizeof(ipc::Reply_IPC_ClientConnect)));
+					std::memcpy(padded.data(), &reply, std::min(padded.size(), sizeof(ipc::Reply)));
+					std::lock_guard<std::mutex> guard(_sendMutex);
+					queue->send(padded.data(), (uint32_t)padded.size());
+				}
+			}
+			catch (std::exception & e)
+			{
+				LOG(ERROR) << "Error during client connect: " << e.what();
 			}
-			_this->_ipcThreadRunning = false;
-			LOG(DEBUG) << "CServerDriver::_ipcThreadFunc: thread stopped";
 		}
 
 		void IpcShmCommunicator::sendReply(uint32_t clientId, const ipc::Reply& reply)
@@ -446,7 +1022,7 @@ namespace vrmotioncompensation
 			auto i = _ipcEndpoints.find(clientId);
 			if (i != _ipcEndpoints.end())
 			{
-				i->second->send(&reply, sizeof(ipc::Reply), 0);
+				i->second->send(&reply, sizeof(ipc::Reply));
 			}
 			else
 			{
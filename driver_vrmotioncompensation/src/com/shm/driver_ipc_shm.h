@@ -1,11 +1,12 @@
 #pragma once
 
+#include <atomic>
 #include <thread>
 #include <string>
 #include <map>
 #include <mutex>
 #include <memory>
-#include <boost/interprocess/ipc/message_queue.hpp>
+#include <DeviceEventQueue.h>
 
 
 // driver namespace
@@ -14,7 +15,10 @@ namespace vrmotioncompensation
 	// forward declarations
 	namespace ipc
 	{
+		struct Request;
 		struct Reply;
+		class Transport;
+		enum class TransportType : uint32_t;
 	}
 
 	namespace driver
@@ -28,19 +32,43 @@ namespace vrmotioncompensation
 			void init(ServerDriver* driver);
 			void shutdown();
 
+			bool hasEventSubscribers() const
+			{
+				return _eventSubscribers.load(std::memory_order_relaxed) != 0;
+			}
+
+			// Any thread, never blocks. The event thread sends it to the clients that subscribed to its type
+			void pushEvent(const DeviceEvent& event)
+			{
+				_events.push(event);
+			}
+
 		private:
-			static void _ipcThreadFunc(IpcShmCommunicator* _this, ServerDriver* driver);
+			// One thread per transport type receives the requests sent into it
+			static void _ipcThreadFunc(IpcShmCommunicator* _this, ServerDriver* driver, ipc::TransportType transportType);
+
+			// IPC_ClientConnect of any protocol version. requestSize tells requests of older versions apart, their size differs
+			void clientConnect(const ipc::Request& message, uint32_t requestSize);
 
 			void sendReply(uint32_t clientId, const ipc::Reply& reply);
 
+			static void _eventThreadFunc(IpcShmCommunicator* _this);
+
 			std::mutex _sendMutex;
+			std::mutex _dispatchMutex;	// Requests are handled one at a time, whichever transport they came through
 			ServerDriver* _driver = nullptr;
 			std::thread _ipcThread;
-			volatile bool _ipcThreadRunning = false;
+			std::thread _ipcRingThread;
 			volatile bool _ipcThreadStopFlag = false;
 			std::string _ipcQueueName = "driver_vrmotioncompensation.server_queue";
 			uint32_t _ipcClientIdNext = 1;
-			std::map<uint32_t, std::shared_ptr<boost::interprocess::message_queue>> _ipcEndpoints;
+			std::map<uint32_t, std::shared_ptr<ipc::Transport>> _ipcEndpoints;
+
+			// Event masks by clientId, guarded by _dispatchMutex like _ipcEndpoints
+			std::map<uint32_t, uint32_t> _eventSubscriptions;
+			std::atomic<uint32_t> _eventSubscribers = { 0 };
+			core::DeviceEventQueue _events;
+			std::thread _eventThread;
 
 			// This is not exactly multi-user safe, maybe I fix it in the future
 			uint32_t _setMotionCompensationClientId = 0;
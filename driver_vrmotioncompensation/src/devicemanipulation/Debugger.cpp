@@ -1,8 +1,10 @@
 #include "Debugger.h"
 #include "../logging.h"
 
-#include <iostream>
-#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <limits>
 
 namespace vrmotioncompensation
 {
@@ -18,198 +20,138 @@ namespace vrmotioncompensation
 
 		}
 
-		void Debugger::Start()
+		// The data point a thread is filling. Channels it does not fill stay NaN
+		struct DebugPoint
 		{
-			std::lock_guard<std::recursive_mutex> lockGuard(_mut);
+			double Values[MAX_DEBUG_POINT_DOUBLES];
 
-			DebugCounter = 0;
-			WroteToFile = false;
-			DebuggerRunning = true;
-			DebugTimer.start();
-			LOG(DEBUG) << "Logger started";
-		}
-
-		void Debugger::Stop()
-		{
-			std::lock_guard<std::recursive_mutex> lockGuard(_mut);
+			DebugPoint()
+			{
+				clear();
+			}
 
-			DebuggerRunning = false;
+			void clear()
+			{
+				std::fill(std::begin(Values), std::end(Values), std::numeric_limits<double>::quiet_NaN());
+			}
+		};
 
-			LOG(DEBUG) << "Logger stopped";
-		}
+		static thread_local DebugPoint ThreadDebugPoint;
 
-		bool Debugger::IsRunning()
+		bool Debugger::Start(uint32_t maxDebugPoints)
 		{
-			return DebuggerRunning;
-		}
+			if (DebugRecorder.isRunning())
+			{
+				return true;
+			}
+			// A capture that filled up is closed before the next one starts
+			DebugRecorder.stop();
 
-		void Debugger::CountUp()
-		{
-			std::lock_guard<std::recursive_mutex> lockGuard(_mut);
+			uint32_t maxPoints = maxDebugPoints == 0 ? MAX_DEBUG_ENTRIES : std::min<uint32_t>(maxDebugPoints, MAX_DEBUG_ENTRIES_LIMIT);
 
-			if (DebuggerRunning)
+			//Only the named channels go into the data points, quaternions first like in the capture file
+			std::vector<core::CaptureChannel> channels;
+			uint32_t doubles = 1;
+			for (int i = 0; i < MAX_DEBUG_QUATERNIONS; i++)
 			{
-				DebugTiming[DebugCounter] = DebugTimer.seconds();
-
-				if (DebugCounter >= MAX_DEBUG_ENTRIES - 1)
+				DebugDataQ4[i].Offset = DebugDataQ4[i].InUse ? (int)doubles : -1;
+				if (DebugDataQ4[i].InUse)
 				{
-					DebuggerRunning = false;
+					channels.push_back({ DebugDataQ4[i].Name, core::CaptureChannelType::Quaternion });
+					doubles += 4;
 				}
-				else
+			}
+			for (int i = 0; i < MAX_DEBUG_VECTORS; i++)
+			{
+				DebugDataV3[i].Offset = DebugDataV3[i].InUse ? (int)doubles : -1;
+				if (DebugDataV3[i].InUse)
 				{
-					DebugCounter++;
-					Ref = Hmd = false;
+					channels.push_back({ DebugDataV3[i].Name, core::CaptureChannelType::Vector3 });
+					doubles += 3;
 				}
 			}
-		}
-
-		void Debugger::AddDebugData(vr::HmdVector3d_t Data, int ID)
-		{
-			std::lock_guard<std::recursive_mutex> lockGuard(_mut);
 
-			if (DebuggerRunning)
+			DebugTimer.start();
+			int64_t startTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			if (!DebugRecorder.start("MotionData.vrmccap", channels, startTimeUs, maxPoints))
 			{
-				DebugDataV3[ID].Data[DebugCounter] = Data;
-			}			
+				LOG(ERROR) << "Could not start a capture of " << maxPoints << " debug data points into MotionData.vrmccap";
+				return false;
+			}
+
+			LOG(DEBUG) << "Logger started for " << maxPoints << " data points of " << channels.size() << " channels";
+			return true;
 		}
 
-		void Debugger::AddDebugData(vr::HmdQuaternion_t Data, int ID)
+		void Debugger::Stop()
 		{
-			std::lock_guard<std::recursive_mutex> lockGuard(_mut);
+			uint64_t dropped = DebugRecorder.getDropped();
+			DebugRecorder.stop();
 
-			if (DebuggerRunning)
-			{
-				DebugDataQ4[ID].Data[DebugCounter] = Data;
-			}			
+			LOG(DEBUG) << "Logger stopped, " << DebugRecorder.getRecordCount() << " data points written, " << dropped << " dropped";
 		}
 
-		void Debugger::AddDebugData(const double Data[3], int ID)
+		bool Debugger::IsRunning()
 		{
-			std::lock_guard<std::recursive_mutex> lockGuard(_mut);
-
-			if (DebuggerRunning)
-			{
-				DebugDataV3[ID].Data[DebugCounter].v[0] = Data[0];
-				DebugDataV3[ID].Data[DebugCounter].v[1] = Data[1];
-				DebugDataV3[ID].Data[DebugCounter].v[2] = Data[2];
-			}
+			return DebugRecorder.isRunning();
 		}
 
-		void Debugger::gotRef()
+		void Debugger::CountUp()
 		{
-			Ref = true;
+			DebugPoint& point = ThreadDebugPoint;
+			if (DebugRecorder.isRunning())
+			{
+				point.Values[0] = DebugTimer.seconds();
+				DebugRecorder.record(point.Values);
+			}
+			point.clear();
 		}
 
-		void Debugger::gotHmd()
+		void Debugger::AddDebugData(vr::HmdVector3d_t Data, int ID)
 		{
-			Hmd = true;
+			AddDebugData(Data.v, ID);
 		}
 
-		bool Debugger::hasRef()
+		void Debugger::AddDebugData(vr::HmdQuaternion_t Data, int ID)
 		{
-			return Ref;
+			int offset = DebugDataQ4[ID].Offset.load(std::memory_order_relaxed);
+			if (offset >= 0 && DebugRecorder.isRunning())
+			{
+				double* point = &ThreadDebugPoint.Values[offset];
+				point[0] = Data.w;
+				point[1] = Data.x;
+				point[2] = Data.y;
+				point[3] = Data.z;
+			}
 		}
 
-		bool Debugger::hasHmd()
+		void Debugger::AddDebugData(const double Data[3], int ID)
 		{
-			return Hmd;
+			int offset = DebugDataV3[ID].Offset.load(std::memory_order_relaxed);
+			if (offset >= 0 && DebugRecorder.isRunning())
+			{
+				double* point = &ThreadDebugPoint.Values[offset];
+				point[0] = Data[0];
+				point[1] = Data[1];
+				point[2] = Data[2];
+			}
 		}
 
-
 		void Debugger::SetDebugNameQ4(std::string Name, int ID)
 		{
-			std::lock_guard<std::recursive_mutex> lockGuard(_mut);
-
-			DebugDataQ4[ID].Name = Name;
-			DebugDataQ4[ID].InUse = true;
+			if (!DebugRecorder.isRunning())
+			{
+				DebugDataQ4[ID].Name = Name;
+				DebugDataQ4[ID].InUse = true;
+			}
 		}
 
 		void Debugger::SetDebugNameV3(std::string Name, int ID)
 		{
-			std::lock_guard<std::recursive_mutex> lockGuard(_mut);
-
-			DebugDataV3[ID].Name = Name;
-			DebugDataV3[ID].InUse = true;
-		}
-
-		void Debugger::WriteFile()
-		{
-			std::lock_guard<std::recursive_mutex> lockGuard(_mut);
-
-			if (!WroteToFile && DebugCounter > 0)
+			if (!DebugRecorder.isRunning())
 			{
-				LOG(DEBUG) << "Trying to write debug file...";
-
-				std::ofstream DebugFile;
-				DebugFile.open("MotionData.txt");
-
-				if (!DebugFile.bad())
-				{
-					unsigned int index = 1;
-
-					LOG(DEBUG) << "Writing " << DebugCounter << " debug points of data";
-
-					//Write title
-					DebugFile << "Time;";
-
-					//Quaternions
-					for (int i = 0; i < MAX_DEBUG_QUATERNIONS; i++)
-					{
-						if (DebugDataQ4[i].InUse)
-						{
-							DebugFile << DebugDataQ4[i].Name << "[" << index << ":4];";
-							index += 4;
-						}
-					}
-
-					//Vectors
-					for (int i = 0; i < MAX_DEBUG_VECTORS; i++)
-					{
-						if (DebugDataV3[i].InUse)
-						{
-							DebugFile << DebugDataV3[i].Name << "[" << index << ":3];";
-							index += 3;
-						}
-					}
-					DebugFile << std::endl;
-
-					//Write data
-					for (int i = 0; i < DebugCounter; i++)
-					{
-						DebugFile << DebugTiming[i] << ";";
-				
-						for (int j = 0; j < MAX_DEBUG_QUATERNIONS; j++)
-						{
-							if (DebugDataQ4[j].InUse)
-							{
-								DebugFile << DebugDataQ4[j].Data[i].w << ";";
-								DebugFile << DebugDataQ4[j].Data[i].x << ";";
-								DebugFile << DebugDataQ4[j].Data[i].y << ";";
-								DebugFile << DebugDataQ4[j].Data[i].z << ";";
-							}
-						}
-				
-						for (int j = 0; j < MAX_DEBUG_VECTORS; j++)
-						{
-							if (DebugDataV3[j].InUse)
-							{
-								DebugFile << DebugDataV3[j].Data[i].v[0] << ";";
-								DebugFile << DebugDataV3[j].Data[i].v[1] << ";";
-								DebugFile << DebugDataV3[j].Data[i].v[2] << ";";
-							}
-						}
-
-						DebugFile << std::endl;
-					}
-
-					DebugFile.close();
-
-					WroteToFile = true;
-				}
-				else
-				{
-					LOG(ERROR) << "Could not write debug log";
-				}
+				DebugDataV3[ID].Name = Name;
+				DebugDataV3[ID].InUse = true;
 			}
 		}
 	}
@@ -1,14 +1,22 @@
 #pragma once
 
 #include <openvr_driver.h>
+#include <CaptureRecorder.h>
 
 #include <boost/timer/timer.hpp>
 #include <boost/chrono/chrono.hpp>
 #include <boost/chrono/system_clocks.hpp>
 
-#define MAX_DEBUG_ENTRIES 50000
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define MAX_DEBUG_ENTRIES 50000			// Data points of a capture if the client does not ask for a number
+#define MAX_DEBUG_ENTRIES_LIMIT 500000
 #define MAX_DEBUG_VECTORS 24
 #define MAX_DEBUG_QUATERNIONS 8
+#define MAX_DEBUG_POINT_DOUBLES (1 + MAX_DEBUG_QUATERNIONS * 4 + MAX_DEBUG_VECTORS * 3)
 
 namespace vrmotioncompensation
 {
@@ -23,16 +31,7 @@ namespace vrmotioncompensation
 			{
 				std::string Name = "";
 				bool InUse = false;
-			};
-
-			struct DebugDataV3 : DebugData 
-			{
-				vr::HmdVector3d_t Data[MAX_DEBUG_ENTRIES];
-			};
-
-			struct DebugDataQ4 : DebugData
-			{
-				vr::HmdQuaternion_t Data[MAX_DEBUG_ENTRIES];
+				std::atomic<int> Offset = { -1 };	// First double of the channel in a data point, -1 if the running capture has no room for it
 			};
 
 			template< class Clock > class timer
@@ -60,12 +59,18 @@ namespace vrmotioncompensation
 			Debugger();
 			~Debugger();
 
-			void Start();
+			// Starts a capture of the channels named so far into MotionData.vrmccap, see CaptureFile.h for the format.
+			// Ends by itself after maxDebugPoints data points, 0 for MAX_DEBUG_ENTRIES.
+			// vrmotioncompensation_capture_csv converts the file for spreadsheets
+			bool Start(uint32_t maxDebugPoints = 0);
 
+			// Writes the data points still in flight and closes the file. Not from a thread that adds data
 			void Stop();
 
 			bool IsRunning();
 
+			// Ends the data point the calling thread filled with AddDebugData. Lock-free, the data point goes into the ring
+			// of the thread and the capture thread writes it. Channels the thread did not fill are NaN in this data point
 			void CountUp();
 
 			void AddDebugData(vr::HmdVector3d_t Data, int ID);
@@ -74,30 +79,18 @@ namespace vrmotioncompensation
 
 			void AddDebugData(const double Data[3], int ID);
 
+			// Only while no capture is running
 			void SetDebugNameV3(std::string Name, int ID);
 			void SetDebugNameQ4(std::string Name, int ID);
 
-			void WriteFile();
-
-			void gotRef();
-			void gotHmd();
-			bool hasRef();
-			bool hasHmd();
-
 		private:
-			int DebugCounter = 0;
-			DebugDataV3 DebugDataV3[MAX_DEBUG_VECTORS];
-			DebugDataQ4 DebugDataQ4[MAX_DEBUG_QUATERNIONS];
+			DebugData DebugDataV3[MAX_DEBUG_VECTORS];
+			DebugData DebugDataQ4[MAX_DEBUG_QUATERNIONS];
 
-			timer<boost::chrono::high_resolution_clock> DebugTimer;
-			double DebugTiming[MAX_DEBUG_ENTRIES];
-
-			bool DebuggerRunning = false;
-			bool Ref = false;
-			bool Hmd = false;
-			bool WroteToFile = false;
+			// Per-thread rings and the thread that writes them into the file
+			core::CaptureRecorder DebugRecorder;
 
-			std::recursive_mutex _mut;
+			timer<boost::chrono::high_resolution_clock> DebugTimer;
 		};
 	}
 }
\ No newline at end of file
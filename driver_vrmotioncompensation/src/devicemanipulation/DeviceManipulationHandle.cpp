@@ -17,8 +17,10 @@ namespace vrmotioncompensation
 	namespace driver
 	{
 		DeviceManipulationHandle::DeviceManipulationHandle(const char* serial, vr::ETrackedDeviceClass eDeviceClass)
-			: m_isValid(true), m_parent(ServerDriver::getInstance()), m_motionCompensationManager(m_parent->motionCompensation()), m_eDeviceClass(eDeviceClass), m_serialNumber(serial)
+			: m_isValid(true), m_parent(ServerDriver::getInstance()), m_motionCompensationManager(m_parent->motionCompensation()), m_eDeviceClass(eDeviceClass), m_serialNumber(serial),
+			m_serialHash(hashSerialNumber(serial))
 		{
+			m_offset.store({ { { 0, 0, 0 }, { 1, 0, 0, 0 } }, false });
 		}
 
 		void DeviceManipulationHandle::setValid(bool isValid)
@@ -28,39 +30,89 @@ namespace vrmotioncompensation
 
 		bool DeviceManipulationHandle::handlePoseUpdate(uint32_t& unWhichDevice, vr::DriverPose_t& newPose, uint32_t unPoseStructSize)
 		{
+			VRMC_LATENCY_SCOPE(latency(LatencyStage::HandlePoseUpdate));
+			m_poseStatistics.record(newPose, core::LatencyHistogram::nowNs());
+
+			// Clients that poll the device infos only see a new generation when the status changes, not with every pose
+			uint32_t status = (newPose.deviceIsConnected ? DeviceStatus_Connected : 0) | (newPose.poseIsValid ? DeviceStatus_PoseValid : 0)
+				| (newPose.result == vr::TrackingResult_Running_OK ? DeviceStatus_RunningOk : 0);
+			if (status != m_status.load(std::memory_order_relaxed))
+			{
+				m_status.store(status, std::memory_order_relaxed);
+				m_parent->deviceEvent(DeviceEventType::StatusChanged, m_openvrId, this);
+			}
 
 			if (m_deviceMode == MotionCompensationDeviceMode::ReferenceTracker)
-			{ 
+			{
+				//Poses that are not valid are passed on as well, so a fused reference tracker that lost tracking is left out
+				VRMC_LATENCY_START(referenceNs);
+				m_motionCompensationManager.updateReferenceTracker(m_openvrId, newPose);
+				VRMC_LATENCY_RECORD(referenceNs, latency(LatencyStage::UpdateReference));
+			}
+			else if (m_deviceMode == MotionCompensationDeviceMode::MotionCompensated)
+			{
 				//Check if the pose is valid to prevent unwanted jitter and movement
 				if (newPose.poseIsValid && newPose.result == vr::TrackingResult_Running_OK)
 				{
-					//Set the Zero-Point for the reference tracker if not done yet
-					if (!m_motionCompensationManager.isZeroPoseValid())
-					{						
-						m_motionCompensationManager.setZeroPose(newPose);
+					VRMC_LATENCY_START(compensationNs);
+					OffsetState offset = m_offset.load();
+					if (offset.HasOffset)
+					{
+						m_motionCompensationManager.applyMotionCompensation(m_openvrId, newPose, offset.Offset);
 					}
 					else
 					{
-						//Update reference tracker position
-						m_motionCompensationManager.updateRefPose(newPose);
+						m_motionCompensationManager.applyMotionCompensation(m_openvrId, newPose);
 					}
+					VRMC_LATENCY_RECORD(compensationNs, latency(LatencyStage::ApplyCompensation));
 				}
 			}
-			else if (m_deviceMode == MotionCompensationDeviceMode::MotionCompensated)
+
+			return true;
+		}
+
+		DeviceLatencyStatistics DeviceManipulationHandle::getLatencyStatistics(bool reset)
+		{
+			DeviceLatencyStatistics statistics;
+			for (uint32_t stage = 0; stage < LatencyStageCount; stage++)
 			{
-				//Check if the pose is valid to prevent unwanted jitter and movement
-				if (newPose.poseIsValid && newPose.result == vr::TrackingResult_Running_OK)
+				statistics.Stages[stage] = m_latency[stage].getStatistics();
+				if (reset)
 				{
-					m_motionCompensationManager.applyMotionCompensation(newPose);
+					m_latency[stage].reset();
 				}
 			}
+			return statistics;
+		}
 
-			return true;
+		PoseStatistics_v1 DeviceManipulationHandle::getPoseStatistics(bool reset)
+		{
+			PoseStatistics_v1 statistics = m_poseStatistics.getStatistics();
+			statistics.OpenVRId = m_openvrId;
+			if (reset)
+			{
+				m_poseStatistics.reset();
+			}
+			return statistics;
 		}
 
 		void DeviceManipulationHandle::setMotionCompensationDeviceMode(MotionCompensationDeviceMode DeviceMode)
 		{
-			m_deviceMode = DeviceMode;
+			if (m_deviceMode != DeviceMode)
+			{
+				m_deviceMode = DeviceMode;
+				m_parent->deviceEvent(DeviceEventType::ModeChanged, m_openvrId, this);
+			}
+		}
+
+		void DeviceManipulationHandle::setOffset(const MotionCompensationDeviceOffset& offset)
+		{
+			// Offset and flag are published together, the pose thread never sees one without the other
+			OffsetState state;
+			state.Offset = offset;
+			state.HasOffset = offset.Translation.v[0] != 0.0 || offset.Translation.v[1] != 0.0 || offset.Translation.v[2] != 0.0
+				|| offset.Rotation.w != 1.0 || offset.Rotation.x != 0.0 || offset.Rotation.y != 0.0 || offset.Rotation.z != 0.0;
+			m_offset.store(state);
 		}
 	} // end namespace driver
 } // end namespace vrmotioncompensation
\ No newline at end of file
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <atomic>
 #include <openvr_driver.h>
 #include <vrmotioncompensation_types.h>
+#include <LatencyHistogram.h>
+#include <PoseStatistics.h>
+#include <SeqLock.h>
 #include "../hooks/common.h"
 
 
@@ -26,11 +30,31 @@ namespace vrmotioncompensation
 			vr::ETrackedDeviceClass m_eDeviceClass = vr::TrackedDeviceClass_Invalid;
 			uint32_t m_openvrId = vr::k_unTrackedDeviceIndexInvalid;
 			std::string m_serialNumber;
+			uint64_t m_serialHash;
 
 			std::shared_ptr<InterfaceHooks> m_serverDriverHooks;
 
 			MotionCompensationDeviceMode m_deviceMode = MotionCompensationDeviceMode::Default;
 
+			// Offset applied after compensation, skipped while it is the identity
+			struct OffsetState
+			{
+				MotionCompensationDeviceOffset Offset;
+				bool HasOffset;
+			};
+
+			// Written by the ipc thread, read by the pose thread as a whole
+			core::SeqLock<OffsetState> m_offset;
+
+			// Latency of the stages of this device's pose updates, indexed by LatencyStage
+			core::LatencyHistogram m_latency[LatencyStageCount];
+
+			// Rate, jitter and tracking state of the poses the device reports
+			core::PoseStatisticsCounter m_poseStatistics;
+
+			// DeviceStatus_ bits of the last pose, written by the pose thread only
+			std::atomic<uint32_t> m_status = { 0 };
+
 		public:
 			DeviceManipulationHandle(const char* serial, vr::ETrackedDeviceClass eDeviceClass);
 
@@ -61,6 +85,16 @@ namespace vrmotioncompensation
 				return m_serialNumber;
 			}
 
+			uint64_t serialHash() const
+			{
+				return m_serialHash;
+			}
+
+			uint32_t getStatus() const
+			{
+				return m_status.load(std::memory_order_relaxed);
+			}
+
 			void setServerDriverHooks(std::shared_ptr<InterfaceHooks> hooks)
 			{
 				m_serverDriverHooks = hooks;
@@ -73,8 +107,26 @@ namespace vrmotioncompensation
 
 			void setMotionCompensationDeviceMode(MotionCompensationDeviceMode DeviceMode);
 
+			MotionCompensationDeviceOffset getOffset() const
+			{
+				return m_offset.load().Offset;
+			}
+
+			void setOffset(const MotionCompensationDeviceOffset& offset);
+
 			bool handlePoseUpdate(uint32_t& unWhichDevice, vr::DriverPose_t& newPose, uint32_t unPoseStructSize);
 
+			core::LatencyHistogram& latency(LatencyStage stage)
+			{
+				return m_latency[(uint32_t)stage];
+			}
+
+			// Percentiles of every stage, optionally starting over afterwards
+			DeviceLatencyStatistics getLatencyStatistics(bool reset);
+
+			// Statistics of the poses since the driver started or the last reset
+			PoseStatistics_v1 getPoseStatistics(bool reset);
+
 			//vr::HmdVector3d_t ToEulerAngles(vr::HmdQuaternion_t q);
 		};
 	} // end namespace driver
@@ -3,18 +3,56 @@
 #include "DeviceManipulationHandle.h"
 #include "../driver/ServerDriver.h"
 
+#include <algorithm>
 #include <cmath>
-#include <boost/math/constants/constants.hpp>
 #include <boost/interprocess/shared_memory_object.hpp>
-#include <chrono>
 
 // driver namespace
 namespace vrmotioncompensation
 {
 	namespace driver
 	{
+		static_assert(sizeof(MMFstruct_OVRMC_v1) <= RigPoseBlockOffset && RigPoseBlockOffset + sizeof(MMFstruct_OVRMC_RigPose_v1) <= SettingsBlockOffset
+			&& SettingsBlockOffset + sizeof(MMFstruct_OVRMC_Settings_v1) <= 4096, "The offset, rig pose and settings blocks have to fit into OVRMC_MMFv1 without overlapping");
+
+		// Channels of the debug capture
+		enum DebugChannel
+		{
+			DebugReference = 0,
+			DebugDevice = 1,
+			DebugDeviceCompensated = 2,
+		};
+
+		// Position and rotation of a pose in the app space
+		static void appPose(const vr::DriverPose_t& pose, vr::HmdVector3d_t& position, vr::HmdQuaternion_t& rotation)
+		{
+			position = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, pose.vecPosition) + pose.vecWorldFromDriverTranslation;
+			rotation = pose.qWorldFromDriverRotation * pose.qRotation;
+		}
+
 		MotionCompensationManager::MotionCompensationManager(ServerDriver* parent) : m_parent(parent)
 		{
+			_Debugger.SetDebugNameQ4("RefRotation", DebugReference);
+			_Debugger.SetDebugNameQ4("DeviceRotation", DebugDevice);
+			_Debugger.SetDebugNameQ4("DeviceRotationCompensated", DebugDeviceCompensated);
+			_Debugger.SetDebugNameV3("RefPosition", DebugReference);
+			_Debugger.SetDebugNameV3("DevicePosition", DebugDevice);
+			_Debugger.SetDebugNameV3("DevicePositionCompensated", DebugDeviceCompensated);
+
+			// Called from the dump thread of the recorder
+			_FlightRecorder.setDumpCallback([](FlightRecorderTrigger reason, const std::string& path, size_t entries)
+			{
+				if (path.empty())
+				{
+					LOG(ERROR) << "Could not write the flight recorder dump of trigger " << (uint32_t)reason;
+				}
+				else
+				{
+					LOG(INFO) << "Flight recorder dumped " << entries << " poses to " << path;
+				}
+			});
+			_Core.setFlightRecorder(&_FlightRecorder);
+
 			try
 			{
 				// create shared memory
@@ -24,457 +62,401 @@ namespace vrmotioncompensation
 				// get pointer address and fill it with data
 				_Poffset = static_cast<MMFstruct_OVRMC_v1*>(_region.get_address());
 				*_Poffset = _Offset;
+
+				// The rig pose and settings blocks are left as they are, the rig software may have started first
+				_RigPose = reinterpret_cast<MMFstruct_OVRMC_RigPose_v1*>(static_cast<char*>(_region.get_address()) + RigPoseBlockOffset);
+				_Settings = reinterpret_cast<MMFstruct_OVRMC_Settings_v1*>(static_cast<char*>(_region.get_address()) + SettingsBlockOffset);
 				LOG(INFO) << "Shared memory OVRMC_MMFv1 created";
 			}
 			catch (boost::interprocess::interprocess_exception& e)
 			{
 				LOG(ERROR) << "Could not create or open shared memory. Error code " << e.get_error_code();
 			}
+
+			try
+			{
+				// Created once with its final size, so publishing a pose never allocates
+				_telemetryShm = { boost::interprocess::open_or_create, TelemetrySharedMemoryName, boost::interprocess::read_write, sizeof(MMFstruct_OVRMC_Telemetry_v1) };
+				_telemetryRegion = { _telemetryShm, boost::interprocess::read_write };
+
+				MMFstruct_OVRMC_Telemetry_v1* ring = static_cast<MMFstruct_OVRMC_Telemetry_v1*>(_telemetryRegion.get_address());
+				core::TelemetryWriter::init(*ring);
+				_Core.setTelemetry(ring);
+				LOG(INFO) << "Shared memory " << TelemetrySharedMemoryName << " created";
+			}
+			catch (boost::interprocess::interprocess_exception& e)
+			{
+				LOG(ERROR) << "Could not create the telemetry shared memory. Error code " << e.get_error_code();
+			}
 		}
 
 		bool MotionCompensationManager::setMotionCompensationMode(MotionCompensationMode Mode, int McDevice, int RtDevice)
 		{
-			if (Mode == MotionCompensationMode::ReferenceTracker)
-			{
-				_RefPoseValid = false;
-				_RefPoseValidCounter = 0;
-				_ZeroPoseValid = false;
-				_Enabled = true;
+			_Core.setEnabled(Mode != MotionCompensationMode::Disabled);
 
-				setAlpha(_Samples);
-			}
-			else
+			// The rig pose is what the rig software commands, it does not need smoothing
+			_Core.setFilterBypass(Mode == MotionCompensationMode::RigPose);
 			{
-				_Enabled = false;
+				std::lock_guard<core::Spinlock> lock(_RigPoseLock);
+				_RigPoseReader.reset();
 			}
 
-			_McDeviceID = McDevice;
-			_RtDeviceID = RtDevice;
+			_McDevices.releaseAll([this](uint32_t id)
+			{
+				return m_parent->getDeviceManipulationHandleById(id);
+			});
+			if (Mode != MotionCompensationMode::Disabled && McDevice >= 0)
+			{
+				_McDevices.add((uint32_t)McDevice);
+			}
+			_ReferenceTrackers.setTracker(RtDevice);
 			_Mode = Mode;
 
+			if (Mode == MotionCompensationMode::Disabled && _Debugger.IsRunning())
+			{
+				stopDebugData();
+			}
+
 			return true;
 		}
 
-		void MotionCompensationManager::setNewMotionCompensatedDevice(int MCdevice)
+		void MotionCompensationManager::addMotionCompensatedDevice(uint32_t McDevice)
 		{
-			_McDeviceID = MCdevice;
+			_McDevices.add(McDevice);
 		}
 
-		void MotionCompensationManager::setNewReferenceTracker(int RTdevice)
+		void MotionCompensationManager::removeMotionCompensatedDevice(uint32_t McDevice)
 		{
-			_RtDeviceID = RTdevice;
-			_RefPoseValid = false;
-			_ZeroPoseValid = false;
+			_McDevices.remove(McDevice);
 		}
 
-		void MotionCompensationManager::setAlpha(uint32_t samples)
+		bool MotionCompensationManager::isMotionCompensatedDevice(uint32_t McDevice) const
 		{
-			_Samples = samples;
-			_Alpha = 2.0 / (1.0 + (double)samples);
+			return _McDevices.contains(McDevice);
 		}
 
-		void MotionCompensationManager::setZeroMode(bool setZero)
+		void MotionCompensationManager::setNewReferenceTracker(int RTdevice)
 		{
-			_SetZeroMode = setZero;
-
-			_zeroVec(_RefVel);
-			_zeroVec(_RefRotVel);
-			_zeroVec(_RefAcc);
-			_zeroVec(_RefRotAcc);
+			_ReferenceTrackers.setTracker(RTdevice);
+			_Core.resetRefPose();
 		}
 
-		void MotionCompensationManager::setOffsets(MMFstruct_OVRMC_v1 offsets)
+		void MotionCompensationManager::setReferenceTrackers(const std::vector<uint32_t>& RtDevices, const double* weights)
 		{
-			//_Offset.Translation = offsets.Translation;
-			//_Offset.Rotation = offsets.Rotation;
-			_Offset = offsets;
-			*_Poffset = _Offset;
+			_ReferenceTrackers.setTrackers(RtDevices, weights);
 		}
 
-		bool MotionCompensationManager::isZeroPoseValid()
+		bool MotionCompensationManager::isReferenceTracker(uint32_t RtDevice)
 		{
-			return _ZeroPoseValid;
+			return _ReferenceTrackers.isTracker(RtDevice);
 		}
 
 		void MotionCompensationManager::resetZeroPose()
 		{
-			_ZeroPoseValid = false;
+			{
+				// The current rig pose becomes the zero pose, also if the rig does not move
+				std::lock_guard<core::Spinlock> lock(_RigPoseLock);
+				_RigPoseReader.reset();
+			}
+			_ReferenceTrackers.resetZeroPose();
 		}
 
-		void MotionCompensationManager::setZeroPose(const vr::DriverPose_t& pose)
+		void MotionCompensationManager::setZeroPoseCalibration(const ZeroPoseCalibrationSettings& settings)
 		{
-			// convert pose from driver space to app space
-			vr::HmdQuaternion_t tmpConj = vrmath::quaternionConjugate(pose.qWorldFromDriverRotation);
+			_ReferenceTrackers.setZeroPoseCalibration(settings);
+		}
 
-			// Save zero points
-			_ZeroLock.lock();
-			_ZeroPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecPosition, false) + pose.vecWorldFromDriverTranslation;
-			_ZeroRot = pose.qWorldFromDriverRotation * pose.qRotation;
+		ZeroPoseCalibrationStatus MotionCompensationManager::getZeroPoseCalibrationStatus()
+		{
+			return _ReferenceTrackers.getZeroPoseCalibrationStatus();
+		}
 
-			_ZeroPoseValid = true;
-			_ZeroLock.unlock();
+		void MotionCompensationManager::setOffsets(MMFstruct_OVRMC_v1 offsets)
+		{
+			//_Offset.Translation = offsets.Translation;
+			//_Offset.Rotation = offsets.Rotation;
+			_Offset = offsets;
+			*_Poffset = _Offset;
 		}
 
 		void MotionCompensationManager::updateRefPose(const vr::DriverPose_t& pose)
 		{
-			// From https://github.com/ValveSoftware/driver_hydra/blob/master/drivers/driver_hydra/driver_hydra.cpp Line 835:
-			// "True acceleration is highly volatile, so it's not really reasonable to
-			// extrapolate much from it anyway.  Passing it as 0 from any driver should
-			// be fine."
-
-			// Line 832:
-			// "The trade-off here is that setting a valid velocity causes the controllers
-			// to jitter, but the controllers feel much more "alive" and lighter.
-			// The jitter while stationary is more annoying than the laggy feeling caused
-			// by disabling velocity (which effectively disables prediction for rendering)."
-			// That means that we have to calculate the velocity to not interfere with the prediction for rendering
-
-			// Oculus devices do use acceleration. It also seems that the HMD uses theses values for render-prediction
-
-			vr::HmdVector3d_t Filter_vecPosition = { 0, 0, 0 };
-			vr::HmdVector3d_t Filter_vecVelocity = { 0, 0, 0 };
-			vr::HmdVector3d_t Filter_vecAcceleration = { 0, 0, 0 };
-			vr::HmdVector3d_t Filter_vecAngularVelocity = { 0, 0, 0 };
-			vr::HmdVector3d_t Filter_vecAngularAcceleration = { 0, 0, 0 };
-			vr::HmdVector3d_t RotEulerFilter = { 0, 0, 0 };
-
-			vr::HmdQuaternion_t tmpConj = vrmath::quaternionConjugate(pose.qWorldFromDriverRotation);
-
-			// Get current time in microseconds and convert it to seconds
-			long long now = std::chrono::duration_cast <std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-			double tdiff = (double)(now - _RefTrackerLastTime) / 1.0E6 + (pose.poseTimeOffset - _RefTrackerLastPose.poseTimeOffset);
-
-			// Position
-			// Add a exponential median average filter
-			if (_Samples >= 2)
-			{
-				// ----------------------------------------------------------------------------------------------- //
-				// ----------------------------------------------------------------------------------------------- //
-				// Position
-				Filter_vecPosition.v[0] = DEMA(pose.vecPosition[0], 0);
-				Filter_vecPosition.v[1] = DEMA(pose.vecPosition[1], 1);
-				Filter_vecPosition.v[2] = DEMA(pose.vecPosition[2], 2);
-
-				// ----------------------------------------------------------------------------------------------- //
-				// ----------------------------------------------------------------------------------------------- //
-				// Velocity and acceleration
-				if (!_SetZeroMode)
-				{
-					Filter_vecVelocity.v[0] = vecVelocity(tdiff, Filter_vecPosition.v[0], _RefTrackerLastPose.vecPosition[0]);
-					Filter_vecVelocity.v[1] = vecVelocity(tdiff, Filter_vecPosition.v[1], _RefTrackerLastPose.vecPosition[1]);
-					Filter_vecVelocity.v[2] = vecVelocity(tdiff, Filter_vecPosition.v[2], _RefTrackerLastPose.vecPosition[2]);
+			captureReference(pose);
+			_Core.updateRefPose(pose, now());
+		}
 
-					Filter_vecAcceleration.v[0] = vecAcceleration(tdiff, Filter_vecVelocity.v[0], _RefTrackerLastPose.vecVelocity[0]);
-					Filter_vecAcceleration.v[1] = vecAcceleration(tdiff, Filter_vecVelocity.v[1], _RefTrackerLastPose.vecVelocity[1]);
-					Filter_vecAcceleration.v[2] = vecAcceleration(tdiff, Filter_vecVelocity.v[2], _RefTrackerLastPose.vecVelocity[2]);
-				}
-			}
-			else
+		void MotionCompensationManager::updateReferenceTracker(uint32_t RtDevice, const vr::DriverPose_t& pose)
+		{
+			pollSettings();
+			captureReference(pose);
+			bool tracking = pose.poseIsValid && pose.result == vr::TrackingResult_Running_OK;
+			_FlightRecorder.updateTracking(RtDevice, tracking, core::TelemetryWriter::nowNs());
+
+			// Each reference tracker reports from one thread, so only a change of its own bit has to be pushed
+			uint64_t bit = RtDevice < 64 ? 1ull << RtDevice : 0;
+			if (bit && ((_ReferenceTracking.load(std::memory_order_relaxed) & bit) != 0) != tracking)
 			{
-				_copyVec(Filter_vecPosition, pose.vecPosition);
-				_copyVec(Filter_vecVelocity, pose.vecVelocity);
+				if (tracking)
+				{
+					_ReferenceTracking.fetch_or(bit, std::memory_order_relaxed);
+				}
+				else
+				{
+					_ReferenceTracking.fetch_and(~bit, std::memory_order_relaxed);
+				}
+				m_parent->deviceEvent(tracking ? DeviceEventType::ReferenceTrackingRegained : DeviceEventType::ReferenceTrackingLost, RtDevice);
 			}
 
-			// convert pose from driver space to app space
-			_RefLock.lock();
-			_RefPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, Filter_vecPosition, false) + pose.vecWorldFromDriverTranslation;
-			_RefLock.unlock();
-
-			// ----------------------------------------------------------------------------------------------- //
-			// ----------------------------------------------------------------------------------------------- //
-			// Rotation
-			if (_LpfBeta <= 0.9999)
+			ZeroPoseCalibrationStatus status;
+			if (!_ReferenceTrackers.update(RtDevice, pose, now(), status))
 			{
-				// 1st stage
-				_Filter_rotPosition[0] = lowPassFilterQuaternion(pose.qRotation, _Filter_rotPosition[0]);
-
-				// 2nd stage
-				_Filter_rotPosition[1] = lowPassFilterQuaternion(_Filter_rotPosition[0], _Filter_rotPosition[1]);
-
-
-				vr::HmdVector3d_t RotEulerFilter = toEulerAngles(_Filter_rotPosition[1]);
-
-				if (!_SetZeroMode)
-				{
-					Filter_vecAngularVelocity.v[0] = rotVelocity(tdiff, RotEulerFilter.v[0], _RotEulerFilterOld.v[0]);
-					Filter_vecAngularVelocity.v[1] = rotVelocity(tdiff, RotEulerFilter.v[1], _RotEulerFilterOld.v[1]);
-					Filter_vecAngularVelocity.v[2] = rotVelocity(tdiff, RotEulerFilter.v[2], _RotEulerFilterOld.v[2]);
-
-					Filter_vecAngularAcceleration.v[0] = vecAcceleration(tdiff, Filter_vecAngularVelocity.v[0], _RefTrackerLastPose.vecAngularVelocity[0]);
-					Filter_vecAngularAcceleration.v[1] = vecAcceleration(tdiff, Filter_vecAngularVelocity.v[1], _RefTrackerLastPose.vecAngularVelocity[1]);
-					Filter_vecAngularAcceleration.v[2] = vecAcceleration(tdiff, Filter_vecAngularVelocity.v[2], _RefTrackerLastPose.vecAngularVelocity[2]);
-				}
+				return;
 			}
-			else
+			if (status.State == ZeroPoseCalibrationState::Done)
 			{
-				_Filter_rotPosition[1] = pose.qRotation;
-
-				_copyVec(Filter_vecAngularVelocity, pose.vecAngularVelocity);
-				_copyVec(Filter_vecAngularAcceleration, pose.vecAngularAcceleration);
+				m_parent->deviceEvent(DeviceEventType::ZeroPoseSet, RtDevice);
 			}
 
-			// calculate orientation difference and its inverse
-			vr::HmdQuaternion_t poseWorldRot = pose.qWorldFromDriverRotation * _Filter_rotPosition[1];
-			_RefLock.lock();
-			_ZeroLock.lock();
-			_RefRot = poseWorldRot * vrmath::quaternionConjugate(_ZeroRot);
-			_RefRotInv = vrmath::quaternionConjugate(_RefRot);
-			_ZeroLock.unlock();
-			_RefLock.unlock();
+			LOG(INFO) << "Zero pose calibration window " << status.Windows << (status.State == ZeroPoseCalibrationState::Done ? " accepted" : " rejected")
+				<< ": " << status.Inliers << "/" << status.WindowSize << " inliers, deviation " << status.PositionDeviation * 1000.0 << " mm, "
+				<< status.RotationDeviation * 180.0 / 3.14159265358979 << " deg";
+		}
 
-			if (!_SetZeroMode)
+		void MotionCompensationManager::pollSettings()
+		{
+			// One atomic load while nothing changed. The lock only keeps two reference threads from taking the same settings
+			if (_Settings == nullptr || !_SettingsReader.hasNewSettings(*_Settings))
 			{
-				// Convert velocity and acceleration values into app space
-				_RefVelLock.lock();
-				_RefVel = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, Filter_vecVelocity, false);
-				_RefRotVel = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, Filter_vecAngularVelocity, false);
-
-				_RefAcc = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, Filter_vecAcceleration, false);
-				_RefRotAcc = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, Filter_vecAngularAcceleration, false);
-				_RefVelLock.unlock();
+				return;
 			}
-
-			// ----------------------------------------------------------------------------------------------- //
-			// ----------------------------------------------------------------------------------------------- //
-			// Wait 100 frames before setting reference pose to valid
-			if (_RefPoseValidCounter > 100)
+			std::unique_lock<core::Spinlock> lock(_SettingsLock, std::try_to_lock);
+			if (!lock.owns_lock())
 			{
-				_RefPoseValid = true;
+				return;
 			}
-			else
+
+			MotionCompensationSettings_v1 settings;
+			uint32_t sequence;
+			if (_SettingsReader.poll(*_Settings, settings, sequence) != core::SettingsReader::Result::NewSettings)
 			{
-				_RefPoseValidCounter++;
+				return;
 			}
 
-			// Save last rotation and pose
-			_RotEulerFilterOld = RotEulerFilter;
-			_RefTrackerLastPose = pose;
-		}
+			SettingsStatus status = core::SettingsReader::validate(settings);
+			if (status == SettingsStatus::Applied)
+			{
+				applySettings(settings);
+			}
+			core::SettingsReader::acknowledge(*_Settings, sequence, status);
 
-		bool MotionCompensationManager::applyMotionCompensation(vr::DriverPose_t& pose)
-		{
-			if (_Enabled && _ZeroPoseValid && _RefPoseValid)
-			{
-				// All filter calculations are done within the function for the reference tracker, because the HMD position is updated 3x more often.
-				// Convert pose from driver space to app space
-				vr::HmdQuaternion_t tmpConj = vrmath::quaternionConjugate(pose.qWorldFromDriverRotation);
-				vr::HmdVector3d_t poseWorldPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecPosition, false) + pose.vecWorldFromDriverTranslation;
-
-				// Do motion compensation
-				vr::HmdQuaternion_t poseWorldRot = pose.qWorldFromDriverRotation * pose.qRotation;
-				_RefLock.lock();
-				_ZeroLock.lock();
-				vr::HmdVector3d_t compensatedPoseWorldPos = _ZeroPos + vrmath::quaternionRotateVector(_RefRot, _RefRotInv, poseWorldPos - _RefPos, true);
-				_ZeroLock.unlock();
-				vr::HmdQuaternion_t compensatedPoseWorldRot = _RefRotInv * poseWorldRot;
-				_RefLock.unlock();
-
-				// Translate the motion ref Velocity / Acceleration values into driver space and directly subtract them
-				if (_SetZeroMode)
+			// The block may be written a hundred times a second, only changes of the status are logged
+			if (status != _SettingsStatus)
+			{
+				if (status == SettingsStatus::Applied)
 				{
-					_zeroVec(pose.vecVelocity);
-					_zeroVec(pose.vecAcceleration);
-					_zeroVec(pose.vecAngularVelocity);
-					_zeroVec(pose.vecAngularAcceleration);
+					LOG(INFO) << "Taking settings from the settings block";
 				}
 				else
 				{
-					// Translate the motion ref Velocity / Acceleration values into driver space and directly subtract them
-					_RefVelLock.lock();
-					vr::HmdVector3d_t tmpPosVel = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, _RefVel, true);
-					pose.vecVelocity[0] -= tmpPosVel.v[0];
-					pose.vecVelocity[1] -= tmpPosVel.v[1];
-					pose.vecVelocity[2] -= tmpPosVel.v[2];
-
-					vr::HmdVector3d_t tmpRotVel = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, _RefRotVel, true);
-					pose.vecAngularVelocity[0] -= tmpRotVel.v[0];
-					pose.vecAngularVelocity[1] -= tmpRotVel.v[1];
-					pose.vecAngularVelocity[2] -= tmpRotVel.v[2];
-
-					vr::HmdVector3d_t tmpPosAcc = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, _RefAcc, true);
-					pose.vecAcceleration[0] -= tmpPosAcc.v[0];
-					pose.vecAcceleration[1] -= tmpPosAcc.v[1];
-					pose.vecAcceleration[2] -= tmpPosAcc.v[2];
-
-					vr::HmdVector3d_t tmpRotAcc = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, _RefRotAcc, true);
-					pose.vecAngularAcceleration[0] -= tmpRotAcc.v[0];
-					pose.vecAngularAcceleration[1] -= tmpRotAcc.v[1];
-					pose.vecAngularAcceleration[2] -= tmpRotAcc.v[2];
-					_RefVelLock.unlock();
+					LOG(ERROR) << "Settings block rejected: Error code " << (int)status;
 				}
-
-
-				// convert back to driver space
-				pose.qRotation = tmpConj * compensatedPoseWorldRot;
-				vr::HmdVector3d_t adjPoseDriverPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, compensatedPoseWorldPos - pose.vecWorldFromDriverTranslation, true);
-				_copyVec(pose.vecPosition, adjPoseDriverPos.v);
+				_SettingsStatus = status;
 			}
-			return true;
 		}
 
-		void MotionCompensationManager::runFrame()
+		void MotionCompensationManager::applySettings(const MotionCompensationSettings_v1& settings)
 		{
-			/*if (_Offset.Flags_1 & (1 << FLAG_ENABLE_MC) && _Mode == MotionCompensationMode::Disabled)
+			// Some setters restart parts of the filter, so nothing is set again with the value it already has
+			if ((settings.Fields & SettingsField_LpfBeta) && settings.LpfBeta != _Core.getLpfBeta())
 			{
-
+				_Core.setLpfBeta(settings.LpfBeta);
 			}
-			else if (!(_Offset.Flags_1 & (1 << FLAG_ENABLE_MC)) && _Mode == MotionCompensationMode::ReferenceTracker)
+			if ((settings.Fields & SettingsField_Samples) && settings.Samples != _Core.getSamples())
 			{
-				setMotionCompensationMode(MotionCompensationMode::ReferenceTracker, -1, -1);
-			}*/
+				_Core.setAlpha(settings.Samples);
+			}
+			if ((settings.Fields & SettingsField_SetZero) && (settings.SetZero != 0) != _Core.getZeroMode())
+			{
+				_Core.setZeroMode(settings.SetZero != 0);
+			}
+			if (settings.Fields & SettingsField_Filter)
+			{
+				if (settings.FilterType != _Core.getFilterType())
+				{
+					_Core.setFilterType(settings.FilterType);
+				}
+				if (settings.KalmanProcessNoise != _Core.getKalmanProcessNoise() || settings.KalmanObservationNoise != _Core.getKalmanObservationNoise())
+				{
+					_Core.setKalmanNoise(settings.KalmanProcessNoise, settings.KalmanObservationNoise);
+				}
+				long long predictionUs = (long long)(settings.KalmanPredictionMs * 1000.0);
+				if (predictionUs != _Core.getKalmanPrediction())
+				{
+					_Core.setKalmanPrediction(predictionUs);
+				}
+				if (settings.OneEuroMinCutoff != _Core.getOneEuroMinCutoff() || settings.OneEuroBeta != _Core.getOneEuroBeta())
+				{
+					_Core.setOneEuroParameters(settings.OneEuroMinCutoff, settings.OneEuroBeta);
+				}
+			}
+			if (settings.Fields & SettingsField_Offsets)
+			{
+				MMFstruct_OVRMC_v1 offsets = _Offset;
+				offsets.Translation = settings.OffsetTranslation;
+				offsets.Rotation = settings.OffsetRotation;
+				offsets.QRotation = settings.OffsetQRotation;
+				setOffsets(offsets);
+			}
 		}
 
-		double MotionCompensationManager::vecVelocity(double time, const double vecPosition, const double Old_vecPosition)
+		void MotionCompensationManager::pollRigPose(long long timestampUs)
 		{
-			double NewVelocity = 0.0;
+			pollSettings();
 
-			if (time != (double)0.0)
+			std::unique_lock<core::Spinlock> lock(_RigPoseLock, std::try_to_lock);
+			if (!lock.owns_lock() || _RigPose == nullptr)
 			{
-				NewVelocity = (vecPosition - Old_vecPosition) / time;
+				return;
 			}
 
-			return NewVelocity;
+			vr::DriverPose_t pose;
+			if (_RigPoseReader.poll(*_RigPose, timestampUs, pose) != core::RigPoseReader::Result::NewPose)
+			{
+				return;
+			}
+			captureReference(pose);
+
+			// The rig pose has no tracking noise, so it is taken as zero pose without a calibration window
+			if (!_Core.isZeroPoseValid())
+			{
+				_Core.setZeroPose(pose);
+				m_parent->deviceEvent(DeviceEventType::ZeroPoseSet, vr::k_unTrackedDeviceIndexInvalid);
+			}
+			else
+			{
+				_Core.updateRefPose(pose, timestampUs);
+			}
 		}
 
-		double MotionCompensationManager::vecAcceleration(double time, const double vecVelocity, const double Old_vecVelocity)
+		bool MotionCompensationManager::applyMotionCompensation(uint32_t McDevice, vr::DriverPose_t& pose)
 		{
-			double NewAcceleration = 0.0;
+			long long timestampUs = now();
+			if (_Mode == MotionCompensationMode::RigPose)
+			{
+				pollRigPose(timestampUs);
+			}
 
-			if (time != (double)0.0)
+			// Copied only while the debug logger runs
+			bool capture = _Debugger.IsRunning();
+			vr::DriverPose_t rawPose;
+			if (capture)
 			{
-				NewAcceleration = (vecVelocity - Old_vecVelocity) / time;
+				rawPose = pose;
 			}
 
-			return NewAcceleration;
+			// The reference is moved to the time this pose was sampled, the HMD updates about 3x more often than the tracker
+			bool compensated = _Core.applyMotionCompensation(pose, timestampUs, McDevice);
+			if (capture)
+			{
+				captureDevice(rawPose, pose);
+			}
+			return compensated;
 		}
 
-		double MotionCompensationManager::rotVelocity(double time, const double vecAngle, const double Old_vecAngle)
+		bool MotionCompensationManager::applyMotionCompensation(uint32_t McDevice, vr::DriverPose_t& pose, const MotionCompensationDeviceOffset& offset)
 		{
-			double NewVelocity = 0.0;
-
-			if (time != (double)0.0)
+			long long timestampUs = now();
+			if (_Mode == MotionCompensationMode::RigPose)
 			{
-				NewVelocity = (1 - angleDifference(vecAngle, Old_vecAngle)) / time;
+				pollRigPose(timestampUs);
 			}
 
-			return NewVelocity;
-		}
+			bool capture = _Debugger.IsRunning();
+			vr::DriverPose_t rawPose;
+			if (capture)
+			{
+				rawPose = pose;
+			}
 
-		// Low Pass Filter for 3d Vectors
-		double MotionCompensationManager::DEMA(const double RawData, int Axis)
-		{
-			_Filter_vecPosition[0].v[Axis] += _Alpha * (RawData - _Filter_vecPosition[1].v[Axis]);
-			_Filter_vecPosition[1].v[Axis] += _Alpha * (_Filter_vecPosition[0].v[Axis] - _Filter_vecPosition[1].v[Axis]);
-			return 2 * _Filter_vecPosition[0].v[Axis] - _Filter_vecPosition[1].v[Axis];
+			bool compensated = _Core.applyMotionCompensation(pose, timestampUs, offset, McDevice);
+			if (capture)
+			{
+				captureDevice(rawPose, pose);
+			}
+			return compensated;
 		}
 
-		// Low Pass Filter for 3d Vectors
-		vr::HmdVector3d_t MotionCompensationManager::LPF(const double RawData[3], vr::HmdVector3d_t SmoothData)
+		void MotionCompensationManager::runFrame()
 		{
-			vr::HmdVector3d_t RetVal;
+			// Without a reference there is no reference update path, the settings are still taken and acknowledged
+			if (_Mode == MotionCompensationMode::Disabled)
+			{
+				pollSettings();
+			}
 
-			RetVal.v[0] = SmoothData.v[0] - (_LpfBeta * (SmoothData.v[0] - RawData[0]));
-			RetVal.v[1] = SmoothData.v[1] - (_LpfBeta * (SmoothData.v[1] - RawData[1]));
-			RetVal.v[2] = SmoothData.v[2] - (_LpfBeta * (SmoothData.v[2] - RawData[2]));
+			/*if (_Offset.Flags_1 & (1 << FLAG_ENABLE_MC) && _Mode == MotionCompensationMode::Disabled)
+			{
 
-			return RetVal;
+			}
+			else if (!(_Offset.Flags_1 & (1 << FLAG_ENABLE_MC)) && _Mode == MotionCompensationMode::ReferenceTracker)
+			{
+				setMotionCompensationMode(MotionCompensationMode::ReferenceTracker, -1, -1);
+			}*/
 		}
 
-		// Low Pass Filter for 3d Vectors
-		vr::HmdVector3d_t MotionCompensationManager::LPF(vr::HmdVector3d_t RawData, vr::HmdVector3d_t SmoothData)
+		bool MotionCompensationManager::startDebugData(uint32_t maxDebugPoints)
 		{
-			vr::HmdVector3d_t RetVal;
-
-			RetVal.v[0] = SmoothData.v[0] - (_LpfBeta * (SmoothData.v[0] - RawData.v[0]));
-			RetVal.v[1] = SmoothData.v[1] - (_LpfBeta * (SmoothData.v[1] - RawData.v[1]));
-			RetVal.v[2] = SmoothData.v[2] - (_LpfBeta * (SmoothData.v[2] - RawData.v[2]));
-
-			return RetVal;
+			return _Debugger.Start(maxDebugPoints);
 		}
 
-		// Low Pass Filter for quaternion
-		vr::HmdQuaternion_t MotionCompensationManager::lowPassFilterQuaternion(vr::HmdQuaternion_t RawData, vr::HmdQuaternion_t SmoothData)
+		void MotionCompensationManager::stopDebugData()
 		{
-			return slerp(SmoothData, RawData, _LpfBeta);
+			_Debugger.Stop();
 		}
 
-		// Spherical Linear Interpolation for Quaternions
-		vr::HmdQuaternion_t MotionCompensationManager::slerp(vr::HmdQuaternion_t q1, vr::HmdQuaternion_t q2, double lambda)
+		bool MotionCompensationManager::setFlightRecorder(const FlightRecorderSettings& settings)
 		{
-			vr::HmdQuaternion_t qr;
-
-			double dotproduct = q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w;
-
-			// if q1 and q2 are the same, we can return either of the values
-			if (dotproduct >= 1.0 || dotproduct <= -1.0)
+			if (!_FlightRecorder.configure(settings))
 			{
-				return q1;
+				return false;
 			}
 
-			double theta, st, sut, sout, coeff1, coeff2;
-
-			// algorithm adapted from Shoemake's paper
-			lambda = lambda / 2.0;
-
-			theta = (double)acos(dotproduct);
-			if (theta < 0.0) theta = -theta;
-
-			st = (double)sin(theta);
-			sut = (double)sin(lambda * theta);
-			sout = (double)sin((1 - lambda) * theta);
-			coeff1 = sout / st;
-			coeff2 = sut / st;
-
-			qr.x = coeff1 * q1.x + coeff2 * q2.x;
-			qr.y = coeff1 * q1.y + coeff2 * q2.y;
-			qr.z = coeff1 * q1.z + coeff2 * q2.z;
-			qr.w = coeff1 * q1.w + coeff2 * q2.w;
-
-
-			//Normalize
-			double norm = sqrt(qr.x * qr.x + qr.y * qr.y + qr.z * qr.z + qr.w * qr.w);
-			qr.x /= norm;
-			qr.y /= norm;
-			qr.z /= norm;
-
-			return qr;
+			LOG(INFO) << "Flight recorder " << (settings.Enabled ? "enabled" : "disabled") << ", " << settings.Seconds << " s before and "
+				<< settings.PostTriggerMs << " ms after a trigger";
+			return true;
 		}
 
-		// Convert Quaternion to Euler Angles in Radians
-		vr::HmdVector3d_t MotionCompensationManager::toEulerAngles(vr::HmdQuaternion_t q)
+		bool MotionCompensationManager::dumpFlightRecorder()
 		{
-			vr::HmdVector3d_t angles;
-
-			// roll (x-axis rotation)
-			double sinr_cosp = 2 * (q.w * q.x + q.y * q.z);
-			double cosr_cosp = 1 - 2 * (q.x * q.x + q.y * q.y);
-			angles.v[0] = std::atan2(sinr_cosp, cosr_cosp);
-
-			// pitch (y-axis rotation)
-			double sinp = 2 * (q.w * q.y - q.z * q.x);
+			return _FlightRecorder.trigger(FlightRecorderTrigger::Request, core::TelemetryWriter::nowNs());
+		}
 
-			if (std::abs(sinp) >= 1)
-			{
-				angles.v[1] = std::copysign(boost::math::constants::pi<double>() / 2, sinp); // use 90 degrees if out of range
-			}
-			else
+		void MotionCompensationManager::captureReference(const vr::DriverPose_t& pose)
+		{
+			if (!_Debugger.IsRunning())
 			{
-				angles.v[1] = std::asin(sinp);
+				return;
 			}
 
-			// yaw (z-axis rotation)
-			double siny_cosp = 2 * (q.w * q.z + q.x * q.y);
-			double cosy_cosp = 1 - 2 * (q.y * q.y + q.z * q.z);
-			angles.v[2] = std::atan2(siny_cosp, cosy_cosp);
-
-			return angles;
+			vr::HmdVector3d_t position;
+			vr::HmdQuaternion_t rotation;
+			appPose(pose, position, rotation);
+			_Debugger.AddDebugData(rotation, DebugReference);
+			_Debugger.AddDebugData(position, DebugReference);
+			_Debugger.CountUp();
 		}
 
-		// Returns the shortest difference between to angles
-		const double MotionCompensationManager::angleDifference(double Raw, double New)
+		void MotionCompensationManager::captureDevice(const vr::DriverPose_t& rawPose, const vr::DriverPose_t& pose)
 		{
-			double diff = fmod((New - Raw + (double)180), (double)360) - (double)180;
-			return diff < -(double)180 ? diff + (double)360 : diff;
+			vr::HmdVector3d_t position;
+			vr::HmdQuaternion_t rotation;
+			appPose(rawPose, position, rotation);
+			_Debugger.AddDebugData(rotation, DebugDevice);
+			_Debugger.AddDebugData(position, DebugDevice);
+			appPose(pose, position, rotation);
+			_Debugger.AddDebugData(rotation, DebugDeviceCompensated);
+			_Debugger.AddDebugData(position, DebugDeviceCompensated);
+			_Debugger.CountUp();
 		}
 
 		vr::HmdVector3d_t MotionCompensationManager::transform(vr::HmdVector3d_t VecRotation, vr::HmdVector3d_t VecPosition, vr::HmdVector3d_t point)
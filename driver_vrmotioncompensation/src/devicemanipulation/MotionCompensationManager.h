@@ -5,6 +5,16 @@
 #include <openvr_math.h>
 #include "../logging.h"
 #include "Debugger.h"
+#include <CompensatedDevices.h>
+#include <MotionCompensationCore.h>
+#include <ReferenceTrackers.h>
+#include <RigPoseChannel.h>
+#include <SettingsChannel.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
 
 #include <boost/timer/timer.hpp>
 #include <boost/chrono/chrono.hpp>
@@ -21,141 +31,162 @@ namespace vrmotioncompensation
 		class ServerDriver;
 		class DeviceManipulationHandle;
 
-		class Spinlock
+		class MotionCompensationManager
 		{
-			// Source: https://rigtorp.se/spinlock/
-			std::atomic<bool> lock_ = { 0 };
-		
 		public:
-			void lock() noexcept
+			MotionCompensationManager(ServerDriver* parent);
+
+			// Returns every device of the old set to default with its offset cleared, then starts the new set with MCdevice.
+			// The caller sets the modes of MCdevice and RTdevice afterwards
+			bool setMotionCompensationMode(MotionCompensationMode Mode, int MCdevice, int RTdevice);
+
+			// The set of motion compensated devices. The devices themselves keep their mode and offset
+			void addMotionCompensatedDevice(uint32_t McDevice);
+
+			void removeMotionCompensatedDevice(uint32_t McDevice);
+
+			bool isMotionCompensatedDevice(uint32_t McDevice) const;
+
+			void setNewReferenceTracker(int RtDevice);
+
+			// Several reference trackers on the same rig, fused into one reference pose. The first one is the main reference tracker.
+			// weights may be nullptr for equal weights
+			void setReferenceTrackers(const std::vector<uint32_t>& RtDevices, const double* weights);
+
+			bool isReferenceTracker(uint32_t RtDevice);
+
+			MotionCompensationMode getMotionCompensationMode()
 			{
-				for (;;)
-				{
-					// Optimistically assume the lock is free on the first try
-					if (!lock_.exchange(true, std::memory_order_acquire))
-					{
-						return;
-					}
-					// Wait for lock to be released without generating cache misses
-					while (lock_.load(std::memory_order_relaxed))
-					{
-						// Issue X86 PAUSE or ARM YIELD instruction to reduce contention between
-						// hyper-threads
-						YieldProcessor();
-					}
-				}
+				return _Mode;
 			}
 
-			bool try_lock() noexcept
+			void setAlpha(uint32_t samples)
 			{
-				// First do a relaxed load to check if lock is free in order to prevent
-				// unnecessary cache misses if someone does while(!try_lock())
-				return !lock_.load(std::memory_order_relaxed) &&
-					!lock_.exchange(true, std::memory_order_acquire);
+				_Core.setAlpha(samples);
 			}
 
-			void unlock() noexcept
+			void setLpfBeta(double NewBeta)
 			{
-				lock_.store(false, std::memory_order_release);
+				_Core.setLpfBeta(NewBeta);
 			}
-		};
-
-		/*class Spinlock
-		{
-			std::atomic_flag _Flag = ATOMIC_FLAG_INIT;
-
-		public:
 
-			void lock() noexcept
+			double getLPFBeta()
 			{
-				while (_Flag.test_and_set(std::memory_order_acquire))
-				{
-					// pause insn
-					YieldProcessor();
-				}
+				return _Core.getLpfBeta();
 			}
 
-			void unlock() noexcept
+			const std::vector<uint32_t>& getMCdeviceIDs() const
 			{
-				_Flag.clear(std::memory_order_release);
+				return _McDevices.devices();
 			}
-			
-		};*/
-
-		class MotionCompensationManager
-		{
-		public:
-			MotionCompensationManager(ServerDriver* parent);
-
-			bool setMotionCompensationMode(MotionCompensationMode Mode, int MCdevice, int RTdevice);
-
-			void setNewMotionCompensatedDevice(int McDevice);
 
-			void setNewReferenceTracker(int RtDevice);
-
-			MotionCompensationMode getMotionCompensationMode()
+			int getRTdeviceID()
 			{
-				return _Mode;
+				return _ReferenceTrackers.getTracker();
 			}
 
-			void setAlpha(uint32_t samples);
+			std::vector<uint32_t> getRTdeviceIDs()
+			{
+				return _ReferenceTrackers.getTrackers();
+			}
 
-			void setLpfBeta(double NewBeta)
+			void setZeroMode(bool setZero)
 			{
-				_LpfBeta = NewBeta;
+				_Core.setZeroMode(setZero);
 			}
 
-			double getLPFBeta()
+			void setFilterType(MotionCompensationFilterType type)
 			{
-				return _LpfBeta;
+				_Core.setFilterType(type);
 			}
 
-			int getMCdeviceID()
+			void setKalmanNoise(double processNoise, double observationNoise)
 			{
-				return _McDeviceID;
+				_Core.setKalmanNoise(processNoise, observationNoise);
 			}
 
-			int getRTdeviceID()
+			void setKalmanPrediction(double ms)
 			{
-				return _RtDeviceID;
+				_Core.setKalmanPrediction((long long)(ms * 1000.0));
 			}
 
-			void setZeroMode(bool setZero);
+			void setOneEuroParameters(double minCutoff, double beta)
+			{
+				_Core.setOneEuroParameters(minCutoff, beta);
+			}
 
 			void setOffsets(MMFstruct_OVRMC_v1 offsets);
 
-			bool isZeroPoseValid();
+			bool isZeroPoseValid()
+			{
+				return _Core.isZeroPoseValid();
+			}
 			
 			void resetZeroPose();
 
-			void setZeroPose(const vr::DriverPose_t& pose);
+			// Window and accepted deviations of the zero pose calibration of the reference tracker. Restarts a calibration
+			// that is still collecting, a zero pose that is already set stays
+			void setZeroPoseCalibration(const ZeroPoseCalibrationSettings& settings);
+
+			ZeroPoseCalibrationStatus getZeroPoseCalibrationStatus();
+
+			void setZeroPose(const vr::DriverPose_t& pose)
+			{
+				_Core.setZeroPose(pose);
+			}
 			
 			void updateRefPose(const vr::DriverPose_t& pose);
+
+			// New pose of one of the reference trackers, also the poses that are not Running_OK.
+			// Calibrates the zero pose if it is not valid yet, otherwise updates the reference pose
+			void updateReferenceTracker(uint32_t RtDevice, const vr::DriverPose_t& pose);
 			
-			bool applyMotionCompensation(vr::DriverPose_t& pose);
+			// In MotionCompensationMode::RigPose both also pick up a new rig pose from shared memory first.
+			// The device id tags the pose in the telemetry ring
+			bool applyMotionCompensation(uint32_t McDevice, vr::DriverPose_t& pose);
+
+			bool applyMotionCompensation(uint32_t McDevice, vr::DriverPose_t& pose, const MotionCompensationDeviceOffset& offset);
 
 			void runFrame();
 
-		private:			
-			double vecVelocity(double time, const double vecPosition, const double Old_vecPosition);
+			// Captures the raw reference poses and the raw and compensated device poses into MotionData.vrmccap,
+			// maxDebugPoints data points at most, 0 for the default. The pose threads only copy into a ring of their own
+			bool startDebugData(uint32_t maxDebugPoints);
 
-			double vecAcceleration(double time, const double vecVelocity, const double Old_vecVelocity);
+			void stopDebugData();
 
-			double rotVelocity(double time, const double vecAngle, const double Old_vecAngle);
+			// Returns false for settings out of range
+			bool setFlightRecorder(const FlightRecorderSettings& settings);
 
-			double DEMA(const double RawData, int Axis);
+			FlightRecorderSettings getFlightRecorder()
+			{
+				return _FlightRecorder.getSettings();
+			}
+
+			// Dumps the poses around now. Returns false if the flight recorder is off or still writing a dump
+			bool dumpFlightRecorder();
 
-			vr::HmdVector3d_t LPF(const double RawData[3], vr::HmdVector3d_t SmoothData);
+			// The fields of settings that are set, only those that differ from the current values. From the settings block
+			// and the ipc request, the values have to be validated before
+			void applySettings(const MotionCompensationSettings_v1& settings);
 
-			vr::HmdVector3d_t LPF(vr::HmdVector3d_t RawData, vr::HmdVector3d_t SmoothData);
+		private:
+			// Current time in microseconds, the clock both the reference and the compensated poses are stamped with
+			static long long now()
+			{
+				return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			}
 
-			vr::HmdQuaternion_t lowPassFilterQuaternion(vr::HmdQuaternion_t RawData, vr::HmdQuaternion_t SmoothData);
+			// One data point of the debug capture per pose
+			void captureReference(const vr::DriverPose_t& pose);
 
-			vr::HmdQuaternion_t slerp(vr::HmdQuaternion_t q1, vr::HmdQuaternion_t q2, double lambda);
+			void captureDevice(const vr::DriverPose_t& rawPose, const vr::DriverPose_t& pose);
 
-			vr::HmdVector3d_t toEulerAngles(vr::HmdQuaternion_t q);
+			// Takes a new pose from the rig pose block as the reference pose, if there is one
+			void pollRigPose(long long timestampUs);
 
-			const double angleDifference(double angle1, double angle2);
+			// Applies and acknowledges new settings from the settings block, if there are any
+			void pollSettings();
 
 			vr::HmdVector3d_t transform(vr::HmdVector3d_t VecRotation, vr::HmdVector3d_t VecPosition, vr::HmdVector3d_t point);
 
@@ -163,97 +194,49 @@ namespace vrmotioncompensation
 
 			vr::HmdVector3d_t transform(vr::HmdVector3d_t VecRotation, vr::HmdVector3d_t VecPosition, vr::HmdVector3d_t centerOfRotation, vr::HmdVector3d_t point);
 
-			std::string _vecToStr(char* name, vr::HmdVector3d_t & v)
-			{
-				std::stringstream ss;
-				ss << name << ": [" << v.v[0] << ", " << v.v[1] << ", " << v.v[2] << "]";
-				return ss.str();
-			}
-
-			std::string _vecToStr(char* name, double v[3])
-			{
-				std::stringstream ss;
-				ss << name << ": [" << v[0] << ", " << v[1] << ", " << v[2] << "]";
-				return ss.str();
-			}
-
-			std::string _quatToStr(const char* name, const vr::HmdQuaternion_t & q)
-			{
-				std::stringstream ss;
-				ss << name << ": [" << q.w << ", " << q.x << ", " << q.y << ", " << q.z << "]";
-				return ss.str();
-			}
-
-			inline void _copyVec(double(&d)[3], const double(&s)[3])
-			{
-				d[0] = s[0];
-				d[1] = s[1];
-				d[2] = s[2];
-			}
-
-			inline void _copyVec(vr::HmdVector3d_t & d, const double(&s)[3])
-			{
-				d.v[0] = s[0];
-				d.v[1] = s[1];
-				d.v[2] = s[2];
-			}
-
-			inline void _zeroVec(double(&d)[3])
-			{
-				d[0] = d[1] = d[2] = 0.0;
-			}
-
-			inline void _zeroVec(vr::HmdVector3d_t & d)
-			{
-				d.v[0] = d.v[1] = d.v[2] = 0.0;
-			}
-
 			ServerDriver* m_parent;
 
 			boost::interprocess::windows_shared_memory _shdmem;
 			boost::interprocess::mapped_region _region;
 
-			int _McDeviceID = -1;
-			int _RtDeviceID = -1;
-			long long _RefTrackerLastTime = -1;
-			vr::DriverPose_t _RefTrackerLastPose;
-			vr::HmdVector3d_t _RotEulerFilterOld = {0, 0, 0};
+			// Telemetry ring for external tools, see MMFstruct_OVRMC_Telemetry_v1
+			boost::interprocess::windows_shared_memory _telemetryShm;
+			boost::interprocess::mapped_region _telemetryRegion;
 
-			double _LpfBeta = 0.2;
-			double _Alpha = -1.0;
-			uint32_t _Samples = 100;
-			bool _SetZeroMode = false;
+			core::CompensatedDevices _McDevices;
 
-			Spinlock _ZeroLock, _RefLock, _RefVelLock;
+			MotionCompensationMode _Mode = MotionCompensationMode::Disabled;
 
-			bool _Enabled = false;
-			MotionCompensationMode _Mode = MotionCompensationMode::Disabled;			
-			
 			// Offset data
 			MMFstruct_OVRMC_v1 _Offset;
 			MMFstruct_OVRMC_v1* _Poffset = nullptr;
 
-			// Zero position
-			vr::HmdVector3d_t _ZeroPos = { 0, 0, 0 };
-			vr::HmdQuaternion_t _ZeroRot = { 1, 0, 0, 0 };
-			bool _ZeroPoseValid = false;
-			
-			// Reference position
-			vr::HmdVector3d_t _RefPos = { 0, 0, 0 };
-			vr::HmdVector3d_t _Filter_vecPosition[2] = { 0, 0, 0 };
+			// Rig pose written by the rig software into the same shared memory. Every compensated device polls it,
+			// _RigPoseLock lets one of them take a new pose while the others go on with the last one
+			MMFstruct_OVRMC_RigPose_v1* _RigPose = nullptr;
+			core::RigPoseReader _RigPoseReader;
+			core::Spinlock _RigPoseLock;
+
+			// Settings written by the rig software into the same shared memory, polled on the reference update path.
+			// _SettingsLock lets one thread apply new settings while the others go on
+			MMFstruct_OVRMC_Settings_v1* _Settings = nullptr;
+			core::SettingsReader _SettingsReader;
+			core::Spinlock _SettingsLock;
+			SettingsStatus _SettingsStatus = SettingsStatus::None;
+
+			// Keeps the last seconds of compensated poses, declared before _Core so that it outlives it
+			core::FlightRecorder _FlightRecorder;
 
-			vr::HmdVector3d_t _RefVel = { 0, 0, 0 };
-			vr::HmdVector3d_t _RefAcc = { 0, 0, 0 };
+			// Filter chain and compensation math
+			core::MotionCompensationCore _Core;
 
-			vr::HmdQuaternion_t _RefRot = { 1, 0, 0, 0 };
-			vr::HmdQuaternion_t _RefRotInv = { 1, 0, 0, 0 };
-			vr::HmdQuaternion_t _Filter_rotPosition[2] = { 1, 0, 0, 0 };
+			// Reference trackers, their fusion and the zero pose calibration, feeding _Core
+			core::ReferenceTrackers _ReferenceTrackers{ _Core };
 
-			vr::HmdVector3d_t _RefRotVel = { 0, 0, 0 };
-			vr::HmdVector3d_t _RefRotAcc = { 0, 0, 0 };
+			// Bit per OpenVR id, cleared while the reference tracker reports poses that are not valid or not Running_OK
+			std::atomic<uint64_t> _ReferenceTracking = { ~0ull };
 
-			bool _RefPoseValid = false;
-			int _RefPoseValidCounter = 0;
+			Debugger _Debugger;
 		};
 	}
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 ﻿#include "ServerDriver.h"
 #include "../devicemanipulation/DeviceManipulationHandle.h"
+#include <PoseStatistics.h>
 #include <set>
 #include <mutex>
 
@@ -34,6 +35,7 @@ namespace vrmotioncompensation
 		bool ServerDriver::hooksTrackedDevicePoseUpdated(void* serverDriverHost, int version,
 			uint32_t& unWhichDevice, vr::DriverPose_t& newPose, uint32_t& unPoseStructSize)
 		{
+			VRMC_LATENCY_START(hookNs);
 			if (unWhichDevice >= vr::k_unMaxTrackedDeviceCount)
 				return true;
 
@@ -78,7 +80,7 @@ namespace vrmotioncompensation
 							handle = std::make_shared<DeviceManipulationHandle>(serial, (vr::ETrackedDeviceClass)deviceClass);
 							handle->setOpenvrId(unWhichDevice);
 							_openvrIdDeviceManipulationHandle[unWhichDevice] = handle;
-
+							deviceEvent(DeviceEventType::DeviceActivated, unWhichDevice, handle.get());
 
 							LOG(INFO) << "Successfully lazy-registered device: " << serial;
 						}
@@ -96,7 +98,9 @@ namespace vrmotioncompensation
 
 			if (handle && handle->isValid())
 			{
-				return handle->handlePoseUpdate(unWhichDevice, newPose, unPoseStructSize);
+				bool forward = handle->handlePoseUpdate(unWhichDevice, newPose, unPoseStructSize);
+				VRMC_LATENCY_RECORD(hookNs, handle->latency(LatencyStage::PoseUpdated));
+				return forward;
 			}
 
 			return true;
@@ -120,6 +124,7 @@ namespace vrmotioncompensation
 			}
 
 			LOG(INFO) << "Pre-registered device: " << pchDeviceSerialNumber;
+			deviceEvent(DeviceEventType::DeviceAdded, vr::k_unTrackedDeviceIndexInvalid, handle.get());
 			
 			// Hook into server driver interface
 			handle->setServerDriverHooks(InterfaceHooks::hookInterface(pDriver, "ITrackedDeviceServerDriver_005"));
@@ -140,6 +145,7 @@ namespace vrmotioncompensation
 				handle->setOpenvrId(unObjectId);
 
 				_openvrIdDeviceManipulationHandle[unObjectId] = handle;
+				deviceEvent(DeviceEventType::DeviceActivated, unObjectId, handle.get());
 
 				std::shared_ptr<InterfaceHooks> hookedInterface;
 				const char* versions[] = {
@@ -181,7 +187,9 @@ namespace vrmotioncompensation
 			LOG(INFO) << "Device deactivated: OpenVR ID " << unObjectId;
 
 			// Clear from array using shared_ptr (safe even if used concurrently)
+			auto handle = _openvrIdDeviceManipulationHandle[unObjectId];
 			_openvrIdDeviceManipulationHandle[unObjectId].reset();
+			deviceEvent(DeviceEventType::DeviceDeactivated, unObjectId, handle.get());
 
 			// Optional: clear from map if you want (not strictly needed — will be cleaned on removal)
 		}
@@ -199,8 +207,13 @@ namespace vrmotioncompensation
 			if (it != _deviceManipulationHandles.end())
 			{
 				LOG(INFO) << "Removed device: " << it->second->serialNumber();
+				deviceEvent(DeviceEventType::DeviceRemoved, unObjectId, it->second.get());
 				_deviceManipulationHandles.erase(it);
 			}
+			else
+			{
+				deviceEvent(DeviceEventType::DeviceRemoved, unObjectId);
+			}
 		}
 
 		// === INIT ===
@@ -229,6 +242,21 @@ namespace vrmotioncompensation
 
 			shmCommunicator.init(this);
 
+			try
+			{
+				_poseStatisticsShm = { boost::interprocess::open_or_create, PoseStatisticsSharedMemoryName, boost::interprocess::read_write, sizeof(MMFstruct_OVRMC_PoseStatistics_v1) };
+				_poseStatisticsRegion = { _poseStatisticsShm, boost::interprocess::read_write };
+
+				_poseStatistics = static_cast<MMFstruct_OVRMC_PoseStatistics_v1*>(_poseStatisticsRegion.get_address());
+				core::PoseStatisticsWriter::init(*_poseStatistics);
+				LOG(INFO) << "Shared memory " << PoseStatisticsSharedMemoryName << " created";
+			}
+			catch (boost::interprocess::interprocess_exception& e)
+			{
+				_poseStatistics = nullptr;
+				LOG(ERROR) << "Could not create the pose statistics shared memory. Error code " << e.get_error_code();
+			}
+
 			return vr::VRInitError_None;
 		}
 
@@ -256,8 +284,35 @@ namespace vrmotioncompensation
 		// === RUNFRAME (optional) ===
 		void ServerDriver::RunFrame()
 		{
-			// You can do lightweight per-frame work here if needed
 			// shmCommunicator is already running in background thread
+			m_motionCompensation.runFrame();
+			publishPoseStatistics();
+		}
+
+		void ServerDriver::publishPoseStatistics()
+		{
+			// Four times a second is plenty for a human and keeps the frame cheap
+			int64_t nowNs = core::LatencyHistogram::nowNs();
+			if (!_poseStatistics || nowNs - _poseStatisticsPublishedNs < 250000000)
+			{
+				return;
+			}
+			_poseStatisticsPublishedNs = nowNs;
+
+			for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+			{
+				auto handle = _openvrIdDeviceManipulationHandle[id];
+				if (handle && handle->isValid())
+				{
+					_poseStatisticsDevices[id] = handle->getPoseStatistics(false);
+				}
+				else
+				{
+					_poseStatisticsDevices[id] = {};
+				}
+				_poseStatisticsDevices[id].OpenVRId = id;
+			}
+			core::PoseStatisticsWriter::publish(*_poseStatistics, _poseStatisticsDevices, nowNs);
 		}
 
 		// === PUBLIC ACCESSOR ===
@@ -273,5 +328,64 @@ namespace vrmotioncompensation
 			return nullptr;
 		}
 
+		void ServerDriver::deviceEvent(DeviceEventType type, uint32_t openVRId, DeviceManipulationHandle* handle)
+		{
+			// Tracking of the reference and the zero pose are not part of the device infos
+			if (type != DeviceEventType::ReferenceTrackingLost && type != DeviceEventType::ReferenceTrackingRegained && type != DeviceEventType::ZeroPoseSet)
+			{
+				deviceInfoChanged();
+			}
+			if (!shmCommunicator.hasEventSubscribers())
+			{
+				return;
+			}
+
+			DeviceEvent event = {};
+			event.Type = type;
+			event.OpenVRId = openVRId;
+			event.deviceClass = vr::TrackedDeviceClass_Invalid;
+			if (!handle)
+			{
+				handle = getDeviceManipulationHandleById(openVRId);
+			}
+			if (handle)
+			{
+				event.deviceClass = handle->deviceClass();
+				event.deviceMode = handle->getDeviceMode();
+				event.Status = handle->getStatus();
+				event.SerialHash = handle->serialHash();
+			}
+			event.Generation = _deviceInfoGeneration.load(std::memory_order_relaxed);
+			event.TimeNs = core::LatencyHistogram::nowNs();
+			shmCommunicator.pushEvent(event);
+		}
+
+		void ServerDriver::getAllDeviceInfo(DeviceInfoList& list, uint32_t knownGeneration)
+		{
+			static_assert(sizeof(list.Devices) / sizeof(list.Devices[0]) == vr::k_unMaxTrackedDeviceCount, "DeviceInfoList has to hold every OpenVR id");
+
+			// Loaded before the pass, so a change during the pass shows up as a new generation the next time
+			list.Generation = _deviceInfoGeneration.load(std::memory_order_acquire);
+			list.Count = 0;
+			if (list.Generation == knownGeneration)
+			{
+				return;
+			}
+
+			for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+			{
+				auto handle = _openvrIdDeviceManipulationHandle[id];
+				if (handle && handle->isValid())
+				{
+					DeviceInfoEntry& entry = list.Devices[list.Count++];
+					entry.OpenVRId = id;
+					entry.deviceClass = handle->deviceClass();
+					entry.deviceMode = handle->getDeviceMode();
+					entry.Status = handle->getStatus();
+					entry.SerialHash = handle->serialHash();
+				}
+			}
+		}
+
 	} // namespace driver
 } // namespace vrmotioncompensation
\ No newline at end of file
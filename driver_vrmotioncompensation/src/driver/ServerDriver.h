@@ -1,5 +1,6 @@
 ﻿#pragma once
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <queue>
@@ -80,6 +81,24 @@ namespace vrmotioncompensation
 
 			DeviceManipulationHandle* getDeviceManipulationHandleById(uint32_t unWhichDevice);
 
+			// The devices with an OpenVR id, in one consistent pass. Skipped when knownGeneration is still current
+			void getAllDeviceInfo(DeviceInfoList& list, uint32_t knownGeneration);
+
+			// Bumps the generation of the device infos if the event changes them and pushes the event to the subscribed
+			// clients. Any thread, never blocks. Without a handle the device is looked up by openVRId
+			void deviceEvent(DeviceEventType type, uint32_t openVRId, DeviceManipulationHandle* handle = nullptr);
+
+			// Called whenever a device is added or removed or its mode or status changes
+			void deviceInfoChanged()
+			{
+				uint32_t generation = _deviceInfoGeneration.fetch_add(1, std::memory_order_relaxed) + 1;
+				if (generation == 0)
+				{
+					// Clients start out with 0
+					_deviceInfoGeneration.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+
 			// internal API
 
 			/* Motion Compensation related */
@@ -117,10 +136,20 @@ namespace vrmotioncompensation
 			std::map<void*, std::shared_ptr<DeviceManipulationHandle>> _deviceManipulationHandles;
 			static std::shared_ptr<DeviceManipulationHandle> _openvrIdDeviceManipulationHandle[vr::k_unMaxTrackedDeviceCount];
 			int _deviceVersionMap[vr::k_unMaxTrackedDeviceCount];
+			std::atomic<uint32_t> _deviceInfoGeneration = { 1 };
 
 			//// motion compensation related ////
 			MotionCompensationManager m_motionCompensation;
 
+			//// pose statistics, published from RunFrame, see MMFstruct_OVRMC_PoseStatistics_v1 ////
+			boost::interprocess::windows_shared_memory _poseStatisticsShm;
+			boost::interprocess::mapped_region _poseStatisticsRegion;
+			MMFstruct_OVRMC_PoseStatistics_v1* _poseStatistics = nullptr;
+			PoseStatistics_v1 _poseStatisticsDevices[vr::k_unMaxTrackedDeviceCount];
+			int64_t _poseStatisticsPublishedNs = 0;
+
+			void publishPoseStatistics();
+
 			//// function hooks related ////
 			std::shared_ptr<InterfaceHooks> _driverContextHooks;
 		};
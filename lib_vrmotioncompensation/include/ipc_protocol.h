@@ -4,7 +4,10 @@
 #include <utility>
 #include <chrono>
 
-#define IPC_PROTOCOL_VERSION 3
+#define IPC_PROTOCOL_VERSION 15
+
+// First protocol version whose IPC_ClientConnect carries the transport of the client's endpoint
+#define IPC_PROTOCOL_VERSION_TRANSPORT 13
 
 namespace vrmotioncompensation
 {
@@ -24,6 +27,16 @@ namespace vrmotioncompensation
 			DeviceManipulation_ResetRefZeroPose,
 			DeviceManipulation_SetOffsets,
 			DebugLogger_Settings,
+			DeviceManipulation_SetDeviceCompensation,
+			DeviceManipulation_SetReferenceTrackers,
+			DeviceManipulation_SetZeroPoseCalibration,
+			DeviceManipulation_GetZeroPoseCalibration,
+			FlightRecorder_Settings,
+			FlightRecorder_Dump,
+			DeviceManipulation_GetLatencyStatistics,
+			DeviceManipulation_GetPoseStatistics,
+			DeviceManipulation_GetAllDeviceInfo,
+			IPC_SubscribeEvents,
 		};
 
 		enum class ReplyType : uint32_t
@@ -32,7 +45,15 @@ namespace vrmotioncompensation
 			IPC_ClientConnect,
 			IPC_Ping,
 			GenericReply,
-			DeviceManipulation_GetDeviceInfo
+			DeviceManipulation_GetDeviceInfo,
+			DeviceEvent					// Pushed by the driver with messageId 0, see IPC_SubscribeEvents
+		};
+
+		// How requests and replies are carried, see ipc_transport.h
+		enum class TransportType : uint32_t
+		{
+			MessageQueue,
+			SharedMemoryRing
 		};
 
 		enum class ReplyStatus : uint32_t
@@ -48,7 +69,8 @@ namespace vrmotioncompensation
 			InvalidVersion,
 			MissingProperty,
 			InvalidOperation,
-			NotTracking
+			NotTracking,
+			InvalidValue
 		};
 
 		struct Request_IPC_ClientConnect
@@ -56,6 +78,7 @@ namespace vrmotioncompensation
 			uint32_t messageId;
 			uint32_t ipcProcotolVersion;
 			char queueName[128];
+			TransportType transport;		// Of the client's endpoint, named after queueName
 		};
 
 		struct Request_IPC_ClientDisconnect
@@ -93,6 +116,34 @@ namespace vrmotioncompensation
 			MotionCompensationMode CompensationMode;
 		};
 
+		// Adds a device to or removes it from the set of motion compensated devices
+		struct Request_DeviceManipulation_SetDeviceCompensation
+		{
+			uint32_t clientId;
+			uint32_t messageId;			// Used to associate with Reply
+			uint32_t OpenVRId;
+			bool compensated;
+			MotionCompensationDeviceOffset offset;
+		};
+
+		// Sets the reference trackers whose poses are fused into one reference pose. The first one is the main reference tracker
+		struct Request_DeviceManipulation_SetReferenceTrackers
+		{
+			uint32_t clientId;
+			uint32_t messageId;			// Used to associate with Reply
+			uint32_t count;
+			uint32_t RTdeviceIds[MaxReferenceTrackers];
+			double weights[MaxReferenceTrackers];
+		};
+
+		// Settings for the next zero pose calibration, a calibration that is still collecting starts over
+		struct Request_DeviceManipulation_SetZeroPoseCalibration
+		{
+			uint32_t clientId;
+			uint32_t messageId;			// Used to associate with Reply
+			ZeroPoseCalibrationSettings settings;
+		};
+
 		struct Request_DeviceManipulation_SetMotionCompensationProperties
 		{
 			uint32_t clientId;
@@ -100,6 +151,12 @@ namespace vrmotioncompensation
 			double LPFBeta;
 			uint32_t samples;
 			bool setZero;
+			MotionCompensationFilterType filterType;
+			double kalmanProcessNoise;
+			double kalmanObservationNoise;
+			double kalmanPredictionMs;		// How far the Kalman filter predicts the reference pose
+			double oneEuroMinCutoff;		// Cutoff at rest in Hz
+			double oneEuroBeta;				// Cutoff increase per unit of speed
 			//MMFstruct_v1 offsets;
 		};
 
@@ -124,6 +181,48 @@ namespace vrmotioncompensation
 			bool enabled;
 		};
 
+		// Turns the flight recorder on or off and sets its window and anomaly triggers
+		struct Request_FlightRecorder_Settings
+		{
+			uint32_t clientId;
+			uint32_t messageId;			// Used to associate with Reply
+			FlightRecorderSettings settings;
+		};
+
+		// Latency percentiles of one device's pose updates, reset optionally starts the histograms over
+		struct Request_DeviceManipulation_GetLatencyStatistics
+		{
+			uint32_t clientId;
+			uint32_t messageId;			// Used to associate with Reply
+			uint32_t OpenVRId;
+			bool reset;
+		};
+
+		// Pose rate, jitter and tracking state of one device, reset optionally starts them over
+		struct Request_DeviceManipulation_GetPoseStatistics
+		{
+			uint32_t clientId;
+			uint32_t messageId;			// Used to associate with Reply
+			uint32_t OpenVRId;
+			bool reset;
+		};
+
+		// All devices in one reply. A client that passes the Generation of its last reply gets no devices back while nothing changed
+		struct Request_DeviceManipulation_GetAllDeviceInfo
+		{
+			uint32_t clientId;
+			uint32_t messageId;			// Used to associate with Reply
+			uint32_t knownGeneration;	// 0 for the devices in any case
+		};
+
+		// The driver pushes the events in eventMask (deviceEventBit) to the client's endpoint as ReplyType::DeviceEvent. 0 unsubscribes
+		struct Request_IPC_SubscribeEvents
+		{
+			uint32_t clientId;
+			uint32_t messageId;			// Used to associate with Reply
+			uint32_t eventMask;
+		};
+
 		struct Request
 		{
 			Request()
@@ -152,10 +251,18 @@ namespace vrmotioncompensation
 				Request_OpenVR_GenericClientMessage ovr_GenericClientMessage;
 				Request_OpenVR_GenericDeviceIdMessage ovr_GenericDeviceIdMessage;
 				Request_DeviceManipulation_MotionCompensationMode dm_MotionCompensationMode;
+				Request_DeviceManipulation_SetDeviceCompensation dm_SetDeviceCompensation;
+				Request_DeviceManipulation_SetReferenceTrackers dm_SetReferenceTrackers;
+				Request_DeviceManipulation_SetZeroPoseCalibration dm_SetZeroPoseCalibration;
 				Request_DeviceManipulation_SetMotionCompensationProperties dm_SetMotionCompensationProperties;
 				Request_DeviceManipulation_ResetRefZeroPose dm_ResetRefZeroPose;
 				Request_DeviceManipulation_SetOffsets dm_SetOffsets;
 				Request_DebugLogger_Settings dl_Settings;
+				Request_FlightRecorder_Settings fr_Settings;
+				Request_DeviceManipulation_GetLatencyStatistics dm_GetLatencyStatistics;
+				Request_DeviceManipulation_GetPoseStatistics dm_GetPoseStatistics;
+				Request_DeviceManipulation_GetAllDeviceInfo dm_GetAllDeviceInfo;
+				Request_IPC_SubscribeEvents ipc_SubscribeEvents;
 				MsgUnion()
 				{
 				}
@@ -180,6 +287,33 @@ namespace vrmotioncompensation
 			MotionCompensationDeviceMode deviceMode;
 		};
 
+		// Progress and residual of the zero pose calibration
+		struct Reply_DeviceManipulation_ZeroPoseCalibration
+		{
+			ZeroPoseCalibrationStatus status;
+		};
+
+		struct Reply_DeviceManipulation_LatencyStatistics
+		{
+			DeviceLatencyStatistics statistics;
+		};
+
+		struct Reply_DeviceManipulation_PoseStatistics
+		{
+			PoseStatistics_v1 statistics;
+		};
+
+		// Count is 0 and Devices is not filled in if Generation is the knownGeneration of the request
+		struct Reply_DeviceManipulation_GetAllDeviceInfo
+		{
+			DeviceInfoList devices;
+		};
+
+		struct Reply_DeviceEvent
+		{
+			DeviceEvent event;
+		};
+
 		struct Reply
 		{
 			Reply()
@@ -202,6 +336,11 @@ namespace vrmotioncompensation
 				Reply_IPC_ClientConnect ipc_ClientConnect;
 				Reply_IPC_Ping ipc_Ping;
 				Reply_DeviceManipulation_GetDeviceInfo dm_deviceInfo;
+				Reply_DeviceManipulation_ZeroPoseCalibration dm_zeroPoseCalibration;
+				Reply_DeviceManipulation_LatencyStatistics dm_latencyStatistics;
+				Reply_DeviceManipulation_PoseStatistics dm_poseStatistics;
+				Reply_DeviceManipulation_GetAllDeviceInfo dm_allDeviceInfo;
+				Reply_DeviceEvent deviceEvent;
 				MsgUnion()
 				{
 				}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include "ipc_protocol.h"
+#include <IpcRing.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/interprocess/ipc/message_queue.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#ifdef _WIN32
+#include <boost/interprocess/windows_shared_memory.hpp>
+#else
+#include <boost/interprocess/shared_memory_object.hpp>
+#endif
+
+// The endpoints requests and replies travel through between the driver and its clients. The driver listens on
+// one endpoint of every type, a client creates one endpoint for the replies and tells the driver its type and
+// name in IPC_ClientConnect. Both ends of a connection use the same type.
+namespace vrmotioncompensation
+{
+	namespace ipc
+	{
+		// Messages an endpoint holds before a send has to wait
+		static const uint32_t TransportMessageCount = 128;
+
+		// How long a send waits for a full endpoint before it throws
+		static const uint32_t TransportSendTimeoutMs = 1000;
+
+		class Transport
+		{
+		public:
+			virtual ~Transport()
+			{
+			}
+
+			virtual TransportType getType() const = 0;
+
+			// Largest message the endpoint takes, the size of the receiver's messages
+			virtual uint32_t getMessageSize() const = 0;
+
+			// Any thread. Throws if the message does not fit or the endpoint stays full
+			virtual void send(const void* data, uint32_t size) = 0;
+
+			// Any thread, never waits. False if the endpoint is full, throws if the message does not fit
+			virtual bool trySend(const void* data, uint32_t size) = 0;
+
+			// One receiving thread. False if nothing arrived within timeoutMs
+			virtual bool receive(void* data, uint32_t capacity, uint32_t& size, uint32_t timeoutMs) = 0;
+		};
+
+		// boost::interprocess::message_queue, the transport of protocol versions before 13. The receiver is woken
+		// through an interprocess condition, which Boost emulates with a spinning and sleeping wait on Windows
+		class MessageQueueTransport : public Transport
+		{
+		public:
+			MessageQueueTransport(boost::interprocess::create_only_t, const std::string& name, uint32_t messageSize)
+				: _name(name), _owner(true)
+			{
+				boost::interprocess::message_queue::remove(name.c_str());
+				_queue.reset(new boost::interprocess::message_queue(boost::interprocess::create_only, name.c_str(), TransportMessageCount, messageSize));
+			}
+
+			MessageQueueTransport(boost::interprocess::open_only_t, const std::string& name)
+				: _name(name), _owner(false)
+			{
+				_queue.reset(new boost::interprocess::message_queue(boost::interprocess::open_only, name.c_str()));
+			}
+
+			~MessageQueueTransport()
+			{
+				_queue.reset();
+				if (_owner)
+				{
+					boost::interprocess::message_queue::remove(_name.c_str());
+				}
+			}
+
+			TransportType getType() const override
+			{
+				return TransportType::MessageQueue;
+			}
+
+			uint32_t getMessageSize() const override
+			{
+				return (uint32_t)_queue->get_max_msg_size();
+			}
+
+			void send(const void* data, uint32_t size) override
+			{
+				boost::posix_time::ptime timeout = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(TransportSendTimeoutMs);
+				if (!_queue->timed_send(data, size, 0, timeout))
+				{
+					throw std::runtime_error("Message queue \"" + _name + "\" is full");
+				}
+			}
+
+			bool trySend(const void* data, uint32_t size) override
+			{
+				return _queue->try_send(data, size, 0);
+			}
+
+			bool receive(void* data, uint32_t capacity, uint32_t& size, uint32_t timeoutMs) override
+			{
+				boost::interprocess::message_queue::size_type recvSize;
+				unsigned priority;
+				boost::posix_time::ptime timeout = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(timeoutMs);
+				if (_queue->timed_receive(data, capacity, recvSize, priority, timeout))
+				{
+					size = (uint32_t)recvSize;
+					return true;
+				}
+				return false;
+			}
+
+		private:
+			std::string _name;
+			bool _owner;
+			std::unique_ptr<boost::interprocess::message_queue> _queue;
+		};
+
+		// core::IpcRing in a named shared memory object. The receiver sleeps in the kernel until a send wakes it
+		class SharedMemoryRingTransport : public Transport
+		{
+		public:
+			SharedMemoryRingTransport(boost::interprocess::create_only_t, const std::string& name, uint32_t messageSize)
+				: _name(name), _owner(true)
+			{
+				size_t size = core::IpcRing::requiredSize(TransportMessageCount, messageSize);
+#ifdef _WIN32
+				// Removed by Windows with the last handle. Clients of a previous driver may still hold it, so an existing
+				// object is reused and the ring in it laid out anew. One of another size fails to map and throws
+				_shm = boost::interprocess::windows_shared_memory(boost::interprocess::open_or_create, name.c_str(), boost::interprocess::read_write, size);
+#else
+				boost::interprocess::shared_memory_object::remove(name.c_str());
+				_shm = boost::interprocess::shared_memory_object(boost::interprocess::create_only, name.c_str(), boost::interprocess::read_write);
+				_shm.truncate(size);
+#endif
+				_region = boost::interprocess::mapped_region(_shm, boost::interprocess::read_write, 0, size);
+				if (!_ring.create(_region.get_address(), _region.get_size(), TransportMessageCount, messageSize, name.c_str()))
+				{
+					throw std::runtime_error("Could not create ipc ring \"" + name + "\"");
+				}
+			}
+
+			SharedMemoryRingTransport(boost::interprocess::open_only_t, const std::string& name)
+				: _name(name), _owner(false)
+			{
+#ifdef _WIN32
+				_shm = boost::interprocess::windows_shared_memory(boost::interprocess::open_only, name.c_str(), boost::interprocess::read_write);
+#else
+				_shm = boost::interprocess::shared_memory_object(boost::interprocess::open_only, name.c_str(), boost::interprocess::read_write);
+#endif
+				_region = boost::interprocess::mapped_region(_shm, boost::interprocess::read_write);
+				if (!_ring.attach(_region.get_address(), _region.get_size(), name.c_str()))
+				{
+					throw std::runtime_error("\"" + name + "\" is no ipc ring of this version");
+				}
+			}
+
+			~SharedMemoryRingTransport()
+			{
+				_ring.detach();
+#ifndef _WIN32
+				if (_owner)
+				{
+					boost::interprocess::shared_memory_object::remove(_name.c_str());
+				}
+#endif
+			}
+
+			TransportType getType() const override
+			{
+				return TransportType::SharedMemoryRing;
+			}
+
+			uint32_t getMessageSize() const override
+			{
+				return _ring.getSlotSize();
+			}
+
+			void send(const void* data, uint32_t size) override
+			{
+				if (!_ring.send(data, size, TransportSendTimeoutMs))
+				{
+					throw std::runtime_error("Could not send into ipc ring \"" + _name + "\"");
+				}
+			}
+
+			bool trySend(const void* data, uint32_t size) override
+			{
+				if (size > _ring.getSlotSize())
+				{
+					throw std::runtime_error("Message too large for ipc ring \"" + _name + "\"");
+				}
+				return _ring.send(data, size, 0);
+			}
+
+			bool receive(void* data, uint32_t capacity, uint32_t& size, uint32_t timeoutMs) override
+			{
+				return _ring.receive(data, capacity, size, timeoutMs);
+			}
+
+		private:
+			std::string _name;
+			bool _owner;
+#ifdef _WIN32
+			boost::interprocess::windows_shared_memory _shm;
+#else
+			boost::interprocess::shared_memory_object _shm;
+#endif
+			boost::interprocess::mapped_region _region;
+			core::IpcRing _ring;
+		};
+
+		// Endpoints of different types share the base name, the ring gets a suffix
+		inline std::string getTransportName(TransportType type, const std::string& baseName)
+		{
+			return type == TransportType::SharedMemoryRing ? baseName + ".ring" : baseName;
+		}
+
+		// Creates the receiving end. messageSize is the largest message that will be sent into it
+		inline std::unique_ptr<Transport> createTransport(TransportType type, const std::string& baseName, uint32_t messageSize)
+		{
+			std::string name = getTransportName(type, baseName);
+			switch (type)
+			{
+			case TransportType::MessageQueue:
+				return std::unique_ptr<Transport>(new MessageQueueTransport(boost::interprocess::create_only, name, messageSize));
+			case TransportType::SharedMemoryRing:
+				return std::unique_ptr<Transport>(new SharedMemoryRingTransport(boost::interprocess::create_only, name, messageSize));
+			}
+			throw std::invalid_argument("Unknown ipc transport type " + std::to_string((uint32_t)type));
+		}
+
+		// Opens the end another process created for sending into it
+		inline std::unique_ptr<Transport> openTransport(TransportType type, const std::string& baseName)
+		{
+			std::string name = getTransportName(type, baseName);
+			switch (type)
+			{
+			case TransportType::MessageQueue:
+				return std::unique_ptr<Transport>(new MessageQueueTransport(boost::interprocess::open_only, name));
+			case TransportType::SharedMemoryRing:
+				return std::unique_ptr<Transport>(new SharedMemoryRingTransport(boost::interprocess::open_only, name));
+			}
+			throw std::invalid_argument("Unknown ipc transport type " + std::to_string((uint32_t)type));
+		}
+	} // end namespace ipc
+} // end namespace vrmotioncompensation
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmath>
+#include "openvr_math_simd.h"
 
 inline vr::HmdQuaternion_t operator+(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs)
 {
@@ -24,12 +25,7 @@ inline vr::HmdQuaternion_t operator-(const vr::HmdQuaternion_t& lhs, const vr::H
 
 inline vr::HmdQuaternion_t operator*(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs)
 {
-	return {
-		(lhs.w * rhs.w) - (lhs.x * rhs.x) - (lhs.y * rhs.y) - (lhs.z * rhs.z),
-		(lhs.w * rhs.x) + (lhs.x * rhs.w) + (lhs.y * rhs.z) - (lhs.z * rhs.y),
-		(lhs.w * rhs.y) + (lhs.y * rhs.w) + (lhs.z * rhs.x) - (lhs.x * rhs.z),
-		(lhs.w * rhs.z) + (lhs.z * rhs.w) + (lhs.x * rhs.y) - (lhs.y * rhs.x)
-	};
+	return vrmath::kernels::quaternionMultiply(lhs, rhs);
 }
 
 inline vr::HmdVector3d_t operator+(const vr::HmdVector3d_t& lhs, const vr::HmdVector3d_t& rhs)
@@ -203,15 +199,11 @@ namespace vrmath
 	{
 		if (reverse)
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = vrmath::quaternionConjugate(quat) * pin * quat;
-			return { pout.x, pout.y, pout.z };
+			return kernels::quaternionRotateVector(vrmath::quaternionConjugate(quat), quat, vector.v);
 		}
 		else
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = quat * pin * vrmath::quaternionConjugate(quat);
-			return { pout.x, pout.y, pout.z };
+			return kernels::quaternionRotateVector(quat, vrmath::quaternionConjugate(quat), vector.v);
 		}
 	}
 
@@ -219,15 +211,11 @@ namespace vrmath
 	{
 		if (reverse)
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = quatInv * pin * quat;
-			return{ pout.x, pout.y, pout.z };
+			return kernels::quaternionRotateVector(quatInv, quat, vector.v);
 		}
 		else
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = quat * pin * quatInv;
-			return{ pout.x, pout.y, pout.z };
+			return kernels::quaternionRotateVector(quat, quatInv, vector.v);
 		}
 	}
 
@@ -235,15 +223,11 @@ namespace vrmath
 	{
 		if (reverse)
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = vrmath::quaternionConjugate(quat) * pin * quat;
-			return{ pout.x, pout.y, pout.z };
+			return kernels::quaternionRotateVector(vrmath::quaternionConjugate(quat), quat, vector);
 		}
 		else
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = quat * pin * vrmath::quaternionConjugate(quat);
-			return{ pout.x, pout.y, pout.z };
+			return kernels::quaternionRotateVector(quat, vrmath::quaternionConjugate(quat), vector);
 		}
 	}
 
@@ -251,18 +235,77 @@ namespace vrmath
 	{
 		if (reverse)
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = quatInv * pin * quat;
-			return{ pout.x, pout.y, pout.z };
+			return kernels::quaternionRotateVector(quatInv, quat, vector);
+		}
+		else
+		{
+			return kernels::quaternionRotateVector(quat, quatInv, vector);
+		}
+	}
+
+	// Rotates count vectors from in to out, same as calling quaternionRotateVector for each of them.
+	// in and out may be the same array.
+	inline void quaternionRotateVectors(const vr::HmdQuaternion_t& quat, const vr::HmdVector3d_t* in, vr::HmdVector3d_t* out, size_t count, bool reverse = false)
+	{
+		if (reverse)
+		{
+			kernels::quaternionRotateVectors(vrmath::quaternionConjugate(quat), quat, in, out, count);
 		}
 		else
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = quat * pin * quatInv;
-			return{ pout.x, pout.y, pout.z };
+			kernels::quaternionRotateVectors(quat, vrmath::quaternionConjugate(quat), in, out, count);
 		}
 	}
 
+	// Double precision 3x3 matrix, row-major. HmdMatrix34_t only has float precision.
+	struct Matrix33d
+	{
+		double m[3][3];
+	};
+
+	// Rotation matrix of a quaternion. Uses the homogeneous form, so matMul33(quaternionToMatrix33(q), v)
+	// gives the same result as q * v * conjugate(q) even if q is not exactly normalized.
+	// The matrix of the conjugate quaternion is the transpose.
+	inline Matrix33d quaternionToMatrix33(const vr::HmdQuaternion_t& q)
+	{
+		double ww = q.w * q.w, xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		double xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+		double wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+		return { {
+			{ ww + xx - yy - zz, 2.0 * (xy - wz), 2.0 * (xz + wy) },
+			{ 2.0 * (xy + wz), ww - xx + yy - zz, 2.0 * (yz - wx) },
+			{ 2.0 * (xz - wy), 2.0 * (yz + wx), ww - xx - yy + zz }
+		} };
+	}
+
+	inline vr::HmdVector3d_t matMul33(const Matrix33d& a, const vr::HmdVector3d_t& b)
+	{
+		return {
+			a.m[0][0] * b.v[0] + a.m[0][1] * b.v[1] + a.m[0][2] * b.v[2],
+			a.m[1][0] * b.v[0] + a.m[1][1] * b.v[1] + a.m[1][2] * b.v[2],
+			a.m[2][0] * b.v[0] + a.m[2][1] * b.v[1] + a.m[2][2] * b.v[2]
+		};
+	}
+
+	inline vr::HmdVector3d_t matMul33(const Matrix33d& a, const double(&b)[3])
+	{
+		return {
+			a.m[0][0] * b[0] + a.m[0][1] * b[1] + a.m[0][2] * b[2],
+			a.m[1][0] * b[0] + a.m[1][1] * b[1] + a.m[1][2] * b[2],
+			a.m[2][0] * b[0] + a.m[2][1] * b[1] + a.m[2][2] * b[2]
+		};
+	}
+
+	// Multiplies with the transposed matrix, i.e. applies the inverse rotation
+	inline vr::HmdVector3d_t matTransposeMul33(const Matrix33d& a, const vr::HmdVector3d_t& b)
+	{
+		return {
+			a.m[0][0] * b.v[0] + a.m[1][0] * b.v[1] + a.m[2][0] * b.v[2],
+			a.m[0][1] * b.v[0] + a.m[1][1] * b.v[1] + a.m[2][1] * b.v[2],
+			a.m[0][2] * b.v[0] + a.m[1][2] * b.v[1] + a.m[2][2] * b.v[2]
+		};
+	}
+
 	inline vr::HmdMatrix34_t matMul33(const vr::HmdMatrix34_t& a, const vr::HmdMatrix34_t& b)
 	{
 		vr::HmdMatrix34_t result;
@@ -0,0 +1,232 @@
+#pragma once
+
+// Quaternion and vector kernels used by openvr_math.h.
+// The implementation is chosen at compile time: AVX2 (with FMA) if the compiler targets it, SSE2 on any x86-64 build,
+// scalar code otherwise. Define VRMATH_NO_SIMD to force the scalar code.
+// The scalar kernels are always available in vrmath::scalar, e.g. to check the SIMD results against them.
+
+#include <stddef.h>
+
+#if !defined(VRMATH_NO_SIMD)
+	#if defined(__AVX2__)
+		#define VRMATH_SIMD_AVX2
+		#include <immintrin.h>
+	#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		#define VRMATH_SIMD_SSE2
+		#include <emmintrin.h>
+	#endif
+#endif
+
+#if defined(VRMATH_SIMD_AVX2)
+	#define VRMATH_SIMD_NAME "AVX2"
+#elif defined(VRMATH_SIMD_SSE2)
+	#define VRMATH_SIMD_NAME "SSE2"
+#else
+	#define VRMATH_SIMD_NAME "scalar"
+#endif
+
+namespace vrmath
+{
+	namespace scalar
+	{
+		inline vr::HmdQuaternion_t quaternionMultiply(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs)
+		{
+			return {
+				(lhs.w * rhs.w) - (lhs.x * rhs.x) - (lhs.y * rhs.y) - (lhs.z * rhs.z),
+				(lhs.w * rhs.x) + (lhs.x * rhs.w) + (lhs.y * rhs.z) - (lhs.z * rhs.y),
+				(lhs.w * rhs.y) + (lhs.y * rhs.w) + (lhs.z * rhs.x) - (lhs.x * rhs.z),
+				(lhs.w * rhs.z) + (lhs.z * rhs.w) + (lhs.x * rhs.y) - (lhs.y * rhs.x)
+			};
+		}
+
+		// Returns quat * (0, vector) * quatInv
+		inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdQuaternion_t& quatInv, const double* vector)
+		{
+			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1], vector[2] };
+			vr::HmdQuaternion_t pout = quaternionMultiply(quaternionMultiply(quat, pin), quatInv);
+			return { pout.x, pout.y, pout.z };
+		}
+
+		// Rotates count vectors by quat * v * quatInv
+		inline void quaternionRotateVectors(const vr::HmdQuaternion_t& quat, const vr::HmdQuaternion_t& quatInv, const vr::HmdVector3d_t* in, vr::HmdVector3d_t* out, size_t count)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				out[i] = quaternionRotateVector(quat, quatInv, in[i].v);
+			}
+		}
+	}
+
+#if defined(VRMATH_SIMD_AVX2) || defined(VRMATH_SIMD_SSE2)
+	namespace simd
+	{
+#if defined(VRMATH_SIMD_AVX2)
+		inline __m256d _madd(__m256d a, __m256d b, __m256d c)
+		{
+			return _mm256_fmadd_pd(a, b, c);
+		}
+
+		// Hamilton product of two quaternions held as (w, x, y, z), with the components of a already broadcast
+		inline __m256d _quaternionMultiply(__m256d aw, __m256d ax, __m256d ay, __m256d az, __m256d b)
+		{
+			// Sign masks, lane 0 first
+			const __m256d signX = _mm256_set_pd(0.0, -0.0, 0.0, -0.0);
+			const __m256d signY = _mm256_set_pd(-0.0, 0.0, 0.0, -0.0);
+			const __m256d signZ = _mm256_set_pd(0.0, 0.0, -0.0, -0.0);
+
+			__m256d bSwap = _mm256_permute_pd(b, 0x5);				// (bx, bw, bz, by)
+			__m256d bHalf = _mm256_permute2f128_pd(b, b, 0x1);		// (by, bz, bw, bx)
+			__m256d bRev = _mm256_permute_pd(bHalf, 0x5);			// (bz, by, bx, bw)
+
+			__m256d r = _mm256_mul_pd(aw, b);
+			r = _madd(_mm256_xor_pd(ax, signX), bSwap, r);
+			r = _madd(_mm256_xor_pd(ay, signY), bHalf, r);
+			r = _madd(_mm256_xor_pd(az, signZ), bRev, r);
+			return r;
+		}
+
+		inline __m256d _quaternionMultiply(const vr::HmdQuaternion_t& a, __m256d b)
+		{
+			return _quaternionMultiply(_mm256_broadcast_sd(&a.w), _mm256_broadcast_sd(&a.x), _mm256_broadcast_sd(&a.y), _mm256_broadcast_sd(&a.z), b);
+		}
+
+		inline __m256d _quaternionMultiply(__m256d a, __m256d b)
+		{
+			return _quaternionMultiply(_mm256_permute4x64_pd(a, 0x00), _mm256_permute4x64_pd(a, 0x55), _mm256_permute4x64_pd(a, 0xAA), _mm256_permute4x64_pd(a, 0xFF), b);
+		}
+
+		inline vr::HmdQuaternion_t quaternionMultiply(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs)
+		{
+			vr::HmdQuaternion_t result;
+			_mm256_storeu_pd(&result.w, _quaternionMultiply(lhs, _mm256_loadu_pd(&rhs.w)));
+			return result;
+		}
+
+		inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdQuaternion_t& quatInv, const double* vector)
+		{
+			__m256d pin = _mm256_set_pd(vector[2], vector[1], vector[0], 0.0);
+			__m256d pout = _quaternionMultiply(_quaternionMultiply(quat, pin), _mm256_loadu_pd(&quatInv.w));
+
+			alignas(32) double tmp[4];
+			_mm256_store_pd(tmp, pout);
+			return { tmp[1], tmp[2], tmp[3] };
+		}
+
+		inline void quaternionRotateVectors(const vr::HmdQuaternion_t& quat, const vr::HmdQuaternion_t& quatInv, const vr::HmdVector3d_t* in, vr::HmdVector3d_t* out, size_t count)
+		{
+			__m256d q = _mm256_loadu_pd(&quat.w);
+			__m256d qInv = _mm256_loadu_pd(&quatInv.w);
+
+			// q * (0, v) * qInv is linear in v, so rotate the three unit vectors once and
+			// use them as matrix columns. Lane 0 of each column holds the (zero) w part.
+			__m256d c0 = _quaternionMultiply(_quaternionMultiply(q, _mm256_set_pd(0.0, 0.0, 1.0, 0.0)), qInv);
+			__m256d c1 = _quaternionMultiply(_quaternionMultiply(q, _mm256_set_pd(0.0, 1.0, 0.0, 0.0)), qInv);
+			__m256d c2 = _quaternionMultiply(_quaternionMultiply(q, _mm256_set_pd(1.0, 0.0, 0.0, 0.0)), qInv);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				const double* v = in[i].v;
+				__m256d r = _mm256_mul_pd(c0, _mm256_broadcast_sd(v));
+				r = _madd(c1, _mm256_broadcast_sd(v + 1), r);
+				r = _madd(c2, _mm256_broadcast_sd(v + 2), r);
+
+				// Lanes 1..3 hold x, y, z
+				_mm_storeu_pd(out[i].v, _mm256_castpd256_pd128(_mm256_permute4x64_pd(r, 0x09)));
+				_mm_storeh_pd(out[i].v + 2, _mm256_extractf128_pd(r, 1));
+			}
+		}
+#else
+		// Hamilton product with each quaternion split into (w, x) and (y, z), with the components of a already broadcast
+		inline void _quaternionMultiply(__m128d aw, __m128d ax, __m128d ay, __m128d az, __m128d bLo, __m128d bHi, __m128d& rLo, __m128d& rHi)
+		{
+			// Sign masks, lane 0 first
+			const __m128d signNP = _mm_set_pd(0.0, -0.0);
+			const __m128d signPN = _mm_set_pd(-0.0, 0.0);
+			const __m128d signNN = _mm_set_pd(-0.0, -0.0);
+
+			__m128d bLoSwap = _mm_shuffle_pd(bLo, bLo, 0x1);	// (bx, bw)
+			__m128d bHiSwap = _mm_shuffle_pd(bHi, bHi, 0x1);	// (bz, by)
+
+			rLo = _mm_mul_pd(aw, bLo);
+			rLo = _mm_add_pd(rLo, _mm_mul_pd(ax, _mm_xor_pd(bLoSwap, signNP)));
+			rLo = _mm_add_pd(rLo, _mm_mul_pd(ay, _mm_xor_pd(bHi, signNP)));
+			rLo = _mm_add_pd(rLo, _mm_mul_pd(az, _mm_xor_pd(bHiSwap, signNN)));
+
+			rHi = _mm_mul_pd(aw, bHi);
+			rHi = _mm_add_pd(rHi, _mm_mul_pd(ax, _mm_xor_pd(bHiSwap, signNP)));
+			rHi = _mm_add_pd(rHi, _mm_mul_pd(ay, _mm_xor_pd(bLo, signPN)));
+			rHi = _mm_add_pd(rHi, _mm_mul_pd(az, bLoSwap));
+		}
+
+		inline void _quaternionMultiply(__m128d aLo, __m128d aHi, __m128d bLo, __m128d bHi, __m128d& rLo, __m128d& rHi)
+		{
+			_quaternionMultiply(_mm_unpacklo_pd(aLo, aLo), _mm_unpackhi_pd(aLo, aLo), _mm_unpacklo_pd(aHi, aHi), _mm_unpackhi_pd(aHi, aHi), bLo, bHi, rLo, rHi);
+		}
+
+		inline void _quaternionMultiply(const vr::HmdQuaternion_t& a, __m128d bLo, __m128d bHi, __m128d& rLo, __m128d& rHi)
+		{
+			_quaternionMultiply(_mm_load1_pd(&a.w), _mm_load1_pd(&a.x), _mm_load1_pd(&a.y), _mm_load1_pd(&a.z), bLo, bHi, rLo, rHi);
+		}
+
+		inline vr::HmdQuaternion_t quaternionMultiply(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs)
+		{
+			__m128d rLo, rHi;
+			_quaternionMultiply(lhs, _mm_loadu_pd(&rhs.w), _mm_loadu_pd(&rhs.y), rLo, rHi);
+
+			vr::HmdQuaternion_t result;
+			_mm_storeu_pd(&result.w, rLo);
+			_mm_storeu_pd(&result.y, rHi);
+			return result;
+		}
+
+		inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdQuaternion_t& quatInv, const double* vector)
+		{
+			__m128d tLo, tHi, rLo, rHi;
+			_quaternionMultiply(quat, _mm_set_pd(vector[0], 0.0), _mm_loadu_pd(vector + 1), tLo, tHi);
+			_quaternionMultiply(tLo, tHi, _mm_loadu_pd(&quatInv.w), _mm_loadu_pd(&quatInv.y), rLo, rHi);
+
+			vr::HmdVector3d_t result;
+			_mm_storeh_pd(result.v, rLo);
+			_mm_storeu_pd(result.v + 1, rHi);
+			return result;
+		}
+
+		inline void quaternionRotateVectors(const vr::HmdQuaternion_t& quat, const vr::HmdQuaternion_t& quatInv, const vr::HmdVector3d_t* in, vr::HmdVector3d_t* out, size_t count)
+		{
+			__m128d qLo = _mm_loadu_pd(&quat.w), qHi = _mm_loadu_pd(&quat.y);
+			__m128d qInvLo = _mm_loadu_pd(&quatInv.w), qInvHi = _mm_loadu_pd(&quatInv.y);
+
+			// q * (0, v) * qInv is linear in v, so rotate the three unit vectors once and use them as matrix
+			// columns. Each column is kept as (w, x) and (y, z), the w part is zero.
+			__m128d cLo[3], cHi[3];
+			const __m128d unitLo[3] = { _mm_set_pd(1.0, 0.0), _mm_setzero_pd(), _mm_setzero_pd() };
+			const __m128d unitHi[3] = { _mm_setzero_pd(), _mm_set_pd(0.0, 1.0), _mm_set_pd(1.0, 0.0) };
+			for (int i = 0; i < 3; i++)
+			{
+				__m128d tLo, tHi;
+				_quaternionMultiply(qLo, qHi, unitLo[i], unitHi[i], tLo, tHi);
+				_quaternionMultiply(tLo, tHi, qInvLo, qInvHi, cLo[i], cHi[i]);
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				const double* v = in[i].v;
+				__m128d vx = _mm_load1_pd(v);
+				__m128d vy = _mm_load1_pd(v + 1);
+				__m128d vz = _mm_load1_pd(v + 2);
+
+				__m128d rLo = _mm_add_pd(_mm_add_pd(_mm_mul_pd(cLo[0], vx), _mm_mul_pd(cLo[1], vy)), _mm_mul_pd(cLo[2], vz));
+				__m128d rHi = _mm_add_pd(_mm_add_pd(_mm_mul_pd(cHi[0], vx), _mm_mul_pd(cHi[1], vy)), _mm_mul_pd(cHi[2], vz));
+
+				_mm_storeh_pd(out[i].v, rLo);
+				_mm_storeu_pd(out[i].v + 1, rHi);
+			}
+		}
+#endif
+	}
+
+	namespace kernels = simd;
+#else
+	namespace kernels = scalar;
+#endif
+}
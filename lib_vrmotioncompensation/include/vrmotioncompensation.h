@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include <string>
+#include <functional>
 #include <future>
 #include <mutex>
 #include <thread>
@@ -9,8 +10,10 @@
 #include <memory>
 #include <random>
 #include <string>
+#include <vector>
 #include <openvr.h>
 #include <boost/interprocess/ipc/message_queue.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 
 namespace vr
@@ -140,32 +143,88 @@ namespace vrmotioncompensation
 	};
 
 
+	namespace ipc
+	{
+		class Transport;
+	}
+
 	class VRMotionCompensation
 	{
 	public:
 		VRMotionCompensation(const std::string& driverQueue = "driver_vrmotioncompensation.server_queue", const std::string& clientQueue = "driver_vrmotioncompensation.client_queue.");
 		~VRMotionCompensation();
 
-		void connect();
+		// Requests and replies go through shared memory rings. Falls back to message queues if the driver has no ring
+		void connect(ipc::TransportType transport = ipc::TransportType::SharedMemoryRing);
 		bool isConnected() const;
+
+		// Of the current connection
+		ipc::TransportType getTransport() const;
+
 		void disconnect();
 
 		void ping(bool modal = true, bool enableReply = false);
 
 		void getDeviceInfo(uint32_t deviceId, DeviceInfo& info);;
 
+		// Mode, class, status and serial hash of every device in one request. Returns false and leaves devices
+		// as it is if knownGeneration, the Generation of an earlier reply, is still current
+		bool getAllDeviceInfo(DeviceInfoList& devices, uint32_t knownGeneration = 0);
+
+		// In MotionCompensationMode::RigPose the reference pose is read from the rig pose block in shared memory, RTdeviceId is ignored
 		void setDeviceMotionCompensationMode(uint32_t MCdeviceId, uint32_t RTdeviceId, MotionCompensationMode Mode = MotionCompensationMode::Disabled, bool modal = true);
 
-		void setMoticonCompensationSettings(double LPF_Beta, uint32_t samples, bool setZero);
+		// Adds a device to or removes it from the motion compensated devices. Compensation has to be enabled with setDeviceMotionCompensationMode first
+		void setDeviceCompensation(uint32_t deviceId, bool compensated, const MotionCompensationDeviceOffset& offset = { { 0, 0, 0 }, { 1, 0, 0, 0 } }, bool modal = true);
+
+		// Fuses several reference trackers mounted on the rig into one reference pose, the first one is the main reference tracker.
+		// Missing weights are 1. Compensation has to be enabled with setDeviceMotionCompensationMode first
+		void setReferenceTrackers(const std::vector<uint32_t>& RTdeviceIds, const std::vector<double>& weights = {}, bool modal = true);
+
+		void setMoticonCompensationSettings(double LPF_Beta, uint32_t samples, bool setZero, MotionCompensationFilterType filterType = MotionCompensationFilterType::Default,
+			double kalmanProcessNoise = 5.0, double kalmanObservationNoise = 0.0005, double kalmanPredictionMs = 0.0, double oneEuroMinCutoff = 1.0, double oneEuroBeta = 1.0);
 
 		void resetRefZeroPose();
 
+		// The zero pose of the reference tracker is calibrated from a window of samples, see ZeroPoseCalibrationSettings.
+		// Applies to the next calibration, or restarts the one that is still collecting
+		void setZeroPoseCalibration(const ZeroPoseCalibrationSettings& settings, bool modal = true);
+
+		// Progress of the calibration and the residual of its last window
+		void getZeroPoseCalibration(ZeroPoseCalibrationStatus& status);
+
 		void setOffsets(MMFstruct_OVRMC_v1 offsets);
 
-		void startDebugLogger(bool enable, bool modal = true);
+		// Captures the reference and device poses into MotionData.vrmccap in the working directory of vrserver while motion compensation runs.
+		// maxDebugPoints 0 takes the driver's default
+		void startDebugLogger(bool enable, bool modal = true, uint32_t maxDebugPoints = 0);
+
+		// Keeps the last seconds of poses in the driver and dumps them around a request or an anomaly to
+		// FlightRecorder-<time>-<trigger>.vrmccap in the working directory of vrserver, see FlightRecorderSettings
+		void setFlightRecorder(const FlightRecorderSettings& settings, bool modal = true);
+
+		// Dumps the poses around now. Throws if the flight recorder is off or still writing a dump
+		void dumpFlightRecorder(bool modal = true);
+
+		// Percentiles of how long the stages of a device's pose updates take in the driver, see LatencyStage.
+		// reset starts the histograms over after reading them. Throws if the driver was built without them
+		void getLatencyStatistics(uint32_t deviceId, DeviceLatencyStatistics& statistics, bool reset = false);
+
+		// Update rate, inter-arrival times, poseTimeOffset and tracking state of a device's poses.
+		// reset starts them over after reading them. VRMotionCompensationPoseStatistics reads all devices without ipc
+		void getPoseStatistics(uint32_t deviceId, PoseStatistics_v1& statistics, bool reset = false);
+
+		// The driver pushes the events in eventMask (deviceEventBit, DeviceEventMask_All) to this client as they
+		// happen, 0 unsubscribes. A new connection starts without a subscription
+		void subscribeEvents(uint32_t eventMask, bool modal = true);
+
+		// Called on the receive thread for every pushed event. It must not wait for a request of this client,
+		// the reply would arrive on the same thread. nullptr drops the events
+		void setEventCallback(std::function<void(const DeviceEvent&)> callback);
 
 	private:
 		std::recursive_mutex _mutex;
+		std::function<void(const DeviceEvent&)> _eventCallback;
 		uint32_t m_clientId = 0;
 
 		bool _ipcThreadRunning = false;
@@ -192,8 +251,87 @@ namespace vrmotioncompensation
 		std::map<uint32_t, _ipcPromiseMapEntry> _ipcPromiseMap;
 		std::string _ipcServerQueueName;
 		std::string _ipcClientQueueName;
-		boost::interprocess::message_queue* _ipcServerQueue = nullptr;
-		boost::interprocess::message_queue* _ipcClientQueue = nullptr;
+		ipc::Transport* _ipcServerQueue = nullptr;
+		ipc::Transport* _ipcClientQueue = nullptr;
+	};
+
+
+	namespace core
+	{
+		class TelemetryReader;
+	}
+
+	// Tails the telemetry ring the driver writes into shared memory. Reading does not need an ipc connection,
+	// and any number of readers can tail the ring without the driver noticing them
+	class VRMotionCompensationTelemetry
+	{
+	public:
+		~VRMotionCompensationTelemetry();
+
+		// Throws vrmotioncompensation_sharedmemoryerror when the driver has not created the ring.
+		// Starts with the next entry written, or with the oldest entry still in the ring if skipBacklog is false
+		void open(bool skipBacklog = true);
+		bool isOpen() const;
+		void close();
+
+		// Copies up to maxCount entries written since the last call, oldest first, and returns how many
+		size_t read(TelemetryEntry_v1* entries, size_t maxCount);
+
+		// Entries the driver overwrote before they were read
+		uint64_t getLostEntries() const;
+
+	private:
+		boost::interprocess::mapped_region* _region = nullptr;
+		core::TelemetryReader* _reader = nullptr;
+	};
+
+	// Reads the pose statistics of all devices the driver publishes into shared memory a few times a second.
+	// Reading does not need an ipc connection
+	class VRMotionCompensationPoseStatistics
+	{
+	public:
+		~VRMotionCompensationPoseStatistics();
+
+		// Throws vrmotioncompensation_sharedmemoryerror when the driver has not created the block
+		void open();
+		bool isOpen() const;
+		void close();
+
+		// Copies the statistics of all PoseStatisticsDeviceCount devices, indexed by OpenVR id, and the steady clock
+		// time the driver published them at. False if the block is not open or the driver kept updating it
+		bool read(PoseStatistics_v1* devices, int64_t& timeNs);
+
+	private:
+		boost::interprocess::mapped_region* _region = nullptr;
+	};
+
+	// Writes filter settings and offsets into the settings block the driver polls on its reference update path,
+	// for rig software that changes them many times a second. Writing does not need an ipc connection,
+	// the setters of VRMotionCompensation still work and are answered by the driver. One writer at a time
+	class VRMotionCompensationSettings
+	{
+	public:
+		~VRMotionCompensationSettings();
+
+		// Throws vrmotioncompensation_sharedmemoryerror when the driver has not created OVRMC_MMFv1.
+		// Inits the block if no writer has before
+		void open();
+		bool isOpen() const;
+		void close();
+
+		// Only the fields in settings.Fields are applied. Returns the sequence number of the settings, 0 if the block is not open
+		uint32_t write(const MotionCompensationSettings_v1& settings);
+
+		// The sequence number of the settings the driver took last and what became of them.
+		// False if the block is not open or the driver was acknowledging during every retry
+		bool getStatus(uint32_t& appliedSequence, SettingsStatus& status);
+
+		// Waits until the driver took the settings of sequence or newer ones and returns their status,
+		// SettingsStatus::None after timeoutMs
+		SettingsStatus waitForStatus(uint32_t sequence, uint32_t timeoutMs);
+
+	private:
+		boost::interprocess::mapped_region* _region = nullptr;
 	};
 
 } // end namespace vrmotioncompensation
\ No newline at end of file
@@ -5,10 +5,22 @@
 
 namespace vrmotioncompensation
 {
+	// Number of reference trackers that can be fused into one reference pose
+	const uint32_t MaxReferenceTrackers = 4;
+
 	enum class MotionCompensationMode : uint32_t
 	{
 		Disabled = 0,
 		ReferenceTracker = 1,
+		RigPose = 2,		// Reference pose written to shared memory by the motion rig software, no reference tracker
+	};
+
+	// Filter used on the reference tracker pose
+	enum class MotionCompensationFilterType : uint32_t
+	{
+		Default = 0,	// DEMA on the position, two stage slerp low pass on the rotation
+		Kalman = 1,		// Constant acceleration Kalman filter on position and rotation
+		OneEuro = 2,	// Speed adaptive low pass on position and rotation
 	};
 
 	enum class MotionCompensationDeviceMode : uint32_t
@@ -18,6 +30,14 @@ namespace vrmotioncompensation
 		MotionCompensated = 2,
 	};
 
+	// Rigid offset of a motion compensated device, applied in the device's own frame after compensation.
+	// Translation is in meters, Rotation is a unit quaternion. A zero translation with an identity rotation is no offset
+	struct MotionCompensationDeviceOffset
+	{
+		vr::HmdVector3d_t Translation;
+		vr::HmdQuaternion_t Rotation;
+	};
+
 	struct DeviceInfo
 	{
 		uint32_t OpenVRId;
@@ -25,6 +45,190 @@ namespace vrmotioncompensation
 		MotionCompensationDeviceMode deviceMode;
 	};
 
+	// Bits of DeviceInfoEntry::Status, taken from the last pose the device reported
+	const uint32_t DeviceStatus_Connected = 1 << 0;		// deviceIsConnected
+	const uint32_t DeviceStatus_PoseValid = 1 << 1;		// poseIsValid
+	const uint32_t DeviceStatus_RunningOk = 1 << 2;		// result is TrackingResult_Running_OK
+
+	// One device in the reply of getAllDeviceInfo
+	struct DeviceInfoEntry
+	{
+		uint32_t OpenVRId;
+		vr::ETrackedDeviceClass deviceClass;
+		MotionCompensationDeviceMode deviceMode;
+		uint32_t Status;				// DeviceStatus_ bits, 0 before the first pose
+		uint64_t SerialHash;			// hashSerialNumber of the serial number, tells a new device in the same slot apart
+	};
+
+	// The devices the driver manipulates, ordered by OpenVR id. Generation changes whenever a device is added or
+	// removed or its mode or status changes, and is never 0
+	struct DeviceInfoList
+	{
+		uint32_t Generation;
+		uint32_t Count;
+		DeviceInfoEntry Devices[64];	// vr::k_unMaxTrackedDeviceCount
+	};
+
+	// Events the driver pushes to the clients that subscribed to them
+	enum class DeviceEventType : uint32_t
+	{
+		None = 0,
+		DeviceAdded = 1,				// The device's driver added it, OpenVRId is not known yet
+		DeviceActivated = 2,			// The device got its OpenVR id
+		DeviceDeactivated = 3,
+		DeviceRemoved = 4,
+		ModeChanged = 5,				// deviceMode is the new mode
+		StatusChanged = 6,				// The DeviceStatus_ bits of the device's poses changed
+		ReferenceTrackingLost = 7,		// A reference tracker reported a pose that is not valid or not Running_OK
+		ReferenceTrackingRegained = 8,
+		ZeroPoseSet = 9,				// The zero pose calibration accepted a window, or the rig pose became the zero pose
+	};
+
+	// Bits of the mask of a subscription
+	inline uint32_t deviceEventBit(DeviceEventType type)
+	{
+		return 1u << (uint32_t)type;
+	}
+
+	const uint32_t DeviceEventMask_All = ((1u << 10) - 1) & ~1u;
+
+	struct DeviceEvent
+	{
+		DeviceEventType Type;
+		uint32_t OpenVRId;				// vr::k_unTrackedDeviceIndexInvalid if there is no device or it has no id yet
+		vr::ETrackedDeviceClass deviceClass;
+		MotionCompensationDeviceMode deviceMode;
+		uint32_t Status;				// DeviceStatus_ bits
+		uint32_t Generation;			// Of the device infos after the event, see DeviceInfoList
+		uint64_t SerialHash;			// 0 if there is no device
+		int64_t TimeNs;					// Steady clock of the driver when the event happened
+	};
+
+	// 64 bit FNV-1a of a serial number
+	inline uint64_t hashSerialNumber(const char* serial)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (; *serial; serial++)
+		{
+			hash = (hash ^ (uint8_t)*serial) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// The zero pose of the reference tracker is the mean of a window of samples
+	struct ZeroPoseCalibrationSettings
+	{
+		uint32_t Samples;				// Window size, 1 takes the first sample like before
+		double MaxPositionDeviation;	// Largest RMS deviation of the window's inliers from their mean, meters. 0 for no limit
+		double MaxRotationDeviation;	// Same for the rotation, radians
+	};
+
+	enum class ZeroPoseCalibrationState : uint32_t
+	{
+		Idle = 0,		// No sample since the zero pose was reset, or the reference is the rig pose
+		Collecting = 1,
+		Done = 2,		// The zero pose is set
+	};
+
+	struct ZeroPoseCalibrationStatus
+	{
+		ZeroPoseCalibrationState State;
+		uint32_t Samples;				// Samples in the current window
+		uint32_t WindowSize;
+		uint32_t Windows;				// Windows evaluated since the calibration started, the rejected ones and the accepted one
+		uint32_t Inliers;				// Of the last evaluated window
+		double PositionDeviation;		// RMS deviation of the last evaluated window's inliers, meters
+		double RotationDeviation;		// Radians
+	};
+
+	// The driver keeps the last seconds of reference and device poses in memory and writes them into a capture
+	// (FlightRecorder-<time>-<trigger>.vrmccap) when asked to or when one of the anomalies below shows up
+	struct FlightRecorderSettings
+	{
+		bool Enabled;
+		uint32_t Seconds;				// Poses before the trigger that go into a dump
+		uint32_t PostTriggerMs;			// Poses after the trigger that go into a dump
+		double MaxPositionJump;			// Meters between two consecutive poses of a device or of the reference, 0 disables the trigger
+		double MaxCompensationDelta;	// Meters between a device pose and its compensated pose, 0 disables the trigger
+		bool DumpOnTrackingLost;		// A compensated device or a reference tracker stops tracking
+	};
+
+	enum class FlightRecorderTrigger : uint32_t
+	{
+		None = 0,
+		Request = 1,			// IPC request, e.g. the overlay shortcut
+		PositionJump = 2,
+		TrackingLost = 3,
+		CompensationDelta = 4,
+	};
+
+	// Stages of a pose update the driver times, each device has a latency histogram per stage
+	enum class LatencyStage : uint32_t
+	{
+		PoseUpdated = 0,			// The whole TrackedDevicePoseUpdated hook, from the driver's point of view
+		HandlePoseUpdate = 1,		// The part of the device, without looking it up
+		UpdateReference = 2,		// A reference tracker pose going into the filter
+		ApplyCompensation = 3,		// Compensating a device pose
+	};
+
+	const uint32_t LatencyStageCount = 4;
+
+	// Latency of one stage since the driver started or the statistics were reset. A percentile is the upper
+	// edge of its histogram bucket, at most 1/32 above the true value
+	struct LatencyStatistics
+	{
+		uint64_t Count;
+		uint64_t P50Ns;
+		uint64_t P90Ns;
+		uint64_t P99Ns;
+		uint64_t P999Ns;
+		uint64_t MaxNs;
+	};
+
+	// Indexed by LatencyStage
+	struct DeviceLatencyStatistics
+	{
+		LatencyStatistics Stages[LatencyStageCount];
+	};
+
+	// Pose updates of one device since the driver started or the statistics were reset
+	struct PoseStatistics_v1
+	{
+		uint32_t OpenVRId;
+		uint32_t Reserved;
+		uint64_t Count;					// Pose updates the device's driver reported
+		uint64_t InvalidCount;			// Poses with poseIsValid false
+		uint64_t NotRunningOkCount;		// Poses with another result than TrackingResult_Running_OK
+		double RateHz;					// Average update rate between the first and the last pose
+		double TimeOffsetMinS;			// poseTimeOffset of the valid poses with its sign, in seconds
+		double TimeOffsetMaxS;
+		double TimeOffsetMeanS;
+		LatencyStatistics Interval;		// Time between two pose updates
+		LatencyStatistics TimeOffset;	// Magnitude of poseTimeOffset of the valid poses
+	};
+
+	// Pose statistics of all devices in their own shared memory, published by the driver a few times a second.
+	// Readers open it read-only
+	static const char* const PoseStatisticsSharedMemoryName = "OVRMC_PoseStatistics_v1";
+	const uint32_t PoseStatisticsMagic = 0x534D5652;	// "RVMS"
+	const uint32_t PoseStatisticsVersion = 1;
+	const uint32_t PoseStatisticsDeviceCount = 64;		// vr::k_unMaxTrackedDeviceCount
+
+	// Same sequence counter protocol as MMFstruct_OVRMC_RigPose_v1, guarding TimeNs and Devices.
+	// Devices is indexed by OpenVR id, devices without a pose have a Count of 0
+	struct MMFstruct_OVRMC_PoseStatistics_v1
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t DeviceCount;
+		uint32_t EntrySize;
+		uint32_t Sequence;
+		uint32_t Reserved_int;
+		int64_t TimeNs;				// Steady clock when the statistics were published
+		uint64_t Reserved[4];
+		PoseStatistics_v1 Devices[PoseStatisticsDeviceCount];
+	};
+
 	struct MMFstruct_OVRMC_v1
 	{
 		/*#define FLAG_ENABLE_MC		0
@@ -48,4 +252,139 @@ namespace vrmotioncompensation
 		}
 	};
 
+	// Rig pose block in the OVRMC_MMFv1 shared memory, RigPoseBlockOffset bytes from its start.
+	// Written by the motion rig software, read by the driver in MotionCompensationMode::RigPose.
+	const uint32_t RigPoseBlockOffset = 1024;
+	const uint32_t RigPoseMagic = 0x504D5652;	// "RVMP"
+	const uint32_t RigPoseVersion = 1;
+
+	// Bits of RigPose_v1::Flags
+	const uint32_t RigPoseFlag_Valid = 1 << 0;			// The pose may be used. Without it the driver keeps the last pose
+	const uint32_t RigPoseFlag_Derivatives = 1 << 1;	// Velocity and AngularVelocity are set
+
+	struct RigPose_v1
+	{
+		int64_t TimestampUs;				// Sample time in microseconds since the system clock epoch, 0 for "now"
+		uint32_t Flags;
+		uint32_t Reserved;
+		vr::HmdVector3d_t Position;			// Rig platform in tracking space, meters
+		vr::HmdQuaternion_t Rotation;		// Rig platform in tracking space, unit quaternion
+		vr::HmdVector3d_t Velocity;			// m/s, tracking space
+		vr::HmdVector3d_t AngularVelocity;	// rad/s, tracking space
+	};
+
+	// Sequence counter protocol: the writer increments Sequence to an odd value, writes Pose and increments
+	// Sequence to the next even value, with release ordering on both increments. A reader that sees an odd
+	// Sequence, or a different Sequence after copying Pose, discards the copy. Magic and Version are written
+	// once, before the first pose.
+	struct MMFstruct_OVRMC_RigPose_v1
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t Sequence;
+		uint32_t Reserved_int;
+		RigPose_v1 Pose;
+		double Reserved_double[8];
+	};
+
+	// Settings block in the OVRMC_MMFv1 shared memory, SettingsBlockOffset bytes from its start. Lets rig software
+	// change the filter settings and offsets at a high rate without an ipc request. The driver takes new settings
+	// on the reference update path, checks them and applies the fields the writer controls.
+	const uint32_t SettingsBlockOffset = 2048;
+	const uint32_t SettingsMagic = 0x53435652;	// "RVCS"
+	const uint32_t SettingsVersion = 1;
+
+	// Bits of MotionCompensationSettings_v1::Fields, the settings the writer controls. The others keep the values set over ipc
+	const uint32_t SettingsField_LpfBeta = 1 << 0;
+	const uint32_t SettingsField_Samples = 1 << 1;
+	const uint32_t SettingsField_SetZero = 1 << 2;
+	const uint32_t SettingsField_Filter = 1 << 3;		// FilterType and the Kalman and One Euro parameters
+	const uint32_t SettingsField_Offsets = 1 << 4;		// Same as setOffsets
+	const uint32_t SettingsField_All = (1 << 5) - 1;
+
+	struct MotionCompensationSettings_v1
+	{
+		uint32_t Fields;
+		uint32_t Samples;						// At least 1
+		double LpfBeta;							// 0 to 1
+		uint32_t SetZero;						// 0 or 1
+		MotionCompensationFilterType FilterType;
+		double KalmanProcessNoise;				// Greater than 0
+		double KalmanObservationNoise;			// Greater than 0
+		double KalmanPredictionMs;				// 0 to 1000
+		double OneEuroMinCutoff;				// Greater than 0, Hz
+		double OneEuroBeta;						// 0 or more
+		vr::HmdVector3d_t OffsetTranslation;	// MMFstruct_OVRMC_v1::Translation
+		vr::HmdVector3d_t OffsetRotation;		// MMFstruct_OVRMC_v1::Rotation
+		vr::HmdQuaternion_t OffsetQRotation;	// MMFstruct_OVRMC_v1::QRotation
+		double Reserved_double[8];
+	};
+
+	enum class SettingsStatus : uint32_t
+	{
+		None = 0,			// The driver has not taken settings from the block yet
+		Applied = 1,
+		InvalidValue = 2,	// A field the writer controls is out of range, none of the settings were applied
+	};
+
+	// Same sequence counter protocol as MMFstruct_OVRMC_RigPose_v1, guarding Settings. The writer inits the block.
+	// After the driver took the settings of a Sequence, it writes their Status and then that Sequence into
+	// AppliedSequence with release ordering. A writer reads AppliedSequence, Status and AppliedSequence again
+	struct MMFstruct_OVRMC_Settings_v1
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t Sequence;
+		uint32_t AppliedSequence;
+		uint32_t Status;				// SettingsStatus
+		uint32_t Reserved_int;
+		MotionCompensationSettings_v1 Settings;
+	};
+
+	// Telemetry ring in its own shared memory, written by the driver for every compensated pose.
+	// Readers open it read-only, the driver does not know about them and never waits for them.
+	static const char* const TelemetrySharedMemoryName = "OVRMC_Telemetry_v1";
+	const uint32_t TelemetryMagic = 0x544D5652;	// "RVMT"
+	const uint32_t TelemetryVersion = 1;
+	const uint32_t TelemetryEntryCount = 4096;
+	const uint32_t TelemetryNoDevice = 0xFFFFFFFF;
+
+	// Bits of TelemetryEntry_v1::Flags
+	const uint32_t TelemetryFlag_Compensated = 1 << 0;	// The reference was valid and the device pose was compensated
+	const uint32_t TelemetryFlag_DeviceTracking = 1 << 1;	// The device pose was valid and Running_OK
+
+	struct TelemetryPose_v1
+	{
+		vr::HmdVector3d_t Position;		// Tracking space, meters
+		vr::HmdQuaternion_t Rotation;	// Tracking space
+	};
+
+	struct TelemetryEntry_v1
+	{
+		uint64_t Sequence;			// 2 * index + 2 once the entry with that index is complete, odd while it is written
+		int64_t TimeNs;				// Steady clock when the entry was written (QueryPerformanceCounter on Windows)
+		int64_t DeviceSampleUs;		// Sample time of the device pose, microseconds on the system clock
+		int64_t RefSampleUs;		// Sample time of the newest reference pose, same clock
+		uint32_t DeviceId;			// OpenVR id of the device, TelemetryNoDevice if unknown
+		uint32_t Flags;
+		TelemetryPose_v1 RawReference;			// Newest reference pose before filtering
+		TelemetryPose_v1 FilteredReference;		// Filtered reference the compensation used, moved to the device sample time
+		TelemetryPose_v1 RawDevice;				// Device pose as reported by its driver
+		TelemetryPose_v1 CompensatedDevice;		// Device pose handed on to SteamVR
+	};
+
+	// Writers claim an index by incrementing WriteIndex and then fill the entry at index % EntryCount, guarded by
+	// its Sequence. A reader that finds another Sequence than 2 * index + 2 before or after copying an entry
+	// either has to wait for it (smaller) or has been lapped (larger).
+	struct MMFstruct_OVRMC_Telemetry_v1
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t EntryCount;
+		uint32_t EntrySize;
+		uint64_t WriteIndex;		// Number of entries claimed so far
+		uint64_t Reserved[5];
+		TelemetryEntry_v1 Entries[TelemetryEntryCount];
+	};
+
 } // end namespace vrmotioncompensation
\ No newline at end of file
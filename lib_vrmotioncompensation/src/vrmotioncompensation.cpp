@@ -1,5 +1,10 @@
 #include <vrmotioncompensation.h>
-#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <ipc_transport.h>
+#include <TelemetryRing.h>
+#include <PoseStatistics.h>
+#include <SettingsChannel.h>
+#include <boost/interprocess/windows_shared_memory.hpp>
+#include <algorithm>
 #include <cstdlib>
 #include <functional>
 #include <iostream>
@@ -25,13 +30,25 @@ namespace vrmotioncompensation
 		{
 			try
 			{
+				// Returns as soon as a reply arrives, the timeout only bounds how long disconnect waits for the thread
 				ipc::Reply message;
-				uint64_t recv_size;
-				unsigned priority;
-				boost::posix_time::ptime timeout = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(50);
-				if (_this->_ipcClientQueue->timed_receive(&message, sizeof(ipc::Reply), recv_size, priority, timeout))
+				uint32_t recv_size;
+				if (_this->_ipcClientQueue->receive(&message, sizeof(ipc::Reply), recv_size, 50))
 				{
-					if (recv_size == sizeof(ipc::Reply))
+					if (recv_size == sizeof(ipc::Reply) && message.type == ipc::ReplyType::DeviceEvent)
+					{
+						// Called without the lock, the callback may take locks of its own that a request holds
+						std::function<void(const DeviceEvent&)> callback;
+						{
+							std::lock_guard<std::recursive_mutex> lock(_this->_mutex);
+							callback = _this->_eventCallback;
+						}
+						if (callback)
+						{
+							callback(message.msg.deviceEvent.event);
+						}
+					}
+					else if (recv_size == sizeof(ipc::Reply))
 					{
 						std::lock_guard<std::recursive_mutex> lock(_this->_mutex);
 						auto i = _this->_ipcPromiseMap.find(message.messageId);
@@ -48,10 +65,6 @@ namespace vrmotioncompensation
 						}
 					}
 				}
-				else
-				{
-					std::this_thread::sleep_for(std::chrono::milliseconds(1));
-				}
 			}
 			catch (std::exception & ex)
 			{
@@ -75,14 +88,32 @@ namespace vrmotioncompensation
 		return _ipcServerQueue != nullptr;
 	}
 
-	void VRMotionCompensation::connect()
+	ipc::TransportType VRMotionCompensation::getTransport() const
+	{
+		return _ipcServerQueue ? _ipcServerQueue->getType() : ipc::TransportType::MessageQueue;
+	}
+
+	void VRMotionCompensation::connect(ipc::TransportType transport)
 	{
 		if (!_ipcServerQueue)
 		{
-		// Open server-side message queue
+		// Open server-side endpoint
 			try
 			{
-				_ipcServerQueue = new boost::interprocess::message_queue(boost::interprocess::open_only, _ipcServerQueueName.c_str());
+				try
+				{
+					_ipcServerQueue = ipc::openTransport(transport, _ipcServerQueueName).release();
+				}
+				catch (std::exception&)
+				{
+					if (transport == ipc::TransportType::MessageQueue)
+					{
+						throw;
+					}
+					// The driver could not create its ring, its message queue works all the same
+					transport = ipc::TransportType::MessageQueue;
+					_ipcServerQueue = ipc::openTransport(transport, _ipcServerQueueName).release();
+				}
 			}
 			catch (std::exception & e)
 			{
@@ -93,16 +124,10 @@ namespace vrmotioncompensation
 			}
 			// Append random number to client queue name (and hopefully no other client uses the same random number)
 			_ipcClientQueueName += std::to_string(_ipcRandomDist(_ipcRandomDevice));
-			// Open client-side message queue
+			// Open client-side endpoint of the same type
 			try
 			{
-				boost::interprocess::message_queue::remove(_ipcClientQueueName.c_str());
-				_ipcClientQueue = new boost::interprocess::message_queue(
-					boost::interprocess::create_only,
-					_ipcClientQueueName.c_str(),
-					100,					//max message number
-					sizeof(ipc::Reply)    //max message size
-				);
+				_ipcClientQueue = ipc::createTransport(transport, _ipcClientQueueName, sizeof(ipc::Reply)).release();
 			}
 			catch (std::exception & e)
 			{
@@ -123,13 +148,14 @@ namespace vrmotioncompensation
 			message.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
 			strncpy_s(message.msg.ipc_ClientConnect.queueName, _ipcClientQueueName.c_str(), 127);
 			message.msg.ipc_ClientConnect.queueName[127] = '\0';
+			message.msg.ipc_ClientConnect.transport = transport;
 			std::promise<ipc::Reply> respPromise;
 			auto respFuture = respPromise.get_future();
 			{
 				std::lock_guard<std::recursive_mutex> lock(_mutex);
 				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
 			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+			_ipcServerQueue->send(&message, sizeof(ipc::Request));
 			// Wait for response
 			auto resp = respFuture.get();
 			m_clientId = resp.msg.ipc_ClientConnect.clientId;
@@ -139,6 +165,11 @@ namespace vrmotioncompensation
 			}
 			if (resp.status != ipc::ReplyStatus::Ok)
 			{
+				if (_ipcThreadRunning)
+				{
+					_ipcThreadStop = true;
+					_ipcThread.join();
+				}
 				delete _ipcServerQueue;
 				_ipcServerQueue = nullptr;
 				delete _ipcClientQueue;
@@ -174,7 +205,7 @@ namespace vrmotioncompensation
 				std::lock_guard<std::recursive_mutex> lock(_mutex);
 				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
 			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+			_ipcServerQueue->send(&message, sizeof(ipc::Request));
 			auto resp = respFuture.get();
 			m_clientId = resp.msg.ipc_ClientConnect.clientId;
 			{
@@ -187,7 +218,7 @@ namespace vrmotioncompensation
 				_ipcThreadStop = true;
 				_ipcThread.join();
 			}
-			// delete message queues
+			// delete endpoints
 			if (_ipcServerQueue)
 			{
 				delete _ipcServerQueue;
@@ -219,7 +250,7 @@ namespace vrmotioncompensation
 					std::lock_guard<std::recursive_mutex> lock(_mutex);
 					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
 				}
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
 				auto resp = respFuture.get();
 				{
 					std::lock_guard<std::recursive_mutex> lock(_mutex);
@@ -244,7 +275,7 @@ namespace vrmotioncompensation
 				{
 					message.msg.ipc_Ping.messageId = 0;
 				}
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
 			}
 		}
 		else
@@ -276,7 +307,7 @@ namespace vrmotioncompensation
 			}
 
 			//Send message
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+			_ipcServerQueue->send(&message, sizeof(ipc::Request));
 
 			auto resp = respFuture.get();
 			{
@@ -348,7 +379,7 @@ namespace vrmotioncompensation
 				}
 
 				//Send message
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
 
 				auto resp = respFuture.get();
 				{
@@ -378,7 +409,154 @@ namespace vrmotioncompensation
 			}
 			else
 			{
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
+			}
+		}
+		else
+		{
+			throw vrmotioncompensation_connectionerror("No active connection.");
+		}
+	}
+
+	void VRMotionCompensation::setDeviceCompensation(uint32_t deviceId, bool compensated, const MotionCompensationDeviceOffset& offset, bool modal)
+	{
+		if (_ipcServerQueue)
+		{
+			//Create message
+			ipc::Request message(ipc::RequestType::DeviceManipulation_SetDeviceCompensation);
+			memset(&message.msg, 0, sizeof(message.msg));
+			message.msg.dm_SetDeviceCompensation.clientId = m_clientId;
+			message.msg.dm_SetDeviceCompensation.messageId = 0;
+			message.msg.dm_SetDeviceCompensation.OpenVRId = deviceId;
+			message.msg.dm_SetDeviceCompensation.compensated = compensated;
+			message.msg.dm_SetDeviceCompensation.offset = offset;
+
+			if (modal)
+			{
+				//Create random message ID
+				uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
+				message.msg.dm_SetDeviceCompensation.messageId = messageId;
+
+				//Allocate memory for the reply
+				std::promise<ipc::Reply> respPromise;
+				auto respFuture = respPromise.get_future();
+				{
+					std::lock_guard<std::recursive_mutex> lock(_mutex);
+					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
+				}
+
+				//Send message
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
+
+				auto resp = respFuture.get();
+				{
+					std::lock_guard<std::recursive_mutex> lock(_mutex);
+					_ipcPromiseMap.erase(messageId);
+				}
+
+				//If there was an error, notify the user
+				std::stringstream ss;
+				ss << "Error while setting device compensation: ";
+
+				if (resp.status == ipc::ReplyStatus::InvalidId)
+				{
+					ss << "Invalid device id";
+					throw vrmotioncompensation_invalidid(ss.str(), (int)resp.status);
+				}
+				else if (resp.status == ipc::ReplyStatus::NotFound)
+				{
+					ss << "Device not found";
+					throw vrmotioncompensation_notfound(ss.str(), (int)resp.status);
+				}
+				else if (resp.status == ipc::ReplyStatus::InvalidOperation)
+				{
+					ss << "Motion compensation is not enabled or the device is the reference tracker";
+					throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+				}
+				else if (resp.status != ipc::ReplyStatus::Ok)
+				{
+					ss << "Error code " << (int)resp.status;
+					throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+				}
+			}
+			else
+			{
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
+			}
+		}
+		else
+		{
+			throw vrmotioncompensation_connectionerror("No active connection.");
+		}
+	}
+
+	void VRMotionCompensation::setReferenceTrackers(const std::vector<uint32_t>& RTdeviceIds, const std::vector<double>& weights, bool modal)
+	{
+		if (_ipcServerQueue)
+		{
+			//Create message
+			ipc::Request message(ipc::RequestType::DeviceManipulation_SetReferenceTrackers);
+			memset(&message.msg, 0, sizeof(message.msg));
+			message.msg.dm_SetReferenceTrackers.clientId = m_clientId;
+			message.msg.dm_SetReferenceTrackers.messageId = 0;
+			message.msg.dm_SetReferenceTrackers.count = (uint32_t)RTdeviceIds.size();
+			for (size_t i = 0; i < RTdeviceIds.size() && i < MaxReferenceTrackers; i++)
+			{
+				message.msg.dm_SetReferenceTrackers.RTdeviceIds[i] = RTdeviceIds[i];
+				message.msg.dm_SetReferenceTrackers.weights[i] = i < weights.size() ? weights[i] : 1.0;
+			}
+
+			if (modal)
+			{
+				//Create random message ID
+				uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
+				message.msg.dm_SetReferenceTrackers.messageId = messageId;
+
+				//Allocate memory for the reply
+				std::promise<ipc::Reply> respPromise;
+				auto respFuture = respPromise.get_future();
+				{
+					std::lock_guard<std::recursive_mutex> lock(_mutex);
+					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
+				}
+
+				//Send message
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
+
+				auto resp = respFuture.get();
+				{
+					std::lock_guard<std::recursive_mutex> lock(_mutex);
+					_ipcPromiseMap.erase(messageId);
+				}
+
+				//If there was an error, notify the user
+				std::stringstream ss;
+				ss << "Error while setting the reference trackers: ";
+
+				if (resp.status == ipc::ReplyStatus::InvalidId)
+				{
+					ss << "Invalid device id";
+					throw vrmotioncompensation_invalidid(ss.str(), (int)resp.status);
+				}
+				else if (resp.status == ipc::ReplyStatus::NotFound)
+				{
+					ss << "Device not found";
+					throw vrmotioncompensation_notfound(ss.str(), (int)resp.status);
+				}
+				else if (resp.status == ipc::ReplyStatus::InvalidOperation)
+				{
+					ss << "Motion compensation is not enabled";
+					throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+				}
+				else if (resp.status != ipc::ReplyStatus::Ok)
+				{
+					ss << "Error code " << (int)resp.status;
+					throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+				}
+			}
+			else
+			{
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
 			}
 		}
 		else
@@ -387,7 +565,8 @@ namespace vrmotioncompensation
 		}
 	}
 
-	void VRMotionCompensation::setMoticonCompensationSettings(double LPF_Beta, uint32_t samples, bool setZero)
+	void VRMotionCompensation::setMoticonCompensationSettings(double LPF_Beta, uint32_t samples, bool setZero, MotionCompensationFilterType filterType,
+		double kalmanProcessNoise, double kalmanObservationNoise, double kalmanPredictionMs, double oneEuroMinCutoff, double oneEuroBeta)
 	{
 		if (_ipcServerQueue)
 		{
@@ -399,6 +578,12 @@ namespace vrmotioncompensation
 			message.msg.dm_SetMotionCompensationProperties.LPFBeta = LPF_Beta;
 			message.msg.dm_SetMotionCompensationProperties.samples = samples;
 			message.msg.dm_SetMotionCompensationProperties.setZero = setZero;
+			message.msg.dm_SetMotionCompensationProperties.filterType = filterType;
+			message.msg.dm_SetMotionCompensationProperties.kalmanProcessNoise = kalmanProcessNoise;
+			message.msg.dm_SetMotionCompensationProperties.kalmanObservationNoise = kalmanObservationNoise;
+			message.msg.dm_SetMotionCompensationProperties.kalmanPredictionMs = kalmanPredictionMs;
+			message.msg.dm_SetMotionCompensationProperties.oneEuroMinCutoff = oneEuroMinCutoff;
+			message.msg.dm_SetMotionCompensationProperties.oneEuroBeta = oneEuroBeta;
 
 			//Create random message ID
 			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
@@ -413,7 +598,7 @@ namespace vrmotioncompensation
 			}
 
 			//Send message
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+			_ipcServerQueue->send(&message, sizeof(ipc::Request));
 			WRITELOG(INFO, "MC message created sending to driver" << std::endl);
 
 			auto resp = respFuture.get();
@@ -462,7 +647,7 @@ namespace vrmotioncompensation
 			}
 
 			// Send message
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+			_ipcServerQueue->send(&message, sizeof(ipc::Request));
 			WRITELOG(INFO, "MC message created sending to driver" << std::endl);
 
 			auto resp = respFuture.get();
@@ -487,6 +672,110 @@ namespace vrmotioncompensation
 		}
 	}
 
+	void VRMotionCompensation::setZeroPoseCalibration(const ZeroPoseCalibrationSettings& settings, bool modal)
+	{
+		if (_ipcServerQueue)
+		{
+			//Create message
+			ipc::Request message(ipc::RequestType::DeviceManipulation_SetZeroPoseCalibration);
+			memset(&message.msg, 0, sizeof(message.msg));
+			message.msg.dm_SetZeroPoseCalibration.clientId = m_clientId;
+			message.msg.dm_SetZeroPoseCalibration.messageId = 0;
+			message.msg.dm_SetZeroPoseCalibration.settings = settings;
+
+			if (modal)
+			{
+				//Create random message ID
+				uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
+				message.msg.dm_SetZeroPoseCalibration.messageId = messageId;
+
+				//Allocate memory for the reply
+				std::promise<ipc::Reply> respPromise;
+				auto respFuture = respPromise.get_future();
+				{
+					std::lock_guard<std::recursive_mutex> lock(_mutex);
+					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
+				}
+
+				//Send message
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
+
+				auto resp = respFuture.get();
+				{
+					std::lock_guard<std::recursive_mutex> lock(_mutex);
+					_ipcPromiseMap.erase(messageId);
+				}
+
+				//If there was an error, notify the user
+				std::stringstream ss;
+				ss << "Error while setting the zero pose calibration: ";
+
+				if (resp.status == ipc::ReplyStatus::InvalidValue)
+				{
+					ss << "Invalid settings";
+					throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+				}
+				else if (resp.status != ipc::ReplyStatus::Ok)
+				{
+					ss << "Error code " << (int)resp.status;
+					throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+				}
+			}
+			else
+			{
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
+			}
+		}
+		else
+		{
+			throw vrmotioncompensation_connectionerror("No active connection.");
+		}
+	}
+
+	void VRMotionCompensation::getZeroPoseCalibration(ZeroPoseCalibrationStatus& status)
+	{
+		if (_ipcServerQueue)
+		{
+			//Create message
+			ipc::Request message(ipc::RequestType::DeviceManipulation_GetZeroPoseCalibration);
+			memset(&message.msg, 0, sizeof(message.msg));
+			message.msg.ovr_GenericClientMessage.clientId = m_clientId;
+
+			//Create random message ID
+			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
+			message.msg.ovr_GenericClientMessage.messageId = messageId;
+
+			//Allocate memory for the reply
+			std::promise<ipc::Reply> respPromise;
+			auto respFuture = respPromise.get_future();
+			{
+				std::lock_guard<std::recursive_mutex> lock(_mutex);
+				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
+			}
+
+			//Send message
+			_ipcServerQueue->send(&message, sizeof(ipc::Request));
+
+			auto resp = respFuture.get();
+			{
+				std::lock_guard<std::recursive_mutex> lock(_mutex);
+				_ipcPromiseMap.erase(messageId);
+			}
+
+			if (resp.status != ipc::ReplyStatus::Ok)
+			{
+				std::stringstream ss;
+				ss << "Error while getting the zero pose calibration: Error code " << (int)resp.status;
+				throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+			}
+			status = resp.msg.dm_zeroPoseCalibration.status;
+		}
+		else
+		{
+			throw vrmotioncompensation_connectionerror("No active connection.");
+		}
+	}
+
 	void VRMotionCompensation::setOffsets(MMFstruct_OVRMC_v1 offsets)
 	{
 		if (_ipcServerQueue)
@@ -512,7 +801,7 @@ namespace vrmotioncompensation
 			}
 
 			//Send message
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+			_ipcServerQueue->send(&message, sizeof(ipc::Request));
 
 			auto resp = respFuture.get();
 			{
@@ -536,7 +825,7 @@ namespace vrmotioncompensation
 		}
 	}
 
-	void VRMotionCompensation::startDebugLogger(bool enable, bool modal)
+	void VRMotionCompensation::startDebugLogger(bool enable, bool modal, uint32_t maxDebugPoints)
 	{
 		if (_ipcServerQueue)
 		{
@@ -546,6 +835,7 @@ namespace vrmotioncompensation
 			message.msg.dl_Settings.clientId = m_clientId;
 			message.msg.dl_Settings.messageId = 0;
 			message.msg.dl_Settings.enabled = enable;
+			message.msg.dl_Settings.MaxDebugPoints = maxDebugPoints;
 
 			if (modal)
 			{
@@ -562,7 +852,7 @@ namespace vrmotioncompensation
 				}
 
 				//Send message
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
 				WRITELOG(INFO, "DL message created sending to driver" << std::endl);
 
 				auto resp = respFuture.get();
@@ -588,7 +878,7 @@ namespace vrmotioncompensation
 			}
 			else
 			{
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
 				WRITELOG(INFO, "DL message created sending to driver" << std::endl);
 			}
 		}
@@ -597,4 +887,568 @@ namespace vrmotioncompensation
 			throw vrmotioncompensation_connectionerror("No active connection.");
 		}
 	}
+
+	void VRMotionCompensation::setFlightRecorder(const FlightRecorderSettings& settings, bool modal)
+	{
+		if (_ipcServerQueue)
+		{
+			//Create message
+			ipc::Request message(ipc::RequestType::FlightRecorder_Settings);
+			memset(&message.msg, 0, sizeof(message.msg));
+			message.msg.fr_Settings.clientId = m_clientId;
+			message.msg.fr_Settings.messageId = 0;
+			message.msg.fr_Settings.settings = settings;
+
+			if (modal)
+			{
+				//Create random message ID
+				uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
+				message.msg.fr_Settings.messageId = messageId;
+
+				//Allocate memory for the reply
+				std::promise<ipc::Reply> respPromise;
+				auto respFuture = respPromise.get_future();
+				{
+					std::lock_guard<std::recursive_mutex> lock(_mutex);
+					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
+				}
+
+				//Send message
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
+
+				auto resp = respFuture.get();
+				{
+					std::lock_guard<std::recursive_mutex> lock(_mutex);
+					_ipcPromiseMap.erase(messageId);
+				}
+
+				//If there was an error, notify the user
+				std::stringstream ss;
+				ss << "Error while setting the flight recorder: ";
+
+				if (resp.status == ipc::ReplyStatus::InvalidValue)
+				{
+					ss << "Invalid settings";
+					throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+				}
+				else if (resp.status != ipc::ReplyStatus::Ok)
+				{
+					ss << "Error code " << (int)resp.status;
+					throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+				}
+			}
+			else
+			{
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
+			}
+		}
+		else
+		{
+			throw vrmotioncompensation_connectionerror("No active connection.");
+		}
+	}
+
+	void VRMotionCompensation::dumpFlightRecorder(bool modal)
+	{
+		if (_ipcServerQueue)
+		{
+			//Create message
+			ipc::Request message(ipc::RequestType::FlightRecorder_Dump);
+			memset(&message.msg, 0, sizeof(message.msg));
+			message.msg.ovr_GenericClientMessage.clientId = m_clientId;
+			message.msg.ovr_GenericClientMessage.messageId = 0;
+
+			if (modal)
+			{
+				//Create random message ID
+				uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
+				message.msg.ovr_GenericClientMessage.messageId = messageId;
+
+				//Allocate memory for the reply
+				std::promise<ipc::Reply> respPromise;
+				auto respFuture = respPromise.get_future();
+				{
+					std::lock_guard<std::recursive_mutex> lock(_mutex);
+					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
+				}
+
+				//Send message
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
+
+				auto resp = respFuture.get();
+				{
+					std::lock_guard<std::recursive_mutex> lock(_mutex);
+					_ipcPromiseMap.erase(messageId);
+				}
+
+				//If there was an error, notify the user
+				std::stringstream ss;
+				ss << "Error while dumping the flight recorder: ";
+
+				if (resp.status == ipc::ReplyStatus::InvalidOperation)
+				{
+					ss << "The flight recorder is off";
+					throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+				}
+				else if (resp.status == ipc::ReplyStatus::AlreadyInUse)
+				{
+					ss << "A dump is still being written";
+					throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+				}
+				else if (resp.status != ipc::ReplyStatus::Ok)
+				{
+					ss << "Error code " << (int)resp.status;
+					throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+				}
+			}
+			else
+			{
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
+			}
+		}
+		else
+		{
+			throw vrmotioncompensation_connectionerror("No active connection.");
+		}
+	}
+
+	void VRMotionCompensation::getLatencyStatistics(uint32_t deviceId, DeviceLatencyStatistics& statistics, bool reset)
+	{
+		if (_ipcServerQueue)
+		{
+			//Create message
+			ipc::Request message(ipc::RequestType::DeviceManipulation_GetLatencyStatistics);
+			memset(&message.msg, 0, sizeof(message.msg));
+			message.msg.dm_GetLatencyStatistics.clientId = m_clientId;
+			message.msg.dm_GetLatencyStatistics.OpenVRId = deviceId;
+			message.msg.dm_GetLatencyStatistics.reset = reset;
+
+			//Create random message ID
+			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
+			message.msg.dm_GetLatencyStatistics.messageId = messageId;
+
+			//Allocate memory for the reply
+			std::promise<ipc::Reply> respPromise;
+			auto respFuture = respPromise.get_future();
+			{
+				std::lock_guard<std::recursive_mutex> lock(_mutex);
+				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
+			}
+
+			//Send message
+			_ipcServerQueue->send(&message, sizeof(ipc::Request));
+
+			auto resp = respFuture.get();
+			{
+				std::lock_guard<std::recursive_mutex> lock(_mutex);
+				_ipcPromiseMap.erase(messageId);
+			}
+
+			//If there was an error, notify the user
+			std::stringstream ss;
+			ss << "Error while getting latency statistics: ";
+
+			if (resp.status == ipc::ReplyStatus::InvalidId)
+			{
+				ss << "Invalid device id";
+				throw vrmotioncompensation_invalidid(ss.str());
+			}
+			else if (resp.status == ipc::ReplyStatus::NotFound)
+			{
+				ss << "Device not found";
+				throw vrmotioncompensation_notfound(ss.str());
+			}
+			else if (resp.status == ipc::ReplyStatus::InvalidOperation)
+			{
+				ss << "The driver was built without latency histograms";
+				throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+			}
+			else if (resp.status != ipc::ReplyStatus::Ok)
+			{
+				ss << "Error code " << (int)resp.status;
+				throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+			}
+			statistics = resp.msg.dm_latencyStatistics.statistics;
+		}
+		else
+		{
+			throw vrmotioncompensation_connectionerror("No active connection.");
+		}
+	}
+
+	void VRMotionCompensation::getPoseStatistics(uint32_t deviceId, PoseStatistics_v1& statistics, bool reset)
+	{
+		if (_ipcServerQueue)
+		{
+			//Create message
+			ipc::Request message(ipc::RequestType::DeviceManipulation_GetPoseStatistics);
+			memset(&message.msg, 0, sizeof(message.msg));
+			message.msg.dm_GetPoseStatistics.clientId = m_clientId;
+			message.msg.dm_GetPoseStatistics.OpenVRId = deviceId;
+			message.msg.dm_GetPoseStatistics.reset = reset;
+
+			//Create random message ID
+			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
+			message.msg.dm_GetPoseStatistics.messageId = messageId;
+
+			//Allocate memory for the reply
+			std::promise<ipc::Reply> respPromise;
+			auto respFuture = respPromise.get_future();
+			{
+				std::lock_guard<std::recursive_mutex> lock(_mutex);
+				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
+			}
+
+			//Send message
+			_ipcServerQueue->send(&message, sizeof(ipc::Request));
+
+			auto resp = respFuture.get();
+			{
+				std::lock_guard<std::recursive_mutex> lock(_mutex);
+				_ipcPromiseMap.erase(messageId);
+			}
+
+			//If there was an error, notify the user
+			std::stringstream ss;
+			ss << "Error while getting pose statistics: ";
+
+			if (resp.status == ipc::ReplyStatus::InvalidId)
+			{
+				ss << "Invalid device id";
+				throw vrmotioncompensation_invalidid(ss.str());
+			}
+			else if (resp.status == ipc::ReplyStatus::NotFound)
+			{
+				ss << "Device not found";
+				throw vrmotioncompensation_notfound(ss.str());
+			}
+			else if (resp.status != ipc::ReplyStatus::Ok)
+			{
+				ss << "Error code " << (int)resp.status;
+				throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+			}
+			statistics = resp.msg.dm_poseStatistics.statistics;
+		}
+		else
+		{
+			throw vrmotioncompensation_connectionerror("No active connection.");
+		}
+	}
+
+	bool VRMotionCompensation::getAllDeviceInfo(DeviceInfoList& devices, uint32_t knownGeneration)
+	{
+		if (_ipcServerQueue)
+		{
+			//Create message
+			ipc::Request message(ipc::RequestType::DeviceManipulation_GetAllDeviceInfo);
+			memset(&message.msg, 0, sizeof(message.msg));
+			message.msg.dm_GetAllDeviceInfo.clientId = m_clientId;
+			message.msg.dm_GetAllDeviceInfo.knownGeneration = knownGeneration;
+
+			//Create random message ID
+			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
+			message.msg.dm_GetAllDeviceInfo.messageId = messageId;
+
+			//Allocate memory for the reply
+			std::promise<ipc::Reply> respPromise;
+			auto respFuture = respPromise.get_future();
+			{
+				std::lock_guard<std::recursive_mutex> lock(_mutex);
+				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
+			}
+
+			//Send message
+			_ipcServerQueue->send(&message, sizeof(ipc::Request));
+
+			auto resp = respFuture.get();
+			{
+				std::lock_guard<std::recursive_mutex> lock(_mutex);
+				_ipcPromiseMap.erase(messageId);
+			}
+
+			//If there was an error, notify the user
+			if (resp.status != ipc::ReplyStatus::Ok)
+			{
+				std::stringstream ss;
+				ss << "Error while getting the device infos: Error code " << (int)resp.status;
+				throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+			}
+
+			const DeviceInfoList& reply = resp.msg.dm_allDeviceInfo.devices;
+			if (reply.Generation == knownGeneration)
+			{
+				return false;
+			}
+			devices.Generation = reply.Generation;
+			devices.Count = std::min<uint32_t>(reply.Count, sizeof(reply.Devices) / sizeof(reply.Devices[0]));
+			std::copy(reply.Devices, reply.Devices + devices.Count, devices.Devices);
+			return true;
+		}
+		else
+		{
+			throw vrmotioncompensation_connectionerror("No active connection.");
+		}
+	}
+
+	void VRMotionCompensation::subscribeEvents(uint32_t eventMask, bool modal)
+	{
+		if (_ipcServerQueue)
+		{
+			//Create message
+			ipc::Request message(ipc::RequestType::IPC_SubscribeEvents);
+			memset(&message.msg, 0, sizeof(message.msg));
+			message.msg.ipc_SubscribeEvents.clientId = m_clientId;
+			message.msg.ipc_SubscribeEvents.eventMask = eventMask;
+			if (modal)
+			{
+				//Create random message ID
+				uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
+				message.msg.ipc_SubscribeEvents.messageId = messageId;
+
+				//Allocate memory for the reply
+				std::promise<ipc::Reply> respPromise;
+				auto respFuture = respPromise.get_future();
+				{
+					std::lock_guard<std::recursive_mutex> lock(_mutex);
+					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
+				}
+
+				//Send message
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
+
+				auto resp = respFuture.get();
+				{
+					std::lock_guard<std::recursive_mutex> lock(_mutex);
+					_ipcPromiseMap.erase(messageId);
+				}
+
+				//If there was an error, notify the user
+				std::stringstream ss;
+				ss << "Error while subscribing to events: ";
+				if (resp.status == ipc::ReplyStatus::InvalidId)
+				{
+					ss << "Unknown client";
+					throw vrmotioncompensation_invalidid(ss.str());
+				}
+				else if (resp.status != ipc::ReplyStatus::Ok)
+				{
+					ss << "Error code " << (int)resp.status;
+					throw vrmotioncompensation_exception(ss.str(), (int)resp.status);
+				}
+			}
+			else
+			{
+				message.msg.ipc_SubscribeEvents.messageId = 0;
+				_ipcServerQueue->send(&message, sizeof(ipc::Request));
+			}
+		}
+		else
+		{
+			throw vrmotioncompensation_connectionerror("No active connection.");
+		}
+	}
+
+	void VRMotionCompensation::setEventCallback(std::function<void(const DeviceEvent&)> callback)
+	{
+		std::lock_guard<std::recursive_mutex> lock(_mutex);
+		_eventCallback = callback;
+	}
+
+	VRMotionCompensationTelemetry::~VRMotionCompensationTelemetry()
+	{
+		close();
+	}
+
+	void VRMotionCompensationTelemetry::open(bool skipBacklog)
+	{
+		if (!_region)
+		{
+			try
+			{
+				// The mapping lives as long as the driver or one of the readers keeps it open
+				boost::interprocess::windows_shared_memory shm(boost::interprocess::open_only, TelemetrySharedMemoryName, boost::interprocess::read_only);
+				_region = new boost::interprocess::mapped_region(shm, boost::interprocess::read_only);
+			}
+			catch (std::exception & e)
+			{
+				_region = nullptr;
+				std::stringstream ss;
+				ss << "Could not open the telemetry shared memory: " << e.what();
+				throw vrmotioncompensation_sharedmemoryerror(ss.str());
+			}
+
+			if (_region->get_size() < sizeof(MMFstruct_OVRMC_Telemetry_v1))
+			{
+				close();
+				throw vrmotioncompensation_sharedmemoryerror("The telemetry shared memory is too small");
+			}
+			_reader = new core::TelemetryReader();
+		}
+		_reader->attach(*static_cast<const MMFstruct_OVRMC_Telemetry_v1*>(_region->get_address()), skipBacklog);
+	}
+
+	bool VRMotionCompensationTelemetry::isOpen() const
+	{
+		return _region != nullptr;
+	}
+
+	void VRMotionCompensationTelemetry::close()
+	{
+		delete _reader;
+		_reader = nullptr;
+		delete _region;
+		_region = nullptr;
+	}
+
+	size_t VRMotionCompensationTelemetry::read(TelemetryEntry_v1* entries, size_t maxCount)
+	{
+		if (!_region)
+		{
+			return 0;
+		}
+		return _reader->read(*static_cast<const MMFstruct_OVRMC_Telemetry_v1*>(_region->get_address()), entries, maxCount);
+	}
+
+	uint64_t VRMotionCompensationTelemetry::getLostEntries() const
+	{
+		return _reader ? _reader->getLost() : 0;
+	}
+
+	VRMotionCompensationPoseStatistics::~VRMotionCompensationPoseStatistics()
+	{
+		close();
+	}
+
+	void VRMotionCompensationPoseStatistics::open()
+	{
+		if (_region)
+		{
+			return;
+		}
+
+		try
+		{
+			boost::interprocess::windows_shared_memory shm(boost::interprocess::open_only, PoseStatisticsSharedMemoryName, boost::interprocess::read_only);
+			_region = new boost::interprocess::mapped_region(shm, boost::interprocess::read_only);
+		}
+		catch (std::exception & e)
+		{
+			_region = nullptr;
+			std::stringstream ss;
+			ss << "Could not open the pose statistics shared memory: " << e.what();
+			throw vrmotioncompensation_sharedmemoryerror(ss.str());
+		}
+
+		if (_region->get_size() < sizeof(MMFstruct_OVRMC_PoseStatistics_v1))
+		{
+			close();
+			throw vrmotioncompensation_sharedmemoryerror("The pose statistics shared memory is too small");
+		}
+	}
+
+	bool VRMotionCompensationPoseStatistics::isOpen() const
+	{
+		return _region != nullptr;
+	}
+
+	void VRMotionCompensationPoseStatistics::close()
+	{
+		delete _region;
+		_region = nullptr;
+	}
+
+	bool VRMotionCompensationPoseStatistics::read(PoseStatistics_v1* devices, int64_t& timeNs)
+	{
+		if (!_region)
+		{
+			return false;
+		}
+		return core::PoseStatisticsReader::read(*static_cast<const MMFstruct_OVRMC_PoseStatistics_v1*>(_region->get_address()), devices, timeNs);
+	}
+
+	VRMotionCompensationSettings::~VRMotionCompensationSettings()
+	{
+		close();
+	}
+
+	void VRMotionCompensationSettings::open()
+	{
+		if (_region)
+		{
+			return;
+		}
+
+		try
+		{
+			boost::interprocess::windows_shared_memory shm(boost::interprocess::open_only, "OVRMC_MMFv1", boost::interprocess::read_write);
+			_region = new boost::interprocess::mapped_region(shm, boost::interprocess::read_write);
+		}
+		catch (std::exception & e)
+		{
+			_region = nullptr;
+			std::stringstream ss;
+			ss << "Could not open the OVRMC_MMFv1 shared memory: " << e.what();
+			throw vrmotioncompensation_sharedmemoryerror(ss.str());
+		}
+
+		if (_region->get_size() < SettingsBlockOffset + sizeof(MMFstruct_OVRMC_Settings_v1))
+		{
+			close();
+			throw vrmotioncompensation_sharedmemoryerror("The OVRMC_MMFv1 shared memory is too small for the settings block");
+		}
+
+		auto block = reinterpret_cast<MMFstruct_OVRMC_Settings_v1*>(static_cast<char*>(_region->get_address()) + SettingsBlockOffset);
+		if (block->Magic != SettingsMagic || block->Version != SettingsVersion)
+		{
+			core::SettingsWriter::init(*block);
+		}
+	}
+
+	bool VRMotionCompensationSettings::isOpen() const
+	{
+		return _region != nullptr;
+	}
+
+	void VRMotionCompensationSettings::close()
+	{
+		delete _region;
+		_region = nullptr;
+	}
+
+	uint32_t VRMotionCompensationSettings::write(const MotionCompensationSettings_v1& settings)
+	{
+		if (!_region)
+		{
+			return 0;
+		}
+		auto block = reinterpret_cast<MMFstruct_OVRMC_Settings_v1*>(static_cast<char*>(_region->get_address()) + SettingsBlockOffset);
+		return core::SettingsWriter::write(*block, settings);
+	}
+
+	bool VRMotionCompensationSettings::getStatus(uint32_t& appliedSequence, SettingsStatus& status)
+	{
+		if (!_region)
+		{
+			return false;
+		}
+		auto block = reinterpret_cast<const MMFstruct_OVRMC_Settings_v1*>(static_cast<const char*>(_region->get_address()) + SettingsBlockOffset);
+		return core::SettingsWriter::readStatus(*block, appliedSequence, status);
+	}
+
+	SettingsStatus VRMotionCompensationSettings::waitForStatus(uint32_t sequence, uint32_t timeoutMs)
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+		do
+		{
+			uint32_t appliedSequence;
+			SettingsStatus status;
+			// The sequence numbers wrap around
+			if (getStatus(appliedSequence, status) && appliedSequence != 0 && (int32_t)(appliedSequence - sequence) >= 0)
+			{
+				return status;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		} while (std::chrono::steady_clock::now() < deadline);
+		return SettingsStatus::None;
+	}
 } // end namespace vrmotioncompensation
\ No newline at end of file